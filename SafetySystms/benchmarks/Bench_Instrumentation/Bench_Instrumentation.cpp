@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+#include "BenchSupport.h"
+#include "SafetyRules/SafetyRules.h"
+
+#include <cstdint>
+#include <vector>
+
+// SafetyRules hot path with SAFETY_INSTRUMENTATION as configured for this binary
+// (see CMakeLists.txt: built once with it off and once with it on).
+
+namespace Bench_Instrumentation_Namespace
+{
+
+   using namespace Bench_SafetyRules_Namespace;
+
+   // Arg: 0 = no callbacks installed, 1 = every hook installed (and, when on, timed)
+   void BM_LoaderCycle(benchmark::State& state)
+   {
+       SafetyRules uut;
+       std::uint64_t hits = 0;
+
+       if (state.range(0))
+       {
+           installCounters(uut, hits);
+       }
+
+       for (auto _ : state)
+       {
+           runCycle(uut);
+       }
+
+       benchmark::DoNotOptimize(hits);
+       state.SetItemsProcessed(state.iterations() * 6);
+   }
+
+   void BM_RandomEvents(benchmark::State& state)
+   {
+       SafetyRules uut;
+       std::uint64_t hits = 0;
+
+       if (state.range(0))
+       {
+           installCounters(uut, hits);
+       }
+
+       const auto events = randomEvents(4096);
+
+       for (auto _ : state)
+       {
+           for (Ev ev : events)
+           {
+               uut.dispatch(ev);
+           }
+       }
+
+       benchmark::DoNotOptimize(hits);
+       state.SetItemsProcessed(state.iterations() * events.size());
+   }
+
+   BENCHMARK(BM_LoaderCycle)->Arg(0)->Arg(1);
+   BENCHMARK(BM_RandomEvents)->Arg(0)->Arg(1);
+
+   // Compiled out, the machine carries nothing extra
+   static_assert(SAFETY_INSTRUMENTATION || sizeof(SafetyRules) == 2 * sizeof(void*) + (11 + 4) * sizeof(ISafetyRules::VoidFn),
+                 "Instrumentation must add no state when compiled out");
+
+   const bool context = []() {
+       benchmark::AddCustomContext("safety_instrumentation", SAFETY_INSTRUMENTATION ? "on" : "off");
+       return true;
+   }();
+
+}
+
+BENCHMARK_MAIN();
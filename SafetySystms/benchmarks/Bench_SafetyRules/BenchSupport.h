@@ -0,0 +1,196 @@
+#pragma once
+#include "CrudeSafetyRules/BoxLog.h"
+#include "CrudeSafetyRules/CrudeSafetyRules.h"
+#include "SafetyRules/ISafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <streambuf>
+#include <vector>
+
+namespace Bench_SafetyRules_Namespace
+{
+
+   using namespace safety;
+
+   using Ev = ISafetyRules::Event;
+
+   // ----- Shared workloads
+
+   // Loader cycle: power on, load a plate, power off
+   inline void runCycle(ISafetyRules& uut)
+   {
+       uut.dispatch(Ev::evPowerOn);
+       uut.startLoader();
+       uut.dispatch(Ev::evDoorOpened);
+       uut.dispatch(Ev::evBuildPlateLoaded);
+       uut.dispatch(Ev::evDoorClosed);
+       uut.dispatch(Ev::evPowerOff);
+   }
+
+   // Uniformly random events: mostly ignored ones, which is what noisy sensors produce
+   inline std::vector<Ev> randomEvents(std::size_t count)
+   {
+       std::mt19937 rng(1234);
+       std::uniform_int_distribution<int> pick(0, 5);
+
+       std::vector<Ev> events(count);
+
+       for (auto& ev : events)
+       {
+           ev = static_cast<Ev>(pick(rng));
+       }
+
+       return events;
+   }
+
+   template <typename Rules>
+   void installCounters(Rules& uut, std::uint64_t& hits)
+   {
+       auto count = [&hits]() { ++hits; };
+
+       uut.setOnEnterIdle(count);
+       uut.setOnExitIdle(count);
+       uut.setOnEnterActive(count);
+       uut.setOnExitActive(count);
+       uut.setOnEnterFaulted(count);
+       uut.setOnExitFaulted(count);
+       uut.setOnEnterBuildPlateLoader(count);
+       uut.setOnExitBuildPlateLoader(count);
+       uut.setOnRequestDoorOpen(count);
+       uut.setOnRequestLoadBuildPlate(count);
+       uut.setOnRequestDoorClose(count);
+   }
+
+   // ----- Driving any engine by Trigger
+
+   inline void fire(ISafetyRules& uut, Trigger trigger)
+   {
+       if (trigger == Trigger::StartLoader)
+       {
+           uut.startLoader();
+       }
+       else
+       {
+           uut.dispatch(static_cast<Ev>(trigger));
+       }
+   }
+
+   // SafetyBox commands: 0=powerOn, 1=powerOff, 2=fault, 3=start, 4=doorOpened, 5=plateArrived, 6=doorClosed
+   inline int toCommand(Trigger trigger)
+   {
+       switch (trigger)
+       {
+           case Trigger::evPowerOn:          return 0;
+           case Trigger::evPowerOff:         return 1;
+           case Trigger::evFault:            return 2;
+           case Trigger::StartLoader:        return 3;
+           case Trigger::evDoorOpened:       return 4;
+           case Trigger::evBuildPlateLoaded: return 5;
+           case Trigger::evDoorClosed:       return 6;
+           case Trigger::Reset:              return 1; // powerOff resets mode and step
+       }
+
+       return -1;
+   }
+
+   inline void fire(SafetyBox& box, Trigger trigger)
+   {
+       box.run(toCommand(trigger));
+   }
+
+   // Shortest trigger path from a fresh machine to each reachable configuration
+   inline std::vector<Trigger> pathTo(Config config)
+   {
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+
+       std::vector<Trigger> path;
+
+       if (stateOf(config) == State::Idle)
+       {
+           return path;
+       }
+
+       path.push_back(Trigger::evPowerOn);
+
+       if (stateOf(config) == State::Faulted)
+       {
+           path.push_back(Trigger::evFault);
+       }
+
+       if (stateOf(config) == State::BuildPlateLoader)
+       {
+           path.push_back(Trigger::StartLoader);
+
+           if (subOf(config) != Sub::OpenDoor)
+           {
+               path.push_back(Trigger::evDoorOpened);
+           }
+
+           if (subOf(config) == Sub::BuildPlateLoaded)
+           {
+               path.push_back(Trigger::evBuildPlateLoaded);
+           }
+       }
+
+       return path;
+   }
+
+   inline void driveTo(ISafetyRules& uut, const std::vector<Trigger>& path)
+   {
+       uut.reset();
+
+       for (Trigger t : path)
+       {
+           fire(uut, t);
+       }
+   }
+
+   inline void driveTo(SafetyBox& box, const std::vector<Trigger>& path)
+   {
+       box.run(1); // powerOff resets mode and step from anywhere
+
+       for (Trigger t : path)
+       {
+           fire(box, t);
+       }
+   }
+
+   // ----- SafetyBox prints every command; measure formatting and flushing
+   //       into a discarding buffer rather than the terminal
+   class NullBuffer : public std::streambuf
+   {
+      protected:
+          int overflow(int ch) override
+          {
+              return ch;
+          }
+
+          std::streamsize xsputn(const char*, std::streamsize n) override
+          {
+              return n;
+          }
+   };
+
+   class QuietStdout
+   {
+      public:
+          QuietStdout()
+              : saved(std::cout.rdbuf(&sink))
+          {
+          }
+
+          ~QuietStdout()
+          {
+              std::cout.rdbuf(saved);
+          }
+
+      private:
+          NullBuffer      sink;
+          std::streambuf* saved;
+   };
+
+}
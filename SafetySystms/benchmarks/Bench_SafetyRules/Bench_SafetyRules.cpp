@@ -0,0 +1,1125 @@
+#include <benchmark/benchmark.h>
+#include "BenchSupport.h"
+#include "ChartSafetyRules/ChartSafetyRules.h"
+#include "SafetyChannel/EventChannel.h"
+#include "SafetyCheckpoint/SafetyCheckpoint.h"
+#include "SafetyDispatcher/FleetDispatcher.h"
+#include "SafetyDispatcher/HdrHistogram.h"
+#include "SafetyDispatcher/LatencyTracer.h"
+#include "SafetyDispatcher/SafetyDispatcher.h"
+#include "SafetyRules/BasicSafetyRules.h"
+#include "SafetyRules/HookTable.h"
+#include "SafetyFleet/SafetyFleet.h"
+#include "SafetyRules/SafetyRules.h"
+#include "SafetyScan/SafetyScan.h"
+#include "SafetySnapshot/SafetySnapshot.h"
+#include "SafetyTimers/TimingWheel.h"
+#include "SwitchSafetyRules.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace Bench_SafetyRules_Namespace
+{
+
+   template <typename Rules>
+   void BM_LoaderCycle(benchmark::State& state)
+   {
+       Rules uut;
+       std::uint64_t hits = 0;
+
+       if (state.range(0))
+       {
+           installCounters(uut, hits);
+       }
+
+       for (auto _ : state)
+       {
+           runCycle(uut);
+       }
+
+       benchmark::DoNotOptimize(hits);
+       state.SetItemsProcessed(state.iterations() * 6);
+   }
+
+   template <typename Rules>
+   void BM_RandomEvents(benchmark::State& state)
+   {
+       const auto events = randomEvents(1 << 20);
+
+       Rules uut;
+       std::uint64_t hits = 0;
+       ISafetyRules& rules = uut;
+
+       if (state.range(0))
+       {
+           installCounters(uut, hits);
+       }
+
+       std::size_t i = 0;
+
+       for (auto _ : state)
+       {
+           if ((i & 63) == 0)
+           {
+               rules.startLoader();
+           }
+
+           rules.dispatch(events[i++ & ((1 << 20) - 1)]);
+       }
+
+       benchmark::DoNotOptimize(hits);
+       state.SetItemsProcessed(state.iterations());
+   }
+
+   // ----- Hook storage: std::function (the previous VoidFn) against the inline Delegate
+   using StdVoidFn = std::function<void()>;
+   using Delegate  = ISafetyRules::VoidFn;
+
+   template <typename Fn>
+   void BM_HookSet(benchmark::State& state)
+   {
+       std::array<Fn, 11> hooks;
+       std::uint64_t hits = 0;
+
+       for (auto _ : state)
+       {
+           for (auto& hook : hooks)
+           {
+               hook = [&hits]() { ++hits; };
+           }
+
+           benchmark::ClobberMemory();
+       }
+
+       state.counters["slot_bytes"] = sizeof(Fn);
+       state.counters["object_bytes"] = sizeof(void*) + sizeof(void*) + 11 * sizeof(Fn);
+       state.SetItemsProcessed(state.iterations() * 11);
+   }
+
+   template <typename Fn>
+   void BM_HookCall(benchmark::State& state)
+   {
+       std::array<Fn, 11> hooks;
+       std::uint64_t hits = 0;
+
+       for (auto& hook : hooks)
+       {
+           hook = [&hits]() { ++hits; };
+       }
+
+       for (auto _ : state)
+       {
+           // Keep the targets opaque, as they are behind SafetyRules
+           benchmark::DoNotOptimize(hooks.data());
+           benchmark::ClobberMemory();
+
+           for (const auto& hook : hooks)
+           {
+               if (hook) hook();
+           }
+       }
+
+       benchmark::DoNotOptimize(hits);
+       state.SetItemsProcessed(state.iterations() * 11);
+   }
+
+   BENCHMARK_TEMPLATE(BM_HookSet, StdVoidFn);
+   BENCHMARK_TEMPLATE(BM_HookSet, Delegate);
+
+   BENCHMARK_TEMPLATE(BM_HookCall, StdVoidFn);
+   BENCHMARK_TEMPLATE(BM_HookCall, Delegate);
+
+   // Arg: 0 = no callbacks installed, 1 = every hook installed
+   BENCHMARK_TEMPLATE(BM_LoaderCycle, SwitchSafetyRules)->Arg(0)->Arg(1);
+   BENCHMARK_TEMPLATE(BM_LoaderCycle, SafetyRules)->Arg(0)->Arg(1);
+   BENCHMARK_TEMPLATE(BM_LoaderCycle, ChartSafetyRules)->Arg(0)->Arg(1);
+
+   BENCHMARK_TEMPLATE(BM_RandomEvents, SwitchSafetyRules)->Arg(0)->Arg(1);
+   BENCHMARK_TEMPLATE(BM_RandomEvents, SafetyRules)->Arg(0)->Arg(1);
+   BENCHMARK_TEMPLATE(BM_RandomEvents, ChartSafetyRules)->Arg(0)->Arg(1);
+
+   // ----- Call path: the loader cycle plus a state read per step, through the
+   //       ISafetyRules vtable (pointer kept opaque so it cannot be devirtualized)
+   //       against BasicSafetyRules with compile-time hooks. Same counting work per hook.
+   struct CountingHooks
+   {
+       std::uint64_t hits { 0 };
+
+       void fire(Hook) { ++hits; }
+       void stepped(Trigger, Config) {}
+   };
+
+   template <typename Machine>
+   unsigned cycleWithReads(Machine& m)
+   {
+       unsigned states = 0;
+
+       m.dispatch(Ev::evPowerOn);                 states += static_cast<unsigned>(m.getState());
+       m.startLoader();                           states += static_cast<unsigned>(m.getState());
+       m.dispatch(Ev::evDoorOpened);              states += static_cast<unsigned>(m.getState());
+       m.dispatch(Ev::evBuildPlateLoaded);        states += static_cast<unsigned>(m.getState());
+       m.dispatch(Ev::evDoorClosed);              states += static_cast<unsigned>(m.getState());
+       m.dispatch(Ev::evPowerOff);                states += static_cast<unsigned>(m.getState());
+
+       return states;
+   }
+
+   void BM_CallPathVirtual(benchmark::State& state)
+   {
+       SafetyRules uut;
+       std::uint64_t hits = 0;
+       installCounters(uut, hits);
+
+       ISafetyRules* rules = &uut;
+       benchmark::DoNotOptimize(rules);
+
+       for (auto _ : state)
+       {
+           benchmark::DoNotOptimize(cycleWithReads(*rules));
+       }
+
+       benchmark::DoNotOptimize(hits);
+       state.SetItemsProcessed(state.iterations() * 6);
+   }
+
+   template <typename Hooks>
+   void BM_CallPathInlined(benchmark::State& state)
+   {
+       BasicSafetyRules<Hooks> uut;
+
+       for (auto _ : state)
+       {
+           benchmark::DoNotOptimize(cycleWithReads(uut));
+       }
+
+       benchmark::DoNotOptimize(uut.hooks());
+       state.SetItemsProcessed(state.iterations() * 6);
+   }
+
+   BENCHMARK(BM_CallPathVirtual);
+   BENCHMARK_TEMPLATE(BM_CallPathInlined, CountingHooks);
+   BENCHMARK_TEMPLATE(BM_CallPathInlined, NoHooks);
+
+   // ----- Loader simulator: request hooks answer from inside the hook, so every
+   //       reply goes through the deferred queue. One startLoader() runs the cycle.
+   void BM_LoaderSimulator(benchmark::State& state)
+   {
+       SafetyRules uut;
+
+       uut.setOnRequestDoorOpen([&uut] { uut.dispatch(Ev::evDoorOpened); });
+       uut.setOnRequestLoadBuildPlate([&uut] { uut.dispatch(Ev::evBuildPlateLoaded); });
+       uut.setOnRequestDoorClose([&uut] { uut.dispatch(Ev::evDoorClosed); });
+
+       uut.dispatch(Ev::evPowerOn);
+
+       for (auto _ : state)
+       {
+           uut.startLoader();
+           benchmark::DoNotOptimize(uut.getState());
+       }
+
+       if (uut.deferredOverflow())
+       {
+           state.SkipWithError("deferred queue overflow");
+       }
+
+       state.SetItemsProcessed(state.iterations() * 4);
+   }
+
+   BENCHMARK(BM_LoaderSimulator);
+
+   // ----- Seqlock snapshot: the loader cycle with every transition published, with
+   //       range(0) reader threads polling the snapshot the whole time
+   void BM_SnapshotPublish(benchmark::State& state)
+   {
+       SafetyRules uut;
+       SafetySnapshot snapshot;
+       snapshot.attach(uut);
+
+       std::atomic<bool> done { false };
+       std::atomic<std::uint64_t> reads { 0 };
+       std::vector<std::thread> readers;
+
+       for (int r = 0; r < state.range(0); ++r)
+       {
+           readers.emplace_back([&]() {
+               SnapshotReader reader(snapshot);
+               std::uint64_t count = 0;
+
+               while (!done.load(std::memory_order_relaxed))
+               {
+                   benchmark::DoNotOptimize(reader.read());
+                   ++count;
+               }
+
+               reads.fetch_add(count, std::memory_order_relaxed);
+           });
+       }
+
+       for (auto _ : state)
+       {
+           runCycle(uut);
+       }
+
+       done.store(true, std::memory_order_relaxed);
+
+       for (auto& t : readers)
+       {
+           t.join();
+       }
+
+       state.SetItemsProcessed(state.iterations() * 6);
+       state.counters["reads"] = benchmark::Counter(static_cast<double>(reads.load()), benchmark::Counter::kIsRate);
+   }
+
+   void BM_SnapshotRead(benchmark::State& state)
+   {
+       SafetyRules uut;
+       SafetySnapshot snapshot;
+       snapshot.attach(uut);
+       uut.dispatch(Ev::evPowerOn);
+
+       SnapshotReader reader(snapshot);
+
+       for (auto _ : state)
+       {
+           benchmark::DoNotOptimize(reader.read());
+       }
+
+       state.SetItemsProcessed(state.iterations());
+   }
+
+   BENCHMARK(BM_SnapshotPublish)->Arg(0)->Arg(1)->Arg(2);
+   BENCHMARK(BM_SnapshotRead);
+
+   // ----- 100k printers stepped once each per iteration, in shuffled order
+   constexpr std::size_t kFleetSize = 100000;
+
+   std::vector<std::uint32_t> shuffledIds(std::size_t count)
+   {
+       std::vector<std::uint32_t> ids(count);
+       std::iota(ids.begin(), ids.end(), 0u);
+       std::shuffle(ids.begin(), ids.end(), std::mt19937(99));
+       return ids;
+   }
+
+   void BM_FleetPerObject(benchmark::State& state)
+   {
+       std::vector<std::unique_ptr<ISafetyRules>> printers;
+
+       for (std::size_t p = 0; p < kFleetSize; ++p)
+       {
+           printers.push_back(std::make_unique<SafetyRules>());
+       }
+
+       const auto ids = shuffledIds(kFleetSize);
+       const auto events = randomEvents(kFleetSize);
+
+       for (auto _ : state)
+       {
+           for (std::size_t i = 0; i < kFleetSize; ++i)
+           {
+               printers[ids[i]]->dispatch(events[i]);
+           }
+       }
+
+       state.SetItemsProcessed(state.iterations() * kFleetSize);
+   }
+
+   void BM_FleetBatch(benchmark::State& state)
+   {
+       SafetyFleet fleet(kFleetSize);
+
+       const auto ids = shuffledIds(kFleetSize);
+       const auto events = randomEvents(kFleetSize);
+
+       for (auto _ : state)
+       {
+           fleet.dispatchBatch(ids.data(), events.data(), kFleetSize);
+       }
+
+       state.SetItemsProcessed(state.iterations() * kFleetSize);
+   }
+
+   BENCHMARK(BM_FleetPerObject)->Unit(benchmark::kMicrosecond);
+   BENCHMARK(BM_FleetBatch)->Unit(benchmark::kMicrosecond);
+
+   // ----- Checkpoints of 1M machines: save (Arg: durable, i.e. msync per save) and
+   //       restore into a SafetyFleet or into an array of SafetyRules, no hooks fired
+   constexpr std::size_t kCheckpointMachines = 1 << 20;
+
+   void BM_CheckpointSave(benchmark::State& state)
+   {
+       const std::string path = "Bench_SafetyRules.ckpt";
+       SafetyFleet fleet(kCheckpointMachines);
+       const auto events = randomEvents(kCheckpointMachines);
+
+       for (std::uint32_t p = 0; p < kCheckpointMachines; ++p)
+       {
+           fleet.dispatch(p, Ev::evPowerOn);
+           fleet.dispatch(p, events[p]);
+       }
+
+       {
+           SafetyCheckpoint checkpoint(path, kCheckpointMachines, state.range(0) != 0);
+
+           for (auto _ : state)
+           {
+               checkpoint.save(fleet);
+           }
+       }
+
+       std::remove(path.c_str());
+       state.SetItemsProcessed(state.iterations() * kCheckpointMachines);
+   }
+
+   void BM_CheckpointRestore(benchmark::State& state)
+   {
+       const std::string path = "Bench_SafetyRules.ckpt";
+       std::vector<Config> saved(kCheckpointMachines);
+       std::mt19937 rng(11);
+
+       for (auto& c : saved)
+       {
+           c = rng() % 2 ? toConfig(TopState::Active, LoaderSubstate::None)
+                         : toConfig(TopState::BuildPlateLoader, LoaderSubstate::DoorOpened);
+       }
+
+       SafetyCheckpoint(path, kCheckpointMachines, false).save(saved.data(), saved.size());
+
+       if (state.range(0) == 0)
+       {
+           SafetyFleet fleet(kCheckpointMachines);
+
+           for (auto _ : state)
+           {
+               CheckpointReader(path).restore(fleet);
+           }
+       }
+       else
+       {
+           std::vector<SafetyRules> machines(kCheckpointMachines);
+
+           for (auto _ : state)
+           {
+               CheckpointReader(path).restore(machines.data(), machines.size());
+           }
+       }
+
+       std::remove(path.c_str());
+       state.SetItemsProcessed(state.iterations() * kCheckpointMachines);
+   }
+
+   BENCHMARK(BM_CheckpointSave)->ArgName("durable")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+   BENCHMARK(BM_CheckpointRestore)->ArgName("rules")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+   // ----- Cell controller queries over 1M printers: "how many are Faulted" and "which
+   //       wait in DoorOpened", by scanning getState() vs from the fleet index.
+   //       Arg: 0 count by scan, 1 count from index, 2 list by scan, 3 list from index
+   void BM_FleetQuery(benchmark::State& state)
+   {
+       constexpr std::size_t kPrinters = 1 << 20;
+       SafetyFleet fleet(kPrinters);
+
+       // A plausible mix: most Active, a few loaders at each step, a few Faulted
+       std::mt19937 rng(5);
+
+       for (std::uint32_t p = 0; p < kPrinters; ++p)
+       {
+           fleet.dispatch(p, Ev::evPowerOn);
+
+           switch (rng() % 1000)
+           {
+           case 0:  fleet.dispatch(p, Ev::evFault); break;
+           case 1:  fleet.startLoader(p); fleet.dispatch(p, Ev::evDoorOpened); break;
+           case 2:  fleet.startLoader(p); break;
+           default: break;
+           }
+       }
+
+       const int mode = static_cast<int>(state.range(0));
+       std::vector<std::uint32_t> listed;
+       listed.reserve(kPrinters);
+       std::size_t found = 0;
+
+       for (auto _ : state)
+       {
+           listed.clear();
+
+           switch (mode)
+           {
+           case 0:
+               found = 0;
+               for (std::uint32_t p = 0; p < kPrinters; ++p)
+               {
+                   found += fleet.getState(p) == SafetyFleet::State::Faulted;
+               }
+               break;
+           case 1:
+               found = fleet.index().count(SafetyFleet::State::Faulted);
+               break;
+           case 2:
+               for (std::uint32_t p = 0; p < kPrinters; ++p)
+               {
+                   if (fleet.getLoaderSubstate(p) == SafetyFleet::LoaderSub::DoorOpened)
+                   {
+                       listed.push_back(p);
+                   }
+               }
+               found = listed.size();
+               break;
+           default:
+               fleet.index().forEach(SafetyFleet::State::BuildPlateLoader, SafetyFleet::LoaderSub::DoorOpened,
+                                     [&listed](std::uint32_t p) { listed.push_back(p); });
+               found = listed.size();
+               break;
+           }
+
+           benchmark::DoNotOptimize(found);
+       }
+
+       state.counters["found"] = static_cast<double>(found);
+   }
+
+   BENCHMARK(BM_FleetQuery)->ArgName("mode")->DenseRange(0, 3)->Unit(benchmark::kMicrosecond);
+
+   // ----- Footprint of 1M machines with every hook installed: per-object Delegates,
+   //       a shared HookTable (pointer + id, or id only) and the SoA fleet. One
+   //       iteration delivers one random event to each machine in shuffled order.
+   constexpr std::size_t kFootprintMachines = 1 << 20;
+
+   HookTable footprintTable;
+
+   void countHit(void* hits, std::uint32_t)
+   {
+       ++*static_cast<std::uint64_t*>(hits);
+   }
+
+   struct PerObjectMachines
+   {
+       using Machine = SafetyRules;
+
+       std::vector<SafetyRules> machines;
+
+       explicit PerObjectMachines(std::uint64_t& hits) : machines(kFootprintMachines)
+       {
+           for (auto& m : machines) installCounters(m, hits);
+       }
+
+       void dispatch(std::uint32_t id, Ev ev) { machines[id].dispatch(ev); }
+   };
+
+   struct SharedTableMachines
+   {
+       using Machine = SharedSafetyRules;
+
+       HookTable table;
+       std::vector<SharedSafetyRules> machines;
+
+       explicit SharedTableMachines(std::uint64_t& hits)
+       {
+           for (std::size_t h = 0; h < kHookCount; ++h)
+           {
+               table.set(static_cast<Hook>(h), HookTable::PrinterFn::bind<&countHit>(&hits));
+           }
+
+           machines.reserve(kFootprintMachines);
+
+           for (std::uint32_t id = 0; id < kFootprintMachines; ++id)
+           {
+               machines.emplace_back(SharedHooks { &table, id });
+           }
+       }
+
+       void dispatch(std::uint32_t id, Ev ev) { machines[id].dispatch(ev); }
+   };
+
+   struct StaticTableMachines
+   {
+       using Machine = BasicSafetyRules<TableHooks<footprintTable>>;
+
+       std::vector<Machine> machines;
+
+       explicit StaticTableMachines(std::uint64_t& hits)
+       {
+           for (std::size_t h = 0; h < kHookCount; ++h)
+           {
+               footprintTable.set(static_cast<Hook>(h), HookTable::PrinterFn::bind<&countHit>(&hits));
+           }
+
+           machines.reserve(kFootprintMachines);
+
+           for (std::uint32_t id = 0; id < kFootprintMachines; ++id)
+           {
+               machines.emplace_back(TableHooks<footprintTable> { id });
+           }
+       }
+
+       void dispatch(std::uint32_t id, Ev ev) { machines[id].dispatch(ev); }
+   };
+
+   struct FleetMachines
+   {
+       using Machine = Config;
+
+       SafetyFleet fleet;
+
+       explicit FleetMachines(std::uint64_t& hits) : fleet(kFootprintMachines)
+       {
+           for (std::size_t h = 0; h < kHookCount; ++h)
+           {
+               fleet.setHook(static_cast<Hook>(h), HookTable::PrinterFn::bind<&countHit>(&hits));
+           }
+       }
+
+       void dispatch(std::uint32_t id, Ev ev) { fleet.dispatch(id, ev); }
+   };
+
+   template <typename Machines>
+   void BM_FleetFootprint(benchmark::State& state)
+   {
+       const auto ids = shuffledIds(kFootprintMachines);
+       const auto events = randomEvents(kFootprintMachines);
+       std::uint64_t hits = 0;
+
+       Machines machines(hits);
+
+       for (auto _ : state)
+       {
+           for (std::size_t i = 0; i < kFootprintMachines; ++i)
+           {
+               machines.dispatch(ids[i], events[i]);
+           }
+       }
+
+       benchmark::DoNotOptimize(hits);
+       state.SetItemsProcessed(state.iterations() * kFootprintMachines);
+       state.counters["bytes_per_machine"] = sizeof(typename Machines::Machine);
+       state.counters["fleet_MB"] = static_cast<double>(sizeof(typename Machines::Machine) * kFootprintMachines) / (1 << 20);
+   }
+
+   BENCHMARK_TEMPLATE(BM_FleetFootprint, PerObjectMachines)->Unit(benchmark::kMillisecond);
+   BENCHMARK_TEMPLATE(BM_FleetFootprint, SharedTableMachines)->Unit(benchmark::kMillisecond);
+   BENCHMARK_TEMPLATE(BM_FleetFootprint, StaticTableMachines)->Unit(benchmark::kMillisecond);
+   BENCHMARK_TEMPLATE(BM_FleetFootprint, FleetMachines)->Unit(benchmark::kMillisecond);
+
+   // ----- Sharded dispatcher: one producer posts to 1M printers, N workers drain.
+   //       Arg: workers (0 = hardware concurrency). Latency is post-to-step, sampled 1 in 64.
+   constexpr std::size_t kDispatcherPrinters = 1 << 20;
+
+   void BM_FleetDispatcher(benchmark::State& state)
+   {
+       const unsigned workers = static_cast<unsigned>(state.range(0));
+       const auto ids = shuffledIds(kDispatcherPrinters);
+       const auto events = randomEvents(kDispatcherPrinters);
+
+       FleetDispatcher dispatcher(kDispatcherPrinters, workers);
+       dispatcher.setLatencySampling(64);
+       dispatcher.start();
+
+       std::uint64_t target = 0;
+
+       for (auto _ : state)
+       {
+           for (std::size_t i = 0; i < kDispatcherPrinters; ++i)
+           {
+               while (!dispatcher.post(ids[i], events[i]))
+               {
+                   std::this_thread::yield();
+               }
+           }
+
+           target += kDispatcherPrinters;
+
+           while (dispatcher.stats().dispatched < target)
+           {
+               std::this_thread::yield();
+           }
+       }
+
+       dispatcher.stop();
+
+       const auto stats = dispatcher.stats();
+       state.SetItemsProcessed(state.iterations() * kDispatcherPrinters);
+       state.counters["workers"]  = dispatcher.workerCount();
+       state.counters["steals%"]  = stats.claims ? 100.0 * static_cast<double>(stats.steals) / static_cast<double>(stats.claims) : 0.0;
+       state.counters["p50_ns"]   = static_cast<double>(stats.latencyQuantileNs(0.50));
+       state.counters["p99_ns"]   = static_cast<double>(stats.latencyQuantileNs(0.99));
+       state.counters["p999_ns"]  = static_cast<double>(stats.latencyQuantileNs(0.999));
+   }
+
+   BENCHMARK(BM_FleetDispatcher)
+       ->ArgName("workers")
+       ->Arg(1)->Arg(2)->Arg(4)->Arg(0)
+       ->Unit(benchmark::kMillisecond)
+       ->UseRealTime();
+
+   // ----- Fault latency under saturation: range(0) producers keep the dispatcher's
+   //       ring full of loader traffic (and evPowerOn, so the machine comes back to
+   //       Active after every fault); each iteration posts one evFault and waits for
+   //       onEnterFaulted. Time is post-to-hook; worst_ns is the worst iteration.
+   struct FaultProbe
+   {
+       std::atomic<bool>          armed { false };    // machine is Active or loading
+       std::atomic<std::uint64_t> faultedNs { 0 };
+   };
+
+   void probeArmed(void* probe)
+   {
+       static_cast<FaultProbe*>(probe)->armed.store(true, std::memory_order_release);
+   }
+
+   void probeFaulted(void* probe)
+   {
+       static_cast<FaultProbe*>(probe)->faultedNs.store(instrumentation::nowNs(), std::memory_order_release);
+   }
+
+   void BM_FaultUnderLoad(benchmark::State& state)
+   {
+       SafetyRules uut;
+       FaultProbe probe;
+       uut.setOnEnterActive(ISafetyRules::VoidFn::bind<&probeArmed>(&probe));
+       uut.setOnEnterFaulted(ISafetyRules::VoidFn::bind<&probeFaulted>(&probe));
+
+       SafetyDispatcher dispatcher(uut, 1024);
+       dispatcher.start();
+       dispatcher.post(Ev::evPowerOn);
+
+       std::atomic<bool> done { false };
+       std::vector<std::thread> producers;
+
+       for (int p = 0; p < state.range(0); ++p)
+       {
+           producers.emplace_back([&dispatcher, &done]() {
+               constexpr Ev kTraffic[] = { Ev::evPowerOn, Ev::evDoorOpened, Ev::evBuildPlateLoaded, Ev::evDoorClosed };
+               unsigned i = 0;
+
+               while (!done.load(std::memory_order_relaxed))
+               {
+                   const bool posted = ++i % 5 == 0 ? dispatcher.postStartLoader() : dispatcher.post(kTraffic[i % 4]);
+
+                   if (!posted)
+                   {
+                       std::this_thread::yield();
+                   }
+               }
+           });
+       }
+
+       std::uint64_t worst = 0;
+       std::uint64_t total = 0;
+       std::uint64_t backlog = 0;
+
+       for (auto _ : state)
+       {
+           while (!probe.armed.exchange(false, std::memory_order_acquire))
+           {
+               dispatcher.post(Ev::evPowerOn);
+               std::this_thread::yield();
+           }
+
+           probe.faultedNs.store(0, std::memory_order_relaxed);
+           backlog += dispatcher.stats().depth;
+
+           const std::uint64_t posted = instrumentation::nowNs();
+
+           while (!dispatcher.post(Ev::evFault))
+           {
+               std::this_thread::yield();
+           }
+
+           std::uint64_t faulted;
+
+           while ((faulted = probe.faultedNs.load(std::memory_order_acquire)) == 0)
+           {
+               std::this_thread::yield();
+           }
+
+           const std::uint64_t latency = faulted - posted;
+           worst = std::max(worst, latency);
+           total += latency;
+       }
+
+       done.store(true, std::memory_order_relaxed);
+
+       for (auto& t : producers)
+       {
+           t.join();
+       }
+
+       dispatcher.stop();
+
+       const auto stats = dispatcher.stats();
+       const double iterations = static_cast<double>(state.iterations());
+       state.counters["mean_ns"]    = static_cast<double>(total) / iterations;
+       state.counters["worst_ns"]   = static_cast<double>(worst);
+       state.counters["backlog"]    = static_cast<double>(backlog) / iterations;
+       state.counters["superseded"] = static_cast<double>(stats.superseded) / iterations;
+   }
+
+   BENCHMARK(BM_FaultUnderLoad)
+       ->ArgName("producers")
+       ->Arg(0)->Arg(1)->Arg(2)
+       ->Unit(benchmark::kMicrosecond)
+       ->UseRealTime();
+
+   // ----- Noisy sensors: uniformly random events (mostly no-ops) posted to one
+   //       dispatcher, without and with the ingress filter. Arg 1 paces the sensor
+   //       (a yield after every post) so the dispatcher keeps up, which is when the
+   //       filter can act; a flood keeps a backlog and nothing can be filtered.
+   //       CPU time is the whole process; queued% is the share of posts that took a slot.
+   void BM_NoisyIngress(benchmark::State& state)
+   {
+       constexpr std::size_t kBurst = 1 << 14;
+       const auto events = randomEvents(kBurst);
+       const bool paced = state.range(1) != 0;
+
+       SafetyRules uut;
+       SafetyDispatcher dispatcher(uut, 1024);
+       dispatcher.setIngressFilter(state.range(0) != 0);
+       dispatcher.start();
+
+       std::uint64_t target = 0;
+
+       for (auto _ : state)
+       {
+           for (Ev ev : events)
+           {
+               while (!dispatcher.post(ev))
+               {
+                   std::this_thread::yield();
+               }
+
+               if (paced)
+               {
+                   std::this_thread::yield();
+               }
+           }
+
+           target += kBurst;
+
+           for (;;)
+           {
+               const auto stats = dispatcher.stats();
+
+               if (stats.dispatched + stats.superseded + stats.filtered >= target)
+               {
+                   break;
+               }
+
+               std::this_thread::yield();
+           }
+       }
+
+       dispatcher.stop();
+
+       const auto stats = dispatcher.stats();
+       state.SetItemsProcessed(state.iterations() * kBurst);
+       state.counters["queued%"] = 100.0 * static_cast<double>(stats.dispatched + stats.superseded) / static_cast<double>(target);
+   }
+
+   BENCHMARK(BM_NoisyIngress)
+       ->ArgNames({ "filter", "paced" })
+       ->Args({ 0, 0 })->Args({ 1, 0 })->Args({ 0, 1 })->Args({ 1, 1 })
+       ->Unit(benchmark::kMicrosecond)
+       ->MeasureProcessCPUTime()
+       ->UseRealTime();
+
+   // ----- Latency tracing cost: what the dispatcher thread pays per trigger (one
+   //       loader cycle stepped inline, untraced vs traced), and a posted cycle end
+   //       to end with the ingress -> RequestLoadBuildPlate percentiles it records
+   void BM_TracedLoaderCycle(benchmark::State& state)
+   {
+       constexpr Trigger kCycle[] = { Trigger::evPowerOn, Trigger::StartLoader, Trigger::evDoorOpened,
+                                      Trigger::evBuildPlateLoaded, Trigger::evDoorClosed, Trigger::evPowerOff };
+       const bool traced = state.range(0) != 0;
+
+       SafetyRules uut;
+       std::uint64_t hits = 0;
+       installCounters(uut, hits);
+
+       LatencyTracer tracer;
+
+       if (traced)
+       {
+           tracer.attach(uut);
+       }
+
+       for (auto _ : state)
+       {
+           for (Trigger t : kCycle)
+           {
+               if (traced)
+               {
+                   tracer.beginStep(t, LatencyTracer::now());
+               }
+
+               if (t == Trigger::StartLoader)
+               {
+                   uut.startLoader();
+               }
+               else
+               {
+                   uut.dispatch(static_cast<Ev>(t));
+               }
+
+               if (traced)
+               {
+                   tracer.endStep();
+               }
+           }
+       }
+
+       benchmark::DoNotOptimize(hits);
+       state.SetItemsProcessed(state.iterations() * 6);
+   }
+
+   void BM_TracedDispatch(benchmark::State& state)
+   {
+       SafetyRules uut;
+       std::uint64_t hits = 0;
+       installCounters(uut, hits);
+
+       LatencyTracer tracer;
+       tracer.attach(uut);
+
+       SafetyDispatcher dispatcher(uut);
+       dispatcher.setTracer(&tracer);
+       dispatcher.start();
+
+       std::uint64_t target = 0;
+
+       for (auto _ : state)
+       {
+           dispatcher.post(Ev::evPowerOn);
+           dispatcher.postStartLoader();
+           dispatcher.post(Ev::evDoorOpened);
+           dispatcher.post(Ev::evBuildPlateLoaded);
+           dispatcher.post(Ev::evDoorClosed);
+           dispatcher.post(Ev::evPowerOff);
+           target += 6;
+
+           while (dispatcher.stats().dispatched < target)
+           {
+               std::this_thread::yield();
+           }
+       }
+
+       dispatcher.stop();
+
+       const HdrHistogram& path = tracer.path(Trigger::evDoorOpened, Hook::RequestLoadBuildPlate);
+       const double scale = tracer.nsPerTick();
+
+       benchmark::DoNotOptimize(hits);
+       state.SetItemsProcessed(state.iterations() * 6);
+       state.counters["p50_ns"] = static_cast<double>(path.valueAtQuantile(0.5)) * scale;
+       state.counters["p99_ns"] = static_cast<double>(path.valueAtQuantile(0.99)) * scale;
+       state.counters["p9999_ns"] = static_cast<double>(path.valueAtQuantile(0.9999)) * scale;
+   }
+
+   BENCHMARK(BM_TracedLoaderCycle)->ArgName("traced")->Arg(0)->Arg(1);
+   BENCHMARK(BM_TracedDispatch)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+   // ----- Sensor process -> safety process over a shared-memory EventChannel
+   //
+   // A forked producer process posts until the channel is closed; this process is
+   // the consumer. Throughput: the producer posts flat out and each iteration takes
+   // 1024 events. Wakeup: the producer posts one event stamped with CLOCK_MONOTONIC
+   // every 200 us, so the consumer is asleep on the futex each time; each iteration
+   // is one event and the time from its post to the consumer holding it.
+   template <typename Produce>
+   pid_t forkProducer(const std::string& name, Produce&& produce)
+   {
+       const pid_t child = ::fork();
+
+       if (child == 0)
+       {
+           ChannelProducer producer(name);
+
+           while (!producer.closed())
+           {
+               produce(producer);
+           }
+
+           ::_exit(0);
+       }
+
+       return child;
+   }
+
+   void BM_ChannelThroughput(benchmark::State& state)
+   {
+       constexpr std::size_t kBatch = 1024;
+       const std::string name = "/Bench_SafetyRules.channel." + std::to_string(::getpid());
+
+       auto channel = std::make_unique<EventChannel>(name, 4096);
+       const pid_t producer = forkProducer(name, [](ChannelProducer& p) {
+           for (int i = 0; i < 256; ++i)
+           {
+               if (!p.post(Ev::evDoorOpened))
+               {
+                   std::this_thread::yield();
+               }
+           }
+       });
+
+       std::uint64_t seen = 0;
+
+       for (auto _ : state)
+       {
+           std::size_t taken = 0;
+
+           while (taken < kBatch)
+           {
+               taken += channel->drain([&seen](const ChannelEvent& e) { seen += e.source; }, kBatch - taken);
+
+               if (taken < kBatch)
+               {
+                   channel->wait(std::chrono::milliseconds(10));
+               }
+           }
+       }
+
+       const EventChannel::Stats stats = channel->stats();
+       channel.reset();
+       ::waitpid(producer, nullptr, 0);
+
+       benchmark::DoNotOptimize(seen);
+       state.SetItemsProcessed(state.iterations() * kBatch);
+       state.counters["sleeps"]  = static_cast<double>(stats.sleeps);
+       state.counters["wakeups"] = static_cast<double>(stats.wakeups);
+       state.counters["full%"]   = 100.0 * static_cast<double>(stats.full) / static_cast<double>(stats.full + stats.received);
+   }
+
+   void BM_ChannelWakeup(benchmark::State& state)
+   {
+       const std::string name = "/Bench_SafetyRules.channel." + std::to_string(::getpid());
+
+       auto channel = std::make_unique<EventChannel>(name, 64);
+       const pid_t producer = forkProducer(name, [](ChannelProducer& p) {
+           p.post(Ev::evDoorOpened, 0, instrumentation::nowNs());
+           ::usleep(200);
+       });
+
+       HdrHistogram latency;
+       ChannelEvent event;
+
+       for (auto _ : state)
+       {
+           while (!channel->tryPop(event))
+           {
+               channel->wait(std::chrono::milliseconds(100), 0);
+           }
+
+           latency.record(instrumentation::nowNs() - event.stamp);
+       }
+
+       const EventChannel::Stats stats = channel->stats();
+       channel.reset();
+       ::waitpid(producer, nullptr, 0);
+
+       state.counters["p50_ns"]  = static_cast<double>(latency.valueAtQuantile(0.5));
+       state.counters["p99_ns"]  = static_cast<double>(latency.valueAtQuantile(0.99));
+       state.counters["max_ns"]  = static_cast<double>(latency.max());
+       state.counters["woken%"]  = 100.0 * static_cast<double>(stats.wakeups) / static_cast<double>(stats.received);
+   }
+
+   BENCHMARK(BM_ChannelThroughput)->Unit(benchmark::kMicrosecond)->UseRealTime();
+   BENCHMARK(BM_ChannelWakeup)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+   // ----- One machine, a long recorded stream: sequential dispatch vs fastForward()
+   //       Arg: threads (0 = hardware concurrency); trace variants write every position
+   constexpr std::size_t kStreamLength = 1 << 22;
+
+   void BM_StreamSequential(benchmark::State& state)
+   {
+       const auto events = randomEvents(kStreamLength);
+       SafetyRules uut;
+
+       for (auto _ : state)
+       {
+           for (Ev ev : events)
+           {
+               uut.dispatch(ev);
+           }
+
+           benchmark::DoNotOptimize(uut.getState());
+       }
+
+       state.SetItemsProcessed(state.iterations() * kStreamLength);
+   }
+
+   void BM_StreamFastForward(benchmark::State& state)
+   {
+       const auto events = randomEvents(kStreamLength);
+       const unsigned threads = static_cast<unsigned>(state.range(0));
+       const bool withTrace = state.range(1) != 0;
+
+       std::vector<Config> trace(withTrace ? kStreamLength : 0);
+       const Config idle = toConfig(ISafetyRules::State::Idle, ISafetyRules::LoaderSub::None);
+
+       for (auto _ : state)
+       {
+           benchmark::DoNotOptimize(fastForward(idle, events.data(), kStreamLength,
+                                                withTrace ? trace.data() : nullptr, threads));
+       }
+
+       state.SetItemsProcessed(state.iterations() * kStreamLength);
+   }
+
+   // ----- Loader deadlines: re-arm one of 100k armed timers per step, as a substate change does
+   void BM_TimingWheelRearm(benchmark::State& state)
+   {
+       constexpr std::size_t kTimers = 100000;
+
+       TimingWheel wheel(0);
+       std::vector<TimingWheel::Timer> timers(kTimers);
+       std::mt19937 rng(5);
+
+       for (auto& t : timers)
+       {
+           wheel.arm(t, 1 + rng() % 60000);
+       }
+
+       std::size_t i = 0;
+       std::uint64_t now = 0;
+
+       for (auto _ : state)
+       {
+           wheel.arm(timers[i], now + 100 + (i & 4095));
+
+           if (++i == kTimers)
+           {
+               i = 0;
+               wheel.advance(++now);
+           }
+       }
+
+       state.SetItemsProcessed(state.iterations());
+   }
+
+   BENCHMARK(BM_TimingWheelRearm);
+
+   BENCHMARK(BM_StreamSequential)->Unit(benchmark::kMillisecond);
+   BENCHMARK(BM_StreamFastForward)
+       ->ArgNames({ "threads", "trace" })
+       ->ArgsProduct({ { 1, 2, 4, 0 }, { 0, 1 } })
+       ->Unit(benchmark::kMillisecond)
+       ->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,172 @@
+#include <benchmark/benchmark.h>
+#include "BenchSupport.h"
+#include "SafetyRules/SafetyRules.h"
+#include "SwitchSafetyRules.h"
+
+#include <string>
+#include <vector>
+
+// ns per trigger for every reachable (State, LoaderSub) x (Event | startLoader)
+// cell, for the table engine, the original switch engine and the legacy
+// SafetyBox, with and without callbacks installed.
+//
+// Each iteration moves kMachines machines to the source configuration (untimed)
+// and then delivers the trigger once to each (timed), so the pause/resume cost
+// is spread over thousands of dispatches.
+
+namespace Bench_SafetyRules_Namespace
+{
+
+   constexpr std::size_t kMachines = 4096;
+
+   bool reachable(Config config)
+   {
+       const bool inLoader = stateOf(config) == ISafetyRules::State::BuildPlateLoader;
+       const bool hasSub   = subOf(config) != ISafetyRules::LoaderSub::None;
+       return inLoader == hasSub;
+   }
+
+   template <typename Machine>
+   void BM_Transition(benchmark::State& state, Config from, Trigger trigger, bool hooks)
+   {
+       QuietStdout quiet;
+
+       std::vector<Machine> machines(kMachines);
+       std::uint64_t hits = 0;
+
+       if constexpr (std::is_base_of<ISafetyRules, Machine>::value)
+       {
+           if (hooks)
+           {
+               for (auto& m : machines)
+               {
+                   installCounters(m, hits);
+               }
+           }
+       }
+
+       const auto path = pathTo(from);
+
+       for (auto _ : state)
+       {
+           state.PauseTiming();
+
+           for (auto& m : machines)
+           {
+               driveTo(m, path);
+           }
+
+           state.ResumeTiming();
+
+           for (auto& m : machines)
+           {
+               fire(m, trigger);
+           }
+       }
+
+       benchmark::DoNotOptimize(hits);
+       state.SetItemsProcessed(state.iterations() * kMachines);
+
+       // Seconds per single dispatch (shown as e.g. 3.2n)
+       state.counters["per_dispatch"] = benchmark::Counter(
+           kMachines, benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+   }
+
+   template <typename Machine>
+   void registerMatrix(const std::string& engine, bool hasHooks)
+   {
+       for (Config c = 0; c < kConfigCount; ++c)
+       {
+           if (!reachable(c))
+           {
+               continue;
+           }
+
+           for (std::size_t t = 0; t < kTriggerCount; ++t)
+           {
+               for (bool hooks : { false, true })
+               {
+                   if (hooks && !hasHooks)
+                   {
+                       continue;
+                   }
+
+                   const std::string label = "Transition/" + engine + "/"
+                                           + name(stateOf(c)) + "."
+                                           + name(subOf(c)) + "/"
+                                           + name(static_cast<Trigger>(t))
+                                           + (hasHooks ? (hooks ? "/hooks:1" : "/hooks:0") : "");
+
+                   benchmark::RegisterBenchmark(label.c_str(), BM_Transition<Machine>, c, static_cast<Trigger>(t), hooks);
+               }
+           }
+       }
+   }
+
+   // ----- Legacy SafetyBox loader cycle, same commands as runCycle()
+   void BM_LoaderCycleSafetyBox(benchmark::State& state)
+   {
+       QuietStdout quiet;
+       SafetyBox box;
+
+       for (auto _ : state)
+       {
+           box.run(0);
+           box.run(3);
+           box.run(4);
+           box.run(5);
+           box.run(6);
+           box.run(1);
+       }
+
+       state.SetItemsProcessed(state.iterations() * 6);
+   }
+
+   // Same cycle with the messages going through a BoxLog. The log thread is let
+   //       catch up (untimed) before the ring fills, so this is the cost run() adds to
+   //       a caller for bursts the ring absorbs; sustained overload drops instead.
+   void BM_LoaderCycleSafetyBoxLogged(benchmark::State& state)
+   {
+       constexpr std::size_t kRing = 1 << 12;
+       constexpr std::size_t kCyclesPerDrain = kRing / 8;   // 7 records per cycle
+
+       NullBuffer sink;
+       std::ostream out(&sink);
+       BoxLog log(out, kRing);
+       SafetyBox box(&log);
+       std::size_t cycles = 0;
+
+       for (auto _ : state)
+       {
+           box.run(0);
+           box.run(3);
+           box.run(4);
+           box.run(5);
+           box.run(6);
+           box.run(1);
+
+           if (++cycles == kCyclesPerDrain)
+           {
+               state.PauseTiming();
+               log.flush();
+               cycles = 0;
+               state.ResumeTiming();
+           }
+       }
+
+       log.flush();
+       state.SetItemsProcessed(state.iterations() * 6);
+       state.counters["dropped"] = static_cast<double>(log.dropped());
+   }
+
+   BENCHMARK(BM_LoaderCycleSafetyBox);
+   BENCHMARK(BM_LoaderCycleSafetyBoxLogged);
+
+   const bool registered = []() {
+       registerMatrix<SafetyRules>("SafetyRules", true);
+       registerMatrix<SwitchSafetyRules>("SwitchSafetyRules", true);
+       registerMatrix<SafetyBox>("SafetyBox", false);
+       return true;
+   }();
+
+}
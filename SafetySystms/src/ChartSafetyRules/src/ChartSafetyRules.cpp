@@ -0,0 +1 @@
+#include "ChartSafetyRules/ChartSafetyRules.h"
@@ -0,0 +1,98 @@
+#pragma once
+#include "SafetyBase/MpscRing.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace safety
+{
+
+   // ----- Messages SafetyBox prints, by id
+   enum class BoxMessage : std::uint8_t
+   {
+       Initialized,
+       PowerOn,
+       PowerOff,
+       FaultDetected,
+       LoaderStarted,
+       RequestDoorOpen,
+       DoorOpened,
+       PlateArrived,
+       DoorClosed,
+       UnknownCommand,
+       Status            // "[Mode=m Step=s]"
+   };
+
+   // One log entry: message id plus the box status when it was logged
+   struct BoxRecord
+   {
+       BoxMessage   message;
+       std::uint8_t mode;
+       std::uint8_t step;
+       std::uint8_t reserved;
+       std::int32_t value;   // command, for UnknownCommand
+   };
+
+   static_assert(sizeof(BoxRecord) == 8, "Box log records are 8 bytes");
+
+   // Asynchronous binary logger for SafetyBox.
+   //
+   // write() stores an 8-byte record in a lock-free MPSC ring and returns; it never
+   // formats, locks or blocks, and drops (and counts) the record when the ring is full.
+   // A background thread turns records back into the exact lines SafetyBox used to
+   // print and flushes the stream once per drained batch instead of once per line.
+   class BoxLog
+   {
+      public:
+          explicit BoxLog(std::ostream& out = std::cout, std::size_t capacity = 4096);
+
+          // Formats everything already written, then stops the thread
+          ~BoxLog();
+
+          BoxLog(const BoxLog&) = delete;
+          BoxLog& operator=(const BoxLog&) = delete;
+
+          // ----- Producers (any thread)
+          bool write(BoxMessage message, int mode, int step, int value = 0)
+          {
+              const BoxRecord record { message, static_cast<std::uint8_t>(mode), static_cast<std::uint8_t>(step), 0, value };
+
+              if (!queue.tryPush(record))
+              {
+                  droppedCount.fetch_add(1, std::memory_order_relaxed);
+                  return false;
+              }
+
+              return true;
+          }
+
+          // Blocks until every record written so far is formatted and the stream flushed
+          void flush();
+
+          std::uint64_t dropped() const
+          {
+              return droppedCount.load(std::memory_order_relaxed);
+          }
+
+          // ----- Formatting (shared with SafetyBox's synchronous path)
+          static const char* text(BoxMessage message);
+          static void format(std::ostream& out, const BoxRecord& record);
+
+      private:
+          void run();
+          bool drain();
+
+      private:
+          std::ostream&           out;
+          MpscRing<BoxRecord>     queue;
+          std::mutex              outputMutex;   // held while a batch is formatted
+          std::thread             worker;
+
+          alignas(kCacheLine) std::atomic<bool>          running { true };
+          alignas(kCacheLine) std::atomic<std::uint64_t> droppedCount { 0 };
+   };
+
+} // namespace safety
@@ -1,13 +1,16 @@
 // SafetyBox.h
 #pragma once
+#include "CrudeSafetyRules/BoxLog.h"
 #include <iostream>
 
 class SafetyBox
 {
 public:
-	SafetyBox() : mode(0), step(0) 
+	// Without a log every message goes straight to std::cout (flushed per line);
+	// with one, run() only stores a binary record and the log's thread prints it
+	explicit SafetyBox(safety::BoxLog* log = nullptr) : mode(0), step(0), log(log)
 	{
-		std::cout << "System initialized (off)" << std::endl;
+		say(safety::BoxMessage::Initialized);
 	}
 
 	// One big "driver" for commands
@@ -19,25 +22,25 @@ public:
 			if (mode == 0 || mode == 2)
 			{
 				mode = 1; step = 0;
-				std::cout << "Power on" << std::endl;
+				say(safety::BoxMessage::PowerOn);
 			}
 		}
 		else if (cmd == 1)
 		{
 			mode = 0; step = 0;
-			std::cout << "Power off" << std::endl;
+			say(safety::BoxMessage::PowerOff);
 		}
 		else if (cmd == 2)
 		{
 			mode = 2; step = 0;
-			std::cout << "Fault detected!" << std::endl;
+			say(safety::BoxMessage::FaultDetected);
 		}
 		else if (cmd == 3)
 		{
 			if (mode == 1 && step == 0)
 			{
-				std::cout << "Loader started" << std::endl;
-				std::cout << "Request door open" << std::endl;
+				say(safety::BoxMessage::LoaderStarted);
+				say(safety::BoxMessage::RequestDoorOpen);
 				step = 1;
 			}
 		}
@@ -45,7 +48,7 @@ public:
 		{
 			if (mode == 1 && step == 1)
 			{
-				std::cout << "Door opened, loading plate" << std::endl;
+				say(safety::BoxMessage::DoorOpened);
 				step = 2;
 			}
 		}
@@ -53,7 +56,7 @@ public:
 		{
 			if (mode == 1 && step == 2)
 			{
-				std::cout << "Plate arrived, closing door" << std::endl;
+				say(safety::BoxMessage::PlateArrived);
 				step = 3;
 			}
 		}
@@ -61,24 +64,42 @@ public:
 		{
 			if (mode == 1 && step == 3)
 			{
-				std::cout << "Door closed, workflow complete" << std::endl;
+				say(safety::BoxMessage::DoorClosed);
 				step = 0;
 			}
 		}
 		else
 		{
-			std::cout << "Unknown command" << std::endl;
+			say(safety::BoxMessage::UnknownCommand, cmd);
 		}
 	}
 
 	// Quick status dump (ugly procedural style)
 	void dump()
 	{
-		std::cout << "[Mode=" << mode << " Step=" << step << "]" << std::endl;
+		say(safety::BoxMessage::Status);
 	}
 
+	// Raw status for tools that compare against SafetyRules
+	int getMode() const { return mode; }
+	int getStep() const { return step; }
+
 private:
+	void say(safety::BoxMessage message, int value = 0)
+	{
+		if (log)
+		{
+			log->write(message, mode, step, value);
+		}
+		else
+		{
+			safety::BoxLog::format(std::cout, safety::BoxRecord { message, static_cast<std::uint8_t>(mode), static_cast<std::uint8_t>(step), 0, value });
+			std::cout.flush();
+		}
+	}
+
 	int mode; // 0=off, 1=on, 2=fault
 	int step; // 0=idle, 1=waiting-open, 2=waiting-plate, 3=waiting-close
+	safety::BoxLog* log;
 };
 
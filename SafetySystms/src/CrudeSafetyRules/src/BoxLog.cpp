@@ -0,0 +1,128 @@
+#include "CrudeSafetyRules/BoxLog.h"
+
+#include <chrono>
+
+namespace safety
+{
+
+   namespace
+   {
+       // Idle polling: yield a while, then sleep; write() never signals the thread
+       constexpr unsigned kSpinsBeforeSleep = 64;
+       constexpr auto     kIdleSleep = std::chrono::microseconds(500);
+   }
+
+   BoxLog::BoxLog(std::ostream& out, std::size_t capacity)
+       : out(out),
+         queue(capacity)
+   {
+       worker = std::thread([this]() { run(); });
+   }
+
+   BoxLog::~BoxLog()
+   {
+       running.store(false, std::memory_order_release);
+       worker.join();
+   }
+
+   void BoxLog::flush()
+   {
+       while (queue.size() != 0)
+       {
+           std::this_thread::yield();
+       }
+
+       // The thread pops under this lock, so once we hold it the last batch is out
+       std::lock_guard<std::mutex> lock(outputMutex);
+       out.flush();
+   }
+
+   // ----- Background thread
+   void BoxLog::run()
+   {
+       unsigned idleSpins = 0;
+
+       for (;;)
+       {
+           if (drain())
+           {
+               idleSpins = 0;
+               continue;
+           }
+
+           if (!running.load(std::memory_order_acquire))
+           {
+               // Records that raced with the destructor are still formatted
+               if (queue.size() == 0)
+               {
+                   return;
+               }
+
+               continue;
+           }
+
+           if (++idleSpins < kSpinsBeforeSleep)
+           {
+               std::this_thread::yield();
+               continue;
+           }
+
+           std::this_thread::sleep_for(kIdleSleep);
+       }
+   }
+
+   bool BoxLog::drain()
+   {
+       std::lock_guard<std::mutex> lock(outputMutex);
+
+       BoxRecord record;
+       bool any = false;
+
+       while (queue.tryPop(record))
+       {
+           format(out, record);
+           any = true;
+       }
+
+       if (any)
+       {
+           out.flush();
+       }
+
+       return any;
+   }
+
+   // ----- Formatting
+   const char* BoxLog::text(BoxMessage message)
+   {
+       switch (message)
+       {
+           case BoxMessage::Initialized:     return "System initialized (off)";
+           case BoxMessage::PowerOn:         return "Power on";
+           case BoxMessage::PowerOff:        return "Power off";
+           case BoxMessage::FaultDetected:   return "Fault detected!";
+           case BoxMessage::LoaderStarted:   return "Loader started";
+           case BoxMessage::RequestDoorOpen: return "Request door open";
+           case BoxMessage::DoorOpened:      return "Door opened, loading plate";
+           case BoxMessage::PlateArrived:    return "Plate arrived, closing door";
+           case BoxMessage::DoorClosed:      return "Door closed, workflow complete";
+           case BoxMessage::UnknownCommand:  return "Unknown command";
+           case BoxMessage::Status:          return "";
+       }
+
+       return "";
+   }
+
+   void BoxLog::format(std::ostream& out, const BoxRecord& record)
+   {
+       if (record.message == BoxMessage::Status)
+       {
+           out << "[Mode=" << static_cast<int>(record.mode) << " Step=" << static_cast<int>(record.step) << "]\n";
+       }
+       else
+       {
+           out << text(record.message) << '\n';
+       }
+   }
+
+} // namespace safety
@@ -0,0 +1,136 @@
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace safety
+{
+
+   constexpr std::size_t kCacheLine = 64;
+
+   // Bounded lock-free multi-producer / single-consumer ring.
+   //
+   // Each cell carries a sequence number (Vyukov's bounded queue): producers claim a
+   // slot with one CAS on the tail and publish it by bumping the cell's sequence, the
+   // single consumer reads cells in order without any read-modify-write. Storage is
+   // allocated once at construction; tryPush/tryPop never allocate or block.
+   template <typename T>
+   class MpscRing
+   {
+      static_assert(std::is_trivially_copyable<T>::value, "MpscRing holds trivially copyable items");
+
+      public:
+          // ----- Construction (capacity is rounded up to a power of two)
+          explicit MpscRing(std::size_t capacity)
+              : mask(roundUp(capacity) - 1),
+                cells(new Cell[mask + 1])
+          {
+              for (std::size_t i = 0; i <= mask; ++i)
+              {
+                  cells[i].sequence.store(i, std::memory_order_relaxed);
+              }
+          }
+
+          MpscRing(const MpscRing&) = delete;
+          MpscRing& operator=(const MpscRing&) = delete;
+
+          // ----- Producers (any thread)
+          bool tryPush(const T& item)
+          {
+              std::size_t pos = tail.load(std::memory_order_relaxed);
+
+              for (;;)
+              {
+                  Cell& cell = cells[pos & mask];
+                  const std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+                  const std::intptr_t diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+
+                  if (diff == 0)
+                  {
+                      if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                      {
+                          cell.item = item;
+                          cell.sequence.store(pos + 1, std::memory_order_release);
+                          return true;
+                      }
+                  }
+                  else if (diff < 0)
+                  {
+                      return false; // full
+                  }
+                  else
+                  {
+                      pos = tail.load(std::memory_order_relaxed);
+                  }
+              }
+          }
+
+          // ----- Consumer (one thread only)
+          bool tryPop(T& item)
+          {
+              Cell& cell = cells[head & mask];
+              const std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+
+              if (seq != head + 1)
+              {
+                  return false; // empty, or the claiming producer has not published yet
+              }
+
+              item = cell.item;
+              cell.sequence.store(head + mask + 1, std::memory_order_release);
+              ++head;
+              headPublished.store(head, std::memory_order_relaxed);
+              return true;
+          }
+
+          // ----- Observability (approximate while producers are active)
+          std::size_t size() const
+          {
+              const std::size_t t = tail.load(std::memory_order_relaxed);
+              const std::size_t h = headPublished.load(std::memory_order_relaxed);
+              return t > h ? t - h : 0;
+          }
+
+          std::size_t capacity() const
+          {
+              return mask + 1;
+          }
+
+          // Slots claimed by producers since construction (published or not yet)
+          std::size_t pushed() const
+          {
+              return tail.load(std::memory_order_acquire);
+          }
+
+      private:
+          struct alignas(kCacheLine) Cell
+          {
+              std::atomic<std::size_t> sequence { 0 };
+              T                        item {};
+          };
+
+          static std::size_t roundUp(std::size_t n)
+          {
+              std::size_t p = 2;
+
+              while (p < n)
+              {
+                  p <<= 1;
+              }
+
+              return p;
+          }
+
+      private:
+          const std::size_t       mask;
+          std::unique_ptr<Cell[]> cells;
+
+          alignas(kCacheLine) std::atomic<std::size_t> tail { 0 };
+          alignas(kCacheLine) std::size_t              head { 0 };
+          std::atomic<std::size_t>                     headPublished { 0 };
+   };
+
+} // namespace safety
@@ -0,0 +1,51 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace safety
+{
+
+   // ----- Small POSIX helpers shared by the libraries that map files, shared
+   //       memory and sockets. Implementation detail; not part of their interfaces.
+   namespace posix
+   {
+
+       inline std::uint64_t clockNs(clockid_t clock)
+       {
+           timespec ts;
+           clock_gettime(clock, &ts);
+           return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000u + static_cast<std::uint64_t>(ts.tv_nsec);
+       }
+
+       inline std::uint64_t monotonicNs()
+       {
+           return clockNs(CLOCK_MONOTONIC);
+       }
+
+       // Wall clock, for timestamps that must mean something after a restart
+       inline std::uint64_t realtimeNs()
+       {
+           return clockNs(CLOCK_REALTIME);
+       }
+
+       // Throws std::system_error for errno, naming the call and the file, object or socket
+       [[noreturn]] inline void throwErrno(const char* what, const std::string& subject)
+       {
+           throw std::system_error(errno, std::generic_category(), std::string(what) + " " + subject);
+       }
+
+       // Closes the descriptor once the mapping is established (or on failure)
+       struct Fd
+       {
+           int fd;
+           ~Fd() { if (fd >= 0) ::close(fd); }
+       };
+
+   } // namespace posix
+
+} // namespace safety
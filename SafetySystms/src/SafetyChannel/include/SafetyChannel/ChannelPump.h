@@ -0,0 +1,61 @@
+#pragma once
+#include "SafetyChannel/EventChannel.h"
+#include "SafetyDispatcher/SafetyDispatcher.h"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace safety
+{
+
+   // ----- Feeds a SafetyDispatcher from an EventChannel
+   //
+   // The consumer thread of the channel: it sleeps on the channel's futex, and once
+   // woken drains every published event straight out of shared memory into
+   // dispatcher.post() / postStartLoader(). The dispatcher keeps its own semantics
+   // for what arrives this way: evFault takes the priority lane, the ingress filter
+   // applies, and a post that finds its ring full is dropped and counted there.
+   class ChannelPump
+   {
+      public:
+          ChannelPump(EventChannel& channel, SafetyDispatcher& dispatcher);
+          ~ChannelPump();
+
+          ChannelPump(const ChannelPump&) = delete;
+          ChannelPump& operator=(const ChannelPump&) = delete;
+
+          void start();
+
+          // Stops the pump thread after it has forwarded everything already published
+          void stop();
+
+          // ----- Observability (any thread)
+          std::uint64_t forwarded() const
+          {
+              return forwardedCount.load(std::memory_order_relaxed);
+          }
+
+          // Events not forwarded: the dispatcher's ring was full, or the trigger was
+          // not one a producer may post
+          std::uint64_t rejected() const
+          {
+              return rejectedCount.load(std::memory_order_relaxed);
+          }
+
+      private:
+          void run();
+          void forward(const ChannelEvent& event);
+
+      private:
+          EventChannel&      channel;
+          SafetyDispatcher&  dispatcher;
+          std::thread        worker;
+          std::atomic<bool>  running { false };
+          std::uint64_t      sent { 0 };          // pump thread only
+          std::uint64_t      refused { 0 };       // pump thread only
+
+          alignas(kCacheLine) std::atomic<std::uint64_t> forwardedCount { 0 };
+          std::atomic<std::uint64_t>                    rejectedCount { 0 };
+   };
+
+} // namespace safety
@@ -0,0 +1,269 @@
+#pragma once
+#include "SafetyRules/ISafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace safety
+{
+
+   // ----- One event as it travels from a sensor process to the safety process
+   struct ChannelEvent
+   {
+       std::uint64_t stamp;       // opaque to the channel: whatever the producer put there
+       std::uint32_t source;      // producer-defined: sensor or printer id
+       Trigger       trigger;     // an Event, or StartLoader
+       std::uint8_t  reserved[3];
+   };
+
+   static_assert(sizeof(ChannelEvent) == 16, "Channel events are two words");
+
+   // ----- Shared layout: header, then capacity cells
+   //
+   // The ring is MpscRing's (Vyukov's bounded queue) with its indices and cells
+   // placed in a POSIX shared memory object: producers in any process claim a cell
+   // with one CAS on tail, write the event into it and publish it by bumping the
+   // cell's sequence; the consumer reads it in place. Nothing in the block is a
+   // pointer, so each process may map it anywhere.
+   //
+   // Wakeup: sleeping is a futex word. The consumer sets it before it sleeps and
+   // re-checks the ring; a producer that publishes and then finds it set swaps it
+   // back to 0 and issues FUTEX_WAKE. While the consumer is awake (spinning or
+   // draining) a post is a CAS, a 16-byte store and a release store: no syscall.
+   struct ChannelHeader
+   {
+       char                                   magic[8];   // "SFCHAN01"
+       std::uint32_t                          version;
+       std::uint32_t                          cellSize;
+       std::uint64_t                          capacity;   // cells, a power of two
+       std::uint8_t                           padding[40];
+
+       alignas(64) std::atomic<std::uint64_t> tail;       // producers: next cell to claim
+       std::atomic<std::uint64_t>             full;       // posts that found the ring full
+
+       alignas(64) std::atomic<std::uint64_t> head;       // consumer: cells taken so far
+       std::atomic<std::uint64_t>             sleeps;     // times the consumer slept in the kernel
+       std::atomic<std::uint32_t>             closed;     // the consumer has gone
+
+       alignas(64) std::atomic<std::uint32_t> sleeping;   // futex word, 1 while the consumer sleeps
+       std::atomic<std::uint64_t>             wakeups;    // FUTEX_WAKE calls made by producers
+   };
+
+   struct alignas(64) ChannelCell
+   {
+       std::atomic<std::uint64_t> sequence;
+       ChannelEvent               event;
+   };
+
+   static_assert(sizeof(ChannelHeader) == 256, "Channel header is four cache lines");
+   static_assert(sizeof(ChannelCell) == 64, "Channel cells are one cache line");
+   static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Channel words must be lock-free to be shared");
+   static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "The futex word is a plain 32-bit int");
+
+   // ----- Consumer: owns the shared object, lives in the safety process
+   //
+   // One thread takes events, either one at a time (tryPop) or in place (drain),
+   // and calls wait() when there are none. See ChannelPump for the thread that
+   // feeds a SafetyDispatcher.
+   //
+   // A producer killed between claiming a cell and publishing it leaves that cell
+   // unpublished for good; the consumer stops at it (later events stay queued
+   // behind it). Give each crash-prone producer a channel of its own.
+   class EventChannel
+   {
+      public:
+          struct Stats
+          {
+              std::uint64_t received;   // events taken by the consumer
+              std::uint64_t full;       // posts rejected because the ring was full
+              std::uint64_t sleeps;     // times the consumer went to sleep in the kernel
+              std::uint64_t wakeups;    // futex wakes issued by producers
+              std::size_t   depth;      // events waiting right now
+          };
+
+      public:
+          // Creates POSIX shared memory object name ("/safety-sensors") with room for
+          // capacity events (rounded up to a power of two); an object left behind under
+          // the same name is replaced. Unlinked by the destructor. Throws
+          // std::system_error if it cannot be created or mapped.
+          EventChannel(const std::string& name, std::size_t capacity = 4096);
+          ~EventChannel();
+
+          EventChannel(const EventChannel&) = delete;
+          EventChannel& operator=(const EventChannel&) = delete;
+
+          // ----- Consumer (one thread only)
+          bool tryPop(ChannelEvent& event)
+          {
+              ChannelCell& cell = cells[position & mask];
+
+              if (cell.sequence.load(std::memory_order_acquire) != position + 1)
+              {
+                  return false;
+              }
+
+              event = cell.event;
+              release(cell);
+              return true;
+          }
+
+          // fn(const ChannelEvent&) for up to max waiting events, read where the
+          // producer wrote them; returns how many
+          template <typename Fn>
+          std::size_t drain(Fn&& fn, std::size_t max = ~std::size_t(0))
+          {
+              std::size_t taken = 0;
+
+              while (taken < max)
+              {
+                  ChannelCell& cell = cells[position & mask];
+
+                  if (cell.sequence.load(std::memory_order_acquire) != position + 1)
+                  {
+                      break;
+                  }
+
+                  fn(static_cast<const ChannelEvent&>(cell.event));
+                  release(cell);
+                  ++taken;
+              }
+
+              return taken;
+          }
+
+          // Returns as soon as an event is waiting (true) or once timeout has passed
+          // without one (false). Polls spins times first, then sleeps on the futex.
+          bool wait(std::chrono::nanoseconds timeout, unsigned spins = 64);
+
+          // Ends a wait() in progress early (any thread); used to stop a consumer loop
+          void interrupt();
+
+          // True when the next event has been published
+          bool ready() const
+          {
+              return cells[position & mask].sequence.load(std::memory_order_acquire) == position + 1;
+          }
+
+          // ----- Observability (any thread)
+          Stats stats() const;
+
+          std::size_t capacity() const
+          {
+              return mask + 1;
+          }
+
+          const ChannelHeader& header() const
+          {
+              return *shared;
+          }
+
+      private:
+          void release(ChannelCell& cell)
+          {
+              cell.sequence.store(position + mask + 1, std::memory_order_release);
+              ++position;
+              shared->head.store(position, std::memory_order_relaxed);
+          }
+
+      private:
+          ChannelHeader* shared { nullptr };
+          ChannelCell*   cells { nullptr };
+          std::size_t    mask { 0 };
+          std::size_t    mappedBytes { 0 };
+          std::string    name;
+          std::uint64_t  position { 0 };    // consumer's copy of head
+   };
+
+   // ----- Producer: a sensor process (or thread) posting into a channel
+   //
+   // Any number of producers, in any number of processes, may post to one channel;
+   // each producer's events arrive in the order it posted them.
+   class ChannelProducer
+   {
+      public:
+          using Event = ISafetyRules::Event;
+
+      public:
+          // Maps an existing channel; throws std::system_error if it cannot be opened
+          // or mapped, std::runtime_error if the object is not an event channel
+          explicit ChannelProducer(const std::string& name);
+          ~ChannelProducer();
+
+          ChannelProducer(const ChannelProducer&) = delete;
+          ChannelProducer& operator=(const ChannelProducer&) = delete;
+
+          // False (and counted as full) when the ring has no free cell
+          bool post(Event ev, std::uint32_t source = 0, std::uint64_t stamp = 0)
+          {
+              return push(toTrigger(ev), source, stamp);
+          }
+
+          bool postStartLoader(std::uint32_t source = 0, std::uint64_t stamp = 0)
+          {
+              return push(Trigger::StartLoader, source, stamp);
+          }
+
+          // The consumer has destroyed the channel; posts go nowhere
+          bool closed() const
+          {
+              return shared->closed.load(std::memory_order_relaxed) != 0;
+          }
+
+      private:
+          bool push(Trigger trigger, std::uint32_t source, std::uint64_t stamp)
+          {
+              std::uint64_t pos = shared->tail.load(std::memory_order_relaxed);
+
+              for (;;)
+              {
+                  ChannelCell& cell = cells[pos & mask];
+                  const std::uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+                  const std::int64_t diff = static_cast<std::int64_t>(seq - pos);
+
+                  if (diff == 0)
+                  {
+                      if (shared->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                      {
+                          cell.event = ChannelEvent { stamp, source, trigger, {} };
+                          cell.sequence.store(pos + 1, std::memory_order_release);
+                          notify();
+                          return true;
+                      }
+                  }
+                  else if (diff < 0)
+                  {
+                      shared->full.fetch_add(1, std::memory_order_relaxed);
+                      return false;
+                  }
+                  else
+                  {
+                      pos = shared->tail.load(std::memory_order_relaxed);
+                  }
+              }
+          }
+
+          void notify()
+          {
+              // Pairs with the fence in EventChannel::wait(): either the consumer sees
+              // the event on its re-check or we see it asleep
+              std::atomic_thread_fence(std::memory_order_seq_cst);
+
+              if (shared->sleeping.load(std::memory_order_relaxed) != 0)
+              {
+                  wake();
+              }
+          }
+
+          void wake();
+
+      private:
+          ChannelHeader* shared { nullptr };
+          ChannelCell*   cells { nullptr };
+          std::size_t    mask { 0 };
+          std::size_t    mappedBytes { 0 };
+   };
+
+} // namespace safety
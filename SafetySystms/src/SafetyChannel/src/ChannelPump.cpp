@@ -0,0 +1,89 @@
+#include "SafetyChannel/ChannelPump.h"
+
+#include <chrono>
+
+namespace safety
+{
+
+   namespace
+   {
+       // Timed so a stop() that races with going to sleep costs at most one period
+       constexpr std::chrono::milliseconds kSleep { 10 };
+
+       // Events forwarded between two publications of the counters
+       constexpr std::size_t kBatch = 256;
+   }
+
+   ChannelPump::ChannelPump(EventChannel& channel, SafetyDispatcher& dispatcher)
+       : channel(channel),
+         dispatcher(dispatcher)
+   {
+   }
+
+   ChannelPump::~ChannelPump()
+   {
+       stop();
+   }
+
+   void ChannelPump::start()
+   {
+       if (worker.joinable())
+       {
+           return;
+       }
+
+       running.store(true, std::memory_order_release);
+       worker = std::thread([this]() { run(); });
+   }
+
+   void ChannelPump::stop()
+   {
+       if (!worker.joinable())
+       {
+           return;
+       }
+
+       running.store(false, std::memory_order_release);
+       channel.interrupt();
+       worker.join();
+   }
+
+   void ChannelPump::forward(const ChannelEvent& event)
+   {
+       // Shared memory is written by another process: check before it reaches the table
+       bool posted = false;
+
+       if (event.trigger == Trigger::StartLoader)
+       {
+           posted = dispatcher.postStartLoader();
+       }
+       else if (static_cast<std::size_t>(event.trigger) < kEventCount)
+       {
+           posted = dispatcher.post(static_cast<SafetyDispatcher::Event>(event.trigger));
+       }
+
+       ++(posted ? sent : refused);
+   }
+
+   void ChannelPump::run()
+   {
+       for (;;)
+       {
+           const auto forwardOne = [this](const ChannelEvent& event) { forward(event); };
+
+           while (channel.drain(forwardOne, kBatch) != 0)
+           {
+               forwardedCount.store(sent, std::memory_order_relaxed);
+               rejectedCount.store(refused, std::memory_order_relaxed);
+           }
+
+           if (!running.load(std::memory_order_acquire))
+           {
+               return;
+           }
+
+           channel.wait(kSleep);
+       }
+   }
+
+} // namespace safety
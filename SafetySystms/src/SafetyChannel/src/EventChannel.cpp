@@ -0,0 +1,239 @@
+#include "SafetyChannel/EventChannel.h"
+#include "SafetyBase/Posix.h"
+
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace safety
+{
+
+   namespace
+   {
+       using posix::throwErrno;
+       using posix::Fd;
+
+       constexpr char          kMagic[8] = { 'S', 'F', 'C', 'H', 'A', 'N', '0', '1' };
+       constexpr std::uint32_t kVersion  = 1;
+
+       std::size_t roundUp(std::size_t n)
+       {
+           std::size_t p = 2;
+
+           while (p < n)
+           {
+               p <<= 1;
+           }
+
+           return p;
+       }
+
+       std::size_t bytesFor(std::size_t capacity)
+       {
+           return sizeof(ChannelHeader) + capacity * sizeof(ChannelCell);
+       }
+
+       ChannelCell* cellsOf(ChannelHeader* header)
+       {
+           return reinterpret_cast<ChannelCell*>(header + 1);
+       }
+
+       // Shared futexes (no FUTEX_PRIVATE_FLAG): the word is mapped by several processes
+       int* futexWord(std::atomic<std::uint32_t>& word)
+       {
+           return reinterpret_cast<int*>(&word);
+       }
+
+       void futexWait(std::atomic<std::uint32_t>& word, std::uint32_t expected, std::chrono::nanoseconds timeout)
+       {
+           const auto ns = timeout.count();
+           timespec relative { static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000) };
+
+           // EAGAIN (already woken), ETIMEDOUT and EINTR all mean: look at the ring again
+           ::syscall(SYS_futex, futexWord(word), FUTEX_WAIT, expected, &relative, nullptr, 0);
+       }
+
+       void futexWake(std::atomic<std::uint32_t>& word)
+       {
+           ::syscall(SYS_futex, futexWord(word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+       }
+   }
+
+   // ----- EventChannel
+
+   EventChannel::EventChannel(const std::string& name, std::size_t capacity)
+       : mask(roundUp(capacity) - 1),
+         name(name)
+   {
+       // A fresh object, never the one a previous consumer left mapped in its producers
+       ::shm_unlink(name.c_str());
+       Fd object { ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600) };
+
+       if (object.fd < 0)
+       {
+           throwErrno("shm_open", name);
+       }
+
+       mappedBytes = bytesFor(mask + 1);
+
+       if (::ftruncate(object.fd, static_cast<off_t>(mappedBytes)) != 0)
+       {
+           ::shm_unlink(name.c_str());
+           throwErrno("ftruncate", name);
+       }
+
+       void* base = ::mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, object.fd, 0);
+
+       if (base == MAP_FAILED)
+       {
+           ::shm_unlink(name.c_str());
+           throwErrno("mmap", name);
+       }
+
+       shared = new (base) ChannelHeader();
+       cells = cellsOf(shared);
+
+       for (std::size_t i = 0; i <= mask; ++i)
+       {
+           new (&cells[i]) ChannelCell();
+           cells[i].sequence.store(i, std::memory_order_relaxed);
+       }
+
+       shared->version  = kVersion;
+       shared->cellSize = sizeof(ChannelCell);
+       shared->capacity = mask + 1;
+
+       // The magic last: a producer that opens the object early sees no channel yet
+       std::atomic_thread_fence(std::memory_order_release);
+       std::memcpy(shared->magic, kMagic, sizeof(kMagic));
+   }
+
+   EventChannel::~EventChannel()
+   {
+       shared->closed.store(1, std::memory_order_relaxed);
+       ::munmap(shared, mappedBytes);
+       ::shm_unlink(name.c_str());
+   }
+
+   bool EventChannel::wait(std::chrono::nanoseconds timeout, unsigned spins)
+   {
+       for (unsigned i = 0; i < spins; ++i)
+       {
+           if (ready())
+           {
+               return true;
+           }
+
+           std::this_thread::yield();
+       }
+
+       shared->sleeping.store(1, std::memory_order_relaxed);
+
+       // Pairs with the fence in ChannelProducer::notify()
+       std::atomic_thread_fence(std::memory_order_seq_cst);
+
+       if (!ready() && timeout.count() > 0)
+       {
+           shared->sleeps.store(shared->sleeps.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+           futexWait(shared->sleeping, 1, timeout);
+       }
+
+       shared->sleeping.store(0, std::memory_order_relaxed);
+       return ready();
+   }
+
+   void EventChannel::interrupt()
+   {
+       if (shared->sleeping.exchange(0, std::memory_order_acq_rel) != 0)
+       {
+           futexWake(shared->sleeping);
+       }
+   }
+
+   EventChannel::Stats EventChannel::stats() const
+   {
+       const std::uint64_t head = shared->head.load(std::memory_order_relaxed);
+       const std::uint64_t tail = shared->tail.load(std::memory_order_relaxed);
+
+       return Stats {
+           head,
+           shared->full.load(std::memory_order_relaxed),
+           shared->sleeps.load(std::memory_order_relaxed),
+           shared->wakeups.load(std::memory_order_relaxed),
+           tail > head ? static_cast<std::size_t>(tail - head) : 0
+       };
+   }
+
+   // ----- ChannelProducer
+
+   ChannelProducer::ChannelProducer(const std::string& name)
+   {
+       Fd object { ::shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0) };
+
+       if (object.fd < 0)
+       {
+           throwErrno("shm_open", name);
+       }
+
+       struct stat st;
+
+       if (::fstat(object.fd, &st) != 0)
+       {
+           throwErrno("fstat", name);
+       }
+
+       if (static_cast<std::size_t>(st.st_size) < sizeof(ChannelHeader))
+       {
+           throw std::runtime_error("not an event channel (too small): " + name);
+       }
+
+       mappedBytes = static_cast<std::size_t>(st.st_size);
+       void* base = ::mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, object.fd, 0);
+
+       if (base == MAP_FAILED)
+       {
+           throwErrno("mmap", name);
+       }
+
+       shared = static_cast<ChannelHeader*>(base);
+       const std::uint64_t capacity = shared->capacity;
+
+       if (std::memcmp(shared->magic, kMagic, sizeof(kMagic)) != 0 || shared->version != kVersion
+           || shared->cellSize != sizeof(ChannelCell) || capacity < 2 || (capacity & (capacity - 1)) != 0
+           || bytesFor(capacity) != mappedBytes)
+       {
+           ::munmap(base, mappedBytes);
+           throw std::runtime_error("not an event channel (bad header): " + name);
+       }
+
+       std::atomic_thread_fence(std::memory_order_acquire);
+       cells = cellsOf(shared);
+       mask = capacity - 1;
+   }
+
+   ChannelProducer::~ChannelProducer()
+   {
+       ::munmap(shared, mappedBytes);
+   }
+
+   void ChannelProducer::wake()
+   {
+       // Several producers may see the consumer asleep; one of them wakes it
+       if (shared->sleeping.exchange(0, std::memory_order_acq_rel) != 0)
+       {
+           shared->wakeups.fetch_add(1, std::memory_order_relaxed);
+           futexWake(shared->sleeping);
+       }
+   }
+
+} // namespace safety
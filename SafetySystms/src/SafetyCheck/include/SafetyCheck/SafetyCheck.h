@@ -0,0 +1,112 @@
+#pragma once
+#include "SafetyRules/ISafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace safety
+{
+
+   // Bounded model checker for SafetyRules.
+   //
+   // Explores every trigger sequence (the six events, startLoader() and reset())
+   // breadth first, driving a real SafetyRules per worker thread and recording the
+   // hooks each step fires together with the state the machine reports while the
+   // hook runs. Properties are predicates over single steps; a small monitor carried
+   // in the search state lets them refer to earlier hooks.
+   //
+   // A search state is (configuration, monitor); states already visited are not
+   // expanded again, so depth d covers every sequence of length <= d and the search
+   // stops early at a fixpoint, after which the properties hold for sequences of any
+   // length. A violation is reported with a shortest trigger sequence reaching it.
+
+   // ----- Monitor bits (history the properties may depend on)
+   enum MonitorBit : std::uint8_t
+   {
+       DoorRequested = 1 << 0,     // RequestDoorOpen fired, RequestDoorClose not yet
+   };
+
+   constexpr unsigned kMonitorBits = 1;
+
+   // ----- One explored step
+   struct FiredHook
+   {
+       Hook                hook;
+       ISafetyRules::State state;  // getState() while the hook ran
+   };
+
+   struct CheckStep
+   {
+       Config       from;
+       std::uint8_t monitor;       // before the step
+       Trigger      trigger;       // may be Trigger::Reset
+       Config       to;
+       std::uint8_t hookCount;
+       std::array<FiredHook, 4> hooks;
+   };
+
+   struct Property
+   {
+       const char* name;
+       const char* description;
+       bool        (*holds)(const CheckStep& step);
+   };
+
+   // Properties every SafetyRules must satisfy
+   const std::vector<Property>& standardProperties();
+
+   // Standard properties plus stricter ones that are expected to fail
+   const std::vector<Property>& allProperties();
+
+   // ----- Compact concurrent set of visited search states
+   //
+   // Open addressing over one array of 32-bit keys, inserted with a single CAS per
+   // probe; the capacity is fixed (a power of two) and must exceed the key count.
+   class VisitedSet
+   {
+      public:
+          explicit VisitedSet(std::size_t capacity);
+
+          // True if key was not present (exactly one concurrent inserter wins)
+          bool insert(std::uint32_t key);
+
+          std::size_t size() const;
+
+      private:
+          std::unique_ptr<std::atomic<std::uint32_t>[]> slots;
+          std::size_t                                   mask;
+          std::atomic<std::size_t>                      count { 0 };
+   };
+
+   // ----- Search
+   struct CheckOptions
+   {
+       unsigned depth { 32 };      // longest trigger sequence checked
+       unsigned threads { 0 };     // 0: every hardware thread
+   };
+
+   struct Counterexample
+   {
+       const Property*      property;
+       std::vector<Trigger> trace;  // shortest sequence from reset; the last step fails
+       CheckStep            step;
+   };
+
+   struct CheckResult
+   {
+       unsigned                    depth;      // levels expanded
+       bool                        fixpoint;   // no new state at the last level
+       std::size_t                 states;     // distinct search states
+       std::size_t                 steps;      // explored (state, trigger) pairs
+       std::vector<std::size_t>    perLevel;   // new states first reached at each depth
+       std::vector<Counterexample> violations; // at most one per property
+   };
+
+   CheckResult check(const std::vector<Property>& properties, const CheckOptions& options = {});
+
+} // namespace safety
@@ -0,0 +1,509 @@
+#include "SafetyCheck/SafetyCheck.h"
+#include "SafetyRules/SafetyRules.h"
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace safety
+{
+
+   namespace
+   {
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+
+       // Everything the checker delivers: the table triggers plus reset()
+       constexpr std::size_t kCheckedTriggers = kTriggerCount + 1;
+
+       // Frontier entries per claim
+       constexpr std::size_t kBatch = 64;
+
+       // ----- Search state key: configuration in the low 4 bits, monitor above
+       constexpr std::size_t kKeySpace = kConfigCount << kMonitorBits;
+
+       std::uint32_t keyOf(Config config, std::uint8_t monitor)
+       {
+           return static_cast<std::uint32_t>(config) | static_cast<std::uint32_t>(monitor) << 4;
+       }
+
+       Config configOf(std::uint32_t key)   { return static_cast<Config>(key & 0xF); }
+       std::uint8_t monitorOf(std::uint32_t key) { return static_cast<std::uint8_t>(key >> 4); }
+
+       std::uint8_t advance(std::uint8_t monitor, const CheckStep& step)
+       {
+           for (std::size_t h = 0; h < step.hookCount; ++h)
+           {
+               if (step.hooks[h].hook == Hook::RequestDoorOpen)  monitor |= DoorRequested;
+               if (step.hooks[h].hook == Hook::RequestDoorClose) monitor &= static_cast<std::uint8_t>(~DoorRequested);
+           }
+
+           return monitor;
+       }
+
+       // ----- Spec restated independently of SafetyTable.h
+       Hook enterHook(State state)
+       {
+           switch (state)
+           {
+               case State::Idle:             return Hook::EnterIdle;
+               case State::Active:           return Hook::EnterActive;
+               case State::Faulted:          return Hook::EnterFaulted;
+               case State::BuildPlateLoader: return Hook::EnterBuildPlateLoader;
+           }
+
+           return Hook::None;
+       }
+
+       Hook exitHook(State state)
+       {
+           switch (state)
+           {
+               case State::Idle:             return Hook::ExitIdle;
+               case State::Active:           return Hook::ExitActive;
+               case State::Faulted:          return Hook::ExitFaulted;
+               case State::BuildPlateLoader: return Hook::ExitBuildPlateLoader;
+           }
+
+           return Hook::None;
+       }
+
+       Hook entryAction(Sub sub)
+       {
+           switch (sub)
+           {
+               case Sub::OpenDoor:         return Hook::RequestDoorOpen;
+               case Sub::DoorOpened:       return Hook::RequestLoadBuildPlate;
+               case Sub::BuildPlateLoaded: return Hook::RequestDoorClose;
+               case Sub::None:             break;
+           }
+
+           return Hook::None;
+       }
+
+       bool isRequest(Hook hook)
+       {
+           return hook == Hook::RequestDoorOpen || hook == Hook::RequestLoadBuildPlate || hook == Hook::RequestDoorClose;
+       }
+
+       // ----- Properties
+       bool requestsInsideLoader(const CheckStep& s)
+       {
+           for (std::size_t h = 0; h < s.hookCount; ++h)
+           {
+               if (isRequest(s.hooks[h].hook) && s.hooks[h].state != State::BuildPlateLoader)
+               {
+                   return false;
+               }
+           }
+
+           return true;
+       }
+
+       bool faultReachesFaulted(const CheckStep& s)
+       {
+           const State from = stateOf(s.from);
+
+           if (s.trigger != Trigger::evFault || (from != State::Active && from != State::BuildPlateLoader))
+           {
+               return true;
+           }
+
+           return s.to == toConfig(State::Faulted, Sub::None);
+       }
+
+       bool powerOffLeavesActive(const CheckStep& s)
+       {
+           if (s.trigger != Trigger::evPowerOff || s.from != toConfig(State::Active, Sub::None))
+           {
+               return true;
+           }
+
+           return s.to == toConfig(State::Idle, Sub::None);
+       }
+
+       bool validConfiguration(const CheckStep& s)
+       {
+           return (stateOf(s.to) == State::BuildPlateLoader) == (subOf(s.to) != Sub::None);
+       }
+
+       bool hooksMatchTransition(const CheckStep& s)
+       {
+           std::array<Hook, 4> expected {};
+           std::size_t count = 0;
+
+           if (s.trigger == Trigger::Reset)
+           {
+               expected[count++] = Hook::EnterIdle;
+           }
+           else if (stateOf(s.from) != stateOf(s.to))
+           {
+               expected[count++] = exitHook(stateOf(s.from));
+               expected[count++] = enterHook(stateOf(s.to));
+           }
+
+           if (s.trigger != Trigger::Reset && subOf(s.to) != Sub::None && s.to != s.from)
+           {
+               expected[count++] = entryAction(subOf(s.to));
+           }
+
+           if (count != s.hookCount)
+           {
+               return false;
+           }
+
+           for (std::size_t h = 0; h < count; ++h)
+           {
+               if (s.hooks[h].hook != expected[h])
+               {
+                   return false;
+               }
+           }
+
+           return true;
+       }
+
+       bool doorCloseAfterOpen(const CheckStep& s)
+       {
+           bool requested = (s.monitor & DoorRequested) != 0;
+
+           for (std::size_t h = 0; h < s.hookCount; ++h)
+           {
+               if (s.hooks[h].hook == Hook::RequestDoorOpen)
+               {
+                   requested = true;
+               }
+               else if (s.hooks[h].hook == Hook::RequestDoorClose)
+               {
+                   if (!requested) return false;
+                   requested = false;
+               }
+           }
+
+           return true;
+       }
+
+       // Strict: a loader left by a fault never closes its door, so this one fails
+       bool doorRequestedOnce(const CheckStep& s)
+       {
+           for (std::size_t h = 0; h < s.hookCount; ++h)
+           {
+               if (s.hooks[h].hook == Hook::RequestDoorOpen && (s.monitor & DoorRequested))
+               {
+                   return false;
+               }
+           }
+
+           return true;
+       }
+
+       const Property kStandard[] = {
+           { "requests-inside-loader", "door/plate requests fire only in BuildPlateLoader", &requestsInsideLoader },
+           { "fault-reaches-faulted",  "evFault from Active or any loader substate ends in Faulted", &faultReachesFaulted },
+           { "power-off-leaves-active", "evPowerOff from Active ends in Idle", &powerOffLeavesActive },
+           { "valid-configuration",    "a loader substate is set exactly in BuildPlateLoader", &validConfiguration },
+           { "hooks-match-transition", "exactly the exit, enter and entry-action hooks of the transition fire", &hooksMatchTransition },
+           { "door-close-after-open",  "RequestDoorClose only follows an unanswered RequestDoorOpen", &doorCloseAfterOpen },
+       };
+
+       const Property kStrict[] = {
+           { "door-requested-once",    "no RequestDoorOpen while a previous one is unanswered", &doorRequestedOnce },
+       };
+
+       // ----- Probe: records hooks into the step being explored
+       struct Probe
+       {
+           const SafetyRules* machine { nullptr };
+           CheckStep*         step { nullptr };
+       };
+
+       template <Hook H>
+       void probeHook(void* context)
+       {
+           Probe& probe = *static_cast<Probe*>(context);
+
+           if (probe.step && probe.step->hookCount < probe.step->hooks.size())
+           {
+               probe.step->hooks[probe.step->hookCount++] = FiredHook { H, probe.machine->getState() };
+           }
+       }
+
+       void installProbe(SafetyRules& rules, Probe& probe)
+       {
+           using Fn = ISafetyRules::VoidFn;
+
+           rules.setOnEnterIdle(Fn::bind<&probeHook<Hook::EnterIdle>>(&probe));
+           rules.setOnExitIdle(Fn::bind<&probeHook<Hook::ExitIdle>>(&probe));
+           rules.setOnEnterActive(Fn::bind<&probeHook<Hook::EnterActive>>(&probe));
+           rules.setOnExitActive(Fn::bind<&probeHook<Hook::ExitActive>>(&probe));
+           rules.setOnEnterFaulted(Fn::bind<&probeHook<Hook::EnterFaulted>>(&probe));
+           rules.setOnExitFaulted(Fn::bind<&probeHook<Hook::ExitFaulted>>(&probe));
+           rules.setOnEnterBuildPlateLoader(Fn::bind<&probeHook<Hook::EnterBuildPlateLoader>>(&probe));
+           rules.setOnExitBuildPlateLoader(Fn::bind<&probeHook<Hook::ExitBuildPlateLoader>>(&probe));
+           rules.setOnRequestDoorOpen(Fn::bind<&probeHook<Hook::RequestDoorOpen>>(&probe));
+           rules.setOnRequestLoadBuildPlate(Fn::bind<&probeHook<Hook::RequestLoadBuildPlate>>(&probe));
+           rules.setOnRequestDoorClose(Fn::bind<&probeHook<Hook::RequestDoorClose>>(&probe));
+       }
+
+       void apply(SafetyRules& rules, Trigger trigger)
+       {
+           switch (trigger)
+           {
+               case Trigger::StartLoader: rules.startLoader(); break;
+               case Trigger::Reset:       rules.reset(); break;
+               default:                   rules.dispatch(static_cast<ISafetyRules::Event>(trigger)); break;
+           }
+       }
+
+       // ----- BFS levels: each node points at its parent in the previous level
+       struct Node
+       {
+           std::uint32_t key;
+           std::uint32_t parent;
+           Trigger       trigger;
+       };
+
+       using Level = std::vector<Node>;
+
+       std::vector<Trigger> pathTo(const std::vector<Level>& levels, std::size_t depth, std::size_t index)
+       {
+           std::vector<Trigger> path(depth);
+
+           for (std::size_t d = depth; d > 0; --d)
+           {
+               const Node& node = levels[d][index];
+               path[d - 1] = node.trigger;
+               index = node.parent;
+           }
+
+           return path;
+       }
+
+       std::size_t capacityFor(std::size_t keys)
+       {
+           std::size_t capacity = 16;
+
+           while (capacity < 2 * keys)
+           {
+               capacity <<= 1;
+           }
+
+           return capacity;
+       }
+
+   } // namespace
+
+   // ----- Property sets
+   const std::vector<Property>& standardProperties()
+   {
+       static const std::vector<Property> properties(std::begin(kStandard), std::end(kStandard));
+       return properties;
+   }
+
+   const std::vector<Property>& allProperties()
+   {
+       static const std::vector<Property> properties = [] {
+           std::vector<Property> all(std::begin(kStandard), std::end(kStandard));
+           all.insert(all.end(), std::begin(kStrict), std::end(kStrict));
+           return all;
+       }();
+
+       return properties;
+   }
+
+   // ----- VisitedSet
+   VisitedSet::VisitedSet(std::size_t capacity)
+       : slots(new std::atomic<std::uint32_t>[capacity])
+       , mask(capacity - 1)
+   {
+       assert((capacity & mask) == 0 && "VisitedSet capacity must be a power of two");
+
+       for (std::size_t i = 0; i < capacity; ++i)
+       {
+           slots[i].store(0, std::memory_order_relaxed);
+       }
+   }
+
+   bool VisitedSet::insert(std::uint32_t key)
+   {
+       const std::uint32_t stored = key + 1;   // 0 marks an empty slot
+       std::size_t slot = (static_cast<std::size_t>(key) * 0x9E3779B97F4A7C15ull) >> 20 & mask;
+
+       for (std::size_t probes = 0; probes <= mask; ++probes, slot = (slot + 1) & mask)
+       {
+           std::uint32_t seen = slots[slot].load(std::memory_order_acquire);
+
+           if (seen == 0 && slots[slot].compare_exchange_strong(seen, stored, std::memory_order_acq_rel))
+           {
+               count.fetch_add(1, std::memory_order_relaxed);
+               return true;
+           }
+
+           if (seen == stored)
+           {
+               return false;
+           }
+       }
+
+       throw std::length_error("VisitedSet is full");
+   }
+
+   std::size_t VisitedSet::size() const
+   {
+       return count.load(std::memory_order_relaxed);
+   }
+
+   // ----- Search
+   CheckResult check(const std::vector<Property>& properties, const CheckOptions& options)
+   {
+       const unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+       CheckResult result {};
+       VisitedSet visited(capacityFor(kKeySpace));
+       std::vector<Level> levels;
+
+       const std::uint32_t root = keyOf(toConfig(State::Idle, Sub::None), 0);
+       visited.insert(root);
+       levels.push_back(Level { Node { root, 0, Trigger::Reset } });
+       result.perLevel.push_back(1);
+
+       std::vector<std::vector<Trigger>> found(properties.size());
+       std::vector<CheckStep> foundStep(properties.size());
+       std::mutex foundMutex;
+       std::atomic<std::size_t> steps { 0 };
+
+       for (unsigned depth = 0; depth < options.depth && !levels.back().empty(); ++depth)
+       {
+           const Level& frontier = levels.back();
+           std::atomic<std::size_t> nextIndex { 0 };
+           std::vector<Level> produced(threads);
+
+           auto expand = [&](unsigned worker) {
+               Probe probe;
+               SafetyRules base;
+               SafetyRules machine;
+               Level& out = produced[worker];
+               std::size_t localSteps = 0;
+
+               installProbe(base, probe);
+
+               for (;;)
+               {
+                   const std::size_t begin = nextIndex.fetch_add(kBatch, std::memory_order_relaxed);
+
+                   if (begin >= frontier.size())
+                   {
+                       break;
+                   }
+
+                   for (std::size_t n = begin; n < std::min(begin + kBatch, frontier.size()); ++n)
+                   {
+                       const std::vector<Trigger> path = pathTo(levels, depth, n);
+
+                       // Rebuild the node's machine; its hooks are not recorded
+                       probe.step = nullptr;
+                       base.reset();
+
+                       for (Trigger t : path)
+                       {
+                           apply(base, t);
+                       }
+
+                       assert(toConfig(base.getState(), base.getLoaderSubstate()) == configOf(frontier[n].key));
+
+                       for (std::size_t t = 0; t < kCheckedTriggers; ++t)
+                       {
+                           const Trigger trigger = static_cast<Trigger>(t);
+                           CheckStep step {};
+
+                           step.from    = configOf(frontier[n].key);
+                           step.monitor = monitorOf(frontier[n].key);
+                           step.trigger = trigger;
+
+                           machine = base;
+                           probe.machine = &machine;
+                           probe.step = &step;
+                           apply(machine, trigger);
+                           probe.step = nullptr;
+
+                           step.to = toConfig(machine.getState(), machine.getLoaderSubstate());
+                           ++localSteps;
+
+                           for (std::size_t p = 0; p < properties.size(); ++p)
+                           {
+                               if (properties[p].holds(step))
+                               {
+                                   continue;
+                               }
+
+                               std::vector<Trigger> trace = path;
+                               trace.push_back(trigger);
+
+                               // Shortest first, then lexicographically smallest, so reports are stable
+                               std::lock_guard<std::mutex> lock(foundMutex);
+
+                               if (found[p].empty() || trace.size() < found[p].size()
+                                   || (trace.size() == found[p].size() && trace < found[p]))
+                               {
+                                   found[p] = std::move(trace);
+                                   foundStep[p] = step;
+                               }
+                           }
+
+                           const std::uint32_t key = keyOf(step.to, advance(step.monitor, step));
+
+                           if (visited.insert(key))
+                           {
+                               out.push_back(Node { key, static_cast<std::uint32_t>(n), trigger });
+                           }
+                       }
+                   }
+               }
+
+               steps.fetch_add(localSteps, std::memory_order_relaxed);
+           };
+
+           std::vector<std::thread> workers;
+
+           for (unsigned w = 1; w < threads; ++w)
+           {
+               workers.emplace_back(expand, w);
+           }
+
+           expand(0);
+
+           for (auto& w : workers)
+           {
+               w.join();
+           }
+
+           Level next;
+
+           for (Level& part : produced)
+           {
+               next.insert(next.end(), part.begin(), part.end());
+           }
+
+           result.perLevel.push_back(next.size());
+           result.depth = depth + 1;
+           levels.push_back(std::move(next));
+       }
+
+       result.fixpoint = levels.back().empty();
+       result.states   = visited.size();
+       result.steps    = steps.load();
+
+       for (std::size_t p = 0; p < properties.size(); ++p)
+       {
+           if (!found[p].empty())
+           {
+               result.violations.push_back(Counterexample { &properties[p], std::move(found[p]), foundStep[p] });
+           }
+       }
+
+       return result;
+   }
+
+} // namespace safety
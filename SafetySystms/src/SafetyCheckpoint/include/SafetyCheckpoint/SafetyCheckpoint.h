@@ -0,0 +1,111 @@
+#pragma once
+#include "SafetyFleet/SafetyFleet.h"
+#include "SafetyRules/SafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace safety
+{
+
+   // ----- On-disk layout of a checkpoint file
+   //
+   // A 4 KiB block holding the file header, then two 4 KiB-aligned slots, each a
+   // 64-byte slot header followed by one Config byte per machine. Saves alternate
+   // between the slots, so the slot that holds the newest complete checkpoint is
+   // never the one being written. A slot is valid when its CRC32C, taken over the
+   // slot header fields and the configurations, matches: a save torn by a crash
+   // leaves a mismatch and restore falls back to the other slot.
+   struct CheckpointHeader
+   {
+       char          magic[8];       // "SFCKPT01"
+       std::uint32_t version;
+       std::uint32_t slotHeaderSize;
+       std::uint64_t capacity;       // machines a slot can hold
+       std::uint64_t slotBytes;      // distance between the two slots
+       std::uint8_t  padding[32];
+   };
+
+   static_assert(sizeof(CheckpointHeader) == 64, "Checkpoint header is one cache line");
+
+   struct CheckpointSlot
+   {
+       std::uint64_t generation;     // 1, 2, 3, ... across saves; 0 = never written
+       std::uint64_t count;          // machines saved
+       std::uint64_t timestampNs;    // CLOCK_REALTIME at save, meaningful across reboots
+       std::uint32_t checksum;       // CRC32C of the three fields above and the configurations
+       std::uint32_t reserved;
+       std::uint8_t  padding[32];
+   };
+
+   static_assert(sizeof(CheckpointSlot) == 64, "Checkpoint slot header is one cache line");
+
+   // CRC32C (Castagnoli); SSE4.2 when the CPU has it, a table otherwise, same result
+   std::uint32_t crc32c(const void* data, std::size_t size, std::uint32_t crc = 0);
+
+   // ----- Writer: periodic checkpoints of a whole fleet
+   class SafetyCheckpoint
+   {
+      public:
+          // Opens path for capacity machines. A checkpoint file of the same capacity is
+          // kept, and saves continue its generations; anything else is recreated.
+          // durable: each save is msync'ed to disk before it returns. Throws
+          // std::system_error if the file cannot be created, mapped or synced.
+          SafetyCheckpoint(const std::string& path, std::size_t capacity, bool durable = true);
+          ~SafetyCheckpoint();
+
+          SafetyCheckpoint(const SafetyCheckpoint&) = delete;
+          SafetyCheckpoint& operator=(const SafetyCheckpoint&) = delete;
+
+          // Each returns the generation written; std::invalid_argument above capacity(),
+          // std::system_error if a durable save cannot be synced
+          std::uint64_t save(const Config* configs, std::size_t count);
+          std::uint64_t save(const SafetyFleet& fleet);
+          std::uint64_t save(const SafetyRules* machines, std::size_t count);
+
+          std::uint64_t generation() const { return last; }
+          std::size_t capacity() const;
+
+      private:
+          template <typename ConfigAt>
+          std::uint64_t write(std::size_t count, ConfigAt&& configAt);
+
+          CheckpointSlot& slot(std::uint64_t generation);
+
+      private:
+          CheckpointHeader* header { nullptr };
+          std::size_t       mappedBytes { 0 };
+          std::uint64_t     last { 0 };
+          bool              durable;
+          std::string       path;
+   };
+
+   // ----- Reader: the newest valid checkpoint of a file, copied out and verified
+   class CheckpointReader
+   {
+      public:
+          // Throws std::system_error if the file cannot be read, std::runtime_error if it
+          // is not a checkpoint file or neither slot holds a valid checkpoint
+          explicit CheckpointReader(const std::string& path);
+
+          std::uint64_t generation() const  { return savedGeneration; }
+          std::uint64_t timestampNs() const { return savedNs; }
+          std::size_t size() const          { return configs.size(); }
+
+          const Config* begin() const { return configs.data(); }
+          const Config* end() const   { return configs.data() + configs.size(); }
+
+          // Puts every machine in its saved configuration without firing hooks;
+          // std::invalid_argument unless the fleet has exactly size() machines
+          void restore(SafetyFleet& fleet) const;
+          void restore(SafetyRules* machines, std::size_t count) const;
+
+      private:
+          std::vector<Config> configs;
+          std::uint64_t       savedGeneration { 0 };
+          std::uint64_t       savedNs { 0 };
+   };
+
+} // namespace safety
@@ -0,0 +1,413 @@
+#include "SafetyCheckpoint/SafetyCheckpoint.h"
+#include "SafetyBase/Posix.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define SAFETY_CHECKPOINT_SSE42 1
+#endif
+
+namespace safety
+{
+
+   namespace
+   {
+       using posix::realtimeNs;
+       using posix::throwErrno;
+       using posix::Fd;
+
+       constexpr char          kMagic[8] = { 'S', 'F', 'C', 'K', 'P', 'T', '0', '1' };
+       constexpr std::uint32_t kVersion  = 1;
+       constexpr std::size_t   kPage     = 4096;   // layout unit, not the system page size
+
+       std::size_t slotBytesFor(std::size_t capacity)
+       {
+           return (sizeof(CheckpointSlot) + capacity + kPage - 1) / kPage * kPage;
+       }
+
+       std::size_t fileBytesFor(std::size_t capacity)
+       {
+           return kPage + 2 * slotBytesFor(capacity);
+       }
+
+       bool sameLayout(const CheckpointHeader& h, std::size_t capacity)
+       {
+           return std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0
+                  && h.version == kVersion
+                  && h.slotHeaderSize == sizeof(CheckpointSlot)
+                  && h.capacity == capacity
+                  && h.slotBytes == slotBytesFor(capacity);
+       }
+
+       // msync needs a start on a system page, which may be larger than kPage: sync
+       // from the page the range starts in
+       int syncRange(const void* begin, std::size_t bytes)
+       {
+           static const auto page  = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+           const auto        start = reinterpret_cast<std::uintptr_t>(begin);
+           const auto        first = start & ~(page - 1);
+
+           return ::msync(reinterpret_cast<void*>(first), start + bytes - first, MS_SYNC);
+       }
+
+       const CheckpointSlot& slotAt(const CheckpointHeader& h, std::size_t index)
+       {
+           return *reinterpret_cast<const CheckpointSlot*>(reinterpret_cast<const char*>(&h) + kPage + index * h.slotBytes);
+       }
+
+       // ----- CRC32C, reflected polynomial 0x82F63B78
+       constexpr std::array<std::uint32_t, 256> makeCrcTable()
+       {
+           std::array<std::uint32_t, 256> table {};
+
+           for (std::uint32_t i = 0; i < 256; ++i)
+           {
+               std::uint32_t crc = i;
+
+               for (int bit = 0; bit < 8; ++bit)
+               {
+                   crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+               }
+
+               table[i] = crc;
+           }
+
+           return table;
+       }
+
+       constexpr std::array<std::uint32_t, 256> kCrcTable = makeCrcTable();
+
+       std::uint32_t crcTable(const std::uint8_t* p, std::size_t size, std::uint32_t crc)
+       {
+           for (std::size_t i = 0; i < size; ++i)
+           {
+               crc = (crc >> 8) ^ kCrcTable[(crc ^ p[i]) & 0xFF];
+           }
+
+           return crc;
+       }
+
+#if SAFETY_CHECKPOINT_SSE42
+       __attribute__((target("sse4.2")))
+       std::uint32_t crcHardware(const std::uint8_t* p, std::size_t size, std::uint32_t crc)
+       {
+           std::uint64_t wide = crc;
+
+           for (; size >= 8; p += 8, size -= 8)
+           {
+               std::uint64_t word;
+               std::memcpy(&word, p, 8);
+               wide = _mm_crc32_u64(wide, word);
+           }
+
+           crc = static_cast<std::uint32_t>(wide);
+
+           for (; size != 0; ++p, --size)
+           {
+               crc = _mm_crc32_u8(crc, *p);
+           }
+
+           return crc;
+       }
+
+       bool haveSse42()
+       {
+           static const bool supported = __builtin_cpu_supports("sse4.2");
+           return supported;
+       }
+#endif
+
+       // The slot header fields up to the checksum, then the configurations
+       std::uint32_t checksumOf(const CheckpointSlot& slot, const Config* configs)
+       {
+           const std::uint32_t crc = crc32c(&slot, offsetof(CheckpointSlot, checksum));
+           return crc32c(configs, slot.count, crc);
+       }
+   }
+
+   std::uint32_t crc32c(const void* data, std::size_t size, std::uint32_t crc)
+   {
+       const auto* p = static_cast<const std::uint8_t*>(data);
+
+#if SAFETY_CHECKPOINT_SSE42
+       if (haveSse42())
+       {
+           return ~crcHardware(p, size, ~crc);
+       }
+#endif
+
+       return ~crcTable(p, size, ~crc);
+   }
+
+   // ----- SafetyCheckpoint
+
+   SafetyCheckpoint::SafetyCheckpoint(const std::string& path, std::size_t capacity, bool durable)
+       : durable(durable), path(path)
+   {
+       Fd file { ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644) };
+
+       if (file.fd < 0)
+       {
+           throwErrno("open", path);
+       }
+
+       struct stat st;
+
+       if (::fstat(file.fd, &st) != 0)
+       {
+           throwErrno("fstat", path);
+       }
+
+       mappedBytes = fileBytesFor(capacity);
+       bool keep = false;
+
+       if (static_cast<std::size_t>(st.st_size) == mappedBytes)
+       {
+           CheckpointHeader existing;
+           keep = ::pread(file.fd, &existing, sizeof(existing), 0) == static_cast<ssize_t>(sizeof(existing))
+                  && sameLayout(existing, capacity);
+       }
+
+       if (!keep)
+       {
+           // Start from zeroes: both slots read as never written
+           if (::ftruncate(file.fd, 0) != 0)
+           {
+               throwErrno("ftruncate", path);
+           }
+
+           // Reserve the blocks up front so a save never hits ENOSPC as SIGBUS
+           if (int err = ::posix_fallocate(file.fd, 0, static_cast<off_t>(mappedBytes)); err != 0)
+           {
+               errno = err;
+               throwErrno("posix_fallocate", path);
+           }
+       }
+
+       void* base = ::mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd, 0);
+
+       if (base == MAP_FAILED)
+       {
+           throwErrno("mmap", path);
+       }
+
+       header = static_cast<CheckpointHeader*>(base);
+
+       if (keep)
+       {
+           // Continue after the newest valid generation; a torn slot is simply overwritten next
+           for (std::size_t s = 0; s < 2; ++s)
+           {
+               const CheckpointSlot& existing = slotAt(*header, s);
+               const Config* configs = reinterpret_cast<const Config*>(&existing + 1);
+
+               if (existing.count <= capacity && existing.checksum == checksumOf(existing, configs)
+                   && existing.generation > last)
+               {
+                   last = existing.generation;
+               }
+           }
+       }
+       else
+       {
+           std::memcpy(header->magic, kMagic, sizeof(kMagic));
+           header->version        = kVersion;
+           header->slotHeaderSize = sizeof(CheckpointSlot);
+           header->capacity       = capacity;
+           header->slotBytes      = slotBytesFor(capacity);
+
+           if (durable && syncRange(header, kPage) != 0)
+           {
+               const int err = errno;
+               ::munmap(header, mappedBytes);
+               errno = err;
+               throwErrno("msync", path);
+           }
+       }
+   }
+
+   SafetyCheckpoint::~SafetyCheckpoint()
+   {
+       if (header)
+       {
+           ::munmap(header, mappedBytes);
+       }
+   }
+
+   std::size_t SafetyCheckpoint::capacity() const
+   {
+       return header->capacity;
+   }
+
+   CheckpointSlot& SafetyCheckpoint::slot(std::uint64_t generation)
+   {
+       return const_cast<CheckpointSlot&>(slotAt(*header, generation % 2));
+   }
+
+   template <typename ConfigAt>
+   std::uint64_t SafetyCheckpoint::write(std::size_t count, ConfigAt&& configAt)
+   {
+       if (count > header->capacity)
+       {
+           throw std::invalid_argument("checkpoint of " + std::to_string(count) + " machines exceeds capacity "
+                                       + std::to_string(header->capacity));
+       }
+
+       // Never the slot holding generation last, which stays valid until this one is
+       const std::uint64_t generation = last + 1;
+       CheckpointSlot& target = slot(generation);
+       Config* configs = reinterpret_cast<Config*>(&target + 1);
+
+       for (std::size_t i = 0; i < count; ++i)
+       {
+           configs[i] = configAt(i);
+       }
+
+       target.generation  = generation;
+       target.count       = count;
+       target.timestampNs = realtimeNs();
+       target.reserved    = 0;
+       target.checksum    = checksumOf(target, configs);
+
+       // last stays put on failure, so the next save retries this slot
+       if (durable && syncRange(&target, sizeof(CheckpointSlot) + count) != 0)
+       {
+           throwErrno("msync", path);
+       }
+
+       last = generation;
+       return generation;
+   }
+
+   std::uint64_t SafetyCheckpoint::save(const Config* configs, std::size_t count)
+   {
+       return write(count, [configs](std::size_t i) { return configs[i]; });
+   }
+
+   std::uint64_t SafetyCheckpoint::save(const SafetyFleet& fleet)
+   {
+       return save(fleet.configurations().data(), fleet.size());
+   }
+
+   std::uint64_t SafetyCheckpoint::save(const SafetyRules* machines, std::size_t count)
+   {
+       return write(count, [machines](std::size_t i) {
+           return toConfig(machines[i].getState(), machines[i].getLoaderSubstate());
+       });
+   }
+
+   // ----- CheckpointReader
+
+   CheckpointReader::CheckpointReader(const std::string& path)
+   {
+       Fd file { ::open(path.c_str(), O_RDONLY | O_CLOEXEC) };
+
+       if (file.fd < 0)
+       {
+           throwErrno("open", path);
+       }
+
+       struct stat st;
+
+       if (::fstat(file.fd, &st) != 0)
+       {
+           throwErrno("fstat", path);
+       }
+
+       // The CRC covers slots, not the header: its capacity is only trusted once the
+       // file is exactly as long as that capacity makes it, so a corrupt header (and
+       // a slot count up to it) cannot size an allocation beyond the file
+       const auto fileBytes = static_cast<std::uint64_t>(st.st_size);
+       CheckpointHeader header;
+
+       if (::pread(file.fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))
+           || header.capacity > fileBytes
+           || fileBytes != fileBytesFor(header.capacity)
+           || !sameLayout(header, header.capacity))
+       {
+           throw std::runtime_error("not a safety checkpoint (bad header): " + path);
+       }
+
+       // Each slot is copied out and verified on the copy, so a writer still saving
+       // into the file cannot change what is restored
+       std::vector<Config> candidate;
+
+       for (std::size_t s = 0; s < 2; ++s)
+       {
+           const off_t offset = static_cast<off_t>(kPage + s * header.slotBytes);
+           CheckpointSlot slot;
+
+           if (::pread(file.fd, &slot, sizeof(slot), offset) != static_cast<ssize_t>(sizeof(slot))
+               || slot.generation == 0 || slot.generation <= savedGeneration || slot.count > header.capacity)
+           {
+               continue;
+           }
+
+           candidate.resize(slot.count);
+
+           if (::pread(file.fd, candidate.data(), slot.count, offset + static_cast<off_t>(sizeof(slot)))
+               != static_cast<ssize_t>(slot.count))
+           {
+               continue;
+           }
+
+           bool reachable = true;
+
+           for (Config c : candidate)
+           {
+               reachable = reachable && isReachable(c);
+           }
+
+           if (!reachable || slot.checksum != checksumOf(slot, candidate.data()))
+           {
+               continue;
+           }
+
+           configs.swap(candidate);
+           savedGeneration = slot.generation;
+           savedNs = slot.timestampNs;
+       }
+
+       if (savedGeneration == 0)
+       {
+           throw std::runtime_error("no valid checkpoint in " + path);
+       }
+   }
+
+   void CheckpointReader::restore(SafetyFleet& fleet) const
+   {
+       if (fleet.size() != configs.size())
+       {
+           throw std::invalid_argument("checkpoint holds " + std::to_string(configs.size()) + " machines, fleet has "
+                                       + std::to_string(fleet.size()));
+       }
+
+       fleet.restore(configs.data());
+   }
+
+   void CheckpointReader::restore(SafetyRules* machines, std::size_t count) const
+   {
+       if (count != configs.size())
+       {
+           throw std::invalid_argument("checkpoint holds " + std::to_string(configs.size()) + " machines, not "
+                                       + std::to_string(count));
+       }
+
+       for (std::size_t i = 0; i < count; ++i)
+       {
+           machines[i].restore(configs[i]);
+       }
+   }
+
+} // namespace safety
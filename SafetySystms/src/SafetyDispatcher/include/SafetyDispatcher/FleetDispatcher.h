@@ -0,0 +1,221 @@
+#pragma once
+#include "SafetyBase/MpscRing.h"
+#include "SafetyFleet/SafetyFleet.h"
+#include "SafetyRules/Instrumentation.h"
+#include "SafetyRules/ISafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace safety
+{
+
+   // Thread-safe front end for a whole fleet, scaled over several worker threads.
+   //
+   // Printer ids are dense (0 .. printers-1) and hashed to shards by their low bits;
+   // each shard owns the SafetyFleet slice of its printers and one MPSC ring. A worker
+   // claims a whole shard (one CAS on its flag), drains a batch of its ring and
+   // releases it, so a shard is only ever stepped by one thread at a time and the
+   // events of any one printer are delivered in ring order. Workers serve their home
+   // shards first and steal any other shard with pending work when those run dry.
+   //
+   // Hooks receive the global printer id, run on whichever worker owns the shard and
+   // must not post back into the dispatcher. Set them before start().
+   class FleetDispatcher
+   {
+      public:
+          using Event     = ISafetyRules::Event;
+          using State     = ISafetyRules::State;
+          using LoaderSub = ISafetyRules::LoaderSub;
+          using PrinterFn = SafetyFleet::PrinterFn;
+
+          struct Stats
+          {
+              std::uint64_t dispatched;  // triggers delivered to printers
+              std::uint64_t dropped;     // posts rejected: shard ring full or printer id out of range
+              std::uint64_t claims;      // shard batches drained
+              std::uint64_t steals;      // ... of those, by a worker other than the home one
+              std::array<std::uint64_t, instrumentation::kLatencyBuckets> latency;  // sampled post-to-step, log2 ns
+
+              // Upper bound of the latency bucket holding the q-quantile (0 < q <= 1); 0 without samples
+              std::uint64_t latencyQuantileNs(double q) const
+              {
+                  std::uint64_t total = 0;
+
+                  for (std::uint64_t n : latency)
+                  {
+                      total += n;
+                  }
+
+                  std::uint64_t seen = 0;
+
+                  for (std::size_t b = 0; b < latency.size() && total != 0; ++b)
+                  {
+                      seen += latency[b];
+
+                      if (seen > 0 && static_cast<double>(seen) >= q * static_cast<double>(total))
+                      {
+                          return instrumentation::bucketLimit(b);
+                      }
+                  }
+
+                  return 0;
+              }
+          };
+
+      public:
+          // ----- Construction (shards is rounded up to a power of two; workers == 0: every hardware thread)
+          explicit FleetDispatcher(std::size_t printers, unsigned workers = 0, std::size_t shards = 256,
+                                   std::size_t capacity = 1024);
+
+          ~FleetDispatcher();
+
+          FleetDispatcher(const FleetDispatcher&) = delete;
+          FleetDispatcher& operator=(const FleetDispatcher&) = delete;
+
+          // ----- Lifecycle
+          void start();
+
+          // Stops the workers after everything already posted has been delivered
+          void stop();
+
+          // ----- Producers (any thread)
+          bool post(std::uint32_t printer, Event ev)
+          {
+              return enqueue(printer, toTrigger(ev));
+          }
+
+          bool postStartLoader(std::uint32_t printer)
+          {
+              return enqueue(printer, Trigger::StartLoader);
+          }
+
+          // ----- Configuration (before start())
+          void setHook(Hook h, PrinterFn cb)
+          {
+              hooks[static_cast<std::size_t>(h)] = cb;
+          }
+
+          // Timestamps every n-th post of each producer thread (n a power of two, 0 = off)
+          void setLatencySampling(unsigned n)
+          {
+              sampleMask = n == 0 ? 0 : n - 1;
+              sampling = n != 0;
+          }
+
+          // ----- Observability
+          std::size_t size() const            { return printers; }
+          std::size_t shardCount() const      { return shards.size(); }
+          unsigned workerCount() const        { return workers; }
+
+          // Only meaningful while stopped (or from a hook of that printer)
+          State getState(std::uint32_t printer) const
+          {
+              return shardOf(printer).fleet.getState(localOf(printer));
+          }
+
+          LoaderSub getLoaderSubstate(std::uint32_t printer) const
+          {
+              return shardOf(printer).fleet.getLoaderSubstate(localOf(printer));
+          }
+
+          // Sums the per-worker counters (any thread, approximate while running)
+          Stats stats() const;
+
+      private:
+          struct Envelope
+          {
+              std::uint32_t local;     // index inside the shard's fleet
+              Trigger       trigger;
+              std::uint64_t postedNs;  // 0 unless sampled
+          };
+
+          struct alignas(kCacheLine) Shard
+          {
+              Shard(FleetDispatcher& owner, std::uint32_t index, std::size_t printers, std::size_t capacity)
+                  : owner(owner), index(index), fleet(printers), queue(capacity)
+              {
+              }
+
+              FleetDispatcher&      owner;
+              const std::uint32_t   index;
+              SafetyFleet           fleet;
+              MpscRing<Envelope>    queue;
+              alignas(kCacheLine) std::atomic<bool> claimed { false };
+          };
+
+          struct alignas(kCacheLine) WorkerStats
+          {
+              std::atomic<std::uint64_t> dispatched { 0 };
+              std::atomic<std::uint64_t> claims { 0 };
+              std::atomic<std::uint64_t> steals { 0 };
+              std::array<std::atomic<std::uint64_t>, instrumentation::kLatencyBuckets> latency {};
+          };
+
+          Shard& shardOf(std::uint32_t printer) const
+          {
+              return *shards[printer & shardMask];
+          }
+
+          std::uint32_t localOf(std::uint32_t printer) const
+          {
+              return printer >> shardBits;
+          }
+
+          bool enqueue(std::uint32_t printer, Trigger trigger);
+
+          // ----- Worker threads
+          void run(unsigned worker);
+          bool drain(Shard& shard, WorkerStats& stats, bool steal);
+          bool allEmpty() const;
+          void idle();
+          void wake();
+
+          template <std::size_t H>
+          static void relay(void* shard, std::uint32_t local)
+          {
+              const Shard& s = *static_cast<const Shard*>(shard);
+              const PrinterFn& fn = s.owner.hooks[H];
+
+              if (fn) fn(local << s.owner.shardBits | s.index);
+          }
+
+          template <std::size_t... H>
+          void installRelays(Shard& shard, std::index_sequence<H...>)
+          {
+              (shard.fleet.setHook(static_cast<Hook>(H), PrinterFn::bind<&relay<H>>(&shard)), ...);
+          }
+
+      private:
+          static constexpr std::size_t kBatch = 256;             // triggers per claim
+          static constexpr unsigned    kSpinsBeforeSleep = 64;
+
+          const std::size_t                   printers;
+          const unsigned                      workers;
+          unsigned                            shardBits { 0 };
+          std::uint32_t                       shardMask { 0 };
+          std::vector<std::unique_ptr<Shard>> shards;
+          std::array<PrinterFn, kHookCount>   hooks;
+          std::unique_ptr<WorkerStats[]>      workerStats;
+          std::vector<std::thread>            threads;
+
+          unsigned                            sampleMask { 0 };
+          bool                                sampling { false };
+
+          alignas(kCacheLine) std::atomic<bool>          running { false };
+          std::atomic<unsigned>                         sleepers { 0 };
+          std::mutex                                    sleepMutex;
+          std::condition_variable                       wakeup;
+
+          alignas(kCacheLine) std::atomic<std::uint64_t> dropped { 0 };
+   };
+
+} // namespace safety
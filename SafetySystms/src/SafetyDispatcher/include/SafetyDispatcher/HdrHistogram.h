@@ -0,0 +1,171 @@
+#pragma once
+#include "SafetyRules/Instrumentation.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace safety
+{
+
+   // High-dynamic-range histogram with a fixed footprint.
+   //
+   // Log-linear buckets in the HdrHistogram layout: values below 128 have a bucket
+   // each, and every further power of two is split into 64 equal sub-buckets, so any
+   // recorded value is known to within 1/64 (better than two significant digits) from
+   // 1 up to 2^36. Larger values are clamped into the last bucket; max() stays exact.
+   //
+   // One writer thread records with plain relaxed stores (instrumentation::bump);
+   // any thread may read while it does. A reader may see a count and the buckets a
+   // few records apart, never a torn value.
+   class HdrHistogram
+   {
+      public:
+          static constexpr unsigned    kSubBucketBits  = 7;
+          static constexpr std::size_t kSubBucketCount = std::size_t(1) << kSubBucketBits;
+          static constexpr std::size_t kHalfCount      = kSubBucketCount / 2;
+          static constexpr unsigned    kMaxBits        = 36;
+          static constexpr std::uint64_t kMaxTrackable = (std::uint64_t(1) << kMaxBits) - 1;
+          static constexpr std::size_t kBucketCount    = kSubBucketCount + (kMaxBits - kSubBucketBits) * kHalfCount;
+
+          // ----- Bucket arithmetic
+          static std::size_t indexOf(std::uint64_t value)
+          {
+              if (value > kMaxTrackable)
+              {
+                  value = kMaxTrackable;
+              }
+
+              if (value < kSubBucketCount)
+              {
+                  return static_cast<std::size_t>(value);
+              }
+
+              const unsigned msb   = 63 - static_cast<unsigned>(__builtin_clzll(value));
+              const unsigned shift = msb - (kSubBucketBits - 1);
+
+              return kSubBucketCount + (shift - 1) * kHalfCount + static_cast<std::size_t>((value >> shift) - kHalfCount);
+          }
+
+          // Smallest and largest value that land in bucket index
+          static std::uint64_t lowestOf(std::size_t index)
+          {
+              if (index < kSubBucketCount)
+              {
+                  return index;
+              }
+
+              const std::size_t rest  = index - kSubBucketCount;
+              const unsigned    shift = static_cast<unsigned>(rest / kHalfCount) + 1;
+
+              return static_cast<std::uint64_t>(rest % kHalfCount + kHalfCount) << shift;
+          }
+
+          static std::uint64_t highestOf(std::size_t index)
+          {
+              if (index < kSubBucketCount)
+              {
+                  return index;
+              }
+
+              const unsigned shift = static_cast<unsigned>((index - kSubBucketCount) / kHalfCount) + 1;
+              return lowestOf(index) + (std::uint64_t(1) << shift) - 1;
+          }
+
+          // ----- Writer (one thread)
+          void record(std::uint64_t value)
+          {
+              instrumentation::bump(counts[indexOf(value)]);
+              instrumentation::bump(total);
+              instrumentation::bump(sum, value);
+
+              if (value > maxValue.load(std::memory_order_relaxed))
+              {
+                  maxValue.store(value, std::memory_order_relaxed);
+              }
+
+              if (value < minValue.load(std::memory_order_relaxed))
+              {
+                  minValue.store(value, std::memory_order_relaxed);
+              }
+          }
+
+          // ----- Readers (any thread)
+          std::uint64_t count() const
+          {
+              return total.load(std::memory_order_relaxed);
+          }
+
+          std::uint64_t max() const
+          {
+              return maxValue.load(std::memory_order_relaxed);
+          }
+
+          std::uint64_t min() const
+          {
+              return count() == 0 ? 0 : minValue.load(std::memory_order_relaxed);
+          }
+
+          double mean() const
+          {
+              const std::uint64_t n = count();
+              return n == 0 ? 0.0 : static_cast<double>(sum.load(std::memory_order_relaxed)) / static_cast<double>(n);
+          }
+
+          // Highest value equivalent to the q-quantile (0 < q <= 1), capped at max()
+          std::uint64_t valueAtQuantile(double q) const
+          {
+              std::uint64_t n = 0;
+
+              for (const auto& c : counts)
+              {
+                  n += c.load(std::memory_order_relaxed);
+              }
+
+              if (n == 0)
+              {
+                  return 0;
+              }
+
+              const double target = q * static_cast<double>(n);
+              std::uint64_t seen = 0;
+
+              for (std::size_t i = 0; i < kBucketCount; ++i)
+              {
+                  seen += counts[i].load(std::memory_order_relaxed);
+
+                  if (seen > 0 && static_cast<double>(seen) >= target)
+                  {
+                      const std::uint64_t high = highestOf(i);
+                      return high < max() ? high : max();
+                  }
+              }
+
+              return max();
+          }
+
+          // fn(lowest, highest, count) for every non-empty bucket, in value order
+          template <typename Fn>
+          void forEachBucket(Fn&& fn) const
+          {
+              for (std::size_t i = 0; i < kBucketCount; ++i)
+              {
+                  const std::uint64_t c = counts[i].load(std::memory_order_relaxed);
+
+                  if (c != 0)
+                  {
+                      fn(lowestOf(i), highestOf(i), c);
+                  }
+              }
+          }
+
+      private:
+          std::array<std::atomic<std::uint64_t>, kBucketCount> counts {};
+          std::atomic<std::uint64_t> total { 0 };
+          std::atomic<std::uint64_t> sum { 0 };
+          std::atomic<std::uint64_t> maxValue { 0 };
+          std::atomic<std::uint64_t> minValue { std::numeric_limits<std::uint64_t>::max() };
+   };
+
+} // namespace safety
@@ -0,0 +1,205 @@
+#pragma once
+#include "SafetyDispatcher/HdrHistogram.h"
+#include "SafetyRules/SafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SAFETY_TRACE_TSC 1
+#else
+#define SAFETY_TRACE_TSC 0
+#endif
+
+namespace safety
+{
+
+   namespace detail
+   {
+       // Dense ids for the (trigger, hook) pairs the table can produce in one step,
+       // reset's EnterIdle included; every other pair is kNoPath
+       constexpr std::uint8_t kNoPath = 0xFF;
+
+       struct TracePaths
+       {
+           std::array<std::array<std::uint8_t, kHookCount>, kRowWidth> index;
+           std::array<Trigger, kRowWidth * kHookCount> trigger;
+           std::array<Hook, kRowWidth * kHookCount>    hook;
+           std::size_t                                 count;
+       };
+
+       constexpr TracePaths makeTracePaths()
+       {
+           TracePaths paths {};
+
+           for (auto& row : paths.index)
+           {
+               for (auto& id : row)
+               {
+                   id = kNoPath;
+               }
+           }
+
+           auto add = [&paths](std::size_t t, Hook h) {
+               if (h != Hook::None && paths.index[t][static_cast<std::size_t>(h)] == kNoPath)
+               {
+                   paths.index[t][static_cast<std::size_t>(h)] = static_cast<std::uint8_t>(paths.count);
+                   paths.trigger[paths.count] = static_cast<Trigger>(t);
+                   paths.hook[paths.count] = h;
+                   ++paths.count;
+               }
+           };
+
+           for (std::size_t t = 0; t < kTriggerCount; ++t)
+           {
+               for (std::size_t c = 0; c < kConfigCount; ++c)
+               {
+                   const Transition& cell = kTransitions[c][t];
+                   add(t, cell.exit);
+                   add(t, cell.enter);
+                   add(t, cell.action);
+               }
+           }
+
+           add(static_cast<std::size_t>(Trigger::Reset), Hook::EnterIdle);
+           return paths;
+       }
+
+       inline constexpr TracePaths kTracePaths = makeTracePaths();
+   }
+
+   // End-to-end latency tracing, sensor edge to actuator request.
+   //
+   // Three timestamps per trigger: at ingress (SafetyDispatcher::post stamps every
+   // post once a tracer is set), at dispatch start, and at each hook call. Each hook
+   // call records ingress-to-hook into the histogram of its (trigger, hook) path, e.g.
+   // evDoorOpened -> RequestLoadBuildPlate; dispatch start records ingress-to-start
+   // into the queueing histogram of the trigger. Hooks fired by triggers a hook
+   // posted back into the machine (run to completion) still run inside the original
+   // delivery and count as unattributed unless the pair is a path of their own.
+   //
+   // Timestamps are TSC ticks on x86 (one rdtsc) and steady_clock ns elsewhere;
+   // export converts ticks to ns with a rate measured against steady_clock since
+   // construction. Recording is single-writer (the dispatcher thread) with relaxed
+   // stores only, and the export may run concurrently.
+   class LatencyTracer
+   {
+      public:
+          using Ticks  = std::uint64_t;
+          using VoidFn = ISafetyRules::VoidFn;
+
+          static constexpr std::size_t kPathCount = detail::kTracePaths.count;
+
+          static Ticks now()
+          {
+#if SAFETY_TRACE_TSC
+              return __rdtsc();
+#else
+              return instrumentation::nowNs();
+#endif
+          }
+
+      public:
+          LatencyTracer();
+
+          LatencyTracer(const LatencyTracer&) = delete;
+          LatencyTracer& operator=(const LatencyTracer&) = delete;
+
+          // Wraps every hook slot of rules (empty ones too) so hook calls are timed;
+          // install hooks first, and detach() before changing them again
+          void attach(SafetyRules& rules);
+          void detach(SafetyRules& rules);
+
+          // ----- Dispatch path (the thread that steps the machine)
+          // ingress 0: posted before the tracer was set, so the step is not timed
+          void beginStep(Trigger trigger, Ticks ingress)
+          {
+              if (ingress == 0)
+              {
+                  return;
+              }
+
+              const Ticks start = now();
+
+              current = trigger;
+              currentIngress = ingress;
+              queueing[static_cast<std::size_t>(trigger)].record(start - ingress);
+          }
+
+          void endStep()
+          {
+              currentIngress = 0;
+          }
+
+          // ----- Results (any thread)
+          const HdrHistogram& path(Trigger trigger, Hook hook) const;
+          const HdrHistogram& queueLatency(Trigger trigger) const
+          {
+              return queueing[static_cast<std::size_t>(trigger)];
+          }
+
+          std::uint64_t unattributed() const
+          {
+              return unattributedCount.load(std::memory_order_relaxed);
+          }
+
+          // ns per tick, measured over the tracer's lifetime so far
+          double nsPerTick() const;
+
+          // Percentile table, values in ns: one line per path, then per-trigger queueing
+          void writeText(std::ostream& out) const;
+
+          // Same data plus every non-empty bucket as [lowest, highest, count] in ticks,
+          // with ns_per_tick, so the histograms can be rebuilt
+          void writeJson(std::ostream& out) const;
+
+      private:
+          struct Wrapper
+          {
+              LatencyTracer* tracer;
+              Hook           hook;
+              VoidFn         original;
+          };
+
+          static void onHook(void* wrapper);
+
+          void recordHook(Hook hook)
+          {
+              if (currentIngress == 0)
+              {
+                  return;
+              }
+
+              const Ticks at = now();
+              const std::uint8_t id = detail::kTracePaths.index[static_cast<std::size_t>(current)][static_cast<std::size_t>(hook)];
+
+              if (id == detail::kNoPath)
+              {
+                  instrumentation::bump(unattributedCount);
+                  return;
+              }
+
+              paths[id].record(at - currentIngress);
+          }
+
+      private:
+          std::unique_ptr<HdrHistogram[]>        paths;
+          std::unique_ptr<HdrHistogram[]>        queueing;
+          std::array<Wrapper, kHookCount>        wrappers {};
+          std::atomic<std::uint64_t>             unattributedCount { 0 };
+
+          Trigger                                current { Trigger::Reset };
+          Ticks                                  currentIngress { 0 };
+
+          // Tick rate calibration origin
+          Ticks                                  originTicks;
+          std::chrono::steady_clock::time_point  originTime;
+   };
+
+} // namespace safety
@@ -0,0 +1,476 @@
+#pragma once
+#include "SafetyBase/MpscRing.h"
+#include "SafetyDispatcher/LatencyTracer.h"
+#include "SafetyRules/Instrumentation.h"
+#include "SafetyRules/ISafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace safety
+{
+
+   // Thread-safe front end for one ISafetyRules.
+   //
+   // Any thread may post(); a dedicated dispatcher thread drains the ring and feeds
+   // the machine one trigger at a time, so every hook runs on that thread and each
+   // step runs to completion before the next begins. When the ring is full post()
+   // returns false and the event is counted as dropped.
+   //
+   // Priority lane: evFault (and evPowerOff, if asked for) goes into a small ring of
+   // its own that the dispatcher drains before every normal trigger, so a fault never
+   // waits behind a backlog of door and plate events. A priority event that moves
+   // the machine supersedes everything posted to the normal ring before it; those
+   // triggers were meant for the machine as it was before the fault and are
+   // discarded unseen. One the machine ignores in its current configuration (evFault
+   // in Idle) is held back until the normal triggers posted before it have run, so it
+   // meets the configuration it was posted against.
+   //
+   // Ingress filter (opt-in): while the dispatcher is caught up, it publishes the
+   // triggers the machine accepts in its configuration (kAccepted). A post that
+   // finds nothing queued and its trigger not accepted is counted as filtered and
+   // returns true without taking a slot; it would have been a no-op step. With a
+   // backlog the configuration the trigger will meet is unknown, so it is queued.
+   //
+   // Latency tracing (opt-in): with a LatencyTracer set, every post is stamped at
+   // ingress and the tracer times each step from that stamp (see LatencyTracer.h).
+   class SafetyDispatcher
+   {
+      public:
+          using Event = ISafetyRules::Event;
+
+          struct Stats
+          {
+              std::uint64_t dispatched;    // triggers delivered to the machine
+              std::uint64_t dropped;       // posts rejected because the ring was full
+              std::size_t   depth;         // triggers waiting right now
+              std::size_t   peakDepth;     // deepest backlog the dispatcher has seen
+              std::uint64_t urgent;        // priority events delivered (part of dispatched)
+              std::uint64_t superseded;    // normal triggers discarded after a priority event
+              std::uint64_t worstUrgentNs; // longest priority post-to-step-complete
+              std::uint64_t filtered;      // posts dropped at ingress as no-ops
+              std::array<std::uint64_t, kTriggerCount> filteredByTrigger;
+          };
+
+          static constexpr std::size_t kUrgentCapacity = 64;
+
+      public:
+          // ----- Construction
+          explicit SafetyDispatcher(ISafetyRules& rules, std::size_t capacity = 1024, bool urgentPowerOff = false)
+              : rules(rules),
+                queue(capacity),
+                urgent(kUrgentCapacity),
+                urgentPowerOff(urgentPowerOff)
+          {
+              // The machine is not running yet, so its configuration is current
+              mask = kAccepted[toConfig(rules.getState(), rules.getLoaderSubstate())];
+              settled.store(mask, std::memory_order_relaxed);
+          }
+
+          ~SafetyDispatcher()
+          {
+              stop();
+          }
+
+          SafetyDispatcher(const SafetyDispatcher&) = delete;
+          SafetyDispatcher& operator=(const SafetyDispatcher&) = delete;
+
+          // ----- Lifecycle
+          void start()
+          {
+              if (worker.joinable())
+              {
+                  return;
+              }
+
+              running.store(true, std::memory_order_release);
+              worker = std::thread([this]() { run(); });
+          }
+
+          // Stops the dispatcher thread after it has drained everything already posted
+          void stop()
+          {
+              if (!worker.joinable())
+              {
+                  return;
+              }
+
+              running.store(false, std::memory_order_release);
+              wake();
+              worker.join();
+          }
+
+          // Drop no-op posts at ingress (see above); set before the first post
+          void setIngressFilter(bool on)
+          {
+              filterIgnored = on;
+          }
+
+          // Time every trigger from post() to its hooks; set before start(), after
+          // tracer->attach() on the machine this dispatcher drives
+          void setTracer(LatencyTracer* t)
+          {
+              tracer = t;
+          }
+
+          // ----- Producers (any thread)
+          bool post(Event ev)
+          {
+              if (filterIgnored && ignoredNow(toTrigger(ev)))
+              {
+                  return true;
+              }
+
+              if (ev == Event::evFault || (ev == Event::evPowerOff && urgentPowerOff))
+              {
+                  return enqueueUrgent(toTrigger(ev));
+              }
+
+              return enqueue(toTrigger(ev));
+          }
+
+          bool postStartLoader()
+          {
+              if (filterIgnored && ignoredNow(Trigger::StartLoader))
+              {
+                  return true;
+              }
+
+              return enqueue(Trigger::StartLoader);
+          }
+
+          // ----- Observability (any thread)
+          Stats stats() const
+          {
+              Stats s {
+                  dispatched.load(std::memory_order_relaxed),
+                  dropped.load(std::memory_order_relaxed),
+                  queue.size() + urgent.size(),
+                  peakDepth.load(std::memory_order_relaxed),
+                  urgentDelivered.load(std::memory_order_relaxed),
+                  superseded.load(std::memory_order_relaxed),
+                  worstUrgentNs.load(std::memory_order_relaxed),
+                  0,
+                  {}
+              };
+
+              for (std::size_t t = 0; t < kTriggerCount; ++t)
+              {
+                  s.filteredByTrigger[t] = filtered[t].load(std::memory_order_relaxed);
+                  s.filtered += s.filteredByTrigger[t];
+              }
+
+              return s;
+          }
+
+          // Both lanes: the most triggers that can be waiting at once
+          std::size_t capacity() const
+          {
+              return queue.capacity() + urgent.capacity();
+          }
+
+      private:
+          // A posted trigger. epoch counts the priority posts made before it: a normal
+          // trigger whose epoch is below that of a delivered priority event is stale.
+          struct Posted
+          {
+              Trigger       trigger;
+              std::uint64_t epoch;
+              std::uint64_t postedNs;   // priority lane only
+              std::uint64_t ingress;    // LatencyTracer ticks; only with a tracer set
+          };
+
+          // True (and counted) when nothing is pending and the machine ignores trigger.
+          // settled is read first: if every slot claimed by then had been processed,
+          // its mask is the configuration this post would meet.
+          bool ignoredNow(Trigger trigger)
+          {
+              const std::uint64_t word = settled.load(std::memory_order_acquire);
+
+              if ((word >> 8) != queue.pushed() + urgent.pushed() || (word & triggerBit(trigger)) != 0)
+              {
+                  return false;
+              }
+
+              filtered[static_cast<std::size_t>(trigger)].fetch_add(1, std::memory_order_relaxed);
+              return true;
+          }
+
+          bool enqueue(Trigger trigger)
+          {
+              const Posted posted { trigger, urgentPosts.load(std::memory_order_acquire), 0, stamp() };
+
+              if (!queue.tryPush(posted))
+              {
+                  dropped.fetch_add(1, std::memory_order_relaxed);
+                  return false;
+              }
+
+              notify();
+              return true;
+          }
+
+          bool enqueueUrgent(Trigger trigger)
+          {
+              const std::uint64_t epoch = urgentPosts.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+              if (!urgent.tryPush(Posted { trigger, epoch, instrumentation::nowNs(), stamp() }))
+              {
+                  dropped.fetch_add(1, std::memory_order_relaxed);
+                  return false;
+              }
+
+              notify();
+              return true;
+          }
+
+          LatencyTracer::Ticks stamp() const
+          {
+              return tracer != nullptr ? LatencyTracer::now() : 0;
+          }
+
+          void notify()
+          {
+              // Pairs with the fence in idle(): either the dispatcher sees the item
+              // on its re-check or we see it asleep and wake it.
+              std::atomic_thread_fence(std::memory_order_seq_cst);
+
+              if (sleeping.load(std::memory_order_relaxed))
+              {
+                  wake();
+              }
+          }
+
+          void deliver(const Posted& posted)
+          {
+              if (tracer != nullptr)
+              {
+                  tracer->beginStep(posted.trigger, posted.ingress);
+              }
+
+              if (posted.trigger == Trigger::StartLoader)
+              {
+                  rules.startLoader();
+              }
+              else
+              {
+                  rules.dispatch(static_cast<Event>(posted.trigger));
+              }
+
+              if (tracer != nullptr)
+              {
+                  tracer->endStep();
+              }
+          }
+
+          // ----- Dispatcher thread
+          void run()
+          {
+              unsigned idleSpins = 0;
+
+              for (;;)
+              {
+                  const std::size_t depth = queue.size() + urgent.size();
+
+                  if (depth > peakDepth.load(std::memory_order_relaxed))
+                  {
+                      peakDepth.store(depth, std::memory_order_relaxed);
+                  }
+
+                  std::uint64_t drained = 0;
+                  Posted posted;
+
+                  for (;;)
+                  {
+                      // One acquire load when the lane is empty
+                      drained += drainUrgent();
+
+                      if (!queue.tryPop(posted))
+                      {
+                          if (holding)
+                          {
+                              drained += releaseHeld();
+                              continue;
+                          }
+
+                          break;
+                      }
+
+                      // Everything posted before the held priority event has run
+                      if (holding && posted.epoch >= held.epoch)
+                      {
+                          drained += releaseHeld();
+                      }
+
+                      if (posted.epoch < supersededEpoch)
+                      {
+                          superseded.fetch_add(1, std::memory_order_relaxed);
+                          settle(false);
+                          continue;
+                      }
+
+                      deliver(posted);
+                      settle(true);
+                      ++drained;
+                  }
+
+                  if (drained != 0)
+                  {
+                      dispatched.fetch_add(drained, std::memory_order_relaxed);
+                      idleSpins = 0;
+                      continue;
+                  }
+
+                  if (!running.load(std::memory_order_acquire))
+                  {
+                      // Posts that raced with stop() are still delivered
+                      if (queue.size() == 0 && urgent.size() == 0)
+                      {
+                          return;
+                      }
+
+                      continue;
+                  }
+
+                  if (++idleSpins < kSpinsBeforeSleep)
+                  {
+                      std::this_thread::yield();
+                      continue;
+                  }
+
+                  idle();
+                  idleSpins = 0;
+              }
+          }
+
+          std::uint64_t drainUrgent()
+          {
+              std::uint64_t drained = 0;
+
+              while (!holding && urgent.tryPop(held))
+              {
+                  // Ignored now but maybe not once the backlog before it has run
+                  if (queue.size() != 0 && !accepts(configuration(), held.trigger))
+                  {
+                      holding = true;
+                      break;
+                  }
+
+                  drained += deliverUrgent(held);
+              }
+
+              return drained;
+          }
+
+          std::uint64_t releaseHeld()
+          {
+              holding = false;
+              return deliverUrgent(held);
+          }
+
+          std::uint64_t deliverUrgent(const Posted& posted)
+          {
+              const Config before = configuration();
+
+              deliver(posted);
+              settle(true);
+
+              const std::uint64_t latency = instrumentation::nowNs() - posted.postedNs;
+
+              if (latency > worstUrgentNs.load(std::memory_order_relaxed))
+              {
+                  worstUrgentNs.store(latency, std::memory_order_relaxed);
+              }
+
+              // Only a priority event that moved the machine makes older posts stale
+              if (configuration() != before && posted.epoch > supersededEpoch)
+              {
+                  supersededEpoch = posted.epoch;
+              }
+
+              urgentDelivered.fetch_add(1, std::memory_order_relaxed);
+              return 1;
+          }
+
+          Config configuration() const
+          {
+              return toConfig(rules.getState(), rules.getLoaderSubstate());
+          }
+
+          // One more slot processed; publishes the machine's accepted triggers with it
+          void settle(bool delivered)
+          {
+              if (!filterIgnored)
+              {
+                  return;
+              }
+
+              if (delivered)
+              {
+                  mask = kAccepted[configuration()];
+              }
+
+              settled.store(++processed << 8 | mask, std::memory_order_release);
+          }
+
+          void idle()
+          {
+              std::unique_lock<std::mutex> lock(sleepMutex);
+              sleeping.store(true, std::memory_order_relaxed);
+              std::atomic_thread_fence(std::memory_order_seq_cst);
+
+              if (queue.size() == 0 && urgent.size() == 0 && running.load(std::memory_order_acquire))
+              {
+                  // Timed so a lost wakeup can only ever cost one period
+                  wakeup.wait_for(lock, std::chrono::milliseconds(10));
+              }
+
+              sleeping.store(false, std::memory_order_relaxed);
+          }
+
+          void wake()
+          {
+              std::lock_guard<std::mutex> lock(sleepMutex);
+              wakeup.notify_one();
+          }
+
+      private:
+          static constexpr unsigned kSpinsBeforeSleep = 64;
+
+          ISafetyRules&      rules;
+          MpscRing<Posted>   queue;
+          MpscRing<Posted>   urgent;
+          const bool         urgentPowerOff;
+          std::thread        worker;
+          std::uint64_t      supersededEpoch { 0 };   // dispatcher thread only
+          Posted             held {};                 // dispatcher thread only
+          bool               holding { false };       // dispatcher thread only
+          std::uint64_t      processed { 0 };         // dispatcher thread only
+          TriggerMask        mask { 0 };              // dispatcher thread only
+          bool               filterIgnored { false };
+          LatencyTracer*     tracer { nullptr };
+
+          alignas(kCacheLine) std::atomic<bool>          running { false };
+          std::atomic<bool>                             sleeping { false };
+          std::mutex                                    sleepMutex;
+          std::condition_variable                       wakeup;
+
+          alignas(kCacheLine) std::atomic<std::uint64_t> dropped { 0 };
+          alignas(kCacheLine) std::atomic<std::uint64_t> urgentPosts { 0 };
+          alignas(kCacheLine) std::atomic<std::uint64_t> settled { 0 };   // processed << 8 | mask
+
+          alignas(kCacheLine) std::array<std::atomic<std::uint64_t>, kTriggerCount> filtered {};
+
+          alignas(kCacheLine) std::atomic<std::uint64_t> dispatched { 0 };
+          std::atomic<std::size_t>                      peakDepth { 0 };
+          std::atomic<std::uint64_t>                    urgentDelivered { 0 };
+          std::atomic<std::uint64_t>                    superseded { 0 };
+          std::atomic<std::uint64_t>                    worstUrgentNs { 0 };
+   };
+
+} // namespace safety
@@ -0,0 +1,274 @@
+#include "SafetyDispatcher/FleetDispatcher.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace safety
+{
+
+   // ----- Construction
+   FleetDispatcher::FleetDispatcher(std::size_t printers, unsigned workers, std::size_t shards, std::size_t capacity)
+       : printers(printers),
+         workers(workers != 0 ? workers : std::max(1u, std::thread::hardware_concurrency())),
+         workerStats(new WorkerStats[this->workers])
+   {
+       while ((std::size_t(1) << shardBits) < shards)
+       {
+           ++shardBits;
+       }
+
+       const std::size_t count = std::size_t(1) << shardBits;
+       shardMask = static_cast<std::uint32_t>(count - 1);
+
+       for (std::size_t s = 0; s < count; ++s)
+       {
+           // Printers s, s + count, s + 2 * count, ...
+           const std::size_t owned = printers > s ? (printers - 1 - s) / count + 1 : 0;
+
+           this->shards.push_back(std::make_unique<Shard>(*this, static_cast<std::uint32_t>(s), owned, capacity));
+           installRelays(*this->shards.back(), std::make_index_sequence<kHookCount>());
+       }
+   }
+
+   FleetDispatcher::~FleetDispatcher()
+   {
+       stop();
+   }
+
+   // ----- Lifecycle
+   void FleetDispatcher::start()
+   {
+       if (!threads.empty())
+       {
+           return;
+       }
+
+       running.store(true, std::memory_order_release);
+
+       for (unsigned w = 0; w < workers; ++w)
+       {
+           threads.emplace_back([this, w]() { run(w); });
+       }
+   }
+
+   void FleetDispatcher::stop()
+   {
+       if (threads.empty())
+       {
+           return;
+       }
+
+       running.store(false, std::memory_order_release);
+       wake();
+
+       for (auto& t : threads)
+       {
+           t.join();
+       }
+
+       threads.clear();
+   }
+
+   // ----- Producers
+   bool FleetDispatcher::enqueue(std::uint32_t printer, Trigger trigger)
+   {
+       // Checked in every build: a bad id would index past the shard arrays
+       if (printer >= printers)
+       {
+           dropped.fetch_add(1, std::memory_order_relaxed);
+           return false;
+       }
+
+       Envelope envelope { localOf(printer), trigger, 0 };
+
+       if (sampling)
+       {
+           thread_local unsigned posts = 0;
+
+           if ((++posts & sampleMask) == 0)
+           {
+               envelope.postedNs = instrumentation::nowNs();
+           }
+       }
+
+       if (!shardOf(printer).queue.tryPush(envelope))
+       {
+           dropped.fetch_add(1, std::memory_order_relaxed);
+           return false;
+       }
+
+       // Pairs with the fence in idle(), as in SafetyDispatcher
+       std::atomic_thread_fence(std::memory_order_seq_cst);
+
+       if (sleepers.load(std::memory_order_relaxed) != 0)
+       {
+           wake();
+       }
+
+       return true;
+   }
+
+   // ----- Worker threads
+   void FleetDispatcher::run(unsigned worker)
+   {
+       WorkerStats& stats = workerStats[worker];
+       const std::size_t count = shards.size();
+       unsigned idleSpins = 0;
+
+       for (;;)
+       {
+           bool worked = false;
+
+           for (std::size_t s = worker; s < count; s += workers)
+           {
+               worked |= drain(*shards[s], stats, false);
+           }
+
+           // Home shards are dry: steal, starting next to them so thieves spread out
+           if (!worked)
+           {
+               for (std::size_t i = 1; i < count; ++i)
+               {
+                   const std::size_t s = (worker + i) % count;
+
+                   if (s % workers != worker)
+                   {
+                       worked |= drain(*shards[s], stats, true);
+                   }
+               }
+           }
+
+           if (worked)
+           {
+               idleSpins = 0;
+               continue;
+           }
+
+           if (!running.load(std::memory_order_acquire))
+           {
+               // Posts that raced with stop() are still delivered
+               if (allEmpty())
+               {
+                   return;
+               }
+
+               continue;
+           }
+
+           if (++idleSpins < kSpinsBeforeSleep)
+           {
+               std::this_thread::yield();
+               continue;
+           }
+
+           idle();
+           idleSpins = 0;
+       }
+   }
+
+   bool FleetDispatcher::drain(Shard& shard, WorkerStats& stats, bool steal)
+   {
+       if (shard.queue.size() == 0 || shard.claimed.load(std::memory_order_relaxed))
+       {
+           return false;
+       }
+
+       bool expected = false;
+
+       // The claim hands the ring's consumer side and the fleet slice to this thread
+       if (!shard.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire))
+       {
+           return false;
+       }
+
+       std::size_t drained = 0;
+       Envelope envelope;
+
+       while (drained < kBatch && shard.queue.tryPop(envelope))
+       {
+           if (envelope.trigger == Trigger::StartLoader)
+           {
+               shard.fleet.startLoader(envelope.local);
+           }
+           else
+           {
+               shard.fleet.dispatch(envelope.local, static_cast<Event>(envelope.trigger));
+           }
+
+           if (envelope.postedNs != 0)
+           {
+               const std::uint64_t now = instrumentation::nowNs();
+               instrumentation::bump(stats.latency[instrumentation::bucketOf(now - envelope.postedNs)]);
+           }
+
+           ++drained;
+       }
+
+       shard.claimed.store(false, std::memory_order_release);
+
+       if (drained == 0)
+       {
+           return false;
+       }
+
+       instrumentation::bump(stats.dispatched, drained);
+       instrumentation::bump(stats.claims);
+
+       if (steal)
+       {
+           instrumentation::bump(stats.steals);
+       }
+
+       return true;
+   }
+
+   bool FleetDispatcher::allEmpty() const
+   {
+       return std::all_of(shards.begin(), shards.end(), [](const std::unique_ptr<Shard>& s) { return s->queue.size() == 0; });
+   }
+
+   void FleetDispatcher::idle()
+   {
+       std::unique_lock<std::mutex> lock(sleepMutex);
+       sleepers.fetch_add(1, std::memory_order_relaxed);
+       std::atomic_thread_fence(std::memory_order_seq_cst);
+
+       if (allEmpty() && running.load(std::memory_order_acquire))
+       {
+           // Timed so a lost wakeup can only ever cost one period
+           wakeup.wait_for(lock, std::chrono::milliseconds(10));
+       }
+
+       sleepers.fetch_sub(1, std::memory_order_relaxed);
+   }
+
+   void FleetDispatcher::wake()
+   {
+       std::lock_guard<std::mutex> lock(sleepMutex);
+       wakeup.notify_all();
+   }
+
+   // ----- Observability
+   FleetDispatcher::Stats FleetDispatcher::stats() const
+   {
+       Stats s {};
+       s.dropped = dropped.load(std::memory_order_relaxed);
+
+       for (unsigned w = 0; w < workers; ++w)
+       {
+           const WorkerStats& from = workerStats[w];
+
+           s.dispatched += from.dispatched.load(std::memory_order_relaxed);
+           s.claims     += from.claims.load(std::memory_order_relaxed);
+           s.steals     += from.steals.load(std::memory_order_relaxed);
+
+           for (std::size_t b = 0; b < instrumentation::kLatencyBuckets; ++b)
+           {
+               s.latency[b] += from.latency[b].load(std::memory_order_relaxed);
+           }
+       }
+
+       return s;
+   }
+
+} // namespace safety
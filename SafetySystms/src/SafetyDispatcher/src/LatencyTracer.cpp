@@ -0,0 +1,210 @@
+#include "SafetyDispatcher/LatencyTracer.h"
+
+#include <string>
+#include <thread>
+
+namespace safety
+{
+
+   namespace
+   {
+       // Shorter calibration windows make the tick rate noticeably noisy
+       constexpr auto kMinCalibration = std::chrono::milliseconds(10);
+
+       struct Summary
+       {
+           std::uint64_t count;
+           double        min;
+           double        mean;
+           double        p50;
+           double        p99;
+           double        p999;
+           double        p9999;
+           double        max;
+       };
+
+       Summary summarize(const HdrHistogram& h, double scale)
+       {
+           return Summary {
+               h.count(),
+               static_cast<double>(h.min()) * scale,
+               h.mean() * scale,
+               static_cast<double>(h.valueAtQuantile(0.5)) * scale,
+               static_cast<double>(h.valueAtQuantile(0.99)) * scale,
+               static_cast<double>(h.valueAtQuantile(0.999)) * scale,
+               static_cast<double>(h.valueAtQuantile(0.9999)) * scale,
+               static_cast<double>(h.max()) * scale,
+           };
+       }
+
+       void textLine(std::ostream& out, const std::string& label, const HdrHistogram& h, double scale)
+       {
+           const Summary s = summarize(h, scale);
+
+           out << label << "  count=" << s.count << " min=" << s.min << " mean=" << s.mean
+               << " p50=" << s.p50 << " p99=" << s.p99 << " p99.9=" << s.p999
+               << " p99.99=" << s.p9999 << " max=" << s.max << '\n';
+       }
+
+       void jsonEntry(std::ostream& out, const HdrHistogram& h, double scale)
+       {
+           const Summary s = summarize(h, scale);
+
+           out << "\"count\":" << s.count << ",\"min_ns\":" << s.min << ",\"mean_ns\":" << s.mean
+               << ",\"p50_ns\":" << s.p50 << ",\"p99_ns\":" << s.p99 << ",\"p999_ns\":" << s.p999
+               << ",\"p9999_ns\":" << s.p9999 << ",\"max_ns\":" << s.max << ",\"buckets\":[";
+
+           bool first = true;
+
+           h.forEachBucket([&](std::uint64_t lo, std::uint64_t hi, std::uint64_t c) {
+               out << (first ? "" : ",") << '[' << lo << ',' << hi << ',' << c << ']';
+               first = false;
+           });
+
+           out << ']';
+       }
+   }
+
+   LatencyTracer::LatencyTracer()
+       : paths(new HdrHistogram[kPathCount]),
+         queueing(new HdrHistogram[kTriggerCount]),
+         originTicks(now()),
+         originTime(std::chrono::steady_clock::now())
+   {
+   }
+
+   void LatencyTracer::attach(SafetyRules& rules)
+   {
+       for (std::size_t h = 0; h < kHookCount; ++h)
+       {
+           Wrapper& w = wrappers[h];
+           VoidFn& slot = rules.slot(static_cast<Hook>(h));
+
+           w.tracer   = this;
+           w.hook     = static_cast<Hook>(h);
+           w.original = std::move(slot);
+           slot       = VoidFn::bind<&LatencyTracer::onHook>(&w);
+       }
+   }
+
+   void LatencyTracer::detach(SafetyRules& rules)
+   {
+       for (std::size_t h = 0; h < kHookCount; ++h)
+       {
+           rules.slot(static_cast<Hook>(h)) = std::move(wrappers[h].original);
+           wrappers[h].original = nullptr;
+       }
+   }
+
+   void LatencyTracer::onHook(void* wrapper)
+   {
+       Wrapper& w = *static_cast<Wrapper*>(wrapper);
+
+       // Timed before the hook runs: the latency is to the actuator request, not past it
+       w.tracer->recordHook(w.hook);
+
+       if (w.original)
+       {
+           w.original();
+       }
+   }
+
+   const HdrHistogram& LatencyTracer::path(Trigger trigger, Hook hook) const
+   {
+       static const HdrHistogram kEmpty;
+       const std::uint8_t id = detail::kTracePaths.index[static_cast<std::size_t>(trigger)][static_cast<std::size_t>(hook)];
+
+       return id == detail::kNoPath ? kEmpty : paths[id];
+   }
+
+   double LatencyTracer::nsPerTick() const
+   {
+#if SAFETY_TRACE_TSC
+       auto elapsed = std::chrono::steady_clock::now() - originTime;
+
+       if (elapsed < kMinCalibration)
+       {
+           std::this_thread::sleep_for(kMinCalibration - elapsed);
+       }
+
+       // Read the clocks back to back so the pair describes one instant
+       const Ticks ticks = now();
+       elapsed = std::chrono::steady_clock::now() - originTime;
+
+       const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+       return static_cast<double>(ns) / static_cast<double>(ticks - originTicks);
+#else
+       return 1.0;
+#endif
+   }
+
+   void LatencyTracer::writeText(std::ostream& out) const
+   {
+       const double scale = nsPerTick();
+
+       out << "# ingress -> hook, ns\n";
+
+       for (std::size_t id = 0; id < kPathCount; ++id)
+       {
+           if (paths[id].count() != 0)
+           {
+               textLine(out, std::string(name(detail::kTracePaths.trigger[id])) + " -> " + name(detail::kTracePaths.hook[id]),
+                        paths[id], scale);
+           }
+       }
+
+       out << "# ingress -> dispatch, ns\n";
+
+       for (std::size_t t = 0; t < kTriggerCount; ++t)
+       {
+           if (queueing[t].count() != 0)
+           {
+               textLine(out, name(static_cast<Trigger>(t)), queueing[t], scale);
+           }
+       }
+
+       out << "# unattributed hook calls: " << unattributed() << '\n';
+   }
+
+   void LatencyTracer::writeJson(std::ostream& out) const
+   {
+       const double scale = nsPerTick();
+
+       out << "{\"ns_per_tick\":" << scale << ",\"unattributed\":" << unattributed() << ",\"paths\":[";
+
+       bool first = true;
+
+       for (std::size_t id = 0; id < kPathCount; ++id)
+       {
+           if (paths[id].count() == 0)
+           {
+               continue;
+           }
+
+           out << (first ? "" : ",") << "{\"trigger\":\"" << name(detail::kTracePaths.trigger[id])
+               << "\",\"hook\":\"" << name(detail::kTracePaths.hook[id]) << "\",";
+           jsonEntry(out, paths[id], scale);
+           out << '}';
+           first = false;
+       }
+
+       out << "],\"queueing\":[";
+       first = true;
+
+       for (std::size_t t = 0; t < kTriggerCount; ++t)
+       {
+           if (queueing[t].count() == 0)
+           {
+               continue;
+           }
+
+           out << (first ? "" : ",") << "{\"trigger\":\"" << name(static_cast<Trigger>(t)) << "\",";
+           jsonEntry(out, queueing[t], scale);
+           out << '}';
+           first = false;
+       }
+
+       out << "]}\n";
+   }
+
+} // namespace safety
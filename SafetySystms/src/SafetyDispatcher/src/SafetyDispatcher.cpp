@@ -0,0 +1 @@
+#include "SafetyDispatcher/SafetyDispatcher.h"
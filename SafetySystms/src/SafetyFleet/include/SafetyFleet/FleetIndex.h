@@ -0,0 +1,255 @@
+#pragma once
+#include "SafetyRules/ISafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace safety
+{
+
+   // Which printers of a fleet are in which configuration, kept up to date as they
+   // move instead of found by scanning.
+   //
+   // Per configuration: a member count and a bitset over printer ids, plus a summary
+   // bitset with one bit per non-empty 64-printer word. Counts are O(1) (a state is
+   // the sum of its four configurations); iteration walks the summary with ctz and
+   // touches only words that hold members, so a sparse query over a million printers
+   // visits a few hundred words rather than every printer.
+   //
+   // move() is the only writer; it is not thread-safe, like the fleet that owns it.
+   class FleetIndex
+   {
+      public:
+          using State     = ISafetyRules::State;
+          using LoaderSub = ISafetyRules::LoaderSub;
+
+      public:
+          // ----- Construction: every printer starts in initial
+          FleetIndex(std::size_t printers, Config initial)
+              : printers(printers),
+                wordCount((printers + 63) / 64),
+                summaryCount((wordCount + 63) / 64),
+                words(kConfigCount * wordCount, 0),
+                summaries(kConfigCount * summaryCount, 0)
+          {
+              for (std::uint32_t p = 0; p < printers; ++p)
+              {
+                  insert(initial, p);
+              }
+
+              counts[initial] = printers;
+          }
+
+          // ----- Writer
+          void move(std::uint32_t printer, Config from, Config to)
+          {
+              if (from == to)
+              {
+                  return;
+              }
+
+              erase(from, printer);
+              insert(to, printer);
+              --counts[from];
+              ++counts[to];
+          }
+
+          // Recomputes everything from configs (size() entries); for bulk loads.
+          // Each 64-printer word is built in registers and stored once.
+          void rebuild(const Config* configs)
+          {
+              std::fill(summaries.begin(), summaries.end(), 0);
+              counts.fill(0);
+
+              for (std::size_t w = 0; w < wordCount; ++w)
+              {
+                  const std::size_t first = w << 6;
+                  std::uint64_t bits[kConfigCount];
+                  membersOf(configs + first, std::min<std::size_t>(64, printers - first), bits);
+
+                  for (std::size_t c = 0; c < kConfigCount; ++c)
+                  {
+                      words[c * wordCount + w] = bits[c];
+
+                      if (bits[c] != 0)
+                      {
+                          summaries[c * summaryCount + (w >> 6)] |= std::uint64_t(1) << (w & 63);
+                          counts[c] += static_cast<std::size_t>(__builtin_popcountll(bits[c]));
+                      }
+                  }
+              }
+          }
+
+          // ----- Queries
+          std::size_t size() const
+          {
+              return printers;
+          }
+
+          std::size_t count(Config config) const
+          {
+              return counts[config];
+          }
+
+          std::size_t count(State state, LoaderSub sub) const
+          {
+              return counts[toConfig(state, sub)];
+          }
+
+          std::size_t count(State state) const
+          {
+              const Config first = toConfig(state, LoaderSub::None);
+              return counts[first] + counts[first + 1] + counts[first + 2] + counts[first + 3];
+          }
+
+          bool contains(std::uint32_t printer, Config config) const
+          {
+              return (bitsOf(config)[printer >> 6] >> (printer & 63) & 1) != 0;
+          }
+
+          // Raw membership words of config: bit p % 64 of word p / 64 is printer p
+          const std::uint64_t* bitsOf(Config config) const
+          {
+              return words.data() + config * wordCount;
+          }
+
+          std::size_t wordsPerConfig() const
+          {
+              return wordCount;
+          }
+
+          // fn(printer) for every printer in (state, sub), in id order
+          template <typename Fn>
+          void forEach(State state, LoaderSub sub, Fn&& fn) const
+          {
+              const Config config = toConfig(state, sub);
+              visit(config, config, fn);
+          }
+
+          // fn(printer) for every printer in state, whatever its substate, in id order
+          template <typename Fn>
+          void forEach(State state, Fn&& fn) const
+          {
+              const Config first = toConfig(state, LoaderSub::None);
+              visit(first, static_cast<Config>(first + 3), fn);
+          }
+
+      private:
+          // bits[c] = bit i set where run[i] == c, for a run of up to 64 configurations
+          static void membersOf(const Config* run, std::size_t n, std::uint64_t (&bits)[kConfigCount])
+          {
+              std::fill(std::begin(bits), std::end(bits), 0);
+
+#if defined(__SSE2__)
+              if (n == 64)
+              {
+                  __m128i lanes[4];
+
+                  for (int q = 0; q < 4; ++q)
+                  {
+                      lanes[q] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(run + 16 * q));
+                  }
+
+                  for (std::size_t c = 0; c < kConfigCount; ++c)
+                  {
+                      const __m128i key = _mm_set1_epi8(static_cast<char>(c));
+
+                      for (int q = 0; q < 4; ++q)
+                      {
+                          const auto hit = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(lanes[q], key)));
+                          bits[c] |= static_cast<std::uint64_t>(hit) << (16 * q);
+                      }
+                  }
+
+                  return;
+              }
+#endif
+
+              for (std::size_t i = 0; i < n; ++i)
+              {
+                  bits[run[i] & (kConfigCount - 1)] |= std::uint64_t(1) << i;
+              }
+          }
+
+          void insert(Config config, std::uint32_t printer)
+          {
+              std::uint64_t& word = words[config * wordCount + (printer >> 6)];
+
+              assert((word >> (printer & 63) & 1) == 0 && "Printer indexed twice");
+
+              if (word == 0)
+              {
+                  const std::size_t w = printer >> 6;
+                  summaries[config * summaryCount + (w >> 6)] |= std::uint64_t(1) << (w & 63);
+              }
+
+              word |= std::uint64_t(1) << (printer & 63);
+          }
+
+          void erase(Config config, std::uint32_t printer)
+          {
+              std::uint64_t& word = words[config * wordCount + (printer >> 6)];
+
+              assert((word >> (printer & 63) & 1) != 0 && "Printer not in its indexed configuration");
+              word &= ~(std::uint64_t(1) << (printer & 63));
+
+              if (word == 0)
+              {
+                  const std::size_t w = printer >> 6;
+                  summaries[config * summaryCount + (w >> 6)] &= ~(std::uint64_t(1) << (w & 63));
+              }
+          }
+
+          // Union of configurations first..last, walked word by word through the summaries
+          template <typename Fn>
+          void visit(Config first, Config last, Fn& fn) const
+          {
+              for (std::size_t s = 0; s < summaryCount; ++s)
+              {
+                  std::uint64_t summary = 0;
+
+                  for (std::size_t c = first; c <= last; ++c)
+                  {
+                      summary |= summaries[c * summaryCount + s];
+                  }
+
+                  while (summary != 0)
+                  {
+                      const std::size_t w = s << 6 | static_cast<std::size_t>(__builtin_ctzll(summary));
+                      summary &= summary - 1;
+
+                      std::uint64_t word = 0;
+
+                      for (std::size_t c = first; c <= last; ++c)
+                      {
+                          word |= words[c * wordCount + w];
+                      }
+
+                      while (word != 0)
+                      {
+                          fn(static_cast<std::uint32_t>(w << 6 | static_cast<std::size_t>(__builtin_ctzll(word))));
+                          word &= word - 1;
+                      }
+                  }
+              }
+          }
+
+      private:
+          std::size_t                               printers;
+          std::size_t                               wordCount;
+          std::size_t                               summaryCount;
+          std::vector<std::uint64_t>                words;       // [config][word]
+          std::vector<std::uint64_t>                summaries;   // [config][word / 64]
+          std::array<std::size_t, kConfigCount>     counts {};
+   };
+
+} // namespace safety
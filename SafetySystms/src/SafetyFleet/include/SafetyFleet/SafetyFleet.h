@@ -0,0 +1,173 @@
+#pragma once
+#include "SafetyFleet/FleetIndex.h"
+#include "SafetyRules/HookTable.h"
+#include "SafetyRules/ISafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace safety
+{
+
+   // Structure-of-arrays engine for many printers.
+   //
+   // Each printer is one Config byte ((State, LoaderSub) packed, see SafetyTable.h)
+   // in a contiguous array; hooks are shared by the whole fleet and receive the
+   // printer id. Per printer, dispatch()/startLoader() behave exactly like
+   // SafetyRules, including what hooks observe while they run.
+   //
+   // dispatchBatch() computes next configurations 16 printers at a time with byte
+   // shuffles through the transition table, then fires hooks only for printers
+   // whose configuration changed. Hooks of a block run after the block's new
+   // configurations are stored, and must not call back into the fleet.
+   //
+   // index() answers "how many printers are Faulted" and "which printers wait in
+   // DoorOpened" without a scan: every configuration change updates it, the
+   // intermediate ones hooks observe included, so it always agrees with getState().
+   class SafetyFleet
+   {
+      public:
+          using Event     = ISafetyRules::Event;
+          using State     = ISafetyRules::State;
+          using LoaderSub = ISafetyRules::LoaderSub;
+          using PrinterFn = HookTable::PrinterFn;
+
+      public:
+          // ----- Construction: every printer starts in Idle (no hooks fired)
+          explicit SafetyFleet(std::size_t printers)
+              : configs(printers, toConfig(State::Idle, LoaderSub::None)),
+                members(printers, toConfig(State::Idle, LoaderSub::None)),
+                stamps(printers, 0)
+          {
+          }
+
+          std::size_t size() const
+          {
+              return configs.size();
+          }
+
+          // ----- Per-printer control (same semantics as SafetyRules)
+          void reset(std::uint32_t printer)
+          {
+              assign(printer, toConfig(State::Idle, LoaderSub::None));
+              fire(Hook::EnterIdle, printer);
+          }
+
+          void dispatch(std::uint32_t printer, Event ev)
+          {
+              step(printer, toTrigger(ev));
+          }
+
+          void startLoader(std::uint32_t printer)
+          {
+              step(printer, Trigger::StartLoader);
+          }
+
+          // ----- Batch control: events[i] is delivered to ids[i], in order
+          void dispatchBatch(const std::uint32_t* ids, const Event* events, std::size_t count);
+
+          // The same with StartLoader among them: triggers[i] is an event or StartLoader
+          // (never Reset), for callers whose input mixes both
+          void dispatchBatch(const std::uint32_t* ids, const Trigger* triggers, std::size_t count);
+
+          // ----- Bulk restore: printer p takes saved[p] (size() reachable configurations,
+          //       see SafetyCheckpoint); no hooks fire
+          void restore(const Config* saved)
+          {
+              std::copy(saved, saved + configs.size(), configs.begin());
+              members.rebuild(configs.data());
+          }
+
+          // ----- Observability
+          State getState(std::uint32_t printer) const
+          {
+              return stateOf(configs[printer]);
+          }
+
+          LoaderSub getLoaderSubstate(std::uint32_t printer) const
+          {
+              return subOf(configs[printer]);
+          }
+
+          const std::vector<Config>& configurations() const
+          {
+              return configs;
+          }
+
+          // Per-configuration counts and member bitsets, maintained incrementally
+          const FleetIndex& index() const
+          {
+              return members;
+          }
+
+          // ----- Callbacks, shared by every printer in the fleet
+          void setHook(Hook h, PrinterFn cb)
+          {
+              hooks.set(h, cb);
+          }
+
+      private:
+          void step(std::uint32_t printer, Trigger trigger)
+          {
+              assert(configs[printer] != toConfig(State::BuildPlateLoader, LoaderSub::None)
+                     && "Invalid loader substate in BuildPlateLoader");
+
+              applyHooks(printer, configs[printer], lookup(configs[printer], trigger));
+          }
+
+          // Leaves configs[printer] at t.next, passing through the same intermediate
+          // configurations SafetyRules exposes to its hooks
+          void applyHooks(std::uint32_t printer, Config from, const Transition& t)
+          {
+              if (t.exit != Hook::None)
+              {
+                  assign(printer, topOf(from));
+                  fire(t.exit, printer);
+
+                  assign(printer, topOf(t.next));
+                  fire(t.enter, printer);
+              }
+
+              assign(printer, t.next);
+
+              if (t.action != Hook::None)
+              {
+                  fire(t.action, printer);
+              }
+          }
+
+          void assign(std::uint32_t printer, Config config)
+          {
+              members.move(printer, configs[printer], config);
+              configs[printer] = config;
+          }
+
+          void fire(Hook h, std::uint32_t printer) const
+          {
+              hooks.fire(h, printer);
+          }
+
+          template <std::size_t Columns, typename Code>
+          void batch(const std::uint32_t* ids, const Code* codes, std::size_t count);
+
+          template <typename Code>
+          void dispatchScalar(const std::uint32_t* ids, const Code* codes, std::size_t count);
+
+          bool uniqueIds(const std::uint32_t* ids, std::size_t count);
+
+      private:
+          // ----- Data
+          std::vector<Config>                configs;
+          FleetIndex                         members;
+          HookTable                          hooks;
+
+          // Duplicate detection inside a SIMD block: stamps[printer] == stamp means seen
+          std::vector<std::uint32_t>         stamps;
+          std::uint32_t                      stamp { 0 };
+   };
+
+} // namespace safety
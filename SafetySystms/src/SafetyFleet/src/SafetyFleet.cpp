@@ -0,0 +1,175 @@
+#include "SafetyFleet/SafetyFleet.h"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SAFETY_FLEET_SSSE3 1
+#endif
+
+namespace safety
+{
+
+   namespace
+   {
+       constexpr std::size_t kLanes = 16;
+
+       // One 16-byte shuffle table per trigger: column[t][config] = next config
+       using Column = std::array<std::uint8_t, kConfigCount>;
+
+       constexpr std::array<Column, kTriggerCount> makeColumns()
+       {
+           std::array<Column, kTriggerCount> columns {};
+
+           for (std::size_t t = 0; t < kTriggerCount; ++t)
+           {
+               for (std::size_t c = 0; c < kConfigCount; ++c)
+               {
+                   columns[t][c] = kTransitions[c][t].next;
+               }
+           }
+
+           return columns;
+       }
+
+       alignas(16) constexpr std::array<Column, kTriggerCount> kColumns = makeColumns();
+
+       static_assert(sizeof(ISafetyRules::Event) == 1 && sizeof(Trigger) == 1, "Triggers are shuffled as bytes");
+
+       // Events are the first kEventCount triggers, in the same order
+       constexpr Trigger asTrigger(ISafetyRules::Event ev)
+       {
+           return toTrigger(ev);
+       }
+
+       constexpr Trigger asTrigger(Trigger trigger)
+       {
+           return trigger;
+       }
+
+#if SAFETY_FLEET_SSSE3
+       // next[i] = kColumns[codes[i]][configs[i]] for 16 lanes at once; Columns is
+       // kEventCount for event batches, which spares them the StartLoader column
+       template <std::size_t Columns>
+       __attribute__((target("ssse3")))
+       std::uint32_t nextConfigs(const std::uint8_t* current, const std::uint8_t* codes, std::uint8_t* next)
+       {
+           const __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current));
+           const __m128i ev  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes));
+
+           __m128i out = cur; // unknown trigger values leave the printer where it is
+
+           for (std::size_t t = 0; t < Columns; ++t)
+           {
+               const __m128i column = _mm_load_si128(reinterpret_cast<const __m128i*>(kColumns[t].data()));
+               const __m128i hit    = _mm_cmpeq_epi8(ev, _mm_set1_epi8(static_cast<char>(t)));
+               const __m128i looked = _mm_shuffle_epi8(column, cur);
+
+               out = _mm_or_si128(_mm_and_si128(hit, looked), _mm_andnot_si128(hit, out));
+           }
+
+           _mm_storeu_si128(reinterpret_cast<__m128i*>(next), out);
+
+           // Bit i set when lane i changed configuration
+           return ~static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(out, cur))) & 0xffffu;
+       }
+
+       bool haveSsse3()
+       {
+           static const bool supported = __builtin_cpu_supports("ssse3");
+           return supported;
+       }
+#endif
+   }
+
+   void SafetyFleet::dispatchBatch(const std::uint32_t* ids, const Event* events, std::size_t count)
+   {
+       batch<kEventCount>(ids, events, count);
+   }
+
+   void SafetyFleet::dispatchBatch(const std::uint32_t* ids, const Trigger* triggers, std::size_t count)
+   {
+       batch<kTriggerCount>(ids, triggers, count);
+   }
+
+   template <std::size_t Columns, typename Code>
+   void SafetyFleet::batch(const std::uint32_t* ids, const Code* codes, std::size_t count)
+   {
+#if SAFETY_FLEET_SSSE3
+       if (haveSsse3())
+       {
+           std::size_t i = 0;
+
+           for (; i + kLanes <= count; i += kLanes)
+           {
+               // The same printer twice in one block must see its events in order
+               if (!uniqueIds(ids + i, kLanes))
+               {
+                   dispatchScalar(ids + i, codes + i, kLanes);
+                   continue;
+               }
+
+               alignas(16) std::uint8_t current[kLanes];
+               alignas(16) std::uint8_t next[kLanes];
+
+               for (std::size_t lane = 0; lane < kLanes; ++lane)
+               {
+                   current[lane] = configs[ids[i + lane]];
+                   assert(current[lane] != toConfig(State::BuildPlateLoader, LoaderSub::None));
+               }
+
+               std::uint32_t changed = nextConfigs<Columns>(current, reinterpret_cast<const std::uint8_t*>(codes + i), next);
+
+               for (std::size_t lane = 0; lane < kLanes; ++lane)
+               {
+                   assign(ids[i + lane], next[lane]);
+               }
+
+               // Hooks only where something happened
+               while (changed != 0)
+               {
+                   const unsigned lane = static_cast<unsigned>(__builtin_ctz(changed));
+                   changed &= changed - 1;
+
+                   const Config from = current[lane];
+                   applyHooks(ids[i + lane], from, lookup(from, asTrigger(codes[i + lane])));
+               }
+           }
+
+           dispatchScalar(ids + i, codes + i, count - i);
+           return;
+       }
+#endif
+
+       dispatchScalar(ids, codes, count);
+   }
+
+   template <typename Code>
+   void SafetyFleet::dispatchScalar(const std::uint32_t* ids, const Code* codes, std::size_t count)
+   {
+       for (std::size_t i = 0; i < count; ++i)
+       {
+           step(ids[i], asTrigger(codes[i]));
+       }
+   }
+
+   bool SafetyFleet::uniqueIds(const std::uint32_t* ids, std::size_t count)
+   {
+       if (++stamp == 0)
+       {
+           // Wrapped: forget every old stamp so none can alias the new ones
+           std::fill(stamps.begin(), stamps.end(), 0);
+           stamp = 1;
+       }
+
+       bool unique = true;
+
+       for (std::size_t i = 0; i < count; ++i)
+       {
+           unique = unique && stamps[ids[i]] != stamp;
+           stamps[ids[i]] = stamp;
+       }
+
+       return unique;
+   }
+
+} // namespace safety
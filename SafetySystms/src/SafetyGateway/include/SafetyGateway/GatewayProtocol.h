@@ -0,0 +1,36 @@
+#pragma once
+#include "SafetyRules/SafetyTable.h"
+#include <cstdint>
+
+namespace safety
+{
+
+   // ----- Wire format of safety_gatewayd (Unix domain stream sockets, one box)
+   //
+   // Both directions are a plain sequence of fixed 8-byte frames in host byte
+   // order; a frame may be split across reads and writes however the socket likes.
+   // Clients send EventFrames. After every batch the gateway answers each client
+   // with StateFrames for the printers that moved and that it sent events for, even
+   // when another client's event in the same batch did the moving: one frame per
+   // printer, client and batch, carrying where the printer ended up (intermediate
+   // configurations within one batch are coalesced).
+
+   // Client -> gateway
+   struct EventFrame
+   {
+       std::uint32_t printer;       // 0 .. printers - 1 of the gateway's fleet
+       Trigger       trigger;       // an Event, or StartLoader; anything else is rejected
+       std::uint8_t  reserved[3];
+   };
+
+   // Gateway -> client
+   struct StateFrame
+   {
+       std::uint32_t printer;
+       Config        config;        // toConfig(state, sub), see SafetyTable.h
+       std::uint8_t  reserved[3];
+   };
+
+   static_assert(sizeof(EventFrame) == 8 && sizeof(StateFrame) == 8, "Gateway frames are 8 bytes");
+
+} // namespace safety
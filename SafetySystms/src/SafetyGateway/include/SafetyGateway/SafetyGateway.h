@@ -0,0 +1,126 @@
+#pragma once
+#include "SafetyFleet/SafetyFleet.h"
+#include "SafetyGateway/GatewayProtocol.h"
+#include "SafetyRules/SafetyTable.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace safety
+{
+
+   // Event gateway for a SafetyFleet: many local clients, one thread.
+   //
+   // Listens on a Unix domain stream socket and multiplexes every client with
+   // level-triggered epoll. Each round reads up to kReadBytes from every readable
+   // client, collects their frames into one batch and hands it to
+   // SafetyFleet::dispatchBatch() in a single call, so a busy gateway runs batches
+   // of tens of thousands of events through the fleet's SIMD path. Then it writes
+   // StateFrames back to every client that sent an event for a printer that moved
+   // (see GatewayProtocol.h). Frames from one client keep their order; frames from
+   // different clients within a round are taken client by client.
+   //
+   // A client that does not read its notifications is not allowed to stall the
+   // gateway: beyond kOutboundLimit bytes queued for it, further StateFrames are
+   // dropped and counted. A client that shuts down its write side gets everything
+   // still queued for it, then the gateway closes the connection.
+   class SafetyGateway
+   {
+      public:
+          struct Stats
+          {
+              std::uint64_t accepted;       // connections accepted so far
+              std::size_t   connections;    // open right now
+              std::uint64_t frames;         // event frames dispatched
+              std::uint64_t rejected;       // frames naming an unknown printer or trigger
+              std::uint64_t batches;        // dispatchBatch calls
+              std::size_t   largestBatch;
+              std::uint64_t notifications;  // StateFrames queued to clients
+              std::uint64_t dropped;        // StateFrames dropped, their client not reading
+          };
+
+          static constexpr std::size_t kReadBytes     = 64 * 1024;   // per client per round
+          static constexpr std::size_t kOutboundLimit = 1 << 20;     // per client
+
+      public:
+          // Listens on socketPath (a stale socket file there is replaced) for a fleet
+          // of printers printers. Throws std::invalid_argument if the path does not
+          // fit a sockaddr_un, std::system_error if the socket cannot be set up.
+          SafetyGateway(const std::string& socketPath, std::size_t printers);
+          ~SafetyGateway();
+
+          SafetyGateway(const SafetyGateway&) = delete;
+          SafetyGateway& operator=(const SafetyGateway&) = delete;
+
+          // ----- Gateway thread
+          // Rounds until stop()
+          void run();
+
+          // One round, waiting up to timeoutMs (-1: forever) for something to do;
+          // false once stop() has been called
+          bool pollOnce(int timeoutMs);
+
+          // ----- Any thread, or a signal handler (one eventfd write)
+          void stop();
+
+          // ----- Gateway thread, or any thread once run() has returned
+          const Stats& stats() const
+          {
+              return counters;
+          }
+
+          SafetyFleet& fleet()
+          {
+              return printers;
+          }
+
+          const std::string& path() const
+          {
+              return socketPath;
+          }
+
+      private:
+          struct Connection;
+
+          void acceptAll();
+          void receive(std::uint32_t slot);
+          void dispatch();
+          void notify(std::uint32_t slot, std::uint32_t printer, Config config);
+          void flush(std::uint32_t slot);
+          void watch(std::uint32_t slot);
+          void settle();
+          void close(std::uint32_t slot);
+
+      private:
+          std::string                              socketPath;
+          SafetyFleet                              printers;
+          int                                      listener { -1 };
+          int                                      epoll { -1 };
+          int                                      wakeFd { -1 };
+          bool                                     stopping { false };
+          Stats                                    counters {};
+
+          std::vector<std::unique_ptr<Connection>> connections;   // by slot; null when free
+          std::vector<std::uint32_t>               freeSlots;
+          std::vector<std::uint32_t>               active;        // slots to flush or close this round
+          std::vector<char>                        buffer;        // one read, any client
+
+          // ----- The batch of the current round
+          std::vector<std::uint32_t>               ids;
+          std::vector<Trigger>                     triggers;
+          std::vector<std::uint32_t>               origins;       // slot each frame came from
+
+          // ----- Per printer, for coalesced notifications: touched[p] == round when p
+          //       is in this batch, with its configuration before it and the last
+          //       client slot sent its StateFrame this round
+          static constexpr std::uint32_t           kNobody = ~0u;
+
+          std::vector<std::uint32_t>               touched;
+          std::vector<Config>                      before;
+          std::vector<std::uint32_t>               answered;
+          std::uint32_t                            round { 0 };
+   };
+
+} // namespace safety
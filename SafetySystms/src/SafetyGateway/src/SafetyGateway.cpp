@@ -0,0 +1,491 @@
+#include "SafetyGateway/SafetyGateway.h"
+#include "SafetyBase/Posix.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace safety
+{
+
+   namespace
+   {
+       using posix::throwErrno;
+
+       // epoll data: the listener, the stop eventfd, then connection slot + kFirstSlot
+       constexpr std::uint64_t kListenerTag = 0;
+       constexpr std::uint64_t kWakeTag     = 1;
+       constexpr std::uint64_t kFirstSlot   = 2;
+
+       constexpr int kMaxEvents = 256;
+
+       epoll_event interestIn(std::uint32_t events, std::uint64_t tag)
+       {
+           epoll_event event {};
+           event.events = events;
+           event.data.u64 = tag;
+           return event;
+       }
+
+       bool validFrame(const EventFrame& frame, std::size_t printers)
+       {
+           return frame.printer < printers && static_cast<std::size_t>(frame.trigger) < kTriggerCount;
+       }
+   }
+
+   struct SafetyGateway::Connection
+   {
+       int                     fd;
+       std::uint32_t           interest { EPOLLIN };
+       std::uint8_t            partial[sizeof(EventFrame)] {};   // a frame split across reads
+       std::size_t             partialSize { 0 };
+       std::vector<StateFrame> outbound;
+       std::size_t             sentBytes { 0 };                  // of outbound, from its front
+       bool                    readClosed { false };             // the client shut down its write side
+       bool                    broken { false };                 // a socket error: close, nothing to flush
+       bool                    listed { false };                 // in active this round
+
+       explicit Connection(int fd)
+           : fd(fd)
+       {
+       }
+
+       std::size_t pendingBytes() const
+       {
+           return outbound.size() * sizeof(StateFrame) - sentBytes;
+       }
+
+       // Drops the frames already sent once they outweigh the rest, so a client that
+       // never drains completely does not grow outbound without bound. Moving at most
+       // as many frames as were sent keeps it amortised O(1) per frame.
+       void compact()
+       {
+           const std::size_t sentFrames = sentBytes / sizeof(StateFrame);
+
+           if (sentFrames != 0 && sentFrames * 2 >= outbound.size())
+           {
+               outbound.erase(outbound.begin(), outbound.begin() + static_cast<std::ptrdiff_t>(sentFrames));
+               sentBytes -= sentFrames * sizeof(StateFrame);
+           }
+       }
+   };
+
+   // ----- Construction
+
+   SafetyGateway::SafetyGateway(const std::string& socketPath, std::size_t printers)
+       : socketPath(socketPath),
+         printers(printers),
+         buffer(kReadBytes + sizeof(EventFrame)),
+         touched(printers, 0),
+         before(printers, 0),
+         answered(printers, kNobody)
+   {
+       sockaddr_un address {};
+       address.sun_family = AF_UNIX;
+
+       if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+       {
+           throw std::invalid_argument("socket path must be 1 to " + std::to_string(sizeof(address.sun_path) - 1)
+                                       + " characters: " + socketPath);
+       }
+
+       std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+       try
+       {
+           epoll  = ::epoll_create1(EPOLL_CLOEXEC);
+           wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+           if (epoll < 0 || wakeFd < 0)
+           {
+               throwErrno("epoll/eventfd for", socketPath);
+           }
+
+           listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+           if (listener < 0)
+           {
+               throwErrno("socket", socketPath);
+           }
+
+           // A socket left behind by a gateway that did not shut down; never any other file
+           struct stat st;
+
+           if (::lstat(socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+           {
+               ::unlink(socketPath.c_str());
+           }
+
+           if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+           {
+               throwErrno("bind", socketPath);
+           }
+
+           if (::listen(listener, SOMAXCONN) != 0)
+           {
+               ::unlink(socketPath.c_str());
+               throwErrno("listen", socketPath);
+           }
+
+           epoll_event listen = interestIn(EPOLLIN, kListenerTag);
+           epoll_event wake = interestIn(EPOLLIN, kWakeTag);
+
+           if (::epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &listen) != 0
+               || ::epoll_ctl(epoll, EPOLL_CTL_ADD, wakeFd, &wake) != 0)
+           {
+               ::unlink(socketPath.c_str());
+               throwErrno("epoll_ctl", socketPath);
+           }
+       }
+       catch (...)
+       {
+           for (int fd : { listener, wakeFd, epoll })
+           {
+               if (fd >= 0)
+               {
+                   ::close(fd);
+               }
+           }
+
+           throw;
+       }
+   }
+
+   SafetyGateway::~SafetyGateway()
+   {
+       for (auto& connection : connections)
+       {
+           if (connection)
+           {
+               ::close(connection->fd);
+           }
+       }
+
+       ::close(listener);
+       ::unlink(socketPath.c_str());
+       ::close(wakeFd);
+       ::close(epoll);
+   }
+
+   // ----- Rounds
+
+   void SafetyGateway::run()
+   {
+       while (pollOnce(-1))
+       {
+       }
+   }
+
+   bool SafetyGateway::pollOnce(int timeoutMs)
+   {
+       epoll_event events[kMaxEvents];
+       const int ready = ::epoll_wait(epoll, events, kMaxEvents, timeoutMs);
+
+       if (ready < 0 && errno != EINTR)
+       {
+           throwErrno("epoll_wait on", socketPath);
+       }
+
+       for (int i = 0; i < ready; ++i)
+       {
+           const std::uint64_t tag = events[i].data.u64;
+           const std::uint32_t what = events[i].events;
+
+           if (tag == kListenerTag)
+           {
+               acceptAll();
+               continue;
+           }
+
+           if (tag == kWakeTag)
+           {
+               std::uint64_t count;
+               (void)!::read(wakeFd, &count, sizeof(count));
+               stopping = true;
+               continue;
+           }
+
+           const auto slot = static_cast<std::uint32_t>(tag - kFirstSlot);
+           Connection& connection = *connections[slot];
+
+           if (what & EPOLLIN)
+           {
+               receive(slot);
+           }
+           else if (what & (EPOLLHUP | EPOLLERR))
+           {
+               // Nothing left to read: the peer is gone
+               connection.readClosed = true;
+               connection.broken = (what & EPOLLERR) != 0;
+           }
+
+           if (what & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+           {
+               watch(slot);
+           }
+       }
+
+       dispatch();
+       settle();
+       return !stopping;
+   }
+
+   void SafetyGateway::stop()
+   {
+       const std::uint64_t one = 1;
+       (void)!::write(wakeFd, &one, sizeof(one));
+   }
+
+   void SafetyGateway::acceptAll()
+   {
+       for (;;)
+       {
+           const int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+           if (fd < 0)
+           {
+               // EAGAIN: all taken; anything else (EMFILE, ...) is retried next round
+               return;
+           }
+
+           std::uint32_t slot;
+
+           if (freeSlots.empty())
+           {
+               slot = static_cast<std::uint32_t>(connections.size());
+               connections.emplace_back();
+           }
+           else
+           {
+               slot = freeSlots.back();
+               freeSlots.pop_back();
+           }
+
+           epoll_event event = interestIn(EPOLLIN, slot + kFirstSlot);
+
+           if (::epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) != 0)
+           {
+               ::close(fd);
+               freeSlots.push_back(slot);
+               continue;
+           }
+
+           connections[slot] = std::make_unique<Connection>(fd);
+           ++counters.accepted;
+           ++counters.connections;
+       }
+   }
+
+   // One read: whole frames join the batch, a trailing partial frame waits for the next
+   void SafetyGateway::receive(std::uint32_t slot)
+   {
+       Connection& connection = *connections[slot];
+       char* data = buffer.data();
+
+       std::memcpy(data, connection.partial, connection.partialSize);
+       const ssize_t got = ::read(connection.fd, data + connection.partialSize, kReadBytes);
+
+       if (got <= 0)
+       {
+           if (got < 0 && (errno == EAGAIN || errno == EINTR))
+           {
+               return;
+           }
+
+           connection.readClosed = true;
+           connection.broken = got < 0;
+           watch(slot);
+           return;
+       }
+
+       const std::size_t total = connection.partialSize + static_cast<std::size_t>(got);
+       const std::size_t whole = total - total % sizeof(EventFrame);
+
+       for (std::size_t offset = 0; offset < whole; offset += sizeof(EventFrame))
+       {
+           EventFrame frame;
+           std::memcpy(&frame, data + offset, sizeof(frame));
+
+           if (!validFrame(frame, printers.size()))
+           {
+               ++counters.rejected;
+               continue;
+           }
+
+           ids.push_back(frame.printer);
+           triggers.push_back(frame.trigger);
+           origins.push_back(slot);
+       }
+
+       connection.partialSize = total - whole;
+       std::memcpy(connection.partial, data + whole, connection.partialSize);
+   }
+
+   // The whole round in one dispatchBatch, then one StateFrame per printer that moved
+   // to every client that sent a frame for it
+   void SafetyGateway::dispatch()
+   {
+       if (ids.empty())
+       {
+           return;
+       }
+
+       if (++round == 0)
+       {
+           std::fill(touched.begin(), touched.end(), 0);
+           round = 1;
+       }
+
+       const std::vector<Config>& configs = printers.configurations();
+
+       for (std::size_t i = 0; i < ids.size(); ++i)
+       {
+           const std::uint32_t p = ids[i];
+
+           if (touched[p] != round)
+           {
+               touched[p] = round;
+               before[p] = configs[p];
+               answered[p] = kNobody;
+           }
+       }
+
+       printers.dispatchBatch(ids.data(), triggers.data(), ids.size());
+
+       counters.frames += ids.size();
+       counters.batches += 1;
+       counters.largestBatch = std::max(counters.largestBatch, ids.size());
+
+       // A client's frames of one round are contiguous (one read each), so the last
+       // client answered for a printer is enough to answer every client once
+       for (std::size_t i = 0; i < ids.size(); ++i)
+       {
+           const std::uint32_t p = ids[i];
+
+           if (configs[p] != before[p] && answered[p] != origins[i])
+           {
+               answered[p] = origins[i];
+               notify(origins[i], p, configs[p]);
+           }
+       }
+
+       ids.clear();
+       triggers.clear();
+       origins.clear();
+   }
+
+   void SafetyGateway::notify(std::uint32_t slot, std::uint32_t printer, Config config)
+   {
+       Connection& connection = *connections[slot];
+
+       if (connection.broken)
+       {
+           return;
+       }
+
+       if (connection.pendingBytes() >= kOutboundLimit)
+       {
+           ++counters.dropped;
+           return;
+       }
+
+       connection.outbound.push_back(StateFrame { printer, config, {} });
+       ++counters.notifications;
+       watch(slot);
+   }
+
+   // ----- Writes and closes, once per round
+
+   void SafetyGateway::watch(std::uint32_t slot)
+   {
+       Connection& connection = *connections[slot];
+
+       if (!connection.listed)
+       {
+           connection.listed = true;
+           active.push_back(slot);
+       }
+   }
+
+   void SafetyGateway::flush(std::uint32_t slot)
+   {
+       Connection& connection = *connections[slot];
+       const char* bytes = reinterpret_cast<const char*>(connection.outbound.data());
+
+       while (connection.pendingBytes() != 0)
+       {
+           const ssize_t sent = ::send(connection.fd, bytes + connection.sentBytes, connection.pendingBytes(),
+                                       MSG_NOSIGNAL | MSG_DONTWAIT);
+
+           if (sent > 0)
+           {
+               connection.sentBytes += static_cast<std::size_t>(sent);
+           }
+           else if (errno == EAGAIN)
+           {
+               connection.compact();
+               return;
+           }
+           else if (errno != EINTR)
+           {
+               connection.broken = true;
+               return;
+           }
+       }
+
+       connection.outbound.clear();
+       connection.sentBytes = 0;
+   }
+
+   void SafetyGateway::settle()
+   {
+       for (const std::uint32_t slot : active)
+       {
+           Connection& connection = *connections[slot];
+           connection.listed = false;
+
+           if (!connection.broken)
+           {
+               flush(slot);
+           }
+
+           if (connection.broken || (connection.readClosed && connection.pendingBytes() == 0))
+           {
+               close(slot);
+               continue;
+           }
+
+           // Read while the client writes; ask for EPOLLOUT only while a flush is pending
+           const std::uint32_t interest = (connection.readClosed ? 0u : std::uint32_t(EPOLLIN))
+                                          | (connection.pendingBytes() != 0 ? std::uint32_t(EPOLLOUT) : 0u);
+
+           if (interest != connection.interest)
+           {
+               epoll_event event = interestIn(interest, slot + kFirstSlot);
+               ::epoll_ctl(epoll, EPOLL_CTL_MOD, connection.fd, &event);
+               connection.interest = interest;
+           }
+       }
+
+       active.clear();
+   }
+
+   void SafetyGateway::close(std::uint32_t slot)
+   {
+       ::epoll_ctl(epoll, EPOLL_CTL_DEL, connections[slot]->fd, nullptr);
+       ::close(connections[slot]->fd);
+       connections[slot].reset();
+       freeSlots.push_back(slot);
+       --counters.connections;
+   }
+
+} // namespace safety
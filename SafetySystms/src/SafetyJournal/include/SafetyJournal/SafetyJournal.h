@@ -0,0 +1,125 @@
+#pragma once
+#include "SafetyRules/SafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace safety
+{
+
+   // ----- On-disk layout of a journal segment
+   //
+   // One preallocated file: a 64-byte header followed by fixed-size records.
+   // The writer maps it shared, fills record n and then publishes n + 1 in the
+   // header's committed count, so a reader (or a post-crash replay) never sees a
+   // half-written record as committed. The header also keeps the configuration the
+   // machine was in when the journal was first attached: replay starts from there.
+   struct JournalRecord
+   {
+       std::uint64_t timestampNs;  // CLOCK_MONOTONIC at the end of the step
+       std::uint32_t sequence;     // 0, 1, 2, ... within the segment (capacity fits 32 bits)
+       Trigger       trigger;      // Event, StartLoader or Reset
+       Config        result;       // configuration after the step
+       std::uint16_t reserved;
+   };
+
+   static_assert(sizeof(JournalRecord) == 16, "Journal records are 16 bytes");
+
+   struct JournalHeader
+   {
+       char                       magic[8];     // "SFJRNL01"
+       std::uint32_t              version;
+       std::uint32_t              recordSize;
+       std::uint64_t              capacity;     // records the segment can hold
+       std::atomic<std::uint64_t> committed;    // records fully written
+       std::uint64_t              startNs;      // CLOCK_MONOTONIC when the segment was created
+       Config                     initial;      // configuration at the first attach (Idle until then)
+       std::uint8_t               padding[23];
+   };
+
+   static_assert(sizeof(JournalHeader) == 64, "Journal header is one cache line");
+
+   // ----- Writer: append-only, opt-in per SafetyRules via attach()
+   class SafetyJournal
+   {
+      public:
+          // Creates (or truncates) the segment file; throws std::system_error on failure
+          // and std::invalid_argument if capacity does not fit a record's 32-bit sequence
+          SafetyJournal(const std::string& path, std::size_t capacity);
+          ~SafetyJournal();
+
+          SafetyJournal(const SafetyJournal&) = delete;
+          SafetyJournal& operator=(const SafetyJournal&) = delete;
+
+          // Records every step of rules from now on (adds a step observer; throws
+          // std::runtime_error if the machine has none left). The first attach to an
+          // empty segment stores the machine's current configuration in the header.
+          void attach(SafetyRules& rules);
+          void detach(SafetyRules& rules);
+
+          // False once the segment is full; the record is counted as dropped
+          bool append(Trigger trigger, Config result);
+
+          // Forces committed records to the file
+          void flush();
+
+          std::size_t size() const;
+          std::size_t capacity() const;
+          std::uint64_t dropped() const;
+
+      private:
+          static void record(void* self, Trigger trigger, Config result);
+
+      private:
+          JournalHeader* header { nullptr };
+          JournalRecord* records { nullptr };
+          std::size_t    mappedBytes { 0 };
+          std::uint64_t  next { 0 };
+          std::uint64_t  droppedCount { 0 };
+   };
+
+   // ----- Reader: maps a segment read-only
+   class JournalReader
+   {
+      public:
+          // Throws std::system_error if the file cannot be mapped, std::runtime_error if
+          // it is not a journal segment
+          explicit JournalReader(const std::string& path);
+          ~JournalReader();
+
+          JournalReader(const JournalReader&) = delete;
+          JournalReader& operator=(const JournalReader&) = delete;
+
+          const JournalRecord* begin() const { return records; }
+          const JournalRecord* end() const   { return records + count; }
+          std::size_t size() const           { return count; }
+          std::uint64_t startNs() const      { return header->startNs; }
+          Config initial() const             { return header->initial; }
+
+      private:
+          const JournalHeader* header { nullptr };
+          const JournalRecord* records { nullptr };
+          std::size_t          count { 0 };
+          std::size_t          mappedBytes { 0 };
+   };
+
+   // ----- Replay: drive a fresh machine with the journal, checking every result
+   struct ReplayResult
+   {
+       std::size_t replayed;       // records applied
+       std::size_t mismatches;     // records whose result differed
+       std::size_t firstMismatch;  // index of the first one (== replayed when none)
+       Config      expected;       // at firstMismatch
+       Config      actual;         // at firstMismatch
+   };
+
+   // Drives rules from whatever configuration it is in
+   ReplayResult replay(const JournalRecord* first, const JournalRecord* last, SafetyRules& rules);
+
+   // Restores rules to the journal's initial configuration first, so a journal
+   // attached to a running machine replays from where it started
+   ReplayResult replay(const JournalReader& journal, SafetyRules& rules);
+
+} // namespace safety
@@ -0,0 +1,273 @@
+#include "SafetyJournal/SafetyJournal.h"
+#include "SafetyBase/Posix.h"
+
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace safety
+{
+
+   namespace
+   {
+       using posix::monotonicNs;
+       using posix::throwErrno;
+       using posix::Fd;
+
+       constexpr char          kMagic[8] = { 'S', 'F', 'J', 'R', 'N', 'L', '0', '1' };
+       constexpr std::uint32_t kVersion  = 1;
+   }
+
+   // ----- SafetyJournal
+
+   SafetyJournal::SafetyJournal(const std::string& path, std::size_t capacity)
+   {
+       if (capacity > std::numeric_limits<std::uint32_t>::max() + std::size_t { 1 })
+       {
+           throw std::invalid_argument("journal capacity " + std::to_string(capacity)
+                                       + " exceeds the 32-bit record sequence");
+       }
+
+       Fd file { ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) };
+
+       if (file.fd < 0)
+       {
+           throwErrno("open", path);
+       }
+
+       mappedBytes = sizeof(JournalHeader) + capacity * sizeof(JournalRecord);
+
+       // Reserve the blocks up front so an append never hits ENOSPC as SIGBUS
+       if (int err = ::posix_fallocate(file.fd, 0, static_cast<off_t>(mappedBytes)); err != 0)
+       {
+           errno = err;
+           throwErrno("posix_fallocate", path);
+       }
+
+       void* base = ::mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd, 0);
+
+       if (base == MAP_FAILED)
+       {
+           throwErrno("mmap", path);
+       }
+
+       header  = static_cast<JournalHeader*>(base);
+       records = reinterpret_cast<JournalRecord*>(static_cast<char*>(base) + sizeof(JournalHeader));
+
+       std::memcpy(header->magic, kMagic, sizeof(kMagic));
+       header->version    = kVersion;
+       header->recordSize = sizeof(JournalRecord);
+       header->capacity   = capacity;
+       header->startNs    = monotonicNs();
+       header->initial    = toConfig(ISafetyRules::State::Idle, ISafetyRules::LoaderSub::None);
+       header->committed.store(0, std::memory_order_release);
+   }
+
+   SafetyJournal::~SafetyJournal()
+   {
+       if (header)
+       {
+           ::msync(header, mappedBytes, MS_ASYNC);
+           ::munmap(header, mappedBytes);
+       }
+   }
+
+   void SafetyJournal::attach(SafetyRules& rules)
+   {
+       if (!rules.addOnStep(SafetyRules::StepFn::bind<&SafetyJournal::record>(this)))
+       {
+           throw std::runtime_error("SafetyJournal: no free step observer on the machine");
+       }
+
+       if (next == 0)
+       {
+           header->initial = toConfig(rules.getState(), rules.getLoaderSubstate());
+       }
+   }
+
+   void SafetyJournal::detach(SafetyRules& rules)
+   {
+       rules.removeOnStep(SafetyRules::StepFn::bind<&SafetyJournal::record>(this));
+   }
+
+   void SafetyJournal::record(void* self, Trigger trigger, Config result)
+   {
+       static_cast<SafetyJournal*>(self)->append(trigger, result);
+   }
+
+   bool SafetyJournal::append(Trigger trigger, Config result)
+   {
+       if (next == header->capacity)
+       {
+           ++droppedCount;
+           return false;
+       }
+
+       JournalRecord& r = records[next];
+       r.timestampNs = monotonicNs();
+       r.sequence    = static_cast<std::uint32_t>(next);
+       r.trigger     = trigger;
+       r.result      = result;
+       r.reserved    = 0;
+
+       header->committed.store(++next, std::memory_order_release);
+       return true;
+   }
+
+   void SafetyJournal::flush()
+   {
+       ::msync(header, mappedBytes, MS_SYNC);
+   }
+
+   std::size_t SafetyJournal::size() const
+   {
+       return next;
+   }
+
+   std::size_t SafetyJournal::capacity() const
+   {
+       return header->capacity;
+   }
+
+   std::uint64_t SafetyJournal::dropped() const
+   {
+       return droppedCount;
+   }
+
+   // ----- JournalReader
+
+   JournalReader::JournalReader(const std::string& path)
+   {
+       Fd file { ::open(path.c_str(), O_RDONLY | O_CLOEXEC) };
+
+       if (file.fd < 0)
+       {
+           throwErrno("open", path);
+       }
+
+       struct stat st;
+
+       if (::fstat(file.fd, &st) != 0)
+       {
+           throwErrno("fstat", path);
+       }
+
+       if (static_cast<std::size_t>(st.st_size) < sizeof(JournalHeader))
+       {
+           throw std::runtime_error("not a safety journal (too short): " + path);
+       }
+
+       mappedBytes = static_cast<std::size_t>(st.st_size);
+       void* base = ::mmap(nullptr, mappedBytes, PROT_READ, MAP_SHARED, file.fd, 0);
+
+       if (base == MAP_FAILED)
+       {
+           throwErrno("mmap", path);
+       }
+
+       header  = static_cast<const JournalHeader*>(base);
+       records = reinterpret_cast<const JournalRecord*>(static_cast<const char*>(base) + sizeof(JournalHeader));
+
+       const std::size_t room = (mappedBytes - sizeof(JournalHeader)) / sizeof(JournalRecord);
+
+       if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0
+           || header->version != kVersion
+           || header->recordSize != sizeof(JournalRecord)
+           || header->capacity > room
+           || !isReachable(header->initial))
+       {
+           ::munmap(base, mappedBytes);
+           throw std::runtime_error("not a safety journal (bad header): " + path);
+       }
+
+       count = static_cast<std::size_t>(header->committed.load(std::memory_order_acquire));
+
+       if (count > header->capacity)
+       {
+           ::munmap(base, mappedBytes);
+           throw std::runtime_error("corrupt safety journal (committed > capacity): " + path);
+       }
+   }
+
+   JournalReader::~JournalReader()
+   {
+       ::munmap(const_cast<JournalHeader*>(header), mappedBytes);
+   }
+
+   // ----- Replay
+
+   ReplayResult replay(const JournalRecord* first, const JournalRecord* last, SafetyRules& rules)
+   {
+       ReplayResult result { 0, 0, 0, 0, 0 };
+       bool mismatched = false;
+
+       for (const JournalRecord* r = first; r != last; ++r)
+       {
+           // A corrupt trigger byte is never fed to the machine: it would index past
+           // the transition table. The record counts as a mismatch instead.
+           bool valid = true;
+
+           switch (r->trigger)
+           {
+               case Trigger::Reset:
+                   rules.reset();
+                   break;
+
+               case Trigger::StartLoader:
+                   rules.startLoader();
+                   break;
+
+               default:
+                   if (static_cast<std::size_t>(r->trigger) < kEventCount)
+                   {
+                       rules.dispatch(static_cast<ISafetyRules::Event>(r->trigger));
+                   }
+                   else
+                   {
+                       valid = false;
+                   }
+
+                   break;
+           }
+
+           const Config actual = toConfig(rules.getState(), rules.getLoaderSubstate());
+
+           if (!valid || actual != r->result)
+           {
+               if (!mismatched)
+               {
+                   mismatched           = true;
+                   result.firstMismatch = result.replayed;
+                   result.expected      = r->result;
+                   result.actual        = actual;
+               }
+
+               ++result.mismatches;
+           }
+
+           ++result.replayed;
+       }
+
+       if (!mismatched)
+       {
+           result.firstMismatch = result.replayed;
+       }
+
+       return result;
+   }
+
+   ReplayResult replay(const JournalReader& journal, SafetyRules& rules)
+   {
+       rules.restore(journal.initial());
+       return replay(journal.begin(), journal.end(), rules);
+   }
+
+} // namespace safety
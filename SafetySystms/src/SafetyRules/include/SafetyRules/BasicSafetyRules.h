@@ -0,0 +1,296 @@
+#pragma once
+#include "SafetyRules/ISafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#ifndef SAFETY_INSTRUMENTATION
+#define SAFETY_INSTRUMENTATION 0
+#endif
+
+#if SAFETY_INSTRUMENTATION
+#include "SafetyRules/Instrumentation.h"
+#endif
+
+namespace safety
+{
+
+   namespace detail
+   {
+
+       // ----- Triggers posted from inside a hook, waiting for the current step to finish
+       template <std::size_t Capacity>
+       struct DeferredQueue
+       {
+           static_assert(Capacity < 256, "Deferred queue indices are bytes");
+
+           enum : std::uint8_t
+           {
+               kBusy     = 1 << 0,   // a step (and its hooks) is running
+               kOverflow = 1 << 1    // a trigger was dropped since the last reset
+           };
+
+           // Bytes only, so the machine's configuration byte packs right after them
+           std::array<Trigger, Capacity> items {};
+           std::uint8_t head { 0 };
+           std::uint8_t count { 0 };
+           std::uint8_t flags { 0 };
+
+           bool push(Trigger trigger)
+           {
+               if (count == Capacity)
+               {
+                   flags |= kOverflow;
+                   return false;
+               }
+
+               items[(head + count++) % Capacity] = trigger;
+               return true;
+           }
+
+           bool pop(Trigger& trigger)
+           {
+               if (count == 0)
+               {
+                   return false;
+               }
+
+               trigger = items[head];
+               head = static_cast<std::uint8_t>((head + 1) % Capacity);
+               --count;
+               return true;
+           }
+       };
+
+       // No queue: triggers from hooks re-enter the machine directly
+       template <>
+       struct DeferredQueue<0>
+       {
+       };
+
+   } // namespace detail
+
+   // Statically dispatched SafetyRules core.
+   //
+   // The machine is the table-driven step of SafetyTable.h; what happens on a hook
+   // is a policy type known at compile time, so with a concrete Hooks every call,
+   // the table lookup and the hooks themselves can inline into the caller. No
+   // virtual function, no stored callback unless the policy keeps one.
+   //
+   // A Hooks policy provides
+   //
+   //    void fire(Hook h);                        // a transition runs hook h
+   //    void stepped(Trigger t, Config result);   // after every step, reset included
+   //
+   // and sees the same intermediate configurations through getState() that
+   // SafetyRules hooks see. SafetyRules is this core with Delegate hooks behind the
+   // ISafetyRules interface, for code that needs runtime polymorphism.
+   //
+   // Run to completion: with Deferred > 0, dispatch(), startLoader() and reset()
+   // called from inside a hook do not re-enter the step. The trigger waits in an
+   // inline ring of Deferred entries and runs, in order, once the current step and
+   // its stepped() notification are done; the outermost call returns only when the
+   // ring is empty. A trigger that finds the ring full is dropped, asserts in debug
+   // builds and sets deferredOverflow() until the next reset from outside a hook.
+   // A hook that throws ends the step there: the exception propagates out of the
+   // outermost call, queued triggers are dropped and the machine keeps the
+   // configuration it had reached.
+   template <typename Hooks, std::size_t Deferred = 0>
+   class BasicSafetyRules : private Hooks, private detail::DeferredQueue<Deferred>
+   {
+      public:
+          using State     = ISafetyRules::State;
+          using LoaderSub = ISafetyRules::LoaderSub;
+          using Event     = ISafetyRules::Event;
+
+      public:
+          // ----- Construction (fires EnterIdle, like reset())
+          explicit BasicSafetyRules(Hooks hooks = Hooks())
+              : Hooks(std::move(hooks))
+          {
+              reset();
+          }
+
+          // ----- Control
+          void reset()
+          {
+              if constexpr (Deferred != 0)
+              {
+                  if (!(this->flags & this->kBusy))
+                  {
+                      this->flags &= ~this->kOverflow;
+                  }
+              }
+
+              run(Trigger::Reset);
+          }
+
+          void dispatch(Event ev)
+          {
+              run(toTrigger(ev));
+          }
+
+          void startLoader()
+          {
+              // Ignored unless in Active (see kTransitions)
+              run(Trigger::StartLoader);
+          }
+
+          // Puts the machine straight into config, a reachable configuration saved
+          // earlier (SafetyCheckpoint): no hooks fire and stepped() is not called
+          void restore(Config saved)
+          {
+              assert(isReachable(saved) && "Restoring an unreachable configuration");
+              config = saved;
+          }
+
+          // ----- Observability
+          State getState() const
+          {
+              return stateOf(config);
+          }
+
+          LoaderSub getLoaderSubstate() const
+          {
+              return subOf(config);
+          }
+
+          Config configuration() const
+          {
+              return config;
+          }
+
+          // Triggers that do something in the current configuration (see kAccepted)
+          TriggerMask acceptedTriggers() const
+          {
+              return kAccepted[config];
+          }
+
+          bool deferredOverflow() const
+          {
+              if constexpr (Deferred != 0)
+              {
+                  return (this->flags & this->kOverflow) != 0;
+              }
+              else
+              {
+                  return false;
+              }
+          }
+
+          // ----- The policy instance
+          Hooks& hooks()
+          {
+              return *this;
+          }
+
+          const Hooks& hooks() const
+          {
+              return *this;
+          }
+
+      private:
+          // ----- Run to completion: a call from a hook only queues its trigger
+          void run(Trigger trigger)
+          {
+              if constexpr (Deferred == 0)
+              {
+                  apply(trigger);
+              }
+              else
+              {
+                  if (this->flags & this->kBusy)
+                  {
+                      const bool queued = this->push(trigger);
+                      assert(queued && "Deferred event queue overflow; raise BasicSafetyRules' Deferred");
+                      (void)queued;
+                      return;
+                  }
+
+                  this->flags |= this->kBusy;
+
+                  try
+                  {
+                      apply(trigger);
+
+                      while (this->pop(trigger))
+                      {
+                          apply(trigger);
+                      }
+                  }
+                  catch (...)
+                  {
+                      // A hook threw: abandon the step and what it queued, but leave
+                      // the machine accepting triggers again
+                      this->head  = 0;
+                      this->count = 0;
+                      this->flags &= ~this->kBusy;
+                      throw;
+                  }
+
+                  this->flags &= ~this->kBusy;
+              }
+          }
+
+          void apply(Trigger trigger)
+          {
+              if (trigger == Trigger::Reset)
+              {
+                  config = toConfig(State::Idle, LoaderSub::None);
+
+                  this->fire(Hook::EnterIdle);
+                  this->stepped(Trigger::Reset, config);
+              }
+              else
+              {
+                  step(trigger);
+              }
+          }
+
+          // ----- Table-driven step: one lookup, then exit/enter hooks and substate entry action
+          void step(Trigger trigger)
+          {
+              assert(config != toConfig(State::BuildPlateLoader, LoaderSub::None)
+                     && "Invalid loader substate in BuildPlateLoader");
+
+#if SAFETY_INSTRUMENTATION
+              instrumentation::countEdge(config, trigger);
+#endif
+
+              const Transition t = lookup(config, trigger);
+
+              if (t.exit != Hook::None)
+              {
+                  // Hooks observe the loader submachine already left / not yet entered
+                  config = topOf(config);
+                  this->fire(t.exit);
+
+                  config = topOf(t.next);
+                  this->fire(t.enter);
+              }
+
+              config = t.next;
+
+              if (t.action != Hook::None)
+              {
+                  this->fire(t.action); // entry action
+              }
+
+              this->stepped(trigger, config);
+          }
+
+      private:
+          Config config { toConfig(State::Idle, LoaderSub::None) };
+   };
+
+   // ----- Policy with no hooks: the bare machine
+   struct NoHooks
+   {
+       void fire(Hook) {}
+       void stepped(Trigger, Config) {}
+   };
+
+} // namespace safety
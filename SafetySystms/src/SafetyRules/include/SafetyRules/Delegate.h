@@ -0,0 +1,107 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace safety
+{
+
+   // Non-allocating, fixed-size callable used for hooks.
+   //
+   // Holds any trivially copyable callable that fits in Capacity bytes (a lambda
+   // capturing one pointer, a free function pointer), or a compile-time function
+   // bound to a context pointer via bind<&fn>(context). Anything bigger is rejected
+   // at compile time rather than spilled to the heap, so setting, copying and
+   // calling a Delegate never allocates. Default size: two pointers.
+   template <typename Signature, std::size_t Capacity = sizeof(void*)>
+   class Delegate;
+
+   template <typename R, typename... Args, std::size_t Capacity>
+   class Delegate<R(Args...), Capacity>
+   {
+      public:
+          // ----- Construction
+          Delegate() = default;
+
+          Delegate(std::nullptr_t)
+          {
+          }
+
+          template <typename F,
+                    typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Delegate>::value
+                                                && std::is_invocable_r<R, std::decay_t<F>&, Args...>::value>>
+          Delegate(F&& fn)
+          {
+              using Fn = std::decay_t<F>;
+
+              static_assert(sizeof(Fn) <= Capacity, "Callable too large for Delegate; capture one pointer or use bind()");
+              static_assert(alignof(Fn) <= alignof(void*), "Callable over-aligned for Delegate");
+              static_assert(std::is_trivially_copyable<Fn>::value, "Delegate only stores trivially copyable callables");
+
+              if constexpr (std::is_pointer<Fn>::value)
+              {
+                  if (fn == nullptr)
+                  {
+                      return;
+                  }
+              }
+
+              ::new (static_cast<void*>(storage)) Fn(std::forward<F>(fn));
+              invoker = &invoke<Fn>;
+          }
+
+          // Function known at compile time plus a context pointer, passed as its first argument
+          template <R (*Fn)(void* context, Args... args)>
+          static Delegate bind(void* context)
+          {
+              Delegate d;
+              ::new (static_cast<void*>(d.storage)) void*(context);
+              d.invoker = &invokeBound<Fn>;
+              return d;
+          }
+
+          // ----- Invocation
+          explicit operator bool() const
+          {
+              return invoker != nullptr;
+          }
+
+          R operator()(Args... args) const
+          {
+              return invoker(storage, std::forward<Args>(args)...);
+          }
+
+          // Same target: same invoker and the same stored callable (or context) bytes
+          friend bool operator==(const Delegate& a, const Delegate& b)
+          {
+              return a.invoker == b.invoker && std::memcmp(a.storage, b.storage, Capacity) == 0;
+          }
+
+          friend bool operator!=(const Delegate& a, const Delegate& b)
+          {
+              return !(a == b);
+          }
+
+      private:
+          using Invoker = R (*)(void* storage, Args... args);
+
+          template <typename Fn>
+          static R invoke(void* storage, Args... args)
+          {
+              return (*std::launder(static_cast<Fn*>(storage)))(std::forward<Args>(args)...);
+          }
+
+          template <R (*Fn)(void* context, Args... args)>
+          static R invokeBound(void* storage, Args... args)
+          {
+              return Fn(*std::launder(static_cast<void**>(storage)), std::forward<Args>(args)...);
+          }
+
+      private:
+          Invoker invoker { nullptr };
+          alignas(void*) mutable unsigned char storage[Capacity] {};
+   };
+
+} // namespace safety
@@ -0,0 +1,86 @@
+#pragma once
+#include "SafetyRules/BasicSafetyRules.h"
+#include "SafetyRules/Delegate.h"
+#include "SafetyRules/SafetyTable.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace safety
+{
+
+   // Flyweight hooks for large fleets.
+   //
+   // Printers of one cell run identical hooks that differ only by printer id, so the
+   // callbacks live once in a shared HookTable and each machine keeps its
+   // configuration byte plus the printer id (and, for SharedHooks, a pointer to its
+   // table). Hooks receive the id; changing a table entry changes it for every
+   // machine that uses the table.
+   class HookTable
+   {
+      public:
+          using PrinterFn = Delegate<void(std::uint32_t printer)>;
+
+          void set(Hook h, PrinterFn cb)
+          {
+              hooks[static_cast<std::size_t>(h)] = cb;
+          }
+
+          const PrinterFn& get(Hook h) const
+          {
+              return hooks[static_cast<std::size_t>(h)];
+          }
+
+          void fire(Hook h, std::uint32_t printer) const
+          {
+              const PrinterFn& fn = hooks[static_cast<std::size_t>(h)];
+
+              if (fn) fn(printer);
+          }
+
+      private:
+          std::array<PrinterFn, kHookCount> hooks;
+   };
+
+   // ----- Policy: table chosen per machine at run time (16 bytes per machine)
+   struct SharedHooks
+   {
+       // Declared so the type is not a POD: the machine's configuration byte may then
+       // live in the padding after printer instead of adding another 8 bytes.
+       // Without a table (the default) the machine runs with no hooks.
+       SharedHooks(const HookTable* table = nullptr, std::uint32_t printer = 0)
+           : table(table), printer(printer)
+       {
+       }
+
+       const HookTable* table;
+       std::uint32_t    printer;
+
+       void fire(Hook h)
+       {
+           if (table) table->fire(h, printer);
+       }
+
+       void stepped(Trigger, Config) {}
+   };
+
+   // ----- Policy: table fixed at compile time, e.g. one per cell (8 bytes per machine)
+   //
+   //    inline HookTable cellA;
+   //    using CellAPrinter = BasicSafetyRules<TableHooks<cellA>>;
+   template <const HookTable& Table>
+   struct TableHooks
+   {
+       std::uint32_t printer;
+
+       void fire(Hook h)
+       {
+           Table.fire(h, printer);
+       }
+
+       void stepped(Trigger, Config) {}
+   };
+
+   using SharedSafetyRules = BasicSafetyRules<SharedHooks>;
+
+} // namespace safety
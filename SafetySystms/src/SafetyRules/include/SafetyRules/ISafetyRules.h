@@ -1,5 +1,6 @@
 #pragma once
-#include <functional>
+#include "SafetyRules/Delegate.h"
+#include <cstdint>
 
 namespace safety
 {
@@ -9,7 +10,7 @@ namespace safety
    {
       public:
           // ----- Public types shared by interface and implementation
-          enum class State
+          enum class State : std::uint8_t
           {
               Idle,
               Active,
@@ -17,7 +18,7 @@ namespace safety
               BuildPlateLoader
           };
       
-          enum class LoaderSub
+          enum class LoaderSub : std::uint8_t
           {
               None,
               OpenDoor,
@@ -25,7 +26,7 @@ namespace safety
               BuildPlateLoaded
           };
       
-          enum class Event
+          enum class Event : std::uint8_t
           {
               evPowerOn,          // Idle -> Active, Faulted -> Active
               evPowerOff,         // Active -> Idle
@@ -35,7 +36,7 @@ namespace safety
               evDoorClosed        // BuildPlateLoaded -> completion (-> Active)
           };
       
-          using VoidFn = std::function<void()>;
+          using VoidFn = Delegate<void()>; // never allocates; see Delegate.h
       
       public:
           virtual ~ISafetyRules() = default;
@@ -0,0 +1,220 @@
+#pragma once
+#include "SafetyRules/SafetyTable.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Optional hot-path instrumentation for SafetyRules.
+//
+// Built with SAFETY_INSTRUMENTATION=1 (CMake option of the same name), every step
+// counts its (configuration, trigger) cell, which determines the (from, to, event)
+// edge, and every hook that runs is timed into a log2-bucketed latency histogram.
+// Counters live in one cache-line-aligned block per thread, written only by that
+// thread with plain relaxed stores, so dispatch never takes a lock or an atomic
+// read-modify-write. Blocks are pushed onto a lock-free list, so registering a
+// thread's block never waits on snapshot(), which sums every block without
+// stopping the threads either.
+//
+// Built without it (the default) SafetyRules contains no trace of this header: no
+// calls, no data, no size change. Every translation unit of a program must agree on
+// the setting.
+#ifndef SAFETY_INSTRUMENTATION
+#define SAFETY_INSTRUMENTATION 0
+#endif
+
+namespace safety
+{
+
+   namespace instrumentation
+   {
+
+       // ----- Log2 latency buckets: bucket b holds [2^(b-1), 2^b) ns, bucket 0 holds 0 ns
+       constexpr std::size_t kLatencyBuckets = 40;   // last bucket: >= 2^38 ns (~4.6 min)
+       constexpr std::size_t kEdgeCount      = kConfigCount * kRowWidth;
+
+       inline std::size_t bucketOf(std::uint64_t ns)
+       {
+           const std::size_t b = ns == 0 ? 0 : 64 - static_cast<std::size_t>(__builtin_clzll(ns));
+           return b < kLatencyBuckets ? b : kLatencyBuckets - 1;
+       }
+
+       // Upper bound (exclusive) of a bucket, in ns
+       inline std::uint64_t bucketLimit(std::size_t bucket)
+       {
+           return std::uint64_t(1) << bucket;
+       }
+
+       // ----- Per-thread storage
+       struct alignas(64) HookCounters
+       {
+           std::atomic<std::uint64_t> count { 0 };
+           std::atomic<std::uint64_t> totalNs { 0 };
+           std::atomic<std::uint64_t> maxNs { 0 };
+           std::array<std::atomic<std::uint64_t>, kLatencyBuckets> buckets {};
+       };
+
+       struct alignas(64) ThreadCounters
+       {
+           std::array<std::atomic<std::uint64_t>, kEdgeCount> edges {};
+           std::array<HookCounters, kHookCount> hooks;
+           const ThreadCounters* next { nullptr };   // registry list, set once at add()
+       };
+
+       // Single writer: a relaxed load/store pair, no locked instruction
+       inline void bump(std::atomic<std::uint64_t>& counter, std::uint64_t by = 1)
+       {
+           counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+       }
+
+       // Blocks are never freed, so counts of finished threads stay in the totals.
+       // A push-only list: forEach() walks whatever was published when it started.
+       class Registry
+       {
+          public:
+              ThreadCounters& add()
+              {
+                  ThreadCounters* block = new ThreadCounters;
+                  const ThreadCounters* first = head.load(std::memory_order_relaxed);
+
+                  do
+                  {
+                      block->next = first;
+                  } while (!head.compare_exchange_weak(first, block, std::memory_order_release,
+                                                       std::memory_order_relaxed));
+
+                  return *block;
+              }
+
+              template <typename Fn>
+              void forEach(Fn&& fn) const
+              {
+                  for (const ThreadCounters* block = head.load(std::memory_order_acquire); block; block = block->next)
+                  {
+                      fn(*block);
+                  }
+              }
+
+          private:
+              std::atomic<const ThreadCounters*> head { nullptr };
+       };
+
+       inline Registry& registry()
+       {
+           static Registry instance;
+           return instance;
+       }
+
+       inline ThreadCounters& local()
+       {
+           thread_local ThreadCounters& block = registry().add();
+           return block;
+       }
+
+       // ----- Recording (called by SafetyRules when compiled in)
+       inline void countEdge(Config from, Trigger trigger)
+       {
+           bump(local().edges[from * kRowWidth + static_cast<std::size_t>(trigger)]);
+       }
+
+       inline void recordHook(Hook hook, std::uint64_t ns)
+       {
+           HookCounters& h = local().hooks[static_cast<std::size_t>(hook)];
+
+           bump(h.count);
+           bump(h.totalNs, ns);
+           bump(h.buckets[bucketOf(ns)]);
+
+           if (ns > h.maxNs.load(std::memory_order_relaxed))
+           {
+               h.maxNs.store(ns, std::memory_order_relaxed);
+           }
+       }
+
+       inline std::uint64_t nowNs()
+       {
+           return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count());
+       }
+
+       // ----- Snapshot: sums over all threads, taken while dispatch continues
+       struct HookLatency
+       {
+           std::uint64_t count;
+           std::uint64_t totalNs;
+           std::uint64_t maxNs;
+           std::array<std::uint64_t, kLatencyBuckets> buckets;
+
+           // Upper bound of the bucket holding the q-quantile (0 < q <= 1)
+           std::uint64_t quantileNs(double q) const
+           {
+               const double target = q * static_cast<double>(count);
+               std::uint64_t seen = 0;
+
+               for (std::size_t b = 0; b < kLatencyBuckets; ++b)
+               {
+                   seen += buckets[b];
+
+                   if (seen > 0 && static_cast<double>(seen) >= target)
+                   {
+                       return bucketLimit(b);
+                   }
+               }
+
+               return maxNs;
+           }
+       };
+
+       struct Snapshot
+       {
+           std::array<std::uint64_t, kEdgeCount> edges;
+           std::array<HookLatency, kHookCount>   hooks;
+
+           // Times trigger was delivered in configuration from (ignored ones included);
+           // the edge's target is lookup(from, trigger).next
+           std::uint64_t edge(Config from, Trigger trigger) const
+           {
+               return edges[from * kRowWidth + static_cast<std::size_t>(trigger)];
+           }
+
+           const HookLatency& hook(Hook h) const
+           {
+               return hooks[static_cast<std::size_t>(h)];
+           }
+       };
+
+       inline Snapshot snapshot()
+       {
+           Snapshot s {};
+
+           registry().forEach([&s](const ThreadCounters& block) {
+               for (std::size_t e = 0; e < kEdgeCount; ++e)
+               {
+                   s.edges[e] += block.edges[e].load(std::memory_order_relaxed);
+               }
+
+               for (std::size_t h = 0; h < kHookCount; ++h)
+               {
+                   const HookCounters& from = block.hooks[h];
+                   HookLatency& to = s.hooks[h];
+
+                   to.count   += from.count.load(std::memory_order_relaxed);
+                   to.totalNs += from.totalNs.load(std::memory_order_relaxed);
+
+                   const std::uint64_t max = from.maxNs.load(std::memory_order_relaxed);
+                   to.maxNs = max > to.maxNs ? max : to.maxNs;
+
+                   for (std::size_t b = 0; b < kLatencyBuckets; ++b)
+                   {
+                       to.buckets[b] += from.buckets[b].load(std::memory_order_relaxed);
+                   }
+               }
+           });
+
+           return s;
+       }
+
+   } // namespace instrumentation
+
+} // namespace safety
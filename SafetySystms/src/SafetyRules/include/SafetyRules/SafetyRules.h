@@ -1,6 +1,17 @@
 #pragma once
+#include "SafetyRules/BasicSafetyRules.h"
 #include "SafetyRules/ISafetyRules.h"
-#include <cassert>
+#include "SafetyRules/SafetyTable.h"
+#include <array>
+#include <cstddef>
+
+#ifndef SAFETY_INSTRUMENTATION
+#define SAFETY_INSTRUMENTATION 0
+#endif
+
+#if SAFETY_INSTRUMENTATION
+#include "SafetyRules/Instrumentation.h"
+#endif
 
 namespace safety 
 {
@@ -9,291 +20,192 @@ namespace safety
    using TopState = ISafetyRules::State;
    using LoaderSubstate = ISafetyRules::LoaderSub;
 
-   class SafetyRules final : public ISafetyRules
+   // ----- Hooks policy behind SafetyRules: one Delegate per hook plus a few step observers
+   class DelegateHooks
    {
       public:
-          // ----- Construction
-          SafetyRules()
+          using VoidFn = ISafetyRules::VoidFn;
+          using StepFn = Delegate<void(Trigger trigger, Config result)>;
+
+          // Journal, deadline supervision, snapshot and one more
+          static constexpr std::size_t kStepObservers = 4;
+
+          VoidFn& slot(Hook h)
           {
-              reset();
+              return hooks[static_cast<std::size_t>(h)];
           }
-      
-          // ----- ISafetyRules (control)
-          void reset() override
+
+          void fire(Hook h)
           {
-              current = State::Idle;
-              loader = LoaderSub::None;
+              const VoidFn& fn = hooks[static_cast<std::size_t>(h)];
       
-              if (onEnterIdle)
+#if SAFETY_INSTRUMENTATION
+              if (fn)
               {
-                  onEnterIdle();
+                  const std::uint64_t start = instrumentation::nowNs();
+                  fn();
+                  instrumentation::recordHook(h, instrumentation::nowNs() - start);
               }
+#else
+              if (fn) fn();
+#endif
           }
-      
-          void dispatch(Event ev) override
+
+          void stepped(Trigger trigger, Config result)
           {
-              switch (current)
+              for (const StepFn& fn : observers)
               {
-                  case State::Idle:
-                  {
-                      if (ev == Event::evPowerOn)
-                      {
-                          transitionTo(State::Active);
-                      }
-      
-                      break;
-                  }
-      
-                  case State::Active:
-                  {
-                      if (ev == Event::evPowerOff)
-                      {
-                          transitionTo(State::Idle);
-                      }
-      
-                      else if (ev == Event::evFault)
-                      {
-                          transitionTo(State::Faulted);
-                      }
-      
-                      break;
-                  }
-      
-                  case State::Faulted:
-                  {
-                      if (ev == Event::evPowerOn)
-                      {
-                          transitionTo(State::Active);
-                      }
-      
-                      break;
-                  }
-      
-                  case State::BuildPlateLoader:
+                  if (!fn) break;
+                  fn(trigger, result);
+              }
+          }
+
+          // False when every observer slot is taken
+          bool addObserver(StepFn cb)
+          {
+              for (StepFn& fn : observers)
+              {
+                  if (!fn)
                   {
-                      // Fault escape from any substate
-                      if (ev == Event::evFault)
-                      {
-                          exitLoaderSubmachine();
-                          transitionTo(State::Faulted);
-                          break;
-                      }
-      
-                      switch (loader)
-                      {
-                          case LoaderSub::OpenDoor:
-                          {
-                              if (ev == Event::evDoorOpened)
-                              {
-                                  enterLoaderSub(LoaderSub::DoorOpened);
-                              }
-      
-                              break;
-                          }
-      
-                          case LoaderSub::DoorOpened:
-                          {
-                              if (ev == Event::evBuildPlateLoaded)
-                              {
-                                  enterLoaderSub(LoaderSub::BuildPlateLoaded);
-                              }
-      
-                              break;
-                          }
-      
-                          case LoaderSub::BuildPlateLoaded:
-                          {
-                              if (ev == Event::evDoorClosed)
-                              {
-                                  // Completion of submachine -> Active
-                                  exitLoaderSubmachine();
-                                  transitionTo(State::Active);
-                              }
-      
-                              break;
-                          }
-      
-                          case LoaderSub::None:
-                          default:
-                          {
-                              assert(false && "Invalid loader substate in BuildPlateLoader");
-                              break;
-                          }
-                      }
-      
-                      break;
+                      fn = cb;
+                      return true;
                   }
               }
+
+              return false;
           }
-      
-          void startLoader() override
+
+          // Keeps the remaining observers packed at the front, in the order added
+          void removeObserver(StepFn cb)
           {
-              if (current != State::Active)
+              std::size_t kept = 0;
+
+              for (const StepFn& fn : observers)
+              {
+                  if (fn && fn != cb)
+                  {
+                      observers[kept++] = fn;
+                  }
+              }
+
+              while (kept < kStepObservers)
               {
-                  return; // ignore unless in Active
+                  observers[kept++] = nullptr;
               }
+          }
+
+      private:
+          // Entry/exit hooks and substate entry actions, indexed by Hook
+          std::array<VoidFn, kHookCount> hooks;
+
+          // Step observers, packed at the front; the first empty slot ends the list
+          std::array<StepFn, kStepObservers> observers;
+   };
+
+   // ISafetyRules adapter over BasicSafetyRules<DelegateHooks, kDeferredEvents>.
+   //
+   // Run to completion: a hook may call dispatch(), startLoader() or reset() on the
+   // machine that fired it (a simulator answering RequestDoorOpen with evDoorOpened);
+   // the call is queued and handled after the current step, never nested inside it.
+   class SafetyRules final : public ISafetyRules
+   {
+      public:
+          // Triggers a hook chain may queue before the current step completes
+          static constexpr std::size_t kDeferredEvents = 4;
+
+          // ----- ISafetyRules (control)
+          void reset() override
+          {
+              core.reset();
+          }
       
-              transitionTo(State::BuildPlateLoader);
+          void dispatch(Event ev) override
+          {
+              core.dispatch(ev);
+          }
       
-              // Submachine initial: [*] -> OpenDoor
-              enterLoaderSub(LoaderSub::OpenDoor);
+          void startLoader() override
+          {
+              core.startLoader();
+          }
+
+          // Checkpoint restore: no hooks, no step observer (see BasicSafetyRules)
+          void restore(Config saved)
+          {
+              core.restore(saved);
           }
       
           // ----- ISafetyRules (observability)
           State getState() const override
           {
-              return current;
+              return core.getState();
           }
       
           LoaderSub getLoaderSubstate() const override
           {
-              return loader;
+              return core.getLoaderSubstate();
           }
       
           // ----- ISafetyRules (callback setters)
-          void setOnEnterIdle(VoidFn cb) override                 { onEnterIdle = std::move(cb); }
-          void setOnExitIdle(VoidFn cb) override                  { onExitIdle = std::move(cb); }
+          void setOnEnterIdle(VoidFn cb) override                 { slot(Hook::EnterIdle) = std::move(cb); }
+          void setOnExitIdle(VoidFn cb) override                  { slot(Hook::ExitIdle) = std::move(cb); }
       
-          void setOnEnterActive(VoidFn cb) override               { onEnterActive = std::move(cb); }
-          void setOnExitActive(VoidFn cb) override                { onExitActive = std::move(cb); }
+          void setOnEnterActive(VoidFn cb) override               { slot(Hook::EnterActive) = std::move(cb); }
+          void setOnExitActive(VoidFn cb) override                { slot(Hook::ExitActive) = std::move(cb); }
       
-          void setOnEnterFaulted(VoidFn cb) override              { onEnterFaulted = std::move(cb); }
-          void setOnExitFaulted(VoidFn cb) override               { onExitFaulted = std::move(cb); }
+          void setOnEnterFaulted(VoidFn cb) override              { slot(Hook::EnterFaulted) = std::move(cb); }
+          void setOnExitFaulted(VoidFn cb) override               { slot(Hook::ExitFaulted) = std::move(cb); }
       
-          void setOnEnterBuildPlateLoader(VoidFn cb) override     { onEnterBuildPlateLoader = std::move(cb); }
-          void setOnExitBuildPlateLoader(VoidFn cb) override      { onExitBuildPlateLoader = std::move(cb); }
+          void setOnEnterBuildPlateLoader(VoidFn cb) override     { slot(Hook::EnterBuildPlateLoader) = std::move(cb); }
+          void setOnExitBuildPlateLoader(VoidFn cb) override      { slot(Hook::ExitBuildPlateLoader) = std::move(cb); }
       
-          void setOnRequestDoorOpen(VoidFn cb) override           { onRequestDoorOpen = std::move(cb); }
-          void setOnRequestLoadBuildPlate(VoidFn cb) override     { onRequestLoadBuildPlate = std::move(cb); }
-          void setOnRequestDoorClose(VoidFn cb) override          { onRequestDoorClose = std::move(cb); }
+          void setOnRequestDoorOpen(VoidFn cb) override           { slot(Hook::RequestDoorOpen) = std::move(cb); }
+          void setOnRequestLoadBuildPlate(VoidFn cb) override     { slot(Hook::RequestLoadBuildPlate) = std::move(cb); }
+          void setOnRequestDoorClose(VoidFn cb) override          { slot(Hook::RequestDoorClose) = std::move(cb); }
       
-      private:
-          // ----- Top-level transitions with entry/exit hooks
-          void transitionTo(State next)
+          // ----- Step observers (not part of ISafetyRules): called after every reset,
+          //       dispatch and startLoader, ignored ones included, with the resulting
+          //       configuration, in the order they were added. Up to kStepObservers, so
+          //       a journal, deadline supervision and a snapshot can watch one machine.
+          using StepFn = DelegateHooks::StepFn;
+
+          static constexpr std::size_t kStepObservers = DelegateHooks::kStepObservers;
+
+          // False (and nothing added) when all kStepObservers slots are taken
+          bool addOnStep(StepFn cb)
           {
-              if (next == current)
-              {
-                  return;
-              }
-      
-              // Exit old top-level state
-              switch (current)
-              {
-                  case State::Idle:
-                  {
-                      if (onExitIdle) onExitIdle();
-                      break;
-                  }
-      
-                  case State::Active:
-                  {
-                      if (onExitActive) onExitActive();
-                      break;
-                  }
-      
-                  case State::Faulted:
-                  {
-                      if (onExitFaulted) onExitFaulted();
-                      break;
-                  }
-      
-                  case State::BuildPlateLoader:
-                  {
-                      if (onExitBuildPlateLoader) onExitBuildPlateLoader();
-                      break;
-                  }
-              }
-      
-              current = next;
-      
-              // Enter new top-level state
-              switch (current)
-              {
-                  case State::Idle:
-                  {
-                      if (onEnterIdle) onEnterIdle();
-                      break;
-                  }
-      
-                  case State::Active:
-                  {
-                      if (onEnterActive) onEnterActive();
-                      break;
-                  }
-      
-                  case State::Faulted:
-                  {
-                      if (onEnterFaulted) onEnterFaulted();
-                      break;
-                  }
-      
-                  case State::BuildPlateLoader:
-                  {
-                      if (onEnterBuildPlateLoader) onEnterBuildPlateLoader();
-                      break;
-                  }
-              }
+              return core.hooks().addObserver(cb);
           }
-      
-          // ----- Submachine helpers
-          void enterLoaderSub(LoaderSub sub)
+
+          // Removes cb (compared by target); the others keep their order
+          void removeOnStep(StepFn cb)
           {
-              loader = sub;
-      
-              switch (loader)
-              {
-                  case LoaderSub::OpenDoor:
-                  {
-                      if (onRequestDoorOpen) onRequestDoorOpen(); // entry action
-                      break;
-                  }
-      
-                  case LoaderSub::DoorOpened:
-                  {
-                      if (onRequestLoadBuildPlate) onRequestLoadBuildPlate(); // entry action
-                      break;
-                  }
-      
-                  case LoaderSub::BuildPlateLoaded:
-                  {
-                      if (onRequestDoorClose) onRequestDoorClose(); // entry action
-                      break;
-                  }
-      
-                  // Dead Code 
-                  case LoaderSub::None:
-                  default:
-                      break;
-              }
+              core.hooks().removeObserver(cb);
           }
-      
-          void exitLoaderSubmachine()
+
+          // Hook slot by id, for code that wraps the installed hooks (LatencyTracer)
+          VoidFn& slot(Hook h)
+          {
+              return core.hooks().slot(h);
+          }
+
+          // Triggers that do something in the current configuration; a clear bit
+          // means dispatching that trigger now is a no-op (see kAccepted)
+          TriggerMask acceptedTriggers() const
           {
-              loader = LoaderSub::None;
+              return core.acceptedTriggers();
+          }
+
+          // True when a trigger from a hook found the deferred queue full and was
+          // dropped; cleared by reset()
+          bool deferredOverflow() const
+          {
+              return core.deferredOverflow();
           }
       
       private:
           // ----- Data
-          State     current { State::Idle };
-          LoaderSub loader  { LoaderSub::None };
-      
-          // Entry/exit hooks
-          VoidFn onEnterIdle;
-          VoidFn onExitIdle;
-      
-          VoidFn onEnterActive;
-          VoidFn onExitActive;
-      
-          VoidFn onEnterFaulted;
-          VoidFn onExitFaulted;
-      
-          VoidFn onEnterBuildPlateLoader;
-          VoidFn onExitBuildPlateLoader;
-      
-          // Substate entry actions
-          VoidFn onRequestDoorOpen;
-          VoidFn onRequestLoadBuildPlate;
-          VoidFn onRequestDoorClose;
+          BasicSafetyRules<DelegateHooks, kDeferredEvents> core;
    };
  
 } // namespace safety
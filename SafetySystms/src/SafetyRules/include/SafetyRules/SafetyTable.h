@@ -0,0 +1,330 @@
+#pragma once
+#include "SafetyRules/ISafetyRules.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace safety
+{
+
+   // ----- Hooks a transition may fire (index into the callback slots)
+   enum class Hook : std::uint8_t
+   {
+       EnterIdle,
+       ExitIdle,
+       EnterActive,
+       ExitActive,
+       EnterFaulted,
+       ExitFaulted,
+       EnterBuildPlateLoader,
+       ExitBuildPlateLoader,
+       RequestDoorOpen,        // OpenDoor : entry / requestDoorOpen()
+       RequestLoadBuildPlate,  // DoorOpened : entry / requestLoadBuildPlate()
+       RequestDoorClose,       // BuildPlateLoaded : entry / requestDoorClose()
+       None
+   };
+
+   constexpr std::size_t kHookCount = static_cast<std::size_t>(Hook::None);
+
+   // ----- Everything that drives the machine: the Events plus startLoader()
+   enum class Trigger : std::uint8_t
+   {
+       evPowerOn,
+       evPowerOff,
+       evFault,
+       evDoorOpened,
+       evBuildPlateLoaded,
+       evDoorClosed,
+       StartLoader,
+       Reset           // reported to step observers only; not a table column
+   };
+
+   constexpr std::size_t kEventCount   = 6;
+   constexpr std::size_t kTriggerCount = 7;
+   constexpr std::size_t kRowWidth     = 8;  // triggers padded to a power of two
+
+   // ----- Names for traces, reports and tools; "?" for a value outside the enum
+   constexpr const char* name(Trigger trigger)
+   {
+       switch (trigger)
+       {
+           case Trigger::evPowerOn:          return "evPowerOn";
+           case Trigger::evPowerOff:         return "evPowerOff";
+           case Trigger::evFault:            return "evFault";
+           case Trigger::evDoorOpened:       return "evDoorOpened";
+           case Trigger::evBuildPlateLoaded: return "evBuildPlateLoaded";
+           case Trigger::evDoorClosed:       return "evDoorClosed";
+           case Trigger::StartLoader:        return "startLoader";
+           case Trigger::Reset:              return "reset";
+       }
+
+       return "?";
+   }
+
+   constexpr const char* name(Hook hook)
+   {
+       switch (hook)
+       {
+           case Hook::EnterIdle:             return "EnterIdle";
+           case Hook::ExitIdle:              return "ExitIdle";
+           case Hook::EnterActive:           return "EnterActive";
+           case Hook::ExitActive:            return "ExitActive";
+           case Hook::EnterFaulted:          return "EnterFaulted";
+           case Hook::ExitFaulted:           return "ExitFaulted";
+           case Hook::EnterBuildPlateLoader: return "EnterBuildPlateLoader";
+           case Hook::ExitBuildPlateLoader:  return "ExitBuildPlateLoader";
+           case Hook::RequestDoorOpen:       return "RequestDoorOpen";
+           case Hook::RequestLoadBuildPlate: return "RequestLoadBuildPlate";
+           case Hook::RequestDoorClose:      return "RequestDoorClose";
+           case Hook::None:                  return "None";
+       }
+
+       return "?";
+   }
+
+   constexpr const char* name(ISafetyRules::State state)
+   {
+       switch (state)
+       {
+           case ISafetyRules::State::Idle:             return "Idle";
+           case ISafetyRules::State::Active:           return "Active";
+           case ISafetyRules::State::Faulted:          return "Faulted";
+           case ISafetyRules::State::BuildPlateLoader: return "BuildPlateLoader";
+       }
+
+       return "?";
+   }
+
+   constexpr const char* name(ISafetyRules::LoaderSub sub)
+   {
+       switch (sub)
+       {
+           case ISafetyRules::LoaderSub::None:             return "None";
+           case ISafetyRules::LoaderSub::OpenDoor:         return "OpenDoor";
+           case ISafetyRules::LoaderSub::DoorOpened:       return "DoorOpened";
+           case ISafetyRules::LoaderSub::BuildPlateLoaded: return "BuildPlateLoaded";
+       }
+
+       return "?";
+   }
+
+   // ----- A configuration packs (State, LoaderSub) into one byte: state << 2 | substate.
+   //       Only 6 of the 16 encodings are reachable.
+   using Config = std::uint8_t;
+
+   constexpr std::size_t kConfigCount = 16;
+
+   constexpr Trigger toTrigger(ISafetyRules::Event ev)
+   {
+       return static_cast<Trigger>(ev);
+   }
+
+   constexpr Config toConfig(ISafetyRules::State state, ISafetyRules::LoaderSub sub)
+   {
+       return static_cast<Config>(static_cast<unsigned>(state) << 2 | static_cast<unsigned>(sub));
+   }
+
+   constexpr ISafetyRules::State stateOf(Config config)
+   {
+       return static_cast<ISafetyRules::State>(config >> 2);
+   }
+
+   constexpr ISafetyRules::LoaderSub subOf(Config config)
+   {
+       return static_cast<ISafetyRules::LoaderSub>(config & 3);
+   }
+
+   // Same top-level state, outside the loader submachine
+   constexpr Config topOf(Config config)
+   {
+       return static_cast<Config>(config & ~3u);
+   }
+
+   // ----- One cell of the table: target configuration and the hooks to fire.
+   //       A top-level change fires exit then enter; a substate entry fires action.
+   struct Transition
+   {
+       Config next;
+       Hook   exit;
+       Hook   enter;
+       Hook   action;
+   };
+
+   using TransitionRow   = std::array<Transition, kRowWidth>;
+   using TransitionTable = std::array<TransitionRow, kConfigCount>;
+
+   namespace detail
+   {
+       constexpr Hook exitHookOf(ISafetyRules::State state)
+       {
+           switch (state)
+           {
+               case ISafetyRules::State::Idle:             return Hook::ExitIdle;
+               case ISafetyRules::State::Active:           return Hook::ExitActive;
+               case ISafetyRules::State::Faulted:          return Hook::ExitFaulted;
+               case ISafetyRules::State::BuildPlateLoader: return Hook::ExitBuildPlateLoader;
+           }
+
+           return Hook::None;
+       }
+
+       constexpr Hook enterHookOf(ISafetyRules::State state)
+       {
+           switch (state)
+           {
+               case ISafetyRules::State::Idle:             return Hook::EnterIdle;
+               case ISafetyRules::State::Active:           return Hook::EnterActive;
+               case ISafetyRules::State::Faulted:          return Hook::EnterFaulted;
+               case ISafetyRules::State::BuildPlateLoader: return Hook::EnterBuildPlateLoader;
+           }
+
+           return Hook::None;
+       }
+
+       constexpr Hook entryActionOf(ISafetyRules::LoaderSub sub)
+       {
+           switch (sub)
+           {
+               case ISafetyRules::LoaderSub::OpenDoor:         return Hook::RequestDoorOpen;
+               case ISafetyRules::LoaderSub::DoorOpened:       return Hook::RequestLoadBuildPlate;
+               case ISafetyRules::LoaderSub::BuildPlateLoaded: return Hook::RequestDoorClose;
+               case ISafetyRules::LoaderSub::None:             break;
+           }
+
+           return Hook::None;
+       }
+
+       constexpr Transition stay(Config config)
+       {
+           return Transition { config, Hook::None, Hook::None, Hook::None };
+       }
+
+       constexpr Transition topLevel(ISafetyRules::State from, ISafetyRules::State to)
+       {
+           return Transition { toConfig(to, ISafetyRules::LoaderSub::None), exitHookOf(from), enterHookOf(to), Hook::None };
+       }
+
+       constexpr Transition loaderSub(ISafetyRules::LoaderSub to)
+       {
+           return Transition { toConfig(ISafetyRules::State::BuildPlateLoader, to), Hook::None, Hook::None, entryActionOf(to) };
+       }
+   }
+
+   // ----- The state chart as data (see doc/StartChart.plantuml)
+   constexpr TransitionTable makeTransitionTable()
+   {
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+
+       TransitionTable table {};
+
+       // Default: every trigger (and the padding column) is ignored in every configuration
+       for (std::size_t c = 0; c < kConfigCount; ++c)
+       {
+           for (std::size_t t = 0; t < kRowWidth; ++t)
+           {
+               table[c][t] = detail::stay(static_cast<Config>(c));
+           }
+       }
+
+       auto at = [&table](State s, Sub l, Trigger t) -> Transition&
+       {
+           return table[toConfig(s, l)][static_cast<std::size_t>(t)];
+       };
+
+       // Idle -> Active, Active -> Idle / Faulted, Faulted -> Active
+       at(State::Idle,    Sub::None, Trigger::evPowerOn)  = detail::topLevel(State::Idle, State::Active);
+       at(State::Active,  Sub::None, Trigger::evPowerOff) = detail::topLevel(State::Active, State::Idle);
+       at(State::Active,  Sub::None, Trigger::evFault)    = detail::topLevel(State::Active, State::Faulted);
+       at(State::Faulted, Sub::None, Trigger::evPowerOn)  = detail::topLevel(State::Faulted, State::Active);
+
+       // Active -> BuildPlateLoader, submachine initial [*] -> OpenDoor
+       {
+           Transition& start = at(State::Active, Sub::None, Trigger::StartLoader);
+           start = detail::topLevel(State::Active, State::BuildPlateLoader);
+           start.next = toConfig(State::BuildPlateLoader, Sub::OpenDoor);
+           start.action = Hook::RequestDoorOpen;
+       }
+
+       // Fault escape from any substate
+       for (Sub l : { Sub::OpenDoor, Sub::DoorOpened, Sub::BuildPlateLoaded })
+       {
+           at(State::BuildPlateLoader, l, Trigger::evFault) = detail::topLevel(State::BuildPlateLoader, State::Faulted);
+       }
+
+       // Loader chain and completion of the submachine -> Active
+       at(State::BuildPlateLoader, Sub::OpenDoor,         Trigger::evDoorOpened)       = detail::loaderSub(Sub::DoorOpened);
+       at(State::BuildPlateLoader, Sub::DoorOpened,       Trigger::evBuildPlateLoaded) = detail::loaderSub(Sub::BuildPlateLoaded);
+       at(State::BuildPlateLoader, Sub::BuildPlateLoaded, Trigger::evDoorClosed)       = detail::topLevel(State::BuildPlateLoader, State::Active);
+
+       return table;
+   }
+
+   inline constexpr TransitionTable kTransitions = makeTransitionTable();
+
+   constexpr const Transition& lookup(Config config, Trigger trigger)
+   {
+       return kTransitions[config][static_cast<std::size_t>(trigger)];
+   }
+
+   // ----- Accepted triggers per configuration: bit t of kAccepted[c] is set when
+   //       trigger t does anything in c (moves it or fires a hook). A trigger whose bit
+   //       is clear is a no-op there, so a producer that knows the configuration can
+   //       drop it before it costs a queue slot or a dispatch.
+   using TriggerMask = std::uint8_t;
+
+   constexpr TriggerMask triggerBit(Trigger trigger)
+   {
+       return static_cast<TriggerMask>(1u << static_cast<unsigned>(trigger));
+   }
+
+   constexpr std::array<TriggerMask, kConfigCount> makeAcceptedMasks()
+   {
+       std::array<TriggerMask, kConfigCount> masks {};
+
+       for (std::size_t c = 0; c < kConfigCount; ++c)
+       {
+           for (std::size_t t = 0; t < kTriggerCount; ++t)
+           {
+               const Transition& cell = kTransitions[c][t];
+
+               if (cell.next != c || cell.exit != Hook::None || cell.enter != Hook::None || cell.action != Hook::None)
+               {
+                   masks[c] |= triggerBit(static_cast<Trigger>(t));
+               }
+           }
+       }
+
+       return masks;
+   }
+
+   inline constexpr std::array<TriggerMask, kConfigCount> kAccepted = makeAcceptedMasks();
+
+   constexpr bool accepts(Config config, Trigger trigger)
+   {
+       return (kAccepted[config] & triggerBit(trigger)) != 0;
+   }
+
+   // One of the six configurations a SafetyRules can be in: exactly those accept
+   // some trigger, the other ten encodings none
+   constexpr bool isReachable(Config config)
+   {
+       return config < kConfigCount && kAccepted[config] != 0;
+   }
+
+   static_assert(sizeof(Transition) == 4, "Transition must stay one 32-bit word");
+   static_assert(sizeof(TransitionRow) == 32, "Two rows per cache line");
+   static_assert(stateOf(lookup(toConfig(ISafetyRules::State::Idle, ISafetyRules::LoaderSub::None), Trigger::evPowerOn).next)
+                 == ISafetyRules::State::Active, "Idle -> Active on evPowerOn");
+   static_assert(lookup(toConfig(ISafetyRules::State::Idle, ISafetyRules::LoaderSub::None), Trigger::evFault).exit
+                 == Hook::None, "Idle ignores evFault");
+   static_assert(stateOf(lookup(toConfig(ISafetyRules::State::BuildPlateLoader, ISafetyRules::LoaderSub::DoorOpened), Trigger::evFault).next)
+                 == ISafetyRules::State::Faulted, "Fault escapes the loader submachine");
+   static_assert(kAccepted[toConfig(ISafetyRules::State::Idle, ISafetyRules::LoaderSub::None)] == triggerBit(Trigger::evPowerOn)
+                 && kAccepted[toConfig(ISafetyRules::State::Faulted, ISafetyRules::LoaderSub::None)] == triggerBit(Trigger::evPowerOn),
+                 "Idle and Faulted accept only evPowerOn");
+   static_assert(!isReachable(toConfig(ISafetyRules::State::BuildPlateLoader, ISafetyRules::LoaderSub::None))
+                 && isReachable(toConfig(ISafetyRules::State::BuildPlateLoader, ISafetyRules::LoaderSub::OpenDoor)),
+                 "The loader is never without a substate");
+
+} // namespace safety
@@ -0,0 +1,47 @@
+#pragma once
+#include "SafetyRules/ISafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include <array>
+#include <cstddef>
+
+namespace safety
+{
+
+   // Bulk "fast-forward" of one machine through a long recorded trigger stream.
+   //
+   // A machine has only a handful of configurations, so the effect of any trigger
+   // sequence is a map Config -> Config, and such maps compose associatively. The
+   // stream is cut into one chunk per thread; each thread computes its chunk's map
+   // (following every reachable start configuration at once until they merge,
+   // which for real streams happens within a few triggers), the maps are chained
+   // from the start configuration, and, if a trace is requested, each chunk is
+   // re-walked in parallel from its now known start.
+   //
+   // No hooks fire. The result matches SafetyRules stepped sequentially with the
+   // same triggers exactly; Trigger::Reset behaves like SafetyRules::reset().
+
+   // ----- Effect of a trigger sequence on every configuration
+   using ConfigMap = std::array<Config, kConfigCount>;
+
+   // Maps each configuration to itself
+   ConfigMap identityMap();
+
+   // Effect of running first, then then
+   ConfigMap compose(const ConfigMap& first, const ConfigMap& then);
+
+   // Effect of triggers[0..count); unreachable configurations map to themselves
+   ConfigMap effectOf(const Trigger* triggers, std::size_t count);
+
+   // ----- Fast-forward
+   //
+   // Returns the configuration after all triggers, starting from start (which must
+   // be reachable). If trace is not null, trace[i] receives the configuration after
+   // triggers[i]. threads == 0 uses every hardware thread; short streams run on the
+   // calling thread regardless.
+   Config fastForward(Config start, const Trigger* triggers, std::size_t count,
+                      Config* trace = nullptr, unsigned threads = 0);
+
+   Config fastForward(Config start, const ISafetyRules::Event* events, std::size_t count,
+                      Config* trace = nullptr, unsigned threads = 0);
+
+} // namespace safety
@@ -0,0 +1,272 @@
+#include "SafetyScan/SafetyScan.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace safety
+{
+
+   namespace
+   {
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+
+       // Chunks shorter than this are not worth a thread
+       constexpr std::size_t kMinChunk = std::size_t(1) << 16;
+
+       // ----- Next configuration only, with the padding column used for Reset
+       using NextTable = std::array<std::array<Config, kRowWidth>, kConfigCount>;
+
+       static_assert(static_cast<std::size_t>(Trigger::Reset) < kRowWidth, "Reset must fit in the padding column");
+
+       constexpr NextTable makeNextTable()
+       {
+           NextTable table {};
+
+           for (std::size_t c = 0; c < kConfigCount; ++c)
+           {
+               for (std::size_t t = 0; t < kRowWidth; ++t)
+               {
+                   table[c][t] = kTransitions[c][t].next;
+               }
+
+               table[c][static_cast<std::size_t>(Trigger::Reset)] = toConfig(State::Idle, Sub::None);
+           }
+
+           return table;
+       }
+
+       constexpr NextTable kNext = makeNextTable();
+
+       constexpr Config kReachable[] = {
+           toConfig(State::Idle, Sub::None),
+           toConfig(State::Active, Sub::None),
+           toConfig(State::Faulted, Sub::None),
+           toConfig(State::BuildPlateLoader, Sub::OpenDoor),
+           toConfig(State::BuildPlateLoader, Sub::DoorOpened),
+           toConfig(State::BuildPlateLoader, Sub::BuildPlateLoaded),
+       };
+
+       constexpr std::size_t kReachableCount = sizeof(kReachable) / sizeof(kReachable[0]);
+
+       template <typename T>
+       std::size_t column(T trigger)
+       {
+           return static_cast<std::size_t>(trigger);
+       }
+
+       // Follows every reachable configuration through the sequence at once, merging
+       // paths that meet; once a single path is left the walk is plain table lookups.
+       template <typename T>
+       ConfigMap effectOfImpl(const T* triggers, std::size_t count)
+       {
+           Config        current[kReachableCount];
+           std::uint8_t  pathOf[kReachableCount];   // start index -> index into current
+           std::size_t   paths = kReachableCount;
+           std::size_t   i     = 0;
+
+           for (std::size_t k = 0; k < kReachableCount; ++k)
+           {
+               current[k] = kReachable[k];
+               pathOf[k]  = static_cast<std::uint8_t>(k);
+           }
+
+           while (paths > 1 && i < count)
+           {
+               const std::size_t t = column(triggers[i++]);
+
+               std::int8_t  slot[kConfigCount];
+               std::uint8_t merged[kReachableCount];
+               std::size_t  kept = 0;
+
+               std::fill(std::begin(slot), std::end(slot), std::int8_t(-1));
+
+               for (std::size_t k = 0; k < paths; ++k)
+               {
+                   const Config next = kNext[current[k]][t];
+
+                   if (slot[next] < 0)
+                   {
+                       slot[next]      = static_cast<std::int8_t>(kept);
+                       current[kept++] = next;
+                   }
+
+                   merged[k] = static_cast<std::uint8_t>(slot[next]);
+               }
+
+               if (kept < paths)
+               {
+                   for (auto& p : pathOf)
+                   {
+                       p = merged[p];
+                   }
+
+                   paths = kept;
+               }
+           }
+
+           Config last = current[0];
+
+           for (; i < count; ++i)
+           {
+               last = kNext[last][column(triggers[i])];
+           }
+
+           if (paths == 1)
+           {
+               current[0] = last;
+           }
+
+           ConfigMap map = identityMap();
+
+           for (std::size_t k = 0; k < kReachableCount; ++k)
+           {
+               map[kReachable[k]] = current[pathOf[k]];
+           }
+
+           return map;
+       }
+
+       template <typename T>
+       Config walk(Config config, const T* triggers, std::size_t count, Config* trace)
+       {
+           if (trace)
+           {
+               for (std::size_t i = 0; i < count; ++i)
+               {
+                   config   = kNext[config][column(triggers[i])];
+                   trace[i] = config;
+               }
+           }
+           else
+           {
+               for (std::size_t i = 0; i < count; ++i)
+               {
+                   config = kNext[config][column(triggers[i])];
+               }
+           }
+
+           return config;
+       }
+
+       template <typename T>
+       Config fastForwardImpl(Config start, const T* triggers, std::size_t count, Config* trace, unsigned threads)
+       {
+           assert(isReachable(start) && "fastForward from an invalid configuration");
+
+           if (threads == 0)
+           {
+               threads = std::max(1u, std::thread::hardware_concurrency());
+           }
+
+           const std::size_t chunks = std::min<std::size_t>(threads, count / kMinChunk);
+
+           if (chunks <= 1)
+           {
+               return walk(start, triggers, count, trace);
+           }
+
+           auto beginOf = [count, chunks](std::size_t c) { return count * c / chunks; };
+
+           auto inParallel = [chunks](auto&& body)
+           {
+               std::vector<std::thread> workers;
+               workers.reserve(chunks - 1);
+
+               for (std::size_t c = 1; c < chunks; ++c)
+               {
+                   workers.emplace_back(body, c);
+               }
+
+               body(0);
+
+               for (auto& w : workers)
+               {
+                   w.join();
+               }
+           };
+
+           // 1. Effect of every chunk but the last, whose start is all that is needed of it
+           std::vector<ConfigMap> effects(chunks - 1);
+
+           inParallel([&](std::size_t c) {
+               if (c + 1 < chunks)
+               {
+                   effects[c] = effectOfImpl(triggers + beginOf(c), beginOf(c + 1) - beginOf(c));
+               }
+           });
+
+           // 2. Chain the effects into each chunk's start configuration
+           std::vector<Config> starts(chunks);
+           starts[0] = start;
+
+           for (std::size_t c = 1; c < chunks; ++c)
+           {
+               starts[c] = effects[c - 1][starts[c - 1]];
+           }
+
+           // 3. Without a trace only the last chunk is walked; with one, all of them
+           if (!trace)
+           {
+               const std::size_t b = beginOf(chunks - 1);
+               return walk(starts[chunks - 1], triggers + b, count - b, nullptr);
+           }
+
+           std::vector<Config> ends(chunks);
+
+           inParallel([&](std::size_t c) {
+               const std::size_t b = beginOf(c);
+               ends[c] = walk(starts[c], triggers + b, beginOf(c + 1) - b, trace + b);
+           });
+
+           return ends[chunks - 1];
+       }
+   }
+
+   // ----- Maps
+
+   ConfigMap identityMap()
+   {
+       ConfigMap map {};
+
+       for (std::size_t c = 0; c < kConfigCount; ++c)
+       {
+           map[c] = static_cast<Config>(c);
+       }
+
+       return map;
+   }
+
+   ConfigMap compose(const ConfigMap& first, const ConfigMap& then)
+   {
+       ConfigMap map {};
+
+       for (std::size_t c = 0; c < kConfigCount; ++c)
+       {
+           map[c] = then[first[c]];
+       }
+
+       return map;
+   }
+
+   ConfigMap effectOf(const Trigger* triggers, std::size_t count)
+   {
+       return effectOfImpl(triggers, count);
+   }
+
+   // ----- Fast-forward
+
+   Config fastForward(Config start, const Trigger* triggers, std::size_t count, Config* trace, unsigned threads)
+   {
+       return fastForwardImpl(start, triggers, count, trace, threads);
+   }
+
+   Config fastForward(Config start, const ISafetyRules::Event* events, std::size_t count, Config* trace, unsigned threads)
+   {
+       return fastForwardImpl(start, events, count, trace, threads);
+   }
+
+} // namespace safety
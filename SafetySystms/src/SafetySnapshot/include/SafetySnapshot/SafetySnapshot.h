@@ -0,0 +1,117 @@
+#pragma once
+#include "SafetyRules/SafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace safety
+{
+
+   // ----- What readers get: one consistent view of the machine
+   struct Snapshot
+   {
+       ISafetyRules::State     state;
+       ISafetyRules::LoaderSub sub;
+       Config                  config;
+       Trigger                 trigger;       // the trigger of the last transition
+       std::uint64_t           transitions;   // transitions published so far (reset included)
+       std::uint64_t           timestampNs;   // CLOCK_MONOTONIC at the last transition
+   };
+
+   // ----- Published layout, identical in process and in shared memory
+   //
+   // A seqlock: the writer makes sequence odd, stores the payload and makes it even
+   // again. A reader that sees the same even sequence before and after copying the
+   // payload has a consistent copy; otherwise it overlapped a publish and retries.
+   // Payload words are relaxed atomics so the copy is race-free by the language rules.
+   struct SnapshotBlock
+   {
+       char                                        magic[8];   // "SFSNAP01"
+       std::uint32_t                               version;
+       std::uint32_t                               blockSize;
+       std::uint8_t                                padding[48];
+
+       alignas(64) std::atomic<std::uint64_t>      sequence;
+       std::atomic<std::uint64_t>                  transitions;
+       std::atomic<std::uint64_t>                  timestampNs;
+       std::atomic<std::uint64_t>                  step;        // trigger << 8 | config
+   };
+
+   static_assert(sizeof(SnapshotBlock) == 128, "Snapshot block is two cache lines");
+   static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Snapshot words must be lock-free to be shared");
+
+   // ----- Writer: publishes every transition of one machine
+   //
+   // publish() is called on the thread that dispatches (a SafetyDispatcher thread,
+   // say) and never waits for readers: two counter increments and four stores.
+   // Ignored triggers, which leave the configuration alone, publish nothing.
+   class SafetySnapshot
+   {
+      public:
+          // In-process snapshot
+          SafetySnapshot();
+
+          // Snapshot in POSIX shared memory object name ("/printer-7"), created or
+          // truncated and unlinked again by the destructor; throws std::system_error
+          explicit SafetySnapshot(const std::string& name);
+          ~SafetySnapshot();
+
+          SafetySnapshot(const SafetySnapshot&) = delete;
+          SafetySnapshot& operator=(const SafetySnapshot&) = delete;
+
+          // Publishes every step of rules from now on (adds a step observer; throws
+          // std::runtime_error if the machine has none left) and the configuration
+          // it is in right now
+          void attach(SafetyRules& rules);
+          void detach(SafetyRules& rules);
+
+          // Step observer body, for callers that chain observers themselves
+          void publish(Trigger trigger, Config result);
+          void publish(Trigger trigger, Config result, std::uint64_t timestampNs);
+
+          const SnapshotBlock& block() const
+          {
+              return *shared;
+          }
+
+      private:
+          static void record(void* self, Trigger trigger, Config result);
+
+      private:
+          SnapshotBlock* shared { nullptr };
+          std::string    name;                 // empty when in process
+          std::uint64_t  transitions { 0 };    // writer's copies, never read back
+          Config         last { 0xFF };
+   };
+
+   // ----- Reader: any thread, any number of them, or another process
+   class SnapshotReader
+   {
+      public:
+          explicit SnapshotReader(const SafetySnapshot& snapshot);
+
+          // Maps a shared snapshot read-only; throws std::system_error if it cannot be
+          // mapped, std::runtime_error if it is not a snapshot
+          explicit SnapshotReader(const std::string& name);
+          ~SnapshotReader();
+
+          SnapshotReader(const SnapshotReader&) = delete;
+          SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+          // One attempt; false if it overlapped a publish
+          bool tryRead(Snapshot& out) const;
+
+          // Retries until a copy is consistent
+          Snapshot read() const;
+
+          // Transitions published so far, without copying the rest
+          std::uint64_t transitions() const;
+
+      private:
+          const SnapshotBlock* shared { nullptr };
+          bool                 mapped { false };
+   };
+
+} // namespace safety
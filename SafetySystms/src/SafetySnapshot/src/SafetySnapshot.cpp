@@ -0,0 +1,246 @@
+#include "SafetySnapshot/SafetySnapshot.h"
+#include "SafetyBase/Posix.h"
+
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace safety
+{
+
+   namespace
+   {
+       using posix::monotonicNs;
+       using posix::throwErrno;
+       using posix::Fd;
+
+       constexpr char          kMagic[8] = { 'S', 'F', 'S', 'N', 'A', 'P', '0', '1' };
+       constexpr std::uint32_t kVersion  = 1;
+
+       // A reader that keeps colliding with publishes gives the writer the core
+       constexpr unsigned kRetriesBeforeYield = 64;
+
+       void initialize(SnapshotBlock& block)
+       {
+           std::memcpy(block.magic, kMagic, sizeof(kMagic));
+           block.version   = kVersion;
+           block.blockSize = sizeof(SnapshotBlock);
+
+           block.transitions.store(0, std::memory_order_relaxed);
+           block.timestampNs.store(0, std::memory_order_relaxed);
+           block.step.store(static_cast<std::uint64_t>(Trigger::Reset) << 8, std::memory_order_relaxed);
+           block.sequence.store(0, std::memory_order_release);
+       }
+   }
+
+   // ----- SafetySnapshot
+
+   SafetySnapshot::SafetySnapshot()
+       : shared(new SnapshotBlock())
+   {
+       initialize(*shared);
+   }
+
+   SafetySnapshot::SafetySnapshot(const std::string& name)
+       : name(name)
+   {
+       Fd object { ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) };
+
+       if (object.fd < 0)
+       {
+           throwErrno("shm_open", name);
+       }
+
+       if (::ftruncate(object.fd, sizeof(SnapshotBlock)) != 0)
+       {
+           ::shm_unlink(name.c_str());
+           throwErrno("ftruncate", name);
+       }
+
+       void* base = ::mmap(nullptr, sizeof(SnapshotBlock), PROT_READ | PROT_WRITE, MAP_SHARED, object.fd, 0);
+
+       if (base == MAP_FAILED)
+       {
+           ::shm_unlink(name.c_str());
+           throwErrno("mmap", name);
+       }
+
+       shared = new (base) SnapshotBlock();
+       initialize(*shared);
+   }
+
+   SafetySnapshot::~SafetySnapshot()
+   {
+       if (name.empty())
+       {
+           delete shared;
+       }
+       else
+       {
+           // Readers that still have it mapped keep their view of the last state
+           ::munmap(shared, sizeof(SnapshotBlock));
+           ::shm_unlink(name.c_str());
+       }
+   }
+
+   void SafetySnapshot::attach(SafetyRules& rules)
+   {
+       if (!rules.addOnStep(SafetyRules::StepFn::bind<&SafetySnapshot::record>(this)))
+       {
+           throw std::runtime_error("SafetySnapshot: no free step observer on the machine");
+       }
+
+       publish(Trigger::Reset, toConfig(rules.getState(), rules.getLoaderSubstate()));
+   }
+
+   void SafetySnapshot::detach(SafetyRules& rules)
+   {
+       rules.removeOnStep(SafetyRules::StepFn::bind<&SafetySnapshot::record>(this));
+   }
+
+   void SafetySnapshot::record(void* self, Trigger trigger, Config result)
+   {
+       static_cast<SafetySnapshot*>(self)->publish(trigger, result);
+   }
+
+   void SafetySnapshot::publish(Trigger trigger, Config result)
+   {
+       // Ignored triggers cost one compare; the clock is read only for transitions
+       if (result == last && trigger != Trigger::Reset)
+       {
+           return;
+       }
+
+       publish(trigger, result, monotonicNs());
+   }
+
+   void SafetySnapshot::publish(Trigger trigger, Config result, std::uint64_t timestampNs)
+   {
+       const std::uint64_t sequence = shared->sequence.load(std::memory_order_relaxed);
+
+       // Odd: readers that start now retry; the fence keeps the payload stores after it
+       shared->sequence.store(sequence + 1, std::memory_order_relaxed);
+       std::atomic_thread_fence(std::memory_order_release);
+
+       shared->transitions.store(++transitions, std::memory_order_relaxed);
+       shared->timestampNs.store(timestampNs, std::memory_order_relaxed);
+       shared->step.store(static_cast<std::uint64_t>(trigger) << 8 | result, std::memory_order_relaxed);
+
+       shared->sequence.store(sequence + 2, std::memory_order_release);
+       last = result;
+   }
+
+   // ----- SnapshotReader
+
+   SnapshotReader::SnapshotReader(const SafetySnapshot& snapshot)
+       : shared(&snapshot.block())
+   {
+   }
+
+   SnapshotReader::SnapshotReader(const std::string& name)
+   {
+       Fd object { ::shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0) };
+
+       if (object.fd < 0)
+       {
+           throwErrno("shm_open", name);
+       }
+
+       struct stat st;
+
+       if (::fstat(object.fd, &st) != 0)
+       {
+           throwErrno("fstat", name);
+       }
+
+       if (static_cast<std::size_t>(st.st_size) < sizeof(SnapshotBlock))
+       {
+           throw std::runtime_error("Not a SafetySnapshot (too small): " + name);
+       }
+
+       void* base = ::mmap(nullptr, sizeof(SnapshotBlock), PROT_READ, MAP_SHARED, object.fd, 0);
+
+       if (base == MAP_FAILED)
+       {
+           throwErrno("mmap", name);
+       }
+
+       shared = static_cast<const SnapshotBlock*>(base);
+       mapped = true;
+
+       if (std::memcmp(shared->magic, kMagic, sizeof(kMagic)) != 0 || shared->version != kVersion
+           || shared->blockSize != sizeof(SnapshotBlock))
+       {
+           ::munmap(base, sizeof(SnapshotBlock));
+           throw std::runtime_error("Not a SafetySnapshot: " + name);
+       }
+   }
+
+   SnapshotReader::~SnapshotReader()
+   {
+       if (mapped)
+       {
+           ::munmap(const_cast<SnapshotBlock*>(shared), sizeof(SnapshotBlock));
+       }
+   }
+
+   bool SnapshotReader::tryRead(Snapshot& out) const
+   {
+       const std::uint64_t before = shared->sequence.load(std::memory_order_acquire);
+
+       if (before & 1)
+       {
+           return false;
+       }
+
+       const std::uint64_t transitions = shared->transitions.load(std::memory_order_relaxed);
+       const std::uint64_t timestampNs = shared->timestampNs.load(std::memory_order_relaxed);
+       const std::uint64_t step        = shared->step.load(std::memory_order_relaxed);
+
+       // Keeps the payload loads before the second sequence load
+       std::atomic_thread_fence(std::memory_order_acquire);
+
+       if (shared->sequence.load(std::memory_order_relaxed) != before)
+       {
+           return false;
+       }
+
+       const Config config = static_cast<Config>(step & 0xFF);
+
+       out.state       = stateOf(config);
+       out.sub         = subOf(config);
+       out.config      = config;
+       out.trigger     = static_cast<Trigger>(step >> 8);
+       out.transitions = transitions;
+       out.timestampNs = timestampNs;
+       return true;
+   }
+
+   Snapshot SnapshotReader::read() const
+   {
+       Snapshot out;
+
+       for (unsigned attempt = 1; !tryRead(out); ++attempt)
+       {
+           if (attempt % kRetriesBeforeYield == 0)
+           {
+               std::this_thread::yield();
+           }
+       }
+
+       return out;
+   }
+
+   std::uint64_t SnapshotReader::transitions() const
+   {
+       return shared->transitions.load(std::memory_order_acquire);
+   }
+
+} // namespace safety
@@ -0,0 +1,92 @@
+#pragma once
+#include "SafetyRules/Delegate.h"
+#include "SafetyRules/SafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include "SafetyTimers/TimingWheel.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+namespace safety
+{
+
+   // Per-substate deadlines for the loader submachine: a machine that stays in
+   // OpenDoor, DoorOpened or BuildPlateLoaded longer than its limit is sent evFault.
+   //
+   // attach() adds a step observer to the machine. Every step that changes the
+   // configuration cancels the running deadline and, on entering a loader substate
+   // with a limit, arms a new one; both are O(1) on the timing wheel and never
+   // allocate. poll() reads the clock, advances the wheel and dispatches evFault to
+   // the machines that are overdue. Time comes from the Clock delegate in whatever
+   // unit the limits use (one wheel tick each), so tests can run on virtual time.
+   //
+   // Single-threaded: dispatch to attached machines, poll() and attach() from one thread.
+   class LoaderDeadlines
+   {
+      public:
+          using Clock = Delegate<std::uint64_t()>;
+
+          // Ticks allowed in each substate; 0 = no deadline
+          struct Limits
+          {
+              std::uint64_t openDoor;
+              std::uint64_t doorOpened;
+              std::uint64_t buildPlateLoaded;
+          };
+
+          // Milliseconds on the monotonic clock
+          static std::uint64_t steadyMilliseconds();
+
+      public:
+          // ----- Construction
+          explicit LoaderDeadlines(Limits limits, Clock clock = &LoaderDeadlines::steadyMilliseconds);
+
+          LoaderDeadlines(const LoaderDeadlines&) = delete;
+          LoaderDeadlines& operator=(const LoaderDeadlines&) = delete;
+
+          // ----- Machines: rules must outlive this object or be detached first.
+          //       detach() is a linear search; it is meant for decommissioning.
+          void attach(SafetyRules& rules);
+          void detach(SafetyRules& rules);
+
+          // ----- Time: fires due deadlines, returns how many machines were faulted
+          std::size_t poll();
+
+          // ----- Observability
+          std::size_t pending() const
+          {
+              return wheel.size();
+          }
+
+          std::uint64_t expired() const
+          {
+              return expiredCount;
+          }
+
+      private:
+          struct Watch : TimingWheel::Timer
+          {
+              LoaderDeadlines* owner { nullptr };
+              SafetyRules*     rules { nullptr };
+              Config           config { 0 };
+          };
+
+          static void onStep(void* watch, Trigger trigger, Config result);
+          static void onExpire(void* self, TimingWheel::Timer& timer);
+
+          std::uint64_t limitOf(Config config) const
+          {
+              return limitBySub[static_cast<std::size_t>(subOf(config))];
+          }
+
+      private:
+          std::array<std::uint64_t, 4> limitBySub;   // indexed by LoaderSub, None = 0
+          Clock                        clock;
+          TimingWheel                  wheel;
+          std::deque<Watch>            watches;      // stable addresses; slots reused after detach
+          std::deque<Watch*>           freeWatches;
+          std::uint64_t                expiredCount { 0 };
+   };
+
+} // namespace safety
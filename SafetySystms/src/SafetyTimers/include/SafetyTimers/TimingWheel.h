@@ -0,0 +1,130 @@
+#pragma once
+#include "SafetyRules/Delegate.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace safety
+{
+
+   // Hierarchical timing wheel: four levels of 256 slots, so deadlines up to 2^32
+   // ticks ahead are placed directly (later ones are parked at the horizon and
+   // re-placed when reached).
+   //
+   // Timers are intrusive nodes owned by the caller, so arm() and cancel() are a
+   // few pointer writes: O(1), no allocation. advance(now) expires every timer whose
+   // deadline is <= now, moving timers down a level as their slot comes up, and
+   // skips straight to the next slot boundary of the lowest occupied level.
+   // Expiry callbacks may arm and cancel any timer, including the one expiring.
+   // Not thread-safe: arm, cancel and advance from one thread.
+   class TimingWheel
+   {
+      public:
+          // ----- Intrusive timer: embed (or derive from) one per deadline
+          struct Timer
+          {
+              Timer*        prev { nullptr };
+              Timer*        next { nullptr };
+              std::uint64_t deadline { 0 };
+              std::uint8_t  level { 0 };
+
+              bool armed() const
+              {
+                  return next != nullptr;
+              }
+          };
+
+          using ExpireFn = Delegate<void(Timer& timer)>;
+
+          static constexpr std::size_t kLevels    = 4;
+          static constexpr std::size_t kSlotBits  = 8;
+          static constexpr std::size_t kSlots     = std::size_t(1) << kSlotBits;
+
+      public:
+          // ----- Construction: current time in ticks
+          explicit TimingWheel(std::uint64_t now, ExpireFn onExpire = nullptr);
+
+          TimingWheel(const TimingWheel&) = delete;
+          TimingWheel& operator=(const TimingWheel&) = delete;
+
+          void setOnExpire(ExpireFn fn)
+          {
+              onExpire = fn;
+          }
+
+          // ----- Timers
+          // Deadlines at or before now() fire on the next advance(); re-arming moves the timer
+          void arm(Timer& timer, std::uint64_t deadline);
+
+          void cancel(Timer& timer)
+          {
+              if (timer.armed())
+              {
+                  remove(timer);
+                  --armedCount;
+              }
+          }
+
+          // ----- Time
+          // Expires everything due up to and including now (no-op if now is in the past)
+          void advance(std::uint64_t now);
+
+          std::uint64_t now() const
+          {
+              return current;
+          }
+
+          std::size_t size() const
+          {
+              return armedCount;
+          }
+
+      private:
+          // Circular list with a sentinel head per slot
+          struct Slot
+          {
+              Timer head;
+
+              Slot()
+              {
+                  head.prev = head.next = &head;
+              }
+
+              Slot(const Slot&) = delete;
+              Slot& operator=(const Slot&) = delete;
+
+              bool empty() const
+              {
+                  return head.next == &head;
+              }
+          };
+
+          static void linkBefore(Timer& head, Timer& timer)
+          {
+              timer.prev = head.prev;
+              timer.next = &head;
+              head.prev->next = &timer;
+              head.prev = &timer;
+          }
+
+          void remove(Timer& timer)
+          {
+              timer.prev->next = timer.next;
+              timer.next->prev = timer.prev;
+              timer.prev = timer.next = nullptr;
+              --levelCount[timer.level];
+          }
+
+          void place(Timer& timer, std::uint64_t earliest);
+          void cascade(std::size_t level);
+          void expire(Slot& slot);
+
+      private:
+          std::array<std::array<Slot, kSlots>, kLevels> wheel;
+          std::array<std::size_t, kLevels>              levelCount {};
+          std::uint64_t current;
+          std::size_t   armedCount { 0 };
+          ExpireFn      onExpire;
+   };
+
+} // namespace safety
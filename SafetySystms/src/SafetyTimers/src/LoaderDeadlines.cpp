@@ -0,0 +1,106 @@
+#include "SafetyTimers/LoaderDeadlines.h"
+
+#include <chrono>
+#include <stdexcept>
+
+namespace safety
+{
+
+   std::uint64_t LoaderDeadlines::steadyMilliseconds()
+   {
+       return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count());
+   }
+
+   LoaderDeadlines::LoaderDeadlines(Limits limits, Clock clock)
+       : limitBySub { 0, limits.openDoor, limits.doorOpened, limits.buildPlateLoaded },
+         clock(clock),
+         wheel(clock(), TimingWheel::ExpireFn::bind<&LoaderDeadlines::onExpire>(this))
+   {
+   }
+
+   void LoaderDeadlines::attach(SafetyRules& rules)
+   {
+       Watch* watch = nullptr;
+
+       if (!freeWatches.empty())
+       {
+           watch = freeWatches.back();
+           freeWatches.pop_back();
+       }
+       else
+       {
+           watch = &watches.emplace_back();
+       }
+
+       if (!rules.addOnStep(SafetyRules::StepFn::bind<&LoaderDeadlines::onStep>(watch)))
+       {
+           freeWatches.push_back(watch);
+           throw std::runtime_error("LoaderDeadlines: no free step observer on the machine");
+       }
+
+       watch->owner  = this;
+       watch->rules  = &rules;
+       watch->config = toConfig(rules.getState(), rules.getLoaderSubstate());
+
+       if (const std::uint64_t limit = limitOf(watch->config))
+       {
+           wheel.arm(*watch, clock() + limit);
+       }
+   }
+
+   void LoaderDeadlines::detach(SafetyRules& rules)
+   {
+       for (Watch& watch : watches)
+       {
+           if (watch.rules == &rules)
+           {
+               wheel.cancel(watch);
+               rules.removeOnStep(SafetyRules::StepFn::bind<&LoaderDeadlines::onStep>(&watch));
+               watch.rules = nullptr;
+               freeWatches.push_back(&watch);
+               return;
+           }
+       }
+   }
+
+   std::size_t LoaderDeadlines::poll()
+   {
+       const std::uint64_t before = expiredCount;
+       wheel.advance(clock());
+       return static_cast<std::size_t>(expiredCount - before);
+   }
+
+   // A configuration change restarts (or stops) the deadline; ignored events do not
+   void LoaderDeadlines::onStep(void* context, Trigger, Config result)
+   {
+       Watch& watch = *static_cast<Watch*>(context);
+
+       if (result == watch.config)
+       {
+           return;
+       }
+
+       watch.config = result;
+       LoaderDeadlines& self = *watch.owner;
+
+       if (const std::uint64_t limit = self.limitOf(result))
+       {
+           self.wheel.arm(watch, self.clock() + limit);
+       }
+       else
+       {
+           self.wheel.cancel(watch);
+       }
+   }
+
+   void LoaderDeadlines::onExpire(void* context, TimingWheel::Timer& timer)
+   {
+       LoaderDeadlines& self = *static_cast<LoaderDeadlines*>(context);
+       Watch& watch = static_cast<Watch&>(timer);
+
+       ++self.expiredCount;
+       watch.rules->dispatch(ISafetyRules::Event::evFault);
+   }
+
+} // namespace safety
@@ -0,0 +1,155 @@
+#include "SafetyTimers/TimingWheel.h"
+
+namespace safety
+{
+
+   TimingWheel::TimingWheel(std::uint64_t now, ExpireFn onExpire)
+       : current(now),
+         onExpire(onExpire)
+   {
+   }
+
+   void TimingWheel::arm(Timer& timer, std::uint64_t deadline)
+   {
+       if (timer.armed())
+       {
+           remove(timer);
+       }
+       else
+       {
+           ++armedCount;
+       }
+
+       timer.deadline = deadline;
+       place(timer, current + 1);
+   }
+
+   // Level l holds deadlines [2^(8l), 2^(8(l+1))) ticks ahead, in the slot given by
+   // the deadline's l-th byte; that slot comes up (and is cascaded) exactly when the
+   // lower bytes of the current time wrap to the deadline's. Deadlines before
+   // earliest go to earliest's slot.
+   void TimingWheel::place(Timer& timer, std::uint64_t earliest)
+   {
+       constexpr std::uint64_t kHorizon = std::uint64_t(1) << (kLevels * kSlotBits);
+
+       std::uint64_t at = timer.deadline > earliest ? timer.deadline : earliest;
+
+       if (at - current >= kHorizon)
+       {
+           at = current + kHorizon - 1;   // parked; re-placed when its slot comes up
+       }
+
+       const std::uint64_t delta = at - current;
+       std::size_t level = 0;
+
+       while (level + 1 < kLevels && delta >= (std::uint64_t(1) << (kSlotBits * (level + 1))))
+       {
+           ++level;
+       }
+
+       const std::size_t slot = static_cast<std::size_t>(at >> (kSlotBits * level)) & (kSlots - 1);
+
+       timer.level = static_cast<std::uint8_t>(level);
+       ++levelCount[level];
+       linkBefore(wheel[level][slot].head, timer);
+   }
+
+   void TimingWheel::advance(std::uint64_t now)
+   {
+       while (current < now)
+       {
+           if (armedCount == 0)
+           {
+               current = now;
+               break;
+           }
+
+           // Nothing happens before the next slot boundary of the lowest occupied level
+           std::size_t lowest = 0;
+
+           while (lowest + 1 < kLevels && levelCount[lowest] == 0)
+           {
+               ++lowest;
+           }
+
+           if (lowest > 0)
+           {
+               const std::uint64_t last = current | ((std::uint64_t(1) << (kSlotBits * lowest)) - 1);
+
+               if (last >= now)
+               {
+                   current = now;
+                   break;
+               }
+
+               current = last;
+           }
+
+           ++current;
+
+           const std::size_t slot = static_cast<std::size_t>(current) & (kSlots - 1);
+
+           if (slot == 0)
+           {
+               cascade(1);
+           }
+
+           expire(wheel[0][slot]);
+       }
+   }
+
+   void TimingWheel::cascade(std::size_t level)
+   {
+       const std::size_t slot = static_cast<std::size_t>(current >> (kSlotBits * level)) & (kSlots - 1);
+
+       if (slot == 0 && level + 1 < kLevels)
+       {
+           cascade(level + 1);
+       }
+
+       Slot& from = wheel[level][slot];
+
+       while (!from.empty())
+       {
+           Timer& timer = *from.head.next;
+           remove(timer);
+           place(timer, current);   // due now: lands in the slot expired next
+       }
+   }
+
+   void TimingWheel::expire(Slot& slot)
+   {
+       if (slot.empty())
+       {
+           return;
+       }
+
+       // Detach the slot first: callbacks may arm timers into it or cancel pending ones
+       Slot due;
+       due.head.next = slot.head.next;
+       due.head.prev = slot.head.prev;
+       due.head.next->prev = &due.head;
+       due.head.prev->next = &due.head;
+       slot.head.next = slot.head.prev = &slot.head;
+
+       while (!due.empty())
+       {
+           Timer& timer = *due.head.next;
+           remove(timer);
+
+           if (timer.deadline > current)
+           {
+               place(timer, current + 1);   // parked beyond the horizon
+               continue;
+           }
+
+           --armedCount;
+
+           if (onExpire)
+           {
+               onExpire(timer);
+           }
+       }
+   }
+
+} // namespace safety
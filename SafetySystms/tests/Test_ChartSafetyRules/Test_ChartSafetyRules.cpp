@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+#include "ChartSafetyRules/ChartSafetyRules.h"
+#include "SafetyRules/SafetyRules.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace Test_ChartSafetyRules_Namespace
+{
+
+   using namespace safety;
+
+   class ChartSafetyRulesTest : public ::testing::Test
+   {
+   protected:
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+       using Ev    = ISafetyRules::Event;
+
+       void SetUp() override
+       {
+           record(chart, chartLog);
+       }
+
+       // Each hook appends its name to log; slots keep the (log, name) pair the
+       // one-pointer Delegate refers to
+       void record(ISafetyRules& uut, std::vector<std::string>& log)
+       {
+           auto hook = [this](std::vector<std::string>& l, const char* name) {
+               slots.push_back(Slot { &l, name });
+               Slot* s = &slots.back();
+               return ISafetyRules::VoidFn([s]() { s->log->push_back(s->name); });
+           };
+
+           uut.setOnEnterIdle(hook(log, "EnterIdle"));
+           uut.setOnExitIdle(hook(log, "ExitIdle"));
+           uut.setOnEnterActive(hook(log, "EnterActive"));
+           uut.setOnExitActive(hook(log, "ExitActive"));
+           uut.setOnEnterFaulted(hook(log, "EnterFaulted"));
+           uut.setOnExitFaulted(hook(log, "ExitFaulted"));
+           uut.setOnEnterBuildPlateLoader(hook(log, "EnterBuildPlateLoader"));
+           uut.setOnExitBuildPlateLoader(hook(log, "ExitBuildPlateLoader"));
+           uut.setOnRequestDoorOpen(hook(log, "RequestDoorOpen"));
+           uut.setOnRequestLoadBuildPlate(hook(log, "RequestLoadBuildPlate"));
+           uut.setOnRequestDoorClose(hook(log, "RequestDoorClose"));
+       }
+
+       template <typename Rules>
+       static Config configOf(const Rules& uut)
+       {
+           return toConfig(uut.getState(), uut.getLoaderSubstate());
+       }
+
+       template <typename Rules>
+       static void fire(Rules& uut, Trigger t)
+       {
+           if (t == Trigger::StartLoader)
+           {
+               uut.startLoader();
+           }
+           else
+           {
+               uut.dispatch(static_cast<Ev>(t));
+           }
+       }
+
+       // Drives both machines along the same (shared-vocabulary) path
+       template <typename Rules>
+       static void driveTo(Rules& uut, Config config)
+       {
+           uut.reset();
+
+           if (stateOf(config) == State::Idle) return;
+
+           uut.dispatch(Ev::evPowerOn);
+
+           if (stateOf(config) == State::Faulted)
+           {
+               uut.dispatch(Ev::evFault);
+           }
+           else if (stateOf(config) == State::BuildPlateLoader)
+           {
+               uut.startLoader();
+               if (subOf(config) != Sub::OpenDoor) uut.dispatch(Ev::evDoorOpened);
+               if (subOf(config) == Sub::BuildPlateLoaded) uut.dispatch(Ev::evBuildPlateLoaded);
+           }
+       }
+
+   protected:
+       struct Slot
+       {
+           std::vector<std::string>* log;
+           const char*               name;
+       };
+
+       std::deque<Slot>         slots;
+       ChartSafetyRules         chart;
+       std::vector<std::string> chartLog;
+   };
+
+   TEST_F(ChartSafetyRulesTest, StartsIdleAndFiresEnterIdleOnReset)
+   {
+       EXPECT_EQ(chart.getState(), State::Idle);
+       chart.reset();
+       EXPECT_EQ(chartLog, std::vector<std::string>({ "EnterIdle" }));
+   }
+
+   // The full loader cycle fires the same hooks in the same order as SafetyRules
+   TEST_F(ChartSafetyRulesTest, LoaderCycleMatchesSafetyRules)
+   {
+       SafetyRules rules;
+       std::vector<std::string> rulesLog;
+       record(rules, rulesLog);
+
+       for (ISafetyRules* uut : { static_cast<ISafetyRules*>(&chart), static_cast<ISafetyRules*>(&rules) })
+       {
+           uut->dispatch(Ev::evPowerOn);
+           uut->startLoader();
+           uut->dispatch(Ev::evDoorOpened);
+           uut->dispatch(Ev::evBuildPlateLoaded);
+           uut->dispatch(Ev::evDoorClosed);
+           uut->dispatch(Ev::evFault);
+       }
+
+       EXPECT_EQ(chart.getState(), State::Faulted);
+       EXPECT_EQ(chartLog, rulesLog);
+   }
+
+   // Cell by cell, the generated table equals the hand-written one except where the
+   // chart and SafetyRules are known to disagree about Faulted
+   TEST_F(ChartSafetyRulesTest, TableMatchesSafetyRulesExceptKnownDeltas)
+   {
+       const Config faulted = toConfig(State::Faulted, Sub::None);
+       const Config idle    = toConfig(State::Idle, Sub::None);
+       const Config active  = toConfig(State::Active, Sub::None);
+
+       for (Config c = 0; c < kConfigCount; ++c)
+       {
+           const bool inLoader = stateOf(c) == State::BuildPlateLoader;
+           if (inLoader == (subOf(c) == Sub::None)) continue;
+
+           for (std::size_t t = 0; t < kTriggerCount; ++t)
+           {
+               const Trigger trigger = static_cast<Trigger>(t);
+               SafetyRules rules;
+
+               driveTo(chart, c);
+               driveTo(rules, c);
+               ASSERT_EQ(configOf(chart), c);
+
+               fire(chart, trigger);
+               fire(rules, trigger);
+
+               if (c == faulted && trigger == Trigger::evPowerOn)
+               {
+                   // Chart: no Faulted -> Active arc
+                   EXPECT_EQ(configOf(chart), faulted);
+                   EXPECT_EQ(configOf(rules), active);
+               }
+               else if (c == faulted && trigger == Trigger::evPowerOff)
+               {
+                   // Chart: Faulted -> Idle : evIdle
+                   EXPECT_EQ(configOf(chart), idle);
+                   EXPECT_EQ(configOf(rules), faulted);
+               }
+               else
+               {
+                   EXPECT_EQ(configOf(chart), configOf(rules)) << "config " << int(c) << ", trigger " << t;
+               }
+           }
+       }
+   }
+
+   // Chart-only event: the plate disappears while the door is still open
+   TEST_F(ChartSafetyRulesTest, BuildPlateUnloadedFaults)
+   {
+       chart.dispatch(Ev::evPowerOn);
+       chart.startLoader();
+       chart.dispatch(ChartEvent::evBuildPlateUnloaded);       // ignored before the plate is loaded
+       EXPECT_EQ(chart.getLoaderSubstate(), Sub::OpenDoor);
+
+       chart.dispatch(Ev::evDoorOpened);
+       chart.dispatch(Ev::evBuildPlateLoaded);
+       chartLog.clear();
+
+       chart.dispatch(ChartEvent::evBuildPlateUnloaded);
+       EXPECT_EQ(chart.getState(), State::Faulted);
+       EXPECT_EQ(chart.getLoaderSubstate(), Sub::None);
+       EXPECT_EQ(chartLog, std::vector<std::string>({ "ExitBuildPlateLoader", "EnterFaulted" }));
+   }
+
+   // Chart vocabulary and ISafetyRules vocabulary reach the same cells
+   TEST_F(ChartSafetyRulesTest, ChartEventsAreAliases)
+   {
+       chart.dispatch(ChartEvent::evActive);
+       EXPECT_EQ(chart.getState(), State::Active);
+       chart.dispatch(ChartEvent::evLoadBuildPlate);
+       EXPECT_EQ(chart.getLoaderSubstate(), Sub::OpenDoor);
+       chart.dispatch(ChartEvent::evFault);
+       chart.dispatch(ChartEvent::evIdle);
+       EXPECT_EQ(chart.getState(), State::Idle);
+
+       EXPECT_EQ(kChartEventCount, 8u);
+   }
+
+}
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include "CrudeSafetyRules/BoxLog.h"
+#include "CrudeSafetyRules/CrudeSafetyRules.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Test_CrudeSafetyRules_Namespace
+{
+
+   using namespace safety;
+
+   class CrudeSafetyRulesTest : public ::testing::Test
+   {
+   protected:
+       // Every command, valid and not, in an order that exercises each message
+       static void script(SafetyBox& box)
+       {
+           for (int cmd : { 3, 0, 3, 4, 5, 6, 2, 0, 3, 1, 9 })
+           {
+               box.run(cmd);
+           }
+
+           box.dump();
+       }
+
+       // What SafetyBox prints without a log
+       static std::string synchronousOutput()
+       {
+           std::ostringstream captured;
+           std::streambuf* saved = std::cout.rdbuf(captured.rdbuf());
+
+           {
+               SafetyBox box;
+               script(box);
+           }
+
+           std::cout.rdbuf(saved);
+           return captured.str();
+       }
+   };
+
+   // The log thread prints exactly the lines the synchronous path prints
+   TEST_F(CrudeSafetyRulesTest, LoggedOutputMatchesSynchronousOutput)
+   {
+       std::ostringstream out;
+
+       {
+           BoxLog log(out);
+           SafetyBox box(&log);
+           script(box);
+           log.flush();
+
+           EXPECT_EQ(log.dropped(), 0u);
+       }
+
+       EXPECT_EQ(out.str(), synchronousOutput());
+       EXPECT_NE(out.str().find("Unknown command"), std::string::npos);
+       EXPECT_NE(out.str().find("[Mode=0 Step=0]"), std::string::npos);
+   }
+
+   // Status records carry the box state at the time of the call
+   TEST_F(CrudeSafetyRulesTest, StatusRecordsCarryModeAndStep)
+   {
+       std::ostringstream out;
+       BoxLog log(out);
+       SafetyBox box(&log);
+
+       box.run(0);
+       box.run(3);
+       box.dump();
+       box.run(4);
+       box.dump();
+       log.flush();
+
+       EXPECT_NE(out.str().find("[Mode=1 Step=1]\nDoor opened, loading plate\n[Mode=1 Step=2]\n"), std::string::npos);
+   }
+
+   // Several boxes on several threads share one log; every line is printed or counted as dropped
+   TEST_F(CrudeSafetyRulesTest, ManyWritersOneLog)
+   {
+       constexpr int kThreads = 4;
+       constexpr int kCycles = 5000;
+
+       std::ostringstream out;
+       std::uint64_t dropped = 0;
+
+       {
+           BoxLog log(out, 1024);
+           std::vector<std::thread> threads;
+
+           for (int t = 0; t < kThreads; ++t)
+           {
+               threads.emplace_back([&log]() {
+                   SafetyBox box(&log);
+
+                   for (int i = 0; i < kCycles; ++i)
+                   {
+                       for (int cmd : { 0, 3, 4, 5, 6, 1 })
+                       {
+                           box.run(cmd);
+                       }
+                   }
+               });
+           }
+
+           for (auto& t : threads)
+           {
+               t.join();
+           }
+
+           log.flush();
+           dropped = log.dropped();
+       }
+
+       const std::string text = out.str();
+       const auto lines = static_cast<std::uint64_t>(std::count(text.begin(), text.end(), '\n'));
+
+       // Per box: "initialized" plus 7 lines per cycle
+       EXPECT_EQ(lines + dropped, std::uint64_t(kThreads) * (1 + 7 * kCycles));
+   }
+
+}
@@ -0,0 +1,305 @@
+#include <gtest/gtest.h>
+#include "SafetyChannel/ChannelPump.h"
+#include "SafetyChannel/EventChannel.h"
+#include "SafetyDispatcher/SafetyDispatcher.h"
+#include "SafetyRules/SafetyRules.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace Test_SafetyChannel_Namespace
+{
+
+   using namespace safety;
+
+   class SafetyChannelTest : public ::testing::Test
+   {
+   protected:
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+       using Ev    = ISafetyRules::Event;
+
+       // Polls until done() or a generous deadline
+       template <typename Done>
+       static bool eventually(Done&& done)
+       {
+           const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+           while (!done())
+           {
+               if (std::chrono::steady_clock::now() > deadline)
+               {
+                   return false;
+               }
+
+               std::this_thread::sleep_for(std::chrono::milliseconds(1));
+           }
+
+           return true;
+       }
+
+   protected:
+       const std::string name = "/Test_SafetyChannel." + std::to_string(::getpid());
+   };
+
+   // Events come out in order with what the producer put in them, and a full ring
+   // rejects and counts instead of overwriting
+   TEST_F(SafetyChannelTest, PostAndTakeInOrder)
+   {
+       EventChannel channel(name, 5);
+       ChannelProducer producer(name);
+
+       EXPECT_EQ(channel.capacity(), 8u);
+       EXPECT_FALSE(channel.ready());
+
+       ChannelEvent event;
+       EXPECT_FALSE(channel.tryPop(event));
+
+       for (std::uint32_t i = 0; i < 7; ++i)
+       {
+           EXPECT_TRUE(producer.post(static_cast<Ev>(i % 6), 100 + i, 1000 + i));
+       }
+
+       EXPECT_TRUE(producer.postStartLoader(42, 7));
+       EXPECT_FALSE(producer.post(Ev::evFault));
+       EXPECT_EQ(channel.stats().full, 1u);
+       EXPECT_EQ(channel.stats().depth, 8u);
+
+       ASSERT_TRUE(channel.tryPop(event));
+       EXPECT_EQ(event.trigger, Trigger::evPowerOn);
+       EXPECT_EQ(event.source, 100u);
+       EXPECT_EQ(event.stamp, 1000u);
+
+       std::vector<ChannelEvent> rest;
+       EXPECT_EQ(channel.drain([&rest](const ChannelEvent& e) { rest.push_back(e); }, 3), 3u);
+       EXPECT_EQ(channel.drain([&rest](const ChannelEvent& e) { rest.push_back(e); }), 4u);
+       ASSERT_EQ(rest.size(), 7u);
+
+       for (std::uint32_t i = 1; i < 7; ++i)
+       {
+           EXPECT_EQ(rest[i - 1].trigger, toTrigger(static_cast<Ev>(i % 6)));
+           EXPECT_EQ(rest[i - 1].source, 100 + i);
+           EXPECT_EQ(rest[i - 1].stamp, 1000 + i);
+       }
+
+       EXPECT_EQ(rest[6].trigger, Trigger::StartLoader);
+       EXPECT_EQ(rest[6].source, 42u);
+
+       // The ring wraps
+       for (int round = 0; round < 3; ++round)
+       {
+           for (int i = 0; i < 8; ++i)
+           {
+               ASSERT_TRUE(producer.post(Ev::evDoorOpened));
+           }
+
+           EXPECT_EQ(channel.drain([](const ChannelEvent&) {}), 8u);
+       }
+
+       EXPECT_EQ(channel.stats().received, 32u);
+       EXPECT_EQ(channel.stats().depth, 0u);
+   }
+
+   TEST_F(SafetyChannelTest, ProducerNeedsAChannel)
+   {
+       EXPECT_THROW(ChannelProducer producer(name), std::system_error);
+
+       // Some other shared memory object under the name
+       const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+       ASSERT_GE(fd, 0);
+       ASSERT_EQ(::ftruncate(fd, 4096), 0);
+       ::close(fd);
+
+       EXPECT_THROW(ChannelProducer producer(name), std::runtime_error);
+       ::shm_unlink(name.c_str());
+
+       // A producer outliving its consumer sees it go
+       auto channel = std::make_unique<EventChannel>(name, 16);
+       ChannelProducer producer(name);
+       EXPECT_FALSE(producer.closed());
+
+       channel.reset();
+       EXPECT_TRUE(producer.closed());
+       EXPECT_THROW(ChannelProducer late(name), std::system_error);
+   }
+
+   // An idle consumer sleeps in the kernel, a post wakes it, and posts to a consumer
+   // that is awake make no syscall
+   TEST_F(SafetyChannelTest, SleepingConsumerIsWokenByPost)
+   {
+       EventChannel channel(name, 64);
+       ChannelProducer producer(name);
+
+       EXPECT_FALSE(channel.wait(std::chrono::milliseconds(5)));
+       EXPECT_EQ(channel.stats().sleeps, 1u);
+       EXPECT_EQ(channel.stats().wakeups, 0u);
+
+       std::atomic<bool> woken { false };
+
+       std::thread consumer([&]() {
+           woken = channel.wait(std::chrono::seconds(30), 0);
+       });
+
+       ASSERT_TRUE(eventually([&]() { return channel.header().sleeping.load() != 0; }));
+
+       const auto posted = std::chrono::steady_clock::now();
+       ASSERT_TRUE(producer.post(Ev::evPowerOn));
+       consumer.join();
+
+       EXPECT_TRUE(woken);
+       EXPECT_LT(std::chrono::steady_clock::now() - posted, std::chrono::seconds(5));
+       EXPECT_EQ(channel.stats().wakeups, 1u);
+
+       // Nobody asleep: no more wakes however much is posted
+       for (int i = 0; i < 20; ++i)
+       {
+           ASSERT_TRUE(producer.post(Ev::evDoorOpened));
+       }
+
+       EXPECT_TRUE(channel.wait(std::chrono::seconds(1)));
+       EXPECT_EQ(channel.drain([](const ChannelEvent&) {}), 21u);
+       EXPECT_EQ(channel.stats().wakeups, 1u);
+
+       // interrupt() ends a wait with nothing to take
+       std::thread waiter([&]() { woken = channel.wait(std::chrono::seconds(30), 0); });
+       ASSERT_TRUE(eventually([&]() { return channel.header().sleeping.load() != 0; }));
+       channel.interrupt();
+       waiter.join();
+       EXPECT_FALSE(woken);
+   }
+
+   // Each producer's events arrive in its order, none lost, with the consumer
+   // sleeping and waking throughout
+   TEST_F(SafetyChannelTest, ConcurrentProducersKeepTheirOrder)
+   {
+       constexpr std::uint32_t kProducers   = 4;
+       constexpr std::uint64_t kPerProducer = 50000;
+
+       EventChannel channel(name, 256);
+       std::vector<std::thread> producers;
+
+       for (std::uint32_t p = 0; p < kProducers; ++p)
+       {
+           producers.emplace_back([this, p]() {
+               ChannelProducer producer(name);
+
+               for (std::uint64_t i = 0; i < kPerProducer; ++i)
+               {
+                   while (!producer.post(Ev::evDoorOpened, p, i))
+                   {
+                       std::this_thread::yield();
+                   }
+               }
+           });
+       }
+
+       std::vector<std::uint64_t> next(kProducers, 0);
+       std::uint64_t received = 0;
+       bool ordered = true;
+
+       while (received < kProducers * kPerProducer)
+       {
+           received += channel.drain([&](const ChannelEvent& e) {
+               ordered = ordered && e.source < kProducers && e.stamp == next[e.source];
+               ++next[e.source % kProducers];
+           });
+
+           channel.wait(std::chrono::milliseconds(100), 16);
+       }
+
+       for (auto& t : producers)
+       {
+           t.join();
+       }
+
+       EXPECT_TRUE(ordered);
+       EXPECT_EQ(channel.stats().received, kProducers * kPerProducer);
+       EXPECT_FALSE(channel.ready());
+   }
+
+   // A sensor process posts into the safety process, whose pump feeds its dispatcher
+   TEST_F(SafetyChannelTest, SensorProcessDrivesDispatcher)
+   {
+       constexpr int kCycles = 1000;
+
+       EventChannel channel(name, 128);
+
+       const pid_t sensor = ::fork();
+       ASSERT_GE(sensor, 0);
+
+       if (sensor == 0)
+       {
+           int status = 0;
+
+           try
+           {
+               ChannelProducer producer(name);
+               const auto post = [&producer](Ev ev) {
+                   while (!producer.post(ev, 7))
+                   {
+                       std::this_thread::yield();
+                   }
+               };
+
+               for (int i = 0; i < kCycles; ++i)
+               {
+                   post(Ev::evPowerOn);
+                   post(Ev::evPowerOff);
+               }
+
+               post(Ev::evPowerOn);
+
+               while (!producer.postStartLoader(7))
+               {
+                   std::this_thread::yield();
+               }
+
+               post(Ev::evDoorOpened);
+           }
+           catch (...)
+           {
+               status = 1;
+           }
+
+           ::_exit(status);
+       }
+
+       SafetyRules rules;
+       int entered = 0;
+       rules.setOnEnterActive([&entered]() { ++entered; });
+
+       SafetyDispatcher dispatcher(rules, 1 << 14);
+       ChannelPump pump(channel, dispatcher);
+       dispatcher.start();
+       pump.start();
+
+       int status = -1;
+       ASSERT_EQ(::waitpid(sensor, &status, 0), sensor);
+       EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+       constexpr std::uint64_t kEvents = 2 * kCycles + 3;
+       EXPECT_TRUE(eventually([&]() { return dispatcher.stats().dispatched == kEvents; }));
+
+       pump.stop();
+       dispatcher.stop();
+
+       EXPECT_EQ(pump.forwarded(), kEvents);
+       EXPECT_EQ(pump.rejected(), 0u);
+       EXPECT_EQ(entered, kCycles + 1);
+       EXPECT_EQ(rules.getState(), State::BuildPlateLoader);
+       EXPECT_EQ(rules.getLoaderSubstate(), Sub::DoorOpened);
+   }
+
+}
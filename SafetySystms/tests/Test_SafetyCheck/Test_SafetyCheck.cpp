@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include "SafetyCheck/SafetyCheck.h"
+#include "SafetyRules/SafetyRules.h"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace Test_SafetyCheck_Namespace
+{
+
+   using namespace safety;
+
+   class SafetyCheckTest : public ::testing::Test
+   {
+   protected:
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+
+       static const Counterexample* violationOf(const CheckResult& result, const char* name)
+       {
+           for (const Counterexample& c : result.violations)
+           {
+               if (std::strcmp(c.property->name, name) == 0)
+               {
+                   return &c;
+               }
+           }
+
+           return nullptr;
+       }
+   };
+
+   // ----- VisitedSet
+   TEST_F(SafetyCheckTest, VisitedSetInsertsEachKeyOnce)
+   {
+       VisitedSet set(64);
+
+       EXPECT_TRUE(set.insert(0));
+       EXPECT_TRUE(set.insert(17));
+       EXPECT_FALSE(set.insert(0));
+       EXPECT_FALSE(set.insert(17));
+       EXPECT_EQ(set.size(), 2u);
+   }
+
+   TEST_F(SafetyCheckTest, VisitedSetHasOneWinnerPerKeyAcrossThreads)
+   {
+       VisitedSet set(1 << 12);
+       std::atomic<int> wins { 0 };
+       std::vector<std::thread> threads;
+
+       for (int t = 0; t < 4; ++t)
+       {
+           threads.emplace_back([&] {
+               for (std::uint32_t k = 0; k < 1000; ++k)
+               {
+                   if (set.insert(k)) ++wins;
+               }
+           });
+       }
+
+       for (auto& t : threads)
+       {
+           t.join();
+       }
+
+       EXPECT_EQ(wins.load(), 1000);
+       EXPECT_EQ(set.size(), 1000u);
+   }
+
+   // ----- Search
+   TEST_F(SafetyCheckTest, StandardPropertiesHoldAndSearchReachesFixpoint)
+   {
+       const CheckResult result = check(standardProperties(), CheckOptions { 32, 2 });
+
+       EXPECT_TRUE(result.violations.empty());
+       EXPECT_TRUE(result.fixpoint);
+       EXPECT_LT(result.depth, 32u);
+       EXPECT_EQ(result.perLevel.back(), 0u);
+   }
+
+   TEST_F(SafetyCheckTest, ExploresEveryReachableConfiguration)
+   {
+       const CheckResult result = check(standardProperties(), CheckOptions { 32, 1 });
+
+       // Six configurations, some also reached with a door request outstanding
+       EXPECT_GE(result.states, 6u);
+       EXPECT_EQ(result.steps, result.states * (kTriggerCount + 1));
+   }
+
+   TEST_F(SafetyCheckTest, ThreadCountDoesNotChangeTheResult)
+   {
+       const CheckResult one  = check(allProperties(), CheckOptions { 32, 1 });
+       const CheckResult four = check(allProperties(), CheckOptions { 32, 4 });
+
+       EXPECT_EQ(one.states, four.states);
+       EXPECT_EQ(one.steps, four.steps);
+       EXPECT_EQ(one.perLevel, four.perLevel);
+       ASSERT_EQ(one.violations.size(), four.violations.size());
+
+       for (std::size_t v = 0; v < one.violations.size(); ++v)
+       {
+           EXPECT_EQ(one.violations[v].trace, four.violations[v].trace);
+       }
+   }
+
+   TEST_F(SafetyCheckTest, StrictPropertyFailsWithShortestCounterexample)
+   {
+       const CheckResult result = check(allProperties(), CheckOptions { 32, 2 });
+       const Counterexample* c = violationOf(result, "door-requested-once");
+
+       ASSERT_NE(c, nullptr);
+       EXPECT_EQ(result.violations.size(), 1u);
+
+       // Fault out of the loader before the door is closed, then load again
+       const std::vector<Trigger> expected = { Trigger::evPowerOn, Trigger::StartLoader, Trigger::evFault,
+                                               Trigger::evPowerOn, Trigger::StartLoader };
+       EXPECT_EQ(c->trace, expected);
+       EXPECT_EQ(c->step.to, toConfig(State::BuildPlateLoader, Sub::OpenDoor));
+   }
+
+   TEST_F(SafetyCheckTest, CounterexampleReplaysOnSafetyRules)
+   {
+       const CheckResult result = check(allProperties(), CheckOptions { 32, 1 });
+       ASSERT_FALSE(result.violations.empty());
+
+       const Counterexample& c = result.violations.front();
+       SafetyRules rules;
+       int doorRequests = 0;
+
+       rules.setOnRequestDoorOpen([&doorRequests] { ++doorRequests; });
+
+       for (Trigger t : c.trace)
+       {
+           if (t == Trigger::StartLoader) rules.startLoader();
+           else if (t == Trigger::Reset)  rules.reset();
+           else                           rules.dispatch(static_cast<ISafetyRules::Event>(t));
+       }
+
+       EXPECT_EQ(toConfig(rules.getState(), rules.getLoaderSubstate()), c.step.to);
+       EXPECT_EQ(doorRequests, 2);
+   }
+
+   TEST_F(SafetyCheckTest, DepthLimitStopsTheSearch)
+   {
+       const CheckResult result = check(standardProperties(), CheckOptions { 1, 1 });
+
+       EXPECT_EQ(result.depth, 1u);
+       EXPECT_FALSE(result.fixpoint);
+       EXPECT_EQ(result.steps, kTriggerCount + 1);
+   }
+
+   TEST_F(SafetyCheckTest, FailingPropertyIsReportedAtDepthOne)
+   {
+       static const std::vector<Property> never = {
+           { "never-active", "Active is never entered", [](const CheckStep& s) { return stateOf(s.to) != ISafetyRules::State::Active; } },
+       };
+
+       const CheckResult result = check(never, CheckOptions { 8, 2 });
+
+       ASSERT_EQ(result.violations.size(), 1u);
+       EXPECT_EQ(result.violations[0].trace, std::vector<Trigger> { Trigger::evPowerOn });
+   }
+
+} // namespace Test_SafetyCheck_Namespace
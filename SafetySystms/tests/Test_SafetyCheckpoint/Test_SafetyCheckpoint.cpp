@@ -0,0 +1,352 @@
+#include <gtest/gtest.h>
+#include "SafetyCheckpoint/SafetyCheckpoint.h"
+#include "SafetyFleet/SafetyFleet.h"
+#include "SafetyRules/SafetyRules.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace Test_SafetyCheckpoint_Namespace
+{
+
+   using namespace safety;
+
+   class SafetyCheckpointTest : public ::testing::Test
+   {
+   protected:
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+       using Ev    = ISafetyRules::Event;
+
+       static constexpr Config kReachable[] = {
+           toConfig(State::Idle, Sub::None),
+           toConfig(State::Active, Sub::None),
+           toConfig(State::Faulted, Sub::None),
+           toConfig(State::BuildPlateLoader, Sub::OpenDoor),
+           toConfig(State::BuildPlateLoader, Sub::DoorOpened),
+           toConfig(State::BuildPlateLoader, Sub::BuildPlateLoaded),
+       };
+
+       void TearDown() override
+       {
+           std::remove(path.c_str());
+       }
+
+       // Configurations that tell a generation apart from its neighbours
+       static std::vector<Config> pattern(std::uint64_t generation, std::size_t count)
+       {
+           std::vector<Config> configs(count);
+
+           for (std::size_t i = 0; i < count; ++i)
+           {
+               configs[i] = kReachable[(generation + i / 7) % 6];
+           }
+
+           return configs;
+       }
+
+       // Drives every printer somewhere different
+       static void scramble(SafetyFleet& fleet, unsigned seed)
+       {
+           std::mt19937 rng(seed);
+
+           for (std::uint32_t p = 0; p < fleet.size(); ++p)
+           {
+               for (int k = 0; k < 4; ++k)
+               {
+                   if (rng() % 3 == 0)
+                   {
+                       fleet.startLoader(p);
+                   }
+                   else
+                   {
+                       fleet.dispatch(p, static_cast<Ev>(rng() % 6));
+                   }
+               }
+           }
+       }
+
+       // Where slot s of the file starts
+       off_t slotOffset(std::size_t s)
+       {
+           CheckpointHeader header;
+           std::ifstream in(path, std::ios::binary);
+           in.read(reinterpret_cast<char*>(&header), sizeof(header));
+           return static_cast<off_t>(4096 + s * header.slotBytes);
+       }
+
+       void overwrite(off_t offset, const void* data, std::size_t size)
+       {
+           const int fd = ::open(path.c_str(), O_WRONLY);
+           ASSERT_GE(fd, 0);
+           ASSERT_EQ(::pwrite(fd, data, size, offset), static_cast<ssize_t>(size));
+           ::close(fd);
+       }
+
+   protected:
+       const std::string path = "Test_SafetyCheckpoint." + std::to_string(::getpid()) + ".ckpt";
+   };
+
+   TEST_F(SafetyCheckpointTest, Crc32cMatchesReferenceValue)
+   {
+       EXPECT_EQ(crc32c("123456789", 9), 0xE3069283u);
+
+       // Chaining equals one pass, whichever path (hardware or table) computes it
+       const std::string text = "The quick brown fox jumps over the lazy dog";
+       EXPECT_EQ(crc32c(text.data() + 5, text.size() - 5, crc32c(text.data(), 5)), crc32c(text.data(), text.size()));
+   }
+
+   // A fleet comes back exactly, index included, and no hook fires on restore
+   TEST_F(SafetyCheckpointTest, FleetRoundTrip)
+   {
+       constexpr std::size_t kPrinters = 5000;
+
+       SafetyFleet fleet(kPrinters);
+       scramble(fleet, 1);
+
+       SafetyCheckpoint checkpoint(path, kPrinters);
+       EXPECT_EQ(checkpoint.save(fleet), 1u);
+
+       SafetyFleet restored(kPrinters);
+       int hooks = 0;
+
+       for (std::size_t h = 0; h < kHookCount; ++h)
+       {
+           restored.setHook(static_cast<Hook>(h), [&hooks](std::uint32_t) { ++hooks; });
+       }
+
+       const CheckpointReader reader(path);
+       EXPECT_EQ(reader.generation(), 1u);
+       EXPECT_EQ(reader.size(), kPrinters);
+       EXPECT_NE(reader.timestampNs(), 0u);
+
+       reader.restore(restored);
+
+       EXPECT_EQ(restored.configurations(), fleet.configurations());
+       EXPECT_EQ(hooks, 0);
+
+       for (std::size_t c = 0; c < kConfigCount; ++c)
+       {
+           EXPECT_EQ(restored.index().count(static_cast<Config>(c)), fleet.index().count(static_cast<Config>(c)));
+       }
+
+       // The restored machines carry on from where they were
+       restored.dispatch(0, Ev::evFault);
+       fleet.dispatch(0, Ev::evFault);
+       EXPECT_EQ(restored.getState(0), fleet.getState(0));
+   }
+
+   // SafetyRules restore without the EnterIdle a reset() would fire
+   TEST_F(SafetyCheckpointTest, SafetyRulesRoundTrip)
+   {
+       constexpr std::size_t kMachines = 64;
+
+       std::vector<SafetyRules> machines(kMachines);
+
+       for (std::size_t i = 0; i < kMachines; ++i)
+       {
+           switch (i % 4)
+           {
+           case 1: machines[i].dispatch(Ev::evPowerOn); break;
+           case 2: machines[i].dispatch(Ev::evPowerOn); machines[i].dispatch(Ev::evFault); break;
+           case 3: machines[i].dispatch(Ev::evPowerOn); machines[i].startLoader(); machines[i].dispatch(Ev::evDoorOpened); break;
+           default: break;
+           }
+       }
+
+       SafetyCheckpoint checkpoint(path, kMachines);
+       checkpoint.save(machines.data(), kMachines);
+
+       std::vector<SafetyRules> restored(kMachines);
+       int entered = 0;
+
+       for (auto& m : restored)
+       {
+           m.setOnEnterIdle([&entered]() { ++entered; });
+           m.setOnRequestLoadBuildPlate([&entered]() { ++entered; });
+       }
+
+       CheckpointReader(path).restore(restored.data(), kMachines);
+
+       EXPECT_EQ(entered, 0);
+
+       for (std::size_t i = 0; i < kMachines; ++i)
+       {
+           EXPECT_EQ(restored[i].getState(), machines[i].getState()) << i;
+           EXPECT_EQ(restored[i].getLoaderSubstate(), machines[i].getLoaderSubstate()) << i;
+       }
+
+       restored[3].dispatch(Ev::evBuildPlateLoaded);
+       EXPECT_EQ(restored[3].getLoaderSubstate(), Sub::BuildPlateLoaded);
+   }
+
+   // A reopened file keeps its checkpoints and continues the generations
+   TEST_F(SafetyCheckpointTest, ReopenContinuesGenerations)
+   {
+       {
+           SafetyCheckpoint checkpoint(path, 100);
+
+           for (std::uint64_t g = 1; g <= 3; ++g)
+           {
+               EXPECT_EQ(checkpoint.save(pattern(g, 100).data(), 100), g);
+           }
+       }
+
+       SafetyCheckpoint checkpoint(path, 100);
+       EXPECT_EQ(checkpoint.generation(), 3u);
+       EXPECT_EQ(CheckpointReader(path).generation(), 3u);
+
+       EXPECT_EQ(checkpoint.save(pattern(4, 60).data(), 60), 4u);
+
+       const CheckpointReader reader(path);
+       EXPECT_EQ(reader.generation(), 4u);
+       EXPECT_EQ(std::vector<Config>(reader.begin(), reader.end()), pattern(4, 60));
+
+       // A different capacity starts over
+       SafetyCheckpoint resized(path, 200);
+       EXPECT_EQ(resized.generation(), 0u);
+       EXPECT_THROW(CheckpointReader reader(path), std::runtime_error);
+   }
+
+   // Crash during a save: the slot being written is torn, the other one still holds
+   // the previous checkpoint and restore takes that
+   TEST_F(SafetyCheckpointTest, TornWriteFallsBackToPreviousCheckpoint)
+   {
+       constexpr std::size_t kMachines = 3000;
+
+       {
+           SafetyCheckpoint checkpoint(path, kMachines);
+           checkpoint.save(pattern(1, kMachines).data(), kMachines);
+           checkpoint.save(pattern(2, kMachines).data(), kMachines);
+       }
+
+       // Generation 3 goes to slot 1 (over generation 1). The crash hits after half
+       // its configurations reached the file and before its header did...
+       const off_t slot = slotOffset(1);
+       const std::vector<Config> next = pattern(3, kMachines);
+       overwrite(slot + static_cast<off_t>(sizeof(CheckpointSlot)), next.data(), kMachines / 2);
+
+       {
+           const CheckpointReader reader(path);
+           EXPECT_EQ(reader.generation(), 2u);
+           EXPECT_EQ(std::vector<Config>(reader.begin(), reader.end()), pattern(2, kMachines));
+       }
+
+       // ...or with the header half written: new generation, stale checksum
+       const std::uint64_t generation = 3;
+       overwrite(slot, &generation, sizeof(generation));
+
+       {
+           const CheckpointReader reader(path);
+           EXPECT_EQ(reader.generation(), 2u);
+           EXPECT_EQ(std::vector<Config>(reader.begin(), reader.end()), pattern(2, kMachines));
+       }
+
+       // The restarted writer reuses the torn slot and keeps generation 2 intact
+       SafetyCheckpoint checkpoint(path, kMachines);
+       EXPECT_EQ(checkpoint.generation(), 2u);
+       EXPECT_EQ(checkpoint.save(pattern(3, kMachines).data(), kMachines), 3u);
+
+       const CheckpointReader reader(path);
+       EXPECT_EQ(reader.generation(), 3u);
+       EXPECT_EQ(std::vector<Config>(reader.begin(), reader.end()), pattern(3, kMachines));
+   }
+
+   // A writer killed at random points always leaves a whole checkpoint behind
+   TEST_F(SafetyCheckpointTest, KilledWriterLeavesValidCheckpoint)
+   {
+       constexpr std::size_t kMachines = 1 << 18;
+
+       {
+           SafetyCheckpoint checkpoint(path, kMachines);
+           checkpoint.save(pattern(1, kMachines).data(), kMachines);
+       }
+
+       std::mt19937 rng(3);
+
+       for (int round = 0; round < 8; ++round)
+       {
+           const pid_t child = ::fork();
+           ASSERT_GE(child, 0);
+
+           if (child == 0)
+           {
+               SafetyCheckpoint checkpoint(path, kMachines, false);
+
+               for (;;)
+               {
+                   const std::uint64_t g = checkpoint.generation() + 1;
+                   checkpoint.save(pattern(g, kMachines).data(), kMachines);
+               }
+           }
+
+           std::this_thread::sleep_for(std::chrono::microseconds(2000 + rng() % 20000));
+           ::kill(child, SIGKILL);
+           ::waitpid(child, nullptr, 0);
+
+           const CheckpointReader reader(path);
+           ASSERT_GE(reader.generation(), 1u);
+           ASSERT_EQ(std::vector<Config>(reader.begin(), reader.end()), pattern(reader.generation(), kMachines))
+               << "round " << round << ", generation " << reader.generation();
+       }
+   }
+
+   TEST_F(SafetyCheckpointTest, RejectsBadInput)
+   {
+       EXPECT_THROW(CheckpointReader reader(path), std::system_error);
+
+       {
+           std::ofstream out(path);
+           out << std::string(8192, 'x');
+       }
+
+       EXPECT_THROW(CheckpointReader reader(path), std::runtime_error);
+
+       SafetyCheckpoint checkpoint(path, 10);
+       EXPECT_THROW(CheckpointReader reader(path), std::runtime_error);   // nothing saved yet
+       EXPECT_THROW(checkpoint.save(pattern(1, 11).data(), 11), std::invalid_argument);
+
+       checkpoint.save(pattern(1, 10).data(), 10);
+       SafetyFleet fleet(9);
+       EXPECT_THROW(CheckpointReader(path).restore(fleet), std::invalid_argument);
+   }
+
+   // A header claiming more machines than the file holds is rejected before any
+   // slot is read, however consistent the rest of it looks
+   TEST_F(SafetyCheckpointTest, RejectsCapacityBeyondFile)
+   {
+       // Two saves, so the first slot (the only one whose offset the forged header
+       // leaves in place) holds a valid checkpoint
+       {
+           SafetyCheckpoint checkpoint(path, 10);
+           checkpoint.save(pattern(1, 10).data(), 10);
+           checkpoint.save(pattern(2, 10).data(), 10);
+       }
+
+       const off_t firstSlot = slotOffset(0);
+       const std::uint64_t capacity  = std::uint64_t(1) << 40;
+       const std::uint64_t slotBytes = (sizeof(CheckpointSlot) + capacity + 4095) / 4096 * 4096;
+       overwrite(static_cast<off_t>(offsetof(CheckpointHeader, capacity)), &capacity, sizeof(capacity));
+       overwrite(static_cast<off_t>(offsetof(CheckpointHeader, slotBytes)), &slotBytes, sizeof(slotBytes));
+
+       // ...and that slot a count just within the forged capacity
+       const std::uint64_t count = capacity - 1;
+       overwrite(firstSlot + static_cast<off_t>(offsetof(CheckpointSlot, count)), &count, sizeof(count));
+
+       EXPECT_THROW(CheckpointReader reader(path), std::runtime_error);
+   }
+
+}
@@ -0,0 +1,683 @@
+#include <gtest/gtest.h>
+#include "SafetyBase/MpscRing.h"
+#include "SafetyDispatcher/FleetDispatcher.h"
+#include "SafetyDispatcher/HdrHistogram.h"
+#include "SafetyDispatcher/LatencyTracer.h"
+#include "SafetyDispatcher/SafetyDispatcher.h"
+#include "SafetyRules/SafetyRules.h"
+
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Test_SafetyDispatcher_Namespace
+{
+
+   using namespace safety;
+
+   class SafetyDispatcherTest : public ::testing::Test
+   {
+   protected:
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+       using Ev    = ISafetyRules::Event;
+
+       static constexpr unsigned kProducers = 8;
+
+       void SetUp() override
+       {
+           uut.setOnEnterFaulted([this]() { onEnterFaultedCount++; checkThread(); });
+           uut.setOnEnterActive([this]()  { onEnterActiveCount++;  checkThread(); });
+       }
+
+       void checkThread()
+       {
+           if (dispatcherThread == std::thread::id())
+           {
+               dispatcherThread = std::this_thread::get_id();
+           }
+
+           if (dispatcherThread != std::this_thread::get_id())
+           {
+               wrongThread = true;
+           }
+       }
+
+       template <typename Fn>
+       void runProducers(Fn&& produce)
+       {
+           std::vector<std::thread> producers;
+
+           for (unsigned p = 0; p < kProducers; ++p)
+           {
+               producers.emplace_back([&produce, p]() { produce(p); });
+           }
+
+           for (auto& t : producers)
+           {
+               t.join();
+           }
+       }
+
+   protected:
+       SafetyRules uut;
+
+       int onEnterFaultedCount{0};
+       int onEnterActiveCount{0};
+
+       std::thread::id dispatcherThread;
+       bool wrongThread{false};
+   };
+
+   // Items from each producer come out in the order that producer pushed them
+   TEST_F(SafetyDispatcherTest, RingPreservesPerProducerOrder)
+   {
+       constexpr std::uint64_t kPerProducer = 50000;
+       MpscRing<std::uint64_t> ring(256);
+
+       std::atomic<bool> done{false};
+       std::vector<std::uint64_t> next(kProducers, 0);
+       std::uint64_t received = 0;
+       bool ordered = true;
+
+       std::thread consumer([&]() {
+           std::uint64_t item;
+
+           while (!done.load() || ring.size() != 0)
+           {
+               while (ring.tryPop(item))
+               {
+                   const auto producer = item >> 32;
+                   const auto seq = item & 0xffffffff;
+                   ordered = ordered && (seq == next[producer]);
+                   next[producer] = seq + 1;
+                   ++received;
+               }
+
+               std::this_thread::yield();
+           }
+       });
+
+       runProducers([&ring](unsigned p) {
+           for (std::uint64_t i = 0; i < kPerProducer; ++i)
+           {
+               while (!ring.tryPush(std::uint64_t(p) << 32 | i))
+               {
+                   std::this_thread::yield();
+               }
+           }
+       });
+
+       done = true;
+       consumer.join();
+
+       EXPECT_TRUE(ordered);
+       EXPECT_EQ(received, kPerProducer * kProducers);
+   }
+
+   // Full ring rejects pushes and accepts again once drained
+   TEST_F(SafetyDispatcherTest, RingRejectsWhenFull)
+   {
+       MpscRing<int> ring(4);
+       ASSERT_EQ(ring.capacity(), 4u);
+
+       for (int i = 0; i < 4; ++i)
+       {
+           EXPECT_TRUE(ring.tryPush(i));
+       }
+
+       EXPECT_FALSE(ring.tryPush(99));
+       EXPECT_EQ(ring.size(), 4u);
+
+       int item = -1;
+       EXPECT_TRUE(ring.tryPop(item));
+       EXPECT_EQ(item, 0);
+       EXPECT_TRUE(ring.tryPush(4));
+   }
+
+   // Posts made before start() wait in the ring; overflow is counted as dropped
+   TEST_F(SafetyDispatcherTest, CountsDropsAndDepth)
+   {
+       SafetyDispatcher dispatcher(uut, 8);
+
+       for (int i = 0; i < 8; ++i)
+       {
+           EXPECT_TRUE(dispatcher.post(Ev::evDoorOpened));
+       }
+
+       EXPECT_FALSE(dispatcher.post(Ev::evPowerOn));
+
+       auto stats = dispatcher.stats();
+       EXPECT_EQ(stats.depth, 8u);
+       EXPECT_EQ(stats.dropped, 1u);
+       EXPECT_EQ(stats.dispatched, 0u);
+
+       dispatcher.start();
+       dispatcher.stop();
+
+       stats = dispatcher.stats();
+       EXPECT_EQ(stats.depth, 0u);
+       EXPECT_EQ(stats.dispatched, 8u);
+       EXPECT_EQ(stats.peakDepth, 8u);
+       EXPECT_EQ(uut.getState(), State::Idle); // evPowerOn was the dropped one
+   }
+
+   // Loader start goes through the same queue, in order with events
+   TEST_F(SafetyDispatcherTest, PostedLoaderCycle)
+   {
+       SafetyDispatcher dispatcher(uut);
+       dispatcher.start();
+
+       dispatcher.post(Ev::evPowerOn);
+       dispatcher.postStartLoader();
+       dispatcher.post(Ev::evDoorOpened);
+       dispatcher.post(Ev::evBuildPlateLoaded);
+       dispatcher.stop();
+
+       EXPECT_EQ(uut.getState(), State::BuildPlateLoader);
+       EXPECT_EQ(uut.getLoaderSubstate(), Sub::BuildPlateLoaded);
+       EXPECT_EQ(dispatcher.stats().dispatched, 4u);
+   }
+
+   // Many producers hammer one machine; every accepted post is dispatched exactly
+   // once, on the dispatcher thread
+   TEST_F(SafetyDispatcherTest, StressManyProducers)
+   {
+       constexpr int kCyclesPerProducer = 20000;
+
+       SafetyDispatcher dispatcher(uut, 256);
+       dispatcher.start();
+
+       std::atomic<std::uint64_t> accepted{0};
+       std::atomic<std::uint64_t> rejected{0};
+
+       runProducers([&](unsigned) {
+           for (int i = 0; i < kCyclesPerProducer; ++i)
+           {
+               for (Ev ev : { Ev::evPowerOn, Ev::evFault })
+               {
+                   if (dispatcher.post(ev))
+                   {
+                       accepted++;
+                   }
+                   else
+                   {
+                       rejected++;
+                   }
+               }
+           }
+       });
+
+       dispatcher.stop();
+
+       // Accepted posts are dispatched once or superseded by a fault posted after them
+       const auto stats = dispatcher.stats();
+       EXPECT_EQ(stats.dispatched + stats.superseded, accepted.load());
+       EXPECT_EQ(stats.dropped, rejected.load());
+       EXPECT_EQ(stats.dispatched + stats.superseded + stats.dropped, std::uint64_t(kProducers) * kCyclesPerProducer * 2);
+       EXPECT_LE(stats.peakDepth, dispatcher.capacity());
+       EXPECT_FALSE(wrongThread);
+       EXPECT_GT(onEnterActiveCount, 0);
+       EXPECT_GE(onEnterActiveCount, onEnterFaultedCount);
+   }
+
+   // ----- Priority lane
+
+   // A fault posted behind a full backlog is delivered first, and the backlog it
+   // supersedes is never seen by the machine
+   TEST_F(SafetyDispatcherTest, FaultPreemptsBacklog)
+   {
+       int loaderEntries = 0;
+       uut.setOnEnterBuildPlateLoader([&loaderEntries]() { loaderEntries++; });
+       uut.dispatch(Ev::evPowerOn);
+       onEnterActiveCount = 0;
+
+       SafetyDispatcher dispatcher(uut, 1024);
+       dispatcher.postStartLoader();
+
+       for (int i = 0; i < 1000; ++i)
+       {
+           dispatcher.post(i % 2 ? Ev::evDoorOpened : Ev::evBuildPlateLoaded);
+       }
+
+       EXPECT_TRUE(dispatcher.post(Ev::evFault));
+       EXPECT_EQ(dispatcher.stats().depth, 1002u);
+
+       dispatcher.start();
+       dispatcher.stop();
+
+       const auto stats = dispatcher.stats();
+       EXPECT_EQ(uut.getState(), State::Faulted);
+       EXPECT_EQ(loaderEntries, 0);
+       EXPECT_EQ(onEnterFaultedCount, 1);
+       EXPECT_EQ(stats.dispatched, 1u);
+       EXPECT_EQ(stats.urgent, 1u);
+       EXPECT_EQ(stats.superseded, 1001u);
+       EXPECT_GT(stats.worstUrgentNs, 0u);
+   }
+
+   // Only what was posted before the fault is stale: a later power-on still runs
+   TEST_F(SafetyDispatcherTest, PostsAfterFaultAreKept)
+   {
+       uut.dispatch(Ev::evPowerOn);
+       onEnterActiveCount = 0;
+
+       SafetyDispatcher dispatcher(uut);
+       dispatcher.post(Ev::evDoorOpened);
+       dispatcher.post(Ev::evFault);
+       dispatcher.post(Ev::evPowerOn);
+
+       dispatcher.start();
+       dispatcher.stop();
+
+       EXPECT_EQ(uut.getState(), State::Active);
+       EXPECT_EQ(onEnterFaultedCount, 1);
+       EXPECT_EQ(onEnterActiveCount, 1);
+       EXPECT_EQ(dispatcher.stats().superseded, 1u);
+   }
+
+   // A fault the machine would ignore now waits for the power-on posted before it,
+   // and does not supersede it
+   TEST_F(SafetyDispatcherTest, IgnoredFaultKeepsPostingOrder)
+   {
+       SafetyDispatcher dispatcher(uut);
+       dispatcher.post(Ev::evPowerOn);
+       dispatcher.post(Ev::evFault);
+
+       dispatcher.start();
+       dispatcher.stop();
+
+       const auto stats = dispatcher.stats();
+       EXPECT_EQ(uut.getState(), State::Faulted);
+       EXPECT_EQ(onEnterActiveCount, 1);
+       EXPECT_EQ(onEnterFaultedCount, 1);
+       EXPECT_EQ(stats.dispatched, 2u);
+       EXPECT_EQ(stats.urgent, 1u);
+       EXPECT_EQ(stats.superseded, 0u);
+   }
+
+   // evPowerOff takes the priority lane only when configured to
+   TEST_F(SafetyDispatcherTest, PowerOffLaneIsConfigurable)
+   {
+       for (bool urgentPowerOff : { false, true })
+       {
+           SafetyRules rules;
+           rules.dispatch(Ev::evPowerOn);
+
+           SafetyDispatcher dispatcher(rules, 64, urgentPowerOff);
+           dispatcher.postStartLoader();
+           dispatcher.post(Ev::evPowerOff);
+
+           dispatcher.start();
+           dispatcher.stop();
+
+           // Normal lane: loader starts, then power-off is ignored inside the loader
+           EXPECT_EQ(rules.getState(), urgentPowerOff ? State::Idle : State::BuildPlateLoader);
+           EXPECT_EQ(dispatcher.stats().urgent, urgentPowerOff ? 1u : 0u);
+           EXPECT_EQ(dispatcher.stats().superseded, urgentPowerOff ? 1u : 0u);
+       }
+   }
+
+   // ----- Ingress filter
+
+   // With nothing queued, posts the machine would ignore never take a slot
+   TEST_F(SafetyDispatcherTest, IngressFilterDropsNoOps)
+   {
+       SafetyDispatcher dispatcher(uut, 8);
+       dispatcher.setIngressFilter(true);
+
+       for (int i = 0; i < 100; ++i)
+       {
+           EXPECT_TRUE(dispatcher.post(Ev::evDoorOpened));
+       }
+
+       EXPECT_TRUE(dispatcher.post(Ev::evFault));
+       EXPECT_TRUE(dispatcher.postStartLoader());
+       EXPECT_EQ(dispatcher.stats().depth, 0u);
+
+       // Behind a queued evPowerOn the machine will be Active: nothing is filtered
+       EXPECT_TRUE(dispatcher.post(Ev::evPowerOn));
+       EXPECT_TRUE(dispatcher.postStartLoader());
+       EXPECT_EQ(dispatcher.stats().depth, 2u);
+
+       dispatcher.start();
+       dispatcher.stop();
+
+       EXPECT_EQ(uut.getState(), State::BuildPlateLoader);
+
+       // Caught up again: the loader ignores power-on
+       EXPECT_TRUE(dispatcher.post(Ev::evPowerOn));
+
+       const auto stats = dispatcher.stats();
+       EXPECT_EQ(stats.dispatched, 2u);
+       EXPECT_EQ(stats.filtered, 103u);
+       EXPECT_EQ(stats.filteredByTrigger[static_cast<std::size_t>(Trigger::evDoorOpened)], 100u);
+       EXPECT_EQ(stats.filteredByTrigger[static_cast<std::size_t>(Trigger::evPowerOn)], 1u);
+   }
+
+   // Filtering is exact: one producer's random stream ends in the same configuration,
+   // with the same hooks fired, as feeding it straight to a machine
+   TEST_F(SafetyDispatcherTest, IngressFilterMatchesDirectDispatch)
+   {
+       constexpr int kLength = 100000;
+       constexpr Trigger kStream[] = {
+           Trigger::evPowerOn, Trigger::evPowerOff, Trigger::evDoorOpened,
+           Trigger::evBuildPlateLoaded, Trigger::evDoorClosed, Trigger::StartLoader
+       };
+
+       std::mt19937 rng(7);
+       std::vector<Trigger> stream(kLength);
+
+       for (auto& t : stream)
+       {
+           t = kStream[rng() % 6];
+       }
+
+       SafetyRules reference;
+       int referenceActive = 0;
+       reference.setOnEnterActive([&referenceActive]() { referenceActive++; });
+
+       for (Trigger t : stream)
+       {
+           t == Trigger::StartLoader ? reference.startLoader() : reference.dispatch(static_cast<Ev>(t));
+       }
+
+       SafetyDispatcher dispatcher(uut, 64);
+       dispatcher.setIngressFilter(true);
+       dispatcher.start();
+
+       for (Trigger t : stream)
+       {
+           while (!(t == Trigger::StartLoader ? dispatcher.postStartLoader() : dispatcher.post(static_cast<Ev>(t))))
+           {
+               std::this_thread::yield();
+           }
+       }
+
+       dispatcher.stop();
+
+       const auto stats = dispatcher.stats();
+       EXPECT_EQ(stats.dispatched + stats.filtered, std::uint64_t(kLength));
+       EXPECT_GT(stats.filtered, 0u);
+       EXPECT_EQ(uut.getState(), reference.getState());
+       EXPECT_EQ(uut.getLoaderSubstate(), reference.getLoaderSubstate());
+       EXPECT_EQ(onEnterActiveCount, referenceActive);
+   }
+
+   // ----- Latency tracing
+
+   // Every value lands in a bucket no wider than 1/64 of it; quantiles stay within that
+   TEST_F(SafetyDispatcherTest, HdrHistogramBucketsAndQuantiles)
+   {
+       std::mt19937_64 rng(7);
+
+       for (int i = 0; i < 100000; ++i)
+       {
+           const std::uint64_t v = rng() >> (28 + rng() % 36);
+           const std::size_t index = HdrHistogram::indexOf(v);
+
+           ASSERT_LT(index, HdrHistogram::kBucketCount);
+           ASSERT_LE(HdrHistogram::lowestOf(index), v);
+           ASSERT_GE(HdrHistogram::highestOf(index), v);
+           ASSERT_LE(HdrHistogram::highestOf(index) - HdrHistogram::lowestOf(index), v / 64);
+       }
+
+       HdrHistogram h;
+       EXPECT_EQ(h.valueAtQuantile(0.99), 0u);
+
+       for (std::uint64_t v = 1; v <= 10000; ++v)
+       {
+           h.record(v);
+       }
+
+       EXPECT_EQ(h.count(), 10000u);
+       EXPECT_EQ(h.min(), 1u);
+       EXPECT_EQ(h.max(), 10000u);
+       EXPECT_DOUBLE_EQ(h.mean(), 5000.5);
+       EXPECT_NEAR(double(h.valueAtQuantile(0.5)), 5000.0, 5000.0 / 64);
+       EXPECT_NEAR(double(h.valueAtQuantile(0.99)), 9900.0, 9900.0 / 64);
+       EXPECT_EQ(h.valueAtQuantile(1.0), 10000u);
+   }
+
+   // Posts are timed to each hook of their step; the installed hooks still run
+   TEST_F(SafetyDispatcherTest, TracerTimesPostToHook)
+   {
+       LatencyTracer tracer;
+       tracer.attach(uut);
+
+       SafetyDispatcher dispatcher(uut);
+       dispatcher.setTracer(&tracer);
+       dispatcher.start();
+
+       dispatcher.post(Ev::evPowerOn);
+       dispatcher.postStartLoader();
+       dispatcher.post(Ev::evDoorOpened);
+       dispatcher.stop();
+
+       EXPECT_EQ(onEnterActiveCount, 1);
+       EXPECT_FALSE(wrongThread);
+
+       EXPECT_EQ(tracer.path(Trigger::evPowerOn, Hook::ExitIdle).count(), 1u);
+       EXPECT_EQ(tracer.path(Trigger::evPowerOn, Hook::EnterActive).count(), 1u);
+       EXPECT_EQ(tracer.path(Trigger::StartLoader, Hook::RequestDoorOpen).count(), 1u);
+       EXPECT_EQ(tracer.path(Trigger::evDoorOpened, Hook::RequestLoadBuildPlate).count(), 1u);
+       EXPECT_EQ(tracer.path(Trigger::evPowerOn, Hook::EnterFaulted).count(), 0u);
+       EXPECT_EQ(tracer.unattributed(), 0u);
+
+       // The hook fires after the step starts, which is after the post
+       EXPECT_EQ(tracer.queueLatency(Trigger::evPowerOn).count(), 1u);
+       EXPECT_GE(tracer.path(Trigger::evPowerOn, Hook::EnterActive).max(), tracer.queueLatency(Trigger::evPowerOn).max());
+   }
+
+   TEST_F(SafetyDispatcherTest, TracerExportsTextAndJson)
+   {
+       LatencyTracer tracer;
+       tracer.attach(uut);
+
+       for (int i = 0; i < 100; ++i)
+       {
+           tracer.beginStep(Trigger::evPowerOn, LatencyTracer::now());
+           uut.dispatch(Ev::evPowerOn);
+           tracer.endStep();
+
+           tracer.beginStep(Trigger::evPowerOff, LatencyTracer::now());
+           uut.dispatch(Ev::evPowerOff);
+           tracer.endStep();
+       }
+
+       EXPECT_GT(tracer.nsPerTick(), 0.0);
+
+       std::ostringstream text;
+       tracer.writeText(text);
+       EXPECT_NE(text.str().find("evPowerOn -> EnterActive  count=100 "), std::string::npos);
+       EXPECT_NE(text.str().find("evPowerOff -> EnterIdle  count=100 "), std::string::npos);
+       EXPECT_NE(text.str().find("p99.99="), std::string::npos);
+       EXPECT_EQ(text.str().find("startLoader ->"), std::string::npos);
+
+       std::ostringstream json;
+       tracer.writeJson(json);
+       EXPECT_EQ(json.str().front(), '{');
+       EXPECT_NE(json.str().find("{\"trigger\":\"evPowerOn\",\"hook\":\"EnterActive\",\"count\":100,"), std::string::npos);
+       EXPECT_NE(json.str().find("\"buckets\":[["), std::string::npos);
+   }
+
+   TEST_F(SafetyDispatcherTest, TracerDetachRestoresHooks)
+   {
+       LatencyTracer tracer;
+       tracer.attach(uut);
+       tracer.detach(uut);
+
+       tracer.beginStep(Trigger::evPowerOn, LatencyTracer::now());
+       uut.dispatch(Ev::evPowerOn);
+       tracer.endStep();
+
+       EXPECT_EQ(onEnterActiveCount, 1);
+       EXPECT_EQ(tracer.path(Trigger::evPowerOn, Hook::EnterActive).count(), 0u);
+   }
+
+   // A post stamped before the tracer was set (ingress 0) is not timed at all
+   TEST_F(SafetyDispatcherTest, TracerSkipsUnstampedPosts)
+   {
+       LatencyTracer tracer;
+       tracer.attach(uut);
+
+       tracer.beginStep(Trigger::evPowerOn, 0);
+       uut.dispatch(Ev::evPowerOn);
+       tracer.endStep();
+
+       EXPECT_EQ(onEnterActiveCount, 1);
+       EXPECT_EQ(tracer.queueLatency(Trigger::evPowerOn).count(), 0u);
+       EXPECT_EQ(tracer.path(Trigger::evPowerOn, Hook::EnterActive).count(), 0u);
+   }
+
+   // ----- FleetDispatcher
+
+   void countPrinter(void* counts, std::uint32_t printer)
+   {
+       (*static_cast<std::vector<std::atomic<int>>*>(counts))[printer]++;
+   }
+
+   // Per-printer trigger script, the same for the dispatcher and the reference
+   std::vector<Trigger> printerScript(std::uint32_t printer, std::size_t length)
+   {
+       std::mt19937 rng(printer + 1);
+       std::vector<Trigger> script(length);
+
+       for (auto& t : script)
+       {
+           t = static_cast<Trigger>(rng() % kTriggerCount);
+       }
+
+       return script;
+   }
+
+   bool postTrigger(FleetDispatcher& dispatcher, std::uint32_t printer, Trigger trigger)
+   {
+       return trigger == Trigger::StartLoader ? dispatcher.postStartLoader(printer)
+                                              : dispatcher.post(printer, static_cast<ISafetyRules::Event>(trigger));
+   }
+
+   // Several producers and workers, shards stolen back and forth: every printer ends
+   // where a SafetyRules fed its own events in order ends
+   TEST_F(SafetyDispatcherTest, FleetPreservesPerPrinterOrder)
+   {
+       constexpr std::uint32_t kPrinters = 5000;
+       constexpr std::size_t kLength = 40;
+
+       FleetDispatcher dispatcher(kPrinters, 4, 16, 64);
+       dispatcher.start();
+
+       runProducers([&](unsigned producer) {
+           std::vector<std::vector<Trigger>> scripts;
+
+           for (std::uint32_t p = producer; p < kPrinters; p += kProducers)
+           {
+               scripts.push_back(printerScript(p, kLength));
+           }
+
+           for (std::size_t i = 0; i < kLength; ++i)
+           {
+               std::size_t n = 0;
+
+               for (std::uint32_t p = producer; p < kPrinters; p += kProducers, ++n)
+               {
+                   while (!postTrigger(dispatcher, p, scripts[n][i]))
+                   {
+                       std::this_thread::yield();
+                   }
+               }
+           }
+       });
+
+       dispatcher.stop();
+
+       for (std::uint32_t p = 0; p < kPrinters; ++p)
+       {
+           SafetyRules reference;
+
+           for (Trigger t : printerScript(p, kLength))
+           {
+               if (t == Trigger::StartLoader) reference.startLoader();
+               else                           reference.dispatch(static_cast<Ev>(t));
+           }
+
+           ASSERT_EQ(dispatcher.getState(p), reference.getState()) << "printer " << p;
+           ASSERT_EQ(dispatcher.getLoaderSubstate(p), reference.getLoaderSubstate()) << "printer " << p;
+       }
+
+       const auto stats = dispatcher.stats();
+       EXPECT_EQ(stats.dispatched, std::uint64_t(kPrinters) * kLength);
+       EXPECT_GT(stats.claims, 0u);
+   }
+
+   // Hooks see global printer ids, whichever shard the printer lives in
+   TEST_F(SafetyDispatcherTest, FleetHooksReceiveGlobalIds)
+   {
+       constexpr std::uint32_t kPrinters = 1000;
+
+       FleetDispatcher dispatcher(kPrinters, 2, 8);
+       std::vector<std::atomic<int>> loads(kPrinters);
+
+       dispatcher.setHook(Hook::RequestDoorOpen,
+                          FleetDispatcher::PrinterFn::bind<&countPrinter>(&loads));
+       dispatcher.start();
+
+       for (std::uint32_t p = 0; p < kPrinters; p += 3)
+       {
+           while (!dispatcher.post(p, Ev::evPowerOn)) std::this_thread::yield();
+           while (!dispatcher.postStartLoader(p)) std::this_thread::yield();
+       }
+
+       dispatcher.stop();
+
+       for (std::uint32_t p = 0; p < kPrinters; ++p)
+       {
+           EXPECT_EQ(loads[p].load(), p % 3 == 0 ? 1 : 0) << "printer " << p;
+           EXPECT_EQ(dispatcher.getState(p), p % 3 == 0 ? State::BuildPlateLoader : State::Idle);
+       }
+   }
+
+   // A full shard ring rejects and counts; nothing is lost silently
+   TEST_F(SafetyDispatcherTest, FleetCountsDrops)
+   {
+       FleetDispatcher dispatcher(4, 1, 1, 8);   // not started: nothing drains
+
+       int accepted = 0;
+
+       for (int i = 0; i < 20; ++i)
+       {
+           accepted += dispatcher.post(static_cast<std::uint32_t>(i % 4), Ev::evPowerOn) ? 1 : 0;
+       }
+
+       EXPECT_EQ(accepted, 8);
+       EXPECT_EQ(dispatcher.stats().dropped, 12u);
+
+       dispatcher.start();
+       dispatcher.stop();
+
+       EXPECT_EQ(dispatcher.stats().dispatched, 8u);
+       EXPECT_EQ(dispatcher.getState(3), State::Active);
+   }
+
+   // A printer id past the fleet is rejected and counted, in release builds too
+   TEST_F(SafetyDispatcherTest, FleetRejectsUnknownPrinter)
+   {
+       FleetDispatcher dispatcher(4, 1, 2, 8);
+
+       EXPECT_FALSE(dispatcher.post(4, Ev::evPowerOn));
+       EXPECT_FALSE(dispatcher.postStartLoader(0xffffffffu));
+       EXPECT_TRUE(dispatcher.post(3, Ev::evPowerOn));
+       EXPECT_EQ(dispatcher.stats().dropped, 2u);
+
+       dispatcher.start();
+       dispatcher.stop();
+
+       EXPECT_EQ(dispatcher.stats().dispatched, 1u);
+       EXPECT_EQ(dispatcher.getState(3), State::Active);
+   }
+
+}
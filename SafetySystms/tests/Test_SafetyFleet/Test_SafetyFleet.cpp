@@ -0,0 +1,361 @@
+#include <gtest/gtest.h>
+#include "SafetyFleet/FleetIndex.h"
+#include "SafetyFleet/SafetyFleet.h"
+#include "SafetyRules/SafetyRules.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace Test_SafetyFleet_Namespace
+{
+
+   using namespace safety;
+
+   // Runs a SafetyFleet and one SafetyRules per printer side by side and records,
+   // per printer, every hook fired together with the configuration it observed.
+   class SafetyFleetTest : public ::testing::Test
+   {
+   protected:
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+       using Ev    = ISafetyRules::Event;
+
+       struct Fired
+       {
+           Hook   hook;
+           Config observed;
+
+           bool operator==(const Fired& other) const
+           {
+               return hook == other.hook && observed == other.observed;
+           }
+       };
+
+       struct Recorder
+       {
+           SafetyFleetTest* test;
+           std::uint32_t    printer;
+           Hook             hook;
+       };
+
+       void build(std::size_t printers)
+       {
+           fleet = std::make_unique<SafetyFleet>(printers);
+           fleetLog.assign(printers, {});
+           rulesLog.assign(printers, {});
+           recorders.clear();
+           recorders.reserve(printers * kHookCount);
+           rules.clear();
+
+           for (std::size_t h = 0; h < kHookCount; ++h)
+           {
+               fleetHooks[h] = Recorder { this, 0, static_cast<Hook>(h) };
+               fleet->setHook(static_cast<Hook>(h),
+                              [r = &fleetHooks[h]](std::uint32_t printer) {
+                                  const Config observed = toConfig(r->test->fleet->getState(printer),
+                                                                   r->test->fleet->getLoaderSubstate(printer));
+                                  r->test->fleetLog[printer].push_back(Fired { r->hook, observed });
+                                  r->test->staleIndex |= !r->test->fleet->index().contains(printer, observed);
+                              });
+           }
+
+           for (std::uint32_t p = 0; p < printers; ++p)
+           {
+               rules.push_back(std::make_unique<SafetyRules>());
+               wire(*rules.back(), p);
+           }
+       }
+
+       void wire(SafetyRules& r, std::uint32_t printer)
+       {
+           auto slot = [this, printer](Hook h) {
+               recorders.push_back(Recorder { this, printer, h });
+               return &recorders.back();
+           };
+
+           auto hook = [](Recorder* rec) {
+               return ISafetyRules::VoidFn([rec]() {
+                   const SafetyRules& r = *rec->test->rules[rec->printer];
+                   rec->test->rulesLog[rec->printer].push_back(
+                       Fired { rec->hook, toConfig(r.getState(), r.getLoaderSubstate()) });
+               });
+           };
+
+           r.setOnEnterIdle(hook(slot(Hook::EnterIdle)));
+           r.setOnExitIdle(hook(slot(Hook::ExitIdle)));
+           r.setOnEnterActive(hook(slot(Hook::EnterActive)));
+           r.setOnExitActive(hook(slot(Hook::ExitActive)));
+           r.setOnEnterFaulted(hook(slot(Hook::EnterFaulted)));
+           r.setOnExitFaulted(hook(slot(Hook::ExitFaulted)));
+           r.setOnEnterBuildPlateLoader(hook(slot(Hook::EnterBuildPlateLoader)));
+           r.setOnExitBuildPlateLoader(hook(slot(Hook::ExitBuildPlateLoader)));
+           r.setOnRequestDoorOpen(hook(slot(Hook::RequestDoorOpen)));
+           r.setOnRequestLoadBuildPlate(hook(slot(Hook::RequestLoadBuildPlate)));
+           r.setOnRequestDoorClose(hook(slot(Hook::RequestDoorClose)));
+       }
+
+       void expectSame()
+       {
+           for (std::uint32_t p = 0; p < rules.size(); ++p)
+           {
+               ASSERT_EQ(fleet->getState(p), rules[p]->getState()) << "printer " << p;
+               ASSERT_EQ(fleet->getLoaderSubstate(p), rules[p]->getLoaderSubstate()) << "printer " << p;
+               ASSERT_TRUE(fleetLog[p] == rulesLog[p]) << "hook trace differs for printer " << p;
+           }
+
+           expectIndexed();
+       }
+
+       // The index agrees with a scan of every printer
+       void expectIndexed()
+       {
+           const FleetIndex& index = fleet->index();
+           std::array<std::vector<std::uint32_t>, kConfigCount> scanned;
+
+           for (std::uint32_t p = 0; p < fleet->size(); ++p)
+           {
+               scanned[fleet->configurations()[p]].push_back(p);
+           }
+
+           for (std::size_t c = 0; c < kConfigCount; ++c)
+           {
+               const Config config = static_cast<Config>(c);
+               std::vector<std::uint32_t> listed;
+               index.forEach(stateOf(config), subOf(config), [&listed](std::uint32_t p) { listed.push_back(p); });
+
+               ASSERT_EQ(index.count(config), scanned[c].size()) << "config " << c;
+               ASSERT_EQ(listed, scanned[c]) << "config " << c;
+           }
+
+           for (State state : { State::Idle, State::Active, State::Faulted, State::BuildPlateLoader })
+           {
+               std::size_t listed = 0;
+               index.forEach(state, [&listed](std::uint32_t) { ++listed; });
+
+               ASSERT_EQ(index.count(state), listed);
+           }
+
+           ASSERT_FALSE(staleIndex) << "a hook saw a configuration the index did not have";
+       }
+
+   protected:
+       std::unique_ptr<SafetyFleet>              fleet;
+       std::vector<std::unique_ptr<SafetyRules>> rules;
+
+       std::array<Recorder, kHookCount> fleetHooks {};
+       std::vector<Recorder>            recorders;
+
+       std::vector<std::vector<Fired>> fleetLog;
+       std::vector<std::vector<Fired>> rulesLog;
+       bool                            staleIndex { false };
+   };
+
+   // Per-printer scalar calls walk the loader cycle like SafetyRules
+   TEST_F(SafetyFleetTest, ScalarLoaderCycle)
+   {
+       build(3);
+
+       fleet->dispatch(1, Ev::evPowerOn);
+       fleet->startLoader(1);
+       fleet->dispatch(1, Ev::evDoorOpened);
+
+       EXPECT_EQ(fleet->getState(0), State::Idle);
+       EXPECT_EQ(fleet->getState(1), State::BuildPlateLoader);
+       EXPECT_EQ(fleet->getLoaderSubstate(1), Sub::DoorOpened);
+       // Exit Idle, enter Active, exit Active, enter Loader, request door open, request load
+       EXPECT_EQ(fleetLog[1].size(), 6u);
+       EXPECT_TRUE(fleetLog[0].empty());
+   }
+
+   // Random batches over a random fleet match per-object SafetyRules exactly,
+   // including duplicate printers inside one SIMD block and the scalar tail
+   TEST_F(SafetyFleetTest, DifferentialAgainstSafetyRules)
+   {
+       constexpr std::size_t kPrinters = 97;
+       build(kPrinters);
+
+       std::mt19937 rng(42);
+       std::uniform_int_distribution<std::uint32_t> pickPrinter(0, kPrinters - 1);
+       std::uniform_int_distribution<int> pickEvent(0, 5);
+       std::uniform_int_distribution<int> pickBatch(1, 200);
+
+       for (int round = 0; round < 500; ++round)
+       {
+           // Some printers start their loader between batches
+           for (int k = 0; k < 10; ++k)
+           {
+               const auto p = pickPrinter(rng);
+               fleet->startLoader(p);
+               rules[p]->startLoader();
+           }
+
+           // Odd rounds: distinct printers, so every full block of 16 takes the SIMD path
+           const bool distinct = round % 2 == 1;
+           const int n = distinct ? pickBatch(rng) % kPrinters + 1 : pickBatch(rng);
+           std::vector<std::uint32_t> ids(n);
+           std::vector<Ev> events(n);
+
+           std::vector<std::uint32_t> order(kPrinters);
+           std::iota(order.begin(), order.end(), 0u);
+           std::shuffle(order.begin(), order.end(), rng);
+
+           for (int i = 0; i < n; ++i)
+           {
+               ids[i] = distinct ? order[i] : pickPrinter(rng);
+               events[i] = static_cast<Ev>(pickEvent(rng));
+           }
+
+           fleet->dispatchBatch(ids.data(), events.data(), ids.size());
+
+           for (int i = 0; i < n; ++i)
+           {
+               rules[ids[i]]->dispatch(events[i]);
+           }
+
+           expectSame();
+       }
+   }
+
+   // A batch of distinct printers takes the SIMD path; ignored events fire nothing
+   TEST_F(SafetyFleetTest, IgnoredEventsFireNoHooks)
+   {
+       build(32);
+
+       std::vector<std::uint32_t> ids(32);
+       std::vector<Ev> events(32, Ev::evDoorClosed); // ignored in Idle
+
+       for (std::uint32_t p = 0; p < 32; ++p)
+       {
+           ids[p] = p;
+       }
+
+       fleet->dispatchBatch(ids.data(), events.data(), ids.size());
+
+       for (std::uint32_t p = 0; p < 32; ++p)
+       {
+           EXPECT_EQ(fleet->getState(p), State::Idle);
+           EXPECT_TRUE(fleetLog[p].empty());
+       }
+
+       std::fill(events.begin(), events.end(), Ev::evPowerOn);
+       fleet->dispatchBatch(ids.data(), events.data(), ids.size());
+
+       for (std::uint32_t p = 0; p < 32; ++p)
+       {
+           EXPECT_EQ(fleet->getState(p), State::Active);
+           EXPECT_EQ(fleetLog[p].size(), 2u);
+       }
+   }
+
+   // Trigger batches mix StartLoader with events and match SafetyRules step for step
+   TEST_F(SafetyFleetTest, TriggerBatchMatchesSafetyRules)
+   {
+       constexpr std::size_t kPrinters = 48;
+       build(kPrinters);
+
+       std::mt19937 rng(11);
+       std::uniform_int_distribution<std::uint32_t> pickPrinter(0, kPrinters - 1);
+       std::uniform_int_distribution<int> pickTrigger(0, static_cast<int>(kTriggerCount) - 1);
+
+       for (int round = 0; round < 200; ++round)
+       {
+           // Odd rounds: distinct printers, so every full block of 16 takes the SIMD path
+           const bool distinct = round % 2 == 1;
+           std::vector<std::uint32_t> order(kPrinters);
+           std::iota(order.begin(), order.end(), 0u);
+           std::shuffle(order.begin(), order.end(), rng);
+
+           const std::size_t n = distinct ? kPrinters : 64;
+           std::vector<std::uint32_t> ids(n);
+           std::vector<Trigger> triggers(n);
+
+           for (std::size_t i = 0; i < n; ++i)
+           {
+               ids[i] = distinct ? order[i] : pickPrinter(rng);
+               triggers[i] = static_cast<Trigger>(pickTrigger(rng));
+           }
+
+           fleet->dispatchBatch(ids.data(), triggers.data(), n);
+
+           for (std::size_t i = 0; i < n; ++i)
+           {
+               if (triggers[i] == Trigger::StartLoader)
+               {
+                   rules[ids[i]]->startLoader();
+               }
+               else
+               {
+                   rules[ids[i]]->dispatch(static_cast<Ev>(triggers[i]));
+               }
+           }
+
+           expectSame();
+       }
+   }
+
+   // Enough printers for several summary words; queries match a scan after every
+   // kind of update (scalar steps, SIMD batches, resets)
+   TEST_F(SafetyFleetTest, IndexTracksLargeFleet)
+   {
+       constexpr std::size_t kPrinters = 64 * 64 * 2 + 37;
+       fleet = std::make_unique<SafetyFleet>(kPrinters);
+
+       const FleetIndex& index = fleet->index();
+       EXPECT_EQ(index.count(State::Idle), kPrinters);
+       EXPECT_EQ(index.count(State::Idle, Sub::None), kPrinters);
+       EXPECT_EQ(index.count(State::Faulted), 0u);
+
+       std::mt19937 rng(7);
+       std::uniform_int_distribution<std::uint32_t> pickPrinter(0, kPrinters - 1);
+       std::uniform_int_distribution<int> pickEvent(0, 5);
+
+       std::vector<std::uint32_t> ids(kPrinters);
+       std::iota(ids.begin(), ids.end(), 0u);
+       std::vector<Ev> events(kPrinters, Ev::evPowerOn);
+       fleet->dispatchBatch(ids.data(), events.data(), ids.size());
+
+       EXPECT_EQ(index.count(State::Active), kPrinters);
+       EXPECT_EQ(index.count(State::Idle), 0u);
+
+       for (int round = 0; round < 20; ++round)
+       {
+           for (int k = 0; k < 500; ++k)
+           {
+               const auto p = pickPrinter(rng);
+
+               switch (k % 3)
+               {
+               case 0:  fleet->startLoader(p); break;
+               case 1:  fleet->dispatch(p, static_cast<Ev>(pickEvent(rng))); break;
+               default: if (k % 50 == 2) fleet->reset(p); break;
+               }
+           }
+
+           std::shuffle(ids.begin(), ids.end(), rng);
+
+           for (auto& ev : events)
+           {
+               ev = static_cast<Ev>(pickEvent(rng));
+           }
+
+           fleet->dispatchBatch(ids.data(), events.data(), 1000);
+           expectIndexed();
+       }
+
+       // The printers the index lists as DoorOpened are exactly those getState() reports
+       std::size_t doorOpened = 0;
+
+       index.forEach(State::BuildPlateLoader, Sub::DoorOpened, [&](std::uint32_t p) {
+           EXPECT_EQ(fleet->getLoaderSubstate(p), Sub::DoorOpened);
+           ++doorOpened;
+       });
+
+       EXPECT_EQ(doorOpened, index.count(State::BuildPlateLoader, Sub::DoorOpened));
+   }
+
+}
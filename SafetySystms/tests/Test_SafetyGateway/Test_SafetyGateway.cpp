@@ -0,0 +1,361 @@
+#include <gtest/gtest.h>
+#include "SafetyGateway/GatewayProtocol.h"
+#include "SafetyGateway/SafetyGateway.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace Test_SafetyGateway_Namespace
+{
+
+   using namespace safety;
+
+   class SafetyGatewayTest : public ::testing::Test
+   {
+   protected:
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+       using Ev    = ISafetyRules::Event;
+
+       static constexpr std::size_t kPrinters = 4096;
+
+       void SetUp() override
+       {
+           gateway = std::make_unique<SafetyGateway>(path, kPrinters);
+           worker = std::thread([this]() { gateway->run(); });
+       }
+
+       void TearDown() override
+       {
+           stop();
+       }
+
+       // Stats and the fleet may be read once the gateway thread is done
+       void stop()
+       {
+           if (worker.joinable())
+           {
+               gateway->stop();
+               worker.join();
+           }
+       }
+
+       int connect() const
+       {
+           const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+           sockaddr_un address {};
+           address.sun_family = AF_UNIX;
+           std::strcpy(address.sun_path, path.c_str());
+
+           EXPECT_EQ(::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)), 0);
+
+           // Reads give up rather than hang a broken test
+           timeval timeout { 10, 0 };
+           ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+           return fd;
+       }
+
+       static EventFrame frame(std::uint32_t printer, Trigger trigger)
+       {
+           return EventFrame { printer, trigger, {} };
+       }
+
+       static void send(int fd, const std::vector<EventFrame>& frames)
+       {
+           const auto* bytes = reinterpret_cast<const char*>(frames.data());
+           std::size_t left = frames.size() * sizeof(EventFrame);
+
+           while (left != 0)
+           {
+               const ssize_t sent = ::send(fd, bytes, left, MSG_NOSIGNAL);
+               ASSERT_GT(sent, 0);
+               bytes += sent;
+               left -= static_cast<std::size_t>(sent);
+           }
+       }
+
+       // StateFrames until the printer -> config map has every entry of want, or EOF
+       static std::map<std::uint32_t, Config> receiveUntil(int fd, const std::map<std::uint32_t, Config>& want)
+       {
+           std::map<std::uint32_t, Config> latest;
+           std::vector<char> pending;
+
+           const auto satisfied = [&]() {
+               for (const auto& [printer, config] : want)
+               {
+                   const auto it = latest.find(printer);
+
+                   if (it == latest.end() || it->second != config)
+                   {
+                       return false;
+                   }
+               }
+
+               return true;
+           };
+
+           while (!satisfied())
+           {
+               char chunk[4096];
+               const ssize_t got = ::recv(fd, chunk, sizeof(chunk), 0);
+
+               if (got <= 0)
+               {
+                   break;
+               }
+
+               pending.insert(pending.end(), chunk, chunk + got);
+               std::size_t offset = 0;
+
+               for (; offset + sizeof(StateFrame) <= pending.size(); offset += sizeof(StateFrame))
+               {
+                   StateFrame state;
+                   std::memcpy(&state, pending.data() + offset, sizeof(state));
+                   latest[state.printer] = state.config;
+               }
+
+               pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(offset));
+           }
+
+           return latest;
+       }
+
+       // True once the peer has closed (reads 0 bytes), false on data or timeout
+       static bool closedByPeer(int fd)
+       {
+           char byte;
+           return ::recv(fd, &byte, 1, 0) == 0;
+       }
+
+   protected:
+       const std::string                 path = "Test_SafetyGateway." + std::to_string(::getpid()) + ".sock";
+       std::unique_ptr<SafetyGateway>    gateway;
+       std::thread                       worker;
+   };
+
+   // Events move printers and the sender hears where they ended up
+   TEST_F(SafetyGatewayTest, EventsMovePrintersAndNotifySender)
+   {
+       const int client = connect();
+
+       send(client, { frame(3, Trigger::evPowerOn) });
+       auto latest = receiveUntil(client, { { 3, toConfig(State::Active, Sub::None) } });
+       EXPECT_EQ(latest.size(), 1u);
+
+       send(client, { frame(3, Trigger::StartLoader), frame(3, Trigger::evDoorOpened), frame(9, Trigger::evFault) });
+       latest = receiveUntil(client, { { 3, toConfig(State::BuildPlateLoader, Sub::DoorOpened) } });
+
+       // Printer 9 ignored evFault in Idle: nothing to report
+       EXPECT_EQ(latest.count(9), 0u);
+
+       ::close(client);
+       stop();
+
+       EXPECT_EQ(gateway->fleet().getState(3), State::BuildPlateLoader);
+       EXPECT_EQ(gateway->fleet().getLoaderSubstate(3), Sub::DoorOpened);
+       EXPECT_EQ(gateway->stats().frames, 4u);
+       EXPECT_EQ(gateway->stats().rejected, 0u);
+       EXPECT_GE(gateway->stats().notifications, 2u);
+       EXPECT_EQ(gateway->stats().accepted, 1u);
+   }
+
+   // Two clients driving one printer in the same batch both hear where it ended up
+   TEST_F(SafetyGatewayTest, EveryClientOfAMovedPrinterIsNotified)
+   {
+       // Rounds run on this thread from here, so both sends land in one batch
+       stop();
+
+       const int first = connect();
+       const int second = connect();
+
+       while (gateway->stats().connections < 2)
+       {
+           gateway->pollOnce(1000);
+       }
+
+       send(first, { frame(5, Trigger::evPowerOn) });
+       send(second, { frame(5, Trigger::StartLoader) });
+       gateway->pollOnce(1000);
+
+       ASSERT_EQ(gateway->stats().batches, 1u);
+
+       const Config loader = toConfig(State::BuildPlateLoader, Sub::OpenDoor);
+       EXPECT_EQ(receiveUntil(first, { { 5, loader } }).at(5), loader);
+       EXPECT_EQ(receiveUntil(second, { { 5, loader } }).at(5), loader);
+       EXPECT_EQ(gateway->stats().notifications, 2u);
+
+       ::close(first);
+       ::close(second);
+   }
+
+   // Bad frames are counted and skipped; the connection carries on
+   TEST_F(SafetyGatewayTest, RejectsUnknownPrinterAndTrigger)
+   {
+       const int client = connect();
+
+       send(client, { frame(kPrinters, Trigger::evPowerOn),
+                      frame(1, Trigger::Reset),
+                      frame(1, static_cast<Trigger>(200)),
+                      frame(1, Trigger::evPowerOn) });
+
+       receiveUntil(client, { { 1, toConfig(State::Active, Sub::None) } });
+
+       ::close(client);
+       stop();
+
+       EXPECT_EQ(gateway->stats().rejected, 3u);
+       EXPECT_EQ(gateway->stats().frames, 1u);
+       EXPECT_EQ(gateway->fleet().getState(1), State::Active);
+   }
+
+   // Frames arrive in pieces however the client writes them
+   TEST_F(SafetyGatewayTest, FramesSplitAcrossWrites)
+   {
+       const int client = connect();
+
+       const std::vector<EventFrame> frames = { frame(5, Trigger::evPowerOn), frame(5, Trigger::evFault) };
+       const auto* bytes = reinterpret_cast<const char*>(frames.data());
+
+       const std::size_t cuts[] = { 0, 3, 11, 16 };
+
+       for (std::size_t i = 0; i + 1 < std::size(cuts); ++i)
+       {
+           const std::size_t size = cuts[i + 1] - cuts[i];
+           ASSERT_EQ(::send(client, bytes + cuts[i], size, MSG_NOSIGNAL), static_cast<ssize_t>(size));
+           std::this_thread::sleep_for(std::chrono::milliseconds(20));
+       }
+
+       receiveUntil(client, { { 5, toConfig(State::Faulted, Sub::None) } });
+
+       ::close(client);
+       stop();
+
+       EXPECT_EQ(gateway->stats().frames, 2u);
+       EXPECT_EQ(gateway->fleet().getState(5), State::Faulted);
+   }
+
+   // Several clients at once, each driving its own printers through loader cycles:
+   // nothing lost, and each client hears only about the printers it moved
+   TEST_F(SafetyGatewayTest, ManyClientsDriveTheirOwnPrinters)
+   {
+       constexpr std::uint32_t kClients = 4;
+       constexpr std::uint32_t kEach    = 512;
+       constexpr int           kCycles  = 20;
+
+       constexpr Trigger kCycle[] = { Trigger::evPowerOn, Trigger::StartLoader, Trigger::evDoorOpened,
+                                      Trigger::evBuildPlateLoaded, Trigger::evDoorClosed, Trigger::evPowerOff };
+
+       std::vector<std::thread> clients;
+       std::vector<int> strangers(kClients, 0);
+
+       for (std::uint32_t c = 0; c < kClients; ++c)
+       {
+           clients.emplace_back([&, c]() {
+               const int fd = connect();
+               std::vector<EventFrame> frames;
+
+               for (int cycle = 0; cycle < kCycles; ++cycle)
+               {
+                   for (Trigger t : kCycle)
+                   {
+                       for (std::uint32_t i = 0; i < kEach; ++i)
+                       {
+                           frames.push_back(frame(c * kEach + i, t));
+                       }
+                   }
+               }
+
+               // A last power-on, so every printer has a change to report at the end
+               for (std::uint32_t i = 0; i < kEach; ++i)
+               {
+                   frames.push_back(frame(c * kEach + i, Trigger::evPowerOn));
+               }
+
+               std::thread writer([&]() { send(fd, frames); ::shutdown(fd, SHUT_WR); });
+
+               std::map<std::uint32_t, Config> want;
+
+               for (std::uint32_t i = 0; i < kEach; ++i)
+               {
+                   want[c * kEach + i] = toConfig(State::Active, Sub::None);
+               }
+
+               const auto latest = receiveUntil(fd, want);
+               writer.join();
+
+               for (const auto& entry : latest)
+               {
+                   strangers[c] += entry.first / kEach != c;
+               }
+
+               EXPECT_EQ(latest, want) << "client " << c;
+               EXPECT_TRUE(closedByPeer(fd)) << "client " << c;
+               ::close(fd);
+           });
+       }
+
+       for (auto& t : clients)
+       {
+           t.join();
+       }
+
+       stop();
+
+       EXPECT_EQ(strangers, std::vector<int>(kClients, 0));
+       EXPECT_EQ(gateway->stats().frames, std::uint64_t(kClients) * kEach * (6 * kCycles + 1));
+       EXPECT_EQ(gateway->stats().connections, 0u);
+       EXPECT_EQ(gateway->fleet().index().count(State::Active), kClients * kEach);
+   }
+
+   // A client that stops writing still gets every notification, then EOF
+   TEST_F(SafetyGatewayTest, ShutdownWriteFlushesThenCloses)
+   {
+       constexpr std::uint32_t kMoved = 1000;
+
+       const int client = connect();
+       std::vector<EventFrame> frames;
+       std::map<std::uint32_t, Config> want;
+
+       for (std::uint32_t p = 0; p < kMoved; ++p)
+       {
+           frames.push_back(frame(p, Trigger::evPowerOn));
+           want[p] = toConfig(State::Active, Sub::None);
+       }
+
+       send(client, frames);
+       ::shutdown(client, SHUT_WR);
+
+       EXPECT_EQ(receiveUntil(client, want), want);
+       EXPECT_TRUE(closedByPeer(client));
+       ::close(client);
+   }
+
+   TEST_F(SafetyGatewayTest, RejectsBadSocketPath)
+   {
+       EXPECT_THROW(SafetyGateway(std::string(200, 'x'), 10), std::invalid_argument);
+       EXPECT_THROW(SafetyGateway("no-such-directory/gateway.sock", 10), std::system_error);
+
+       // A file that is not a socket is never replaced
+       const std::string file = path + ".file";
+       std::fclose(std::fopen(file.c_str(), "w"));
+       EXPECT_THROW(SafetyGateway(file, 10), std::system_error);
+       EXPECT_EQ(::access(file.c_str(), F_OK), 0);
+       std::remove(file.c_str());
+   }
+
+}
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include "SafetyRules/Instrumentation.h"
+#include "SafetyRules/SafetyRules.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static_assert(SAFETY_INSTRUMENTATION, "Test_SafetyInstrumentation must be built with SAFETY_INSTRUMENTATION=1");
+
+namespace Test_SafetyInstrumentation_Namespace
+{
+
+   using namespace safety;
+   namespace inst = safety::instrumentation;
+
+   class SafetyInstrumentationTest : public ::testing::Test
+   {
+   protected:
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+       using Ev    = ISafetyRules::Event;
+
+       // Counters are process-wide and cumulative: tests look at differences
+       void SetUp() override
+       {
+           before = inst::snapshot();
+       }
+
+       std::uint64_t edgeDelta(const inst::Snapshot& after, State s, Sub l, Trigger t) const
+       {
+           return after.edge(toConfig(s, l), t) - before.edge(toConfig(s, l), t);
+       }
+
+       std::uint64_t hookDelta(const inst::Snapshot& after, Hook h) const
+       {
+           return after.hook(h).count - before.hook(h).count;
+       }
+
+   protected:
+       inst::Snapshot before;
+   };
+
+   TEST_F(SafetyInstrumentationTest, Buckets)
+   {
+       EXPECT_EQ(inst::bucketOf(0), 0u);
+       EXPECT_EQ(inst::bucketOf(1), 1u);
+       EXPECT_EQ(inst::bucketOf(2), 2u);
+       EXPECT_EQ(inst::bucketOf(3), 2u);
+       EXPECT_EQ(inst::bucketOf(1024), 11u);
+       EXPECT_EQ(inst::bucketOf(~std::uint64_t(0)), inst::kLatencyBuckets - 1);
+       EXPECT_LT(1023u, inst::bucketLimit(inst::bucketOf(1023)));
+   }
+
+   // Every delivered trigger counts its edge, ignored ones included
+   TEST_F(SafetyInstrumentationTest, CountsEdges)
+   {
+       SafetyRules uut;
+
+       uut.dispatch(Ev::evPowerOn);
+       uut.startLoader();
+       uut.dispatch(Ev::evDoorClosed);   // ignored in OpenDoor
+       uut.dispatch(Ev::evDoorOpened);
+       uut.dispatch(Ev::evFault);
+       uut.dispatch(Ev::evPowerOn);
+
+       const inst::Snapshot after = inst::snapshot();
+
+       EXPECT_EQ(edgeDelta(after, State::Idle, Sub::None, Trigger::evPowerOn), 1u);
+       EXPECT_EQ(edgeDelta(after, State::Active, Sub::None, Trigger::StartLoader), 1u);
+       EXPECT_EQ(edgeDelta(after, State::BuildPlateLoader, Sub::OpenDoor, Trigger::evDoorClosed), 1u);
+       EXPECT_EQ(edgeDelta(after, State::BuildPlateLoader, Sub::OpenDoor, Trigger::evDoorOpened), 1u);
+       EXPECT_EQ(edgeDelta(after, State::BuildPlateLoader, Sub::DoorOpened, Trigger::evFault), 1u);
+       EXPECT_EQ(edgeDelta(after, State::Faulted, Sub::None, Trigger::evPowerOn), 1u);
+       EXPECT_EQ(edgeDelta(after, State::Active, Sub::None, Trigger::evFault), 0u);
+   }
+
+   // Only hooks that are installed are timed
+   TEST_F(SafetyInstrumentationTest, TimesInstalledHooks)
+   {
+       SafetyRules uut;
+       uut.setOnEnterFaulted([]() { std::this_thread::sleep_for(std::chrono::milliseconds(2)); });
+       uut.setOnRequestDoorOpen([]() {});
+
+       uut.dispatch(Ev::evPowerOn);
+       uut.startLoader();
+       uut.dispatch(Ev::evFault);
+
+       const inst::Snapshot after = inst::snapshot();
+
+       EXPECT_EQ(hookDelta(after, Hook::EnterFaulted), 1u);
+       EXPECT_EQ(hookDelta(after, Hook::RequestDoorOpen), 1u);
+       EXPECT_EQ(hookDelta(after, Hook::ExitActive), 0u);   // no callback installed
+
+       const inst::HookLatency& faulted = after.hook(Hook::EnterFaulted);
+       EXPECT_GE(faulted.maxNs, 2000000u);
+       EXPECT_GE(faulted.totalNs - before.hook(Hook::EnterFaulted).totalNs, 2000000u);
+       EXPECT_GE(faulted.quantileNs(1.0), 2000000u);
+   }
+
+   // Per-thread blocks add up, including threads that have finished, and snapshots
+   // can be taken while other threads dispatch
+   TEST_F(SafetyInstrumentationTest, SumsAcrossThreads)
+   {
+       constexpr int kThreads = 4;
+       constexpr int kCycles  = 10000;
+
+       std::atomic<bool> done { false };
+       std::thread reader([&done]() {
+           while (!done.load())
+           {
+               (void)inst::snapshot();
+               std::this_thread::yield();
+           }
+       });
+
+       std::vector<std::thread> workers;
+
+       for (int w = 0; w < kThreads; ++w)
+       {
+           workers.emplace_back([]() {
+               SafetyRules uut;
+
+               for (int i = 0; i < kCycles; ++i)
+               {
+                   uut.dispatch(Ev::evPowerOn);
+                   uut.dispatch(Ev::evPowerOff);
+               }
+           });
+       }
+
+       for (auto& w : workers)
+       {
+           w.join();
+       }
+
+       done = true;
+       reader.join();
+
+       const inst::Snapshot after = inst::snapshot();
+
+       EXPECT_EQ(edgeDelta(after, State::Idle, Sub::None, Trigger::evPowerOn), std::uint64_t(kThreads) * kCycles);
+       EXPECT_EQ(edgeDelta(after, State::Active, Sub::None, Trigger::evPowerOff), std::uint64_t(kThreads) * kCycles);
+   }
+
+   TEST_F(SafetyInstrumentationTest, BlocksArePadded)
+   {
+       EXPECT_EQ(alignof(inst::ThreadCounters), 64u);
+       EXPECT_EQ(sizeof(inst::HookCounters) % 64, 0u);
+   }
+
+}
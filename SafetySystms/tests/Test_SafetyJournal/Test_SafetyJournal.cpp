@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+#include "SafetyJournal/SafetyJournal.h"
+#include "SafetyRules/SafetyRules.h"
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+namespace Test_SafetyJournal_Namespace
+{
+
+   using namespace safety;
+
+   class SafetyJournalTest : public ::testing::Test
+   {
+   protected:
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+       using Ev    = ISafetyRules::Event;
+
+       void TearDown() override
+       {
+           std::remove(path.c_str());
+       }
+
+       // Record a loader cycle, a fault and a reset
+       void recordCycle(SafetyJournal& journal)
+       {
+           journal.attach(uut);
+
+           uut.dispatch(Ev::evPowerOn);
+           uut.startLoader();
+           uut.dispatch(Ev::evDoorOpened);
+           uut.dispatch(Ev::evDoorClosed);     // ignored, still recorded
+           uut.dispatch(Ev::evBuildPlateLoaded);
+           uut.dispatch(Ev::evDoorClosed);
+           uut.dispatch(Ev::evFault);
+           uut.reset();
+
+           journal.detach(uut);
+       }
+
+   protected:
+       const std::string path = "Test_SafetyJournal." + std::to_string(::getpid()) + ".jrnl";
+       SafetyRules uut;
+   };
+
+   // Every step is recorded in order with its trigger and resulting configuration
+   TEST_F(SafetyJournalTest, RecordsEveryStep)
+   {
+       {
+           SafetyJournal journal(path, 64);
+           recordCycle(journal);
+           EXPECT_EQ(journal.size(), 8u);
+       }
+
+       JournalReader reader(path);
+       ASSERT_EQ(reader.size(), 8u);
+
+       const JournalRecord* r = reader.begin();
+       EXPECT_EQ(r[0].trigger, Trigger::evPowerOn);
+       EXPECT_EQ(r[0].result, toConfig(State::Active, Sub::None));
+       EXPECT_EQ(r[1].trigger, Trigger::StartLoader);
+       EXPECT_EQ(r[1].result, toConfig(State::BuildPlateLoader, Sub::OpenDoor));
+       EXPECT_EQ(r[3].trigger, Trigger::evDoorClosed);
+       EXPECT_EQ(r[3].result, toConfig(State::BuildPlateLoader, Sub::DoorOpened));
+       EXPECT_EQ(r[6].result, toConfig(State::Faulted, Sub::None));
+       EXPECT_EQ(r[7].trigger, Trigger::Reset);
+       EXPECT_EQ(r[7].result, toConfig(State::Idle, Sub::None));
+
+       for (std::size_t i = 0; i < reader.size(); ++i)
+       {
+           EXPECT_EQ(r[i].sequence, i);
+           EXPECT_GE(r[i].timestampNs, reader.startNs());
+
+           if (i > 0)
+           {
+               EXPECT_GE(r[i].timestampNs, r[i - 1].timestampNs);
+           }
+       }
+   }
+
+   // Replaying a random session into a fresh machine reproduces it exactly
+   TEST_F(SafetyJournalTest, ReplayReproducesRandomSession)
+   {
+       {
+           SafetyJournal journal(path, 10000);
+           journal.attach(uut);
+
+           std::mt19937 rng(7);
+           std::uniform_int_distribution<int> pick(0, 7);
+
+           for (int i = 0; i < 10000; ++i)
+           {
+               const int p = pick(rng);
+
+               if (p == 6)
+               {
+                   uut.startLoader();
+               }
+               else if (p == 7)
+               {
+                   uut.reset();
+               }
+               else
+               {
+                   uut.dispatch(static_cast<Ev>(p));
+               }
+           }
+
+           EXPECT_EQ(journal.dropped(), 0u);
+       }
+
+       JournalReader reader(path);
+       SafetyRules fresh;
+       const ReplayResult result = replay(reader.begin(), reader.end(), fresh);
+
+       EXPECT_EQ(result.replayed, 10000u);
+       EXPECT_EQ(result.mismatches, 0u);
+       EXPECT_EQ(result.firstMismatch, result.replayed);
+       EXPECT_EQ(fresh.getState(), uut.getState());
+       EXPECT_EQ(fresh.getLoaderSubstate(), uut.getLoaderSubstate());
+   }
+
+   // A journal attached to a running machine replays from the configuration it started in
+   TEST_F(SafetyJournalTest, ReplayStartsFromAttachConfiguration)
+   {
+       uut.dispatch(Ev::evPowerOn);
+       uut.startLoader();
+
+       {
+           SafetyJournal journal(path, 64);
+           journal.attach(uut);
+           uut.dispatch(Ev::evDoorOpened);
+           uut.dispatch(Ev::evBuildPlateLoaded);
+           journal.detach(uut);
+       }
+
+       JournalReader reader(path);
+       EXPECT_EQ(reader.initial(), toConfig(State::BuildPlateLoader, Sub::OpenDoor));
+
+       SafetyRules fresh;
+       const ReplayResult result = replay(reader, fresh);
+
+       EXPECT_EQ(result.replayed, 2u);
+       EXPECT_EQ(result.mismatches, 0u);
+       EXPECT_EQ(fresh.getLoaderSubstate(), uut.getLoaderSubstate());
+   }
+
+   // Sequences are 32 bits, so a segment cannot hold more records than that
+   TEST_F(SafetyJournalTest, RejectsCapacityBeyondSequence)
+   {
+       EXPECT_THROW(SafetyJournal(path, std::size_t { 1 } << 33), std::invalid_argument);
+   }
+
+   // A tampered record is reported as the first divergence
+   TEST_F(SafetyJournalTest, ReplayReportsDivergence)
+   {
+       SafetyJournal journal(path, 64);
+       recordCycle(journal);
+
+       JournalReader reader(path);
+       std::vector<JournalRecord> records(reader.begin(), reader.end());
+       ASSERT_EQ(records.size(), 8u);
+       records[2].result = toConfig(State::Faulted, Sub::None);
+
+       SafetyRules fresh;
+       const ReplayResult result = replay(records.data(), records.data() + records.size(), fresh);
+
+       EXPECT_EQ(result.mismatches, 1u);
+       EXPECT_EQ(result.firstMismatch, 2u);
+       EXPECT_EQ(result.expected, toConfig(State::Faulted, Sub::None));
+       EXPECT_EQ(result.actual, toConfig(State::BuildPlateLoader, Sub::DoorOpened));
+   }
+
+   // A record whose trigger byte is out of range is a divergence, not a dispatch
+   TEST_F(SafetyJournalTest, ReplayRejectsCorruptTrigger)
+   {
+       SafetyJournal journal(path, 64);
+       recordCycle(journal);
+
+       JournalReader reader(path);
+       std::vector<JournalRecord> records(reader.begin(), reader.end());
+       ASSERT_EQ(records.size(), 8u);
+       records[1].trigger = static_cast<Trigger>(0xff);
+
+       SafetyRules fresh;
+       const ReplayResult result = replay(records.data(), records.data() + 2, fresh);
+
+       EXPECT_EQ(result.replayed, 2u);
+       EXPECT_EQ(result.mismatches, 1u);
+       EXPECT_EQ(result.firstMismatch, 1u);
+       EXPECT_EQ(result.actual, toConfig(State::Active, Sub::None));
+       EXPECT_EQ(fresh.getState(), State::Active);
+   }
+
+   // A full segment drops further records instead of growing or blocking
+   TEST_F(SafetyJournalTest, FullSegmentDrops)
+   {
+       SafetyJournal journal(path, 2);
+       journal.attach(uut);
+
+       uut.dispatch(Ev::evPowerOn);
+       uut.dispatch(Ev::evFault);
+       uut.dispatch(Ev::evPowerOn);
+
+       EXPECT_EQ(journal.size(), 2u);
+       EXPECT_EQ(journal.dropped(), 1u);
+       EXPECT_FALSE(journal.append(Trigger::evPowerOff, 0));
+       EXPECT_EQ(JournalReader(path).size(), 2u);
+       // The machine itself is unaffected
+       EXPECT_EQ(uut.getState(), State::Active);
+   }
+
+   // Files that are not journals are rejected; missing files report the OS error
+   TEST_F(SafetyJournalTest, ReaderValidates)
+   {
+       EXPECT_THROW(JournalReader("does/not/exist.jrnl"), std::system_error);
+
+       {
+           std::ofstream junk(path, std::ios::binary);
+           junk << std::string(256, 'x');
+       }
+
+       EXPECT_THROW(JournalReader reader(path), std::runtime_error);
+   }
+
+}
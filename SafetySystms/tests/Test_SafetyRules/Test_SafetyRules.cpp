@@ -1,7 +1,13 @@
 #include <gtest/gtest.h>
+#include "SafetyRules/BasicSafetyRules.h"
+#include "SafetyRules/HookTable.h"
 #include "SafetyRules/SafetyRules.h"
 #include "SafetyRules/ISafetyRules.h"
 
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
 namespace Test_SafetyRules_Namespace 
 {
 
@@ -891,4 +897,423 @@ namespace Test_SafetyRules_Namespace
        expectState(State::Idle);
    }
 
+
+   void countInto(void* ctx)
+   {
+       ++*static_cast<int*>(ctx);
+   }
+   
+   // Hooks accept a free function bound to a context pointer (no capture, no allocation)
+   TEST_F(SafetyRulesTest, HookFromFunctionAndContext)
+   {
+       int faults = 0;
+       uut.setOnEnterFaulted(ISafetyRules::VoidFn::bind<&countInto>(&faults));
+   
+       uut.reset();
+       uut.dispatch(Ev::evPowerOn);
+       uut.dispatch(Ev::evFault);
+   
+       expectState(State::Faulted);
+       EXPECT_EQ(faults, 1);
+       EXPECT_EQ(onEnterFaultedCount, 0); // replaced the fixture hook
+   }
+   
+   // A null function pointer leaves the hook empty rather than installing a crash
+   TEST_F(SafetyRulesTest, NullFunctionPointerClearsHook)
+   {
+       void (*none)() = nullptr;
+       uut.setOnEnterActive(none);
+   
+       uut.reset();
+       uut.dispatch(Ev::evPowerOn);
+   
+       expectState(State::Active);
+       EXPECT_EQ(onEnterActiveCount, 0);
+   }
+   
+   // Hook storage is inline: a callable slot is two pointers
+   TEST_F(SafetyRulesTest, HookSlotIsInline)
+   {
+       EXPECT_EQ(sizeof(ISafetyRules::VoidFn), 2 * sizeof(void*));
+       // vptr + configuration byte (padded) + 11 hooks + 4 step observers: 256 bytes on 64-bit
+       EXPECT_EQ(SafetyRules::kStepObservers, 4u);
+       EXPECT_EQ(sizeof(SafetyRules), 2 * sizeof(void*) + (11 + 4) * sizeof(ISafetyRules::VoidFn));
+   }
+
+   // ----- BasicSafetyRules: the same machine with compile-time hooks
+
+   // Records every hook with the state the machine reports while it runs
+   struct RecordingHooks
+   {
+       const BasicSafetyRules<RecordingHooks>* machine { nullptr };
+       std::vector<std::pair<Hook, ISafetyRules::State>> fired;
+       std::vector<Trigger> steps;
+
+       void fire(Hook h)
+       {
+           fired.emplace_back(h, machine ? machine->getState() : ISafetyRules::State::Idle);
+       }
+
+       void stepped(Trigger t, Config)
+       {
+           steps.push_back(t);
+       }
+   };
+
+   TEST_F(SafetyRulesTest, BareCoreIsOneByte)
+   {
+       EXPECT_EQ(sizeof(BasicSafetyRules<NoHooks>), 1u);
+   }
+
+   // Policy hooks fire in the order, and observe the states, that Delegate hooks do
+   TEST_F(SafetyRulesTest, PolicyHooksMatchDelegateHooks)
+   {
+       BasicSafetyRules<RecordingHooks> core;
+       core.hooks().machine = &core;
+       core.hooks().fired.clear();
+
+       std::vector<std::pair<Hook, State>> expected;
+       auto record = [&expected, this](Hook h) { expected.emplace_back(h, uut.getState()); };
+
+       uut.setOnExitIdle([&] { record(Hook::ExitIdle); });
+       uut.setOnEnterActive([&] { record(Hook::EnterActive); });
+       uut.setOnExitActive([&] { record(Hook::ExitActive); });
+       uut.setOnEnterBuildPlateLoader([&] { record(Hook::EnterBuildPlateLoader); });
+       uut.setOnExitBuildPlateLoader([&] { record(Hook::ExitBuildPlateLoader); });
+       uut.setOnRequestDoorOpen([&] { record(Hook::RequestDoorOpen); });
+       uut.setOnRequestLoadBuildPlate([&] { record(Hook::RequestLoadBuildPlate); });
+       uut.setOnRequestDoorClose([&] { record(Hook::RequestDoorClose); });
+
+       auto drive = [](auto& machine) {
+           machine.dispatch(Ev::evPowerOn);
+           machine.startLoader();
+           machine.dispatch(Ev::evDoorOpened);
+           machine.dispatch(Ev::evBuildPlateLoaded);
+           machine.dispatch(Ev::evDoorClosed);
+       };
+
+       drive(uut);
+       drive(core);
+
+       EXPECT_EQ(core.hooks().fired, expected);
+       EXPECT_EQ(core.hooks().steps.size(), 6u);   // reset + five steps
+       EXPECT_EQ(core.getState(), uut.getState());
+   }
+
+   TEST_F(SafetyRulesTest, CoreReportsConfiguration)
+   {
+       BasicSafetyRules<NoHooks> core;
+
+       core.dispatch(Ev::evPowerOn);
+       core.startLoader();
+       EXPECT_EQ(core.configuration(), toConfig(State::BuildPlateLoader, Sub::OpenDoor));
+
+       core.dispatch(Ev::evFault);
+       EXPECT_EQ(core.getState(), State::Faulted);
+       EXPECT_EQ(core.getLoaderSubstate(), Sub::None);
+
+       core.reset();
+       EXPECT_EQ(core.getState(), State::Idle);
+   }
+
+   // ----- Accepted triggers: the mask agrees with what the machine actually does
+
+   struct ChangeHooks
+   {
+       int fired { 0 };
+
+       void fire(Hook) { ++fired; }
+       void stepped(Trigger, Config) {}
+   };
+
+   TEST_F(SafetyRulesTest, AcceptedTriggersMatchBehaviour)
+   {
+       const std::vector<std::vector<Trigger>> paths {
+           {},
+           { Trigger::evPowerOn },
+           { Trigger::evPowerOn, Trigger::evFault },
+           { Trigger::evPowerOn, Trigger::StartLoader },
+           { Trigger::evPowerOn, Trigger::StartLoader, Trigger::evDoorOpened },
+           { Trigger::evPowerOn, Trigger::StartLoader, Trigger::evDoorOpened, Trigger::evBuildPlateLoaded },
+       };
+
+       auto apply = [](BasicSafetyRules<ChangeHooks>& m, Trigger t) {
+           t == Trigger::StartLoader ? m.startLoader() : m.dispatch(static_cast<Ev>(t));
+       };
+
+       for (const auto& path : paths)
+       {
+           for (std::size_t t = 0; t < kTriggerCount; ++t)
+           {
+               BasicSafetyRules<ChangeHooks> m;
+
+               for (Trigger p : path)
+               {
+                   apply(m, p);
+               }
+
+               const Config before = m.configuration();
+               const TriggerMask mask = m.acceptedTriggers();
+               m.hooks().fired = 0;
+
+               apply(m, static_cast<Trigger>(t));
+
+               const bool acted = m.configuration() != before || m.hooks().fired != 0;
+               EXPECT_EQ((mask & triggerBit(static_cast<Trigger>(t))) != 0, acted)
+                   << "configuration " << int(before) << ", trigger " << t;
+           }
+       }
+
+       uut.reset();
+       EXPECT_EQ(uut.acceptedTriggers(), triggerBit(Trigger::evPowerOn));
+   }
+
+   // ----- Run to completion: hooks that drive their own machine
+
+   // A loader simulator: every request is answered at once, from inside the hook
+   struct LoaderSimulator
+   {
+       SafetyRules& machine;
+       int depth { 0 };
+       int maxDepth { 0 };
+       std::vector<std::pair<Trigger, Config>> steps;
+
+       void answer(ISafetyRules::Event reply)
+       {
+           maxDepth = std::max(maxDepth, ++depth);
+           machine.dispatch(reply);
+           --depth;
+       }
+   };
+
+   TEST_F(SafetyRulesTest, HookDispatchRunsAfterCurrentStep)
+   {
+       LoaderSimulator sim { uut, 0, 0, {} };
+
+       uut.setOnRequestDoorOpen([&sim] { sim.answer(Ev::evDoorOpened); });
+       uut.setOnRequestLoadBuildPlate([&sim] { sim.answer(Ev::evBuildPlateLoaded); });
+       uut.setOnRequestDoorClose([&sim] { sim.answer(Ev::evDoorClosed); });
+       uut.addOnStep([&sim](Trigger t, Config c) {
+           EXPECT_EQ(sim.depth, 0) << "a step completed inside a hook";
+           sim.steps.emplace_back(t, c);
+       });
+
+       uut.dispatch(Ev::evPowerOn);
+       uut.startLoader();
+
+       expectState(State::Active);
+       expectLoader(Sub::None);
+       EXPECT_EQ(sim.maxDepth, 1);
+       EXPECT_EQ(onExitLoaderCount, 1);
+       EXPECT_FALSE(uut.deferredOverflow());
+
+       const std::vector<std::pair<Trigger, Config>> expected {
+           { Trigger::evPowerOn,          toConfig(State::Active, Sub::None) },
+           { Trigger::StartLoader,        toConfig(State::BuildPlateLoader, Sub::OpenDoor) },
+           { Trigger::evDoorOpened,       toConfig(State::BuildPlateLoader, Sub::DoorOpened) },
+           { Trigger::evBuildPlateLoaded, toConfig(State::BuildPlateLoader, Sub::BuildPlateLoaded) },
+           { Trigger::evDoorClosed,       toConfig(State::Active, Sub::None) },
+       };
+
+       EXPECT_EQ(sim.steps, expected);
+   }
+
+   // Step observers run in the order added; removing one keeps the others
+   TEST_F(SafetyRulesTest, StepObserversStackInOrder)
+   {
+       std::vector<int> calls;
+       std::vector<int>* log = &calls;
+
+       EXPECT_TRUE(uut.addOnStep([log](Trigger, Config) { log->push_back(1); }));
+       const SafetyRules::StepFn second = [log](Trigger, Config) { log->push_back(2); };
+       EXPECT_TRUE(uut.addOnStep(second));
+       EXPECT_TRUE(uut.addOnStep([log](Trigger, Config) { log->push_back(3); }));
+       EXPECT_TRUE(uut.addOnStep([log](Trigger, Config) { log->push_back(4); }));
+       EXPECT_FALSE(uut.addOnStep([log](Trigger, Config) { log->push_back(5); }));
+
+       uut.dispatch(Ev::evPowerOn);
+       EXPECT_EQ(calls, (std::vector<int> { 1, 2, 3, 4 }));
+
+       calls.clear();
+       uut.removeOnStep(second);
+       uut.dispatch(Ev::evFault);
+       EXPECT_EQ(calls, (std::vector<int> { 1, 3, 4 }));
+
+       // The freed slot takes a new observer at the end
+       calls.clear();
+       EXPECT_TRUE(uut.addOnStep(second));
+       uut.reset();
+       EXPECT_EQ(calls, (std::vector<int> { 1, 3, 4, 2 }));
+   }
+
+   // A reset from a hook waits too: the hook still sees the step it was fired by
+   TEST_F(SafetyRulesTest, ResetFromHookIsDeferred)
+   {
+       struct Probe
+       {
+           SafetyRules& machine;
+           State seen;
+       } probe { uut, State::Idle };
+
+       uut.setOnRequestDoorOpen([&probe] {
+           probe.machine.reset();
+           probe.seen = probe.machine.getState();
+       });
+
+       uut.dispatch(Ev::evPowerOn);
+       onEnterIdleCount = 0;
+       uut.startLoader();
+
+       EXPECT_EQ(probe.seen, State::BuildPlateLoader);
+       expectState(State::Idle);
+       EXPECT_EQ(onEnterIdleCount, 1);
+   }
+
+   // A throwing hook abandons its step, drops what it queued and leaves the machine usable
+   TEST_F(SafetyRulesTest, ThrowingHookLeavesMachineUsable)
+   {
+       uut.setOnEnterActive([this] {
+           uut.dispatch(Ev::evFault);
+           throw std::runtime_error("hook failed");
+       });
+
+       EXPECT_THROW(uut.dispatch(Ev::evPowerOn), std::runtime_error);
+       expectState(State::Active);   // the queued evFault was dropped
+
+       uut.setOnEnterActive({});
+       uut.dispatch(Ev::evFault);
+       expectState(State::Faulted);
+   }
+
+   // Posts evPowerOn from EnterFaulted, more times than a two-entry queue holds
+   struct FloodingHooks
+   {
+       BasicSafetyRules<FloodingHooks, 2>* machine { nullptr };
+       int posts { 0 };
+
+       void fire(Hook h)
+       {
+           if (h == Hook::EnterFaulted)
+           {
+               for (int i = 0; i < posts; ++i)
+               {
+                   machine->dispatch(ISafetyRules::Event::evPowerOn);
+               }
+           }
+       }
+
+       void stepped(Trigger, Config) {}
+   };
+
+   TEST_F(SafetyRulesTest, DeferredQueueOverflowIsSticky)
+   {
+       BasicSafetyRules<FloodingHooks, 2> core;
+       core.hooks().machine = &core;
+
+       // Faulted -> Active on the first post; the second is ignored in Active
+       core.hooks().posts = 2;
+       core.dispatch(Ev::evPowerOn);
+       core.dispatch(Ev::evFault);
+       EXPECT_EQ(core.getState(), State::Active);
+       EXPECT_FALSE(core.deferredOverflow());
+
+       core.hooks().posts = 3;
+#ifdef NDEBUG
+       core.dispatch(Ev::evFault);
+       EXPECT_TRUE(core.deferredOverflow());
+       EXPECT_EQ(core.getState(), State::Active);   // the two queued posts still ran
+
+       core.reset();
+       EXPECT_FALSE(core.deferredOverflow());
+#else
+       EXPECT_DEATH(core.dispatch(Ev::evFault), "overflow");
+#endif
+   }
+
+   TEST_F(SafetyRulesTest, DeferredQueueKeepsBareCoreSmall)
+   {
+       EXPECT_EQ(sizeof(BasicSafetyRules<NoHooks, 4>), 8u);
+       EXPECT_EQ(sizeof(BasicSafetyRules<NoHooks>), 1u);
+   }
+
+   // ----- HookTable: hooks shared by many machines, called with the printer id
+
+   HookTable sharedTable;
+
+   void recordPrinter(void* log, std::uint32_t printer)
+   {
+       static_cast<std::vector<std::uint32_t>*>(log)->push_back(printer);
+   }
+
+   TEST_F(SafetyRulesTest, FlyweightMachinesAreSmall)
+   {
+       EXPECT_LE(sizeof(SharedSafetyRules), 2 * sizeof(void*));
+       EXPECT_LE(sizeof(BasicSafetyRules<TableHooks<sharedTable>>), 8u);
+       EXPECT_GE(sizeof(SafetyRules), 10 * sizeof(SharedSafetyRules));
+   }
+
+   TEST_F(SafetyRulesTest, SharedTableHooksReceivePrinterId)
+   {
+       HookTable table;
+       std::vector<std::uint32_t> doorRequests;
+       table.set(Hook::RequestDoorOpen, HookTable::PrinterFn::bind<&recordPrinter>(&doorRequests));
+
+       std::vector<SharedSafetyRules> printers;
+
+       for (std::uint32_t p = 0; p < 4; ++p)
+       {
+           printers.emplace_back(SharedHooks { &table, 100 + p });
+       }
+
+       for (std::uint32_t p : { 2u, 0u, 3u })
+       {
+           printers[p].dispatch(Ev::evPowerOn);
+           printers[p].startLoader();
+       }
+
+       EXPECT_EQ(doorRequests, (std::vector<std::uint32_t> { 102, 100, 103 }));
+       EXPECT_EQ(printers[1].getState(), State::Idle);
+       EXPECT_EQ(printers[3].getLoaderSubstate(), Sub::OpenDoor);
+   }
+
+   // No table bound: the machine constructs and steps without firing anything
+   TEST_F(SafetyRulesTest, SharedMachineWithoutTableRuns)
+   {
+       SharedSafetyRules m;
+
+       m.dispatch(Ev::evPowerOn);
+       m.startLoader();
+
+       EXPECT_EQ(m.getState(), State::BuildPlateLoader);
+       EXPECT_EQ(m.getLoaderSubstate(), Sub::OpenDoor);
+
+       std::vector<SharedSafetyRules> printers(3);
+       printers[1].dispatch(Ev::evPowerOn);
+
+       EXPECT_EQ(printers[1].getState(), State::Active);
+   }
+
+   // One table entry changes the hook of every machine bound to the table
+   TEST_F(SafetyRulesTest, StaticTableIsSharedByAllMachines)
+   {
+       using CellPrinter = BasicSafetyRules<TableHooks<sharedTable>>;
+
+       CellPrinter a(TableHooks<sharedTable> { 7 });
+       CellPrinter b(TableHooks<sharedTable> { 8 });
+
+       std::vector<std::uint32_t> faults;
+       sharedTable.set(Hook::EnterFaulted, HookTable::PrinterFn::bind<&recordPrinter>(&faults));
+
+       for (CellPrinter* m : { &a, &b })
+       {
+           m->dispatch(Ev::evPowerOn);
+           m->dispatch(Ev::evFault);
+       }
+
+       sharedTable.set(Hook::EnterFaulted, nullptr);
+
+       EXPECT_EQ(faults, (std::vector<std::uint32_t> { 7, 8 }));
+       EXPECT_EQ(b.getState(), State::Faulted);
+   }
+
 }
@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+#include "SafetyRules/SafetyRules.h"
+#include "SafetyScan/SafetyScan.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace Test_SafetyScan_Namespace
+{
+
+   using namespace safety;
+
+   class SafetyScanTest : public ::testing::Test
+   {
+   protected:
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+       using Ev    = ISafetyRules::Event;
+
+       // Random stream over all triggers; resets are rare so long runs stay interesting
+       static std::vector<Trigger> randomTriggers(std::size_t count, unsigned seed)
+       {
+           std::mt19937 rng(seed);
+           std::uniform_int_distribution<int> pick(0, 999);
+
+           std::vector<Trigger> triggers(count);
+
+           for (auto& t : triggers)
+           {
+               const int p = pick(rng);
+               t = p == 0 ? Trigger::Reset : static_cast<Trigger>(p % kTriggerCount);
+           }
+
+           return triggers;
+       }
+
+       // Reference: SafetyRules stepped one trigger at a time
+       static std::vector<Config> sequential(Config start, const std::vector<Trigger>& triggers)
+       {
+           SafetyRules rules;
+           driveTo(rules, start);
+
+           std::vector<Config> trace;
+           trace.reserve(triggers.size());
+
+           for (Trigger t : triggers)
+           {
+               step(rules, t);
+               trace.push_back(toConfig(rules.getState(), rules.getLoaderSubstate()));
+           }
+
+           return trace;
+       }
+
+       static void step(SafetyRules& rules, Trigger t)
+       {
+           if (t == Trigger::Reset)
+           {
+               rules.reset();
+           }
+           else if (t == Trigger::StartLoader)
+           {
+               rules.startLoader();
+           }
+           else
+           {
+               rules.dispatch(static_cast<Ev>(t));
+           }
+       }
+
+       static void driveTo(SafetyRules& rules, Config config)
+       {
+           if (stateOf(config) == State::Idle)
+           {
+               return;
+           }
+
+           rules.dispatch(Ev::evPowerOn);
+
+           if (stateOf(config) == State::Faulted)
+           {
+               rules.dispatch(Ev::evFault);
+           }
+           else if (stateOf(config) == State::BuildPlateLoader)
+           {
+               rules.startLoader();
+
+               if (subOf(config) != Sub::OpenDoor)  rules.dispatch(Ev::evDoorOpened);
+               if (subOf(config) == Sub::BuildPlateLoaded) rules.dispatch(Ev::evBuildPlateLoaded);
+           }
+
+           ASSERT_EQ(toConfig(rules.getState(), rules.getLoaderSubstate()), config);
+       }
+
+       static std::vector<Config> reachableConfigs()
+       {
+           std::vector<Config> configs;
+
+           for (Config c = 0; c < kConfigCount; ++c)
+           {
+               if (isReachable(c))
+               {
+                   configs.push_back(c);
+               }
+           }
+
+           return configs;
+       }
+   };
+
+   TEST_F(SafetyScanTest, SixReachableConfigurations)
+   {
+       EXPECT_EQ(reachableConfigs().size(), 6u);
+       EXPECT_TRUE(isReachable(toConfig(State::Idle, Sub::None)));
+       EXPECT_FALSE(isReachable(toConfig(State::Idle, Sub::OpenDoor)));
+       EXPECT_FALSE(isReachable(toConfig(State::BuildPlateLoader, Sub::None)));
+   }
+
+   // The effect of a sequence matches stepping each start configuration through it,
+   // and the effect of a concatenation is the composition of the effects
+   TEST_F(SafetyScanTest, EffectsCompose)
+   {
+       const auto triggers = randomTriggers(3000, 1);
+
+       for (std::size_t cut : { std::size_t(0), std::size_t(1), std::size_t(17), std::size_t(1500), triggers.size() })
+       {
+           const ConfigMap a = effectOf(triggers.data(), cut);
+           const ConfigMap b = effectOf(triggers.data() + cut, triggers.size() - cut);
+           const ConfigMap whole = effectOf(triggers.data(), triggers.size());
+
+           EXPECT_EQ(compose(a, b), whole) << "cut at " << cut;
+       }
+
+       const ConfigMap whole = effectOf(triggers.data(), triggers.size());
+
+       for (Config c : reachableConfigs())
+       {
+           EXPECT_EQ(whole[c], sequential(c, triggers).back()) << "from " << int(c);
+       }
+
+       EXPECT_EQ(effectOf(triggers.data(), 0), identityMap());
+   }
+
+   // Ignored triggers never merge paths; the effect is still exact
+   TEST_F(SafetyScanTest, EffectWithoutConvergence)
+   {
+       const std::vector<Trigger> triggers(1000, Trigger::evBuildPlateLoaded);
+       const ConfigMap map = effectOf(triggers.data(), triggers.size());
+
+       for (Config c : reachableConfigs())
+       {
+           EXPECT_EQ(map[c], sequential(c, triggers).back());
+       }
+   }
+
+   // Parallel fast-forward matches sequential dispatch at every position, for every
+   // start configuration, thread count and chunk boundary
+   TEST_F(SafetyScanTest, MatchesSequentialDispatch)
+   {
+       const auto triggers = randomTriggers(300000 + 7, 2);
+
+       for (Config start : reachableConfigs())
+       {
+           const auto expected = sequential(start, triggers);
+
+           for (unsigned threads : { 1u, 2u, 3u, 4u, 0u })
+           {
+               std::vector<Config> trace(triggers.size());
+
+               EXPECT_EQ(fastForward(start, triggers.data(), triggers.size(), nullptr, threads), expected.back())
+                   << "start " << int(start) << ", " << threads << " threads";
+               EXPECT_EQ(fastForward(start, triggers.data(), triggers.size(), trace.data(), threads), expected.back());
+               EXPECT_TRUE(trace == expected) << "start " << int(start) << ", " << threads << " threads";
+           }
+       }
+   }
+
+   // Event streams (no StartLoader/Reset) take the same path
+   TEST_F(SafetyScanTest, EventStream)
+   {
+       std::mt19937 rng(3);
+       std::uniform_int_distribution<int> pick(0, 5);
+
+       std::vector<Ev> events(200000);
+       std::vector<Trigger> triggers(events.size());
+
+       for (std::size_t i = 0; i < events.size(); ++i)
+       {
+           events[i]   = static_cast<Ev>(pick(rng));
+           triggers[i] = toTrigger(events[i]);
+       }
+
+       const Config start = toConfig(State::Active, Sub::None);
+       const auto expected = sequential(start, triggers);
+       std::vector<Config> trace(events.size());
+
+       EXPECT_EQ(fastForward(start, events.data(), events.size(), trace.data(), 4), expected.back());
+       EXPECT_TRUE(trace == expected);
+   }
+
+   TEST_F(SafetyScanTest, EmptyStream)
+   {
+       const Config start = toConfig(State::Faulted, Sub::None);
+       EXPECT_EQ(fastForward(start, static_cast<const Trigger*>(nullptr), 0), start);
+   }
+
+}
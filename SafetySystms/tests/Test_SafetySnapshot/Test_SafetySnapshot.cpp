@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+#include "SafetySnapshot/SafetySnapshot.h"
+#include "SafetyRules/SafetyRules.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace Test_SafetySnapshot_Namespace
+{
+
+   using namespace safety;
+
+   class SafetySnapshotTest : public ::testing::Test
+   {
+   protected:
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+       using Ev    = ISafetyRules::Event;
+
+   protected:
+       const std::string name = "/Test_SafetySnapshot." + std::to_string(::getpid());
+       SafetyRules uut;
+   };
+
+   // Transitions are published with their trigger; ignored triggers are not
+   TEST_F(SafetySnapshotTest, PublishesTransitionsOnly)
+   {
+       SafetySnapshot snapshot;
+       SnapshotReader reader(snapshot);
+
+       snapshot.attach(uut);
+       EXPECT_EQ(reader.read().transitions, 1u);
+       EXPECT_EQ(reader.read().state, State::Idle);
+
+       uut.dispatch(Ev::evPowerOn);
+       uut.startLoader();
+       uut.dispatch(Ev::evDoorClosed);     // ignored
+
+       const Snapshot s = reader.read();
+       EXPECT_EQ(s.state, State::BuildPlateLoader);
+       EXPECT_EQ(s.sub, Sub::OpenDoor);
+       EXPECT_EQ(s.config, toConfig(State::BuildPlateLoader, Sub::OpenDoor));
+       EXPECT_EQ(s.trigger, Trigger::StartLoader);
+       EXPECT_EQ(s.transitions, 3u);
+       EXPECT_NE(s.timestampNs, 0u);
+
+       // A reset publishes even when the machine is already in Idle
+       uut.reset();
+       uut.reset();
+       EXPECT_EQ(reader.transitions(), 5u);
+       EXPECT_EQ(reader.read().trigger, Trigger::Reset);
+
+       snapshot.detach(uut);
+       uut.dispatch(Ev::evPowerOn);
+       EXPECT_EQ(reader.read().state, State::Idle);
+   }
+
+   // The snapshot shares the machine with other step observers
+   TEST_F(SafetySnapshotTest, CoexistsWithOtherObservers)
+   {
+       int steps = 0;
+       int* counter = &steps;
+       uut.addOnStep([counter](Trigger, Config) { ++*counter; });
+
+       SafetySnapshot snapshot;
+       SnapshotReader reader(snapshot);
+       snapshot.attach(uut);
+
+       uut.dispatch(Ev::evPowerOn);
+       EXPECT_EQ(reader.read().state, State::Active);
+       EXPECT_EQ(steps, 1);
+
+       snapshot.detach(uut);
+       uut.dispatch(Ev::evFault);
+       EXPECT_EQ(reader.read().state, State::Active);
+       EXPECT_EQ(steps, 2);
+   }
+
+   TEST_F(SafetySnapshotTest, TimestampsAreMonotonic)
+   {
+       SafetySnapshot snapshot;
+       SnapshotReader reader(snapshot);
+       snapshot.attach(uut);
+
+       std::uint64_t previous = reader.read().timestampNs;
+
+       for (int i = 0; i < 10; ++i)
+       {
+           uut.dispatch(i % 2 ? Ev::evPowerOff : Ev::evPowerOn);
+
+           const std::uint64_t now = reader.read().timestampNs;
+           EXPECT_GE(now, previous);
+           previous = now;
+       }
+   }
+
+   // Concurrent readers never see a torn snapshot: the writer publishes payloads
+   // whose fields are all functions of the transition count
+   TEST_F(SafetySnapshotTest, ConcurrentReadersSeeConsistentCopies)
+   {
+       constexpr std::uint64_t kPublishes = 200000;
+       constexpr Config kConfigs[] = {
+           toConfig(State::Idle, Sub::None),
+           toConfig(State::Active, Sub::None),
+           toConfig(State::BuildPlateLoader, Sub::OpenDoor),
+           toConfig(State::BuildPlateLoader, Sub::DoorOpened),
+           toConfig(State::BuildPlateLoader, Sub::BuildPlateLoaded),
+           toConfig(State::Faulted, Sub::None),
+       };
+
+       SafetySnapshot snapshot;
+       std::atomic<bool> done { false };
+       std::atomic<std::uint64_t> torn { 0 };
+       std::atomic<std::uint64_t> reads { 0 };
+       std::atomic<int> started { 0 };
+
+       std::vector<std::thread> readers;
+
+       for (int r = 0; r < 3; ++r)
+       {
+           readers.emplace_back([&]() {
+               SnapshotReader reader(snapshot);
+               std::uint64_t seen = 0;
+               started.fetch_add(1, std::memory_order_release);
+
+               while (!done.load(std::memory_order_acquire))
+               {
+                   const Snapshot s = reader.read();
+
+                   if (s.transitions == 0)
+                   {
+                       continue;
+                   }
+
+                   const bool consistent = s.timestampNs == s.transitions * 7
+                                           && s.config == kConfigs[s.transitions % 6]
+                                           && s.trigger == static_cast<Trigger>(s.transitions % 7)
+                                           && s.transitions >= seen;
+
+                   torn.fetch_add(consistent ? 0 : 1, std::memory_order_relaxed);
+                   seen = s.transitions;
+                   reads.fetch_add(1, std::memory_order_relaxed);
+               }
+           });
+       }
+
+       while (started.load(std::memory_order_acquire) != 3)
+       {
+           std::this_thread::yield();
+       }
+
+       for (std::uint64_t n = 1; n <= kPublishes; ++n)
+       {
+           snapshot.publish(static_cast<Trigger>(n % 7), kConfigs[n % 6], n * 7);
+
+           // Lets the readers interleave even on a single core
+           if (n % 1024 == 0)
+           {
+               std::this_thread::yield();
+           }
+       }
+
+       done.store(true, std::memory_order_release);
+
+       for (auto& t : readers)
+       {
+           t.join();
+       }
+
+       EXPECT_EQ(torn.load(), 0u);
+       EXPECT_GT(reads.load(), 0u);
+       EXPECT_EQ(SnapshotReader(snapshot).read().transitions, kPublishes);
+   }
+
+   // A monitoring process maps the snapshot by name
+   TEST_F(SafetySnapshotTest, SharedMemoryReaderSeesWriter)
+   {
+       SafetySnapshot snapshot(name);
+       snapshot.attach(uut);
+
+       SnapshotReader reader(name);
+       uut.dispatch(Ev::evPowerOn);
+       uut.dispatch(Ev::evFault);
+
+       const Snapshot s = reader.read();
+       EXPECT_EQ(s.state, State::Faulted);
+       EXPECT_EQ(s.trigger, Trigger::evFault);
+       EXPECT_EQ(s.transitions, 3u);
+   }
+
+   TEST_F(SafetySnapshotTest, SharedMemoryIsUnlinkedWithTheWriter)
+   {
+       {
+           SafetySnapshot snapshot(name);
+       }
+
+       EXPECT_THROW(SnapshotReader reader(name), std::system_error);
+   }
+
+}
@@ -0,0 +1,314 @@
+#include <gtest/gtest.h>
+#include "SafetyRules/SafetyRules.h"
+#include "SafetyTimers/LoaderDeadlines.h"
+#include "SafetyTimers/TimingWheel.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace Test_SafetyTimers_Namespace
+{
+
+   using namespace safety;
+
+   // ----- TimingWheel
+
+   class TimingWheelTest : public ::testing::Test
+   {
+   protected:
+       struct Probe : TimingWheel::Timer
+       {
+           int           id { 0 };
+           std::uint64_t firedAt { 0 };
+           int           fired { 0 };
+       };
+
+       static void record(void* wheel, TimingWheel::Timer& timer)
+       {
+           Probe& p = static_cast<Probe&>(timer);
+           p.firedAt = static_cast<TimingWheel*>(wheel)->now();
+           ++p.fired;
+       }
+
+       TimingWheel wheel { 1000 };
+
+       void SetUp() override
+       {
+           wheel.setOnExpire(TimingWheel::ExpireFn::bind<&TimingWheelTest::record>(&wheel));
+       }
+   };
+
+   TEST_F(TimingWheelTest, FiresAtDeadlineOnEveryLevel)
+   {
+       const std::uint64_t delays[] = { 1, 255, 256, 257, 65535, 65536, 70000, 1u << 24, (1u << 24) + 3, 1ull << 33 };
+       std::vector<Probe> probes(sizeof(delays) / sizeof(delays[0]));
+
+       for (std::size_t i = 0; i < probes.size(); ++i)
+       {
+           wheel.arm(probes[i], 1000 + delays[i]);
+       }
+
+       EXPECT_EQ(wheel.size(), probes.size());
+
+       for (std::size_t i = 0; i < probes.size(); ++i)
+       {
+           wheel.advance(1000 + delays[i] - 1);
+           EXPECT_EQ(probes[i].fired, 0) << "delay " << delays[i];
+
+           wheel.advance(1000 + delays[i]);
+           EXPECT_EQ(probes[i].fired, 1) << "delay " << delays[i];
+           EXPECT_EQ(probes[i].firedAt, 1000 + delays[i]);
+       }
+
+       EXPECT_EQ(wheel.size(), 0u);
+   }
+
+   TEST_F(TimingWheelTest, PastDeadlineFiresOnNextAdvance)
+   {
+       Probe p;
+       wheel.arm(p, 10);
+       wheel.advance(1000);
+       EXPECT_EQ(p.fired, 0);
+       wheel.advance(1001);
+       EXPECT_EQ(p.fired, 1);
+   }
+
+   TEST_F(TimingWheelTest, CancelAndRearm)
+   {
+       Probe a, b;
+       wheel.arm(a, 1100);
+       wheel.arm(b, 1100);
+       wheel.cancel(a);
+       wheel.cancel(a);   // idempotent
+       wheel.arm(b, 1300);
+
+       wheel.advance(1200);
+       EXPECT_EQ(a.fired, 0);
+       EXPECT_EQ(b.fired, 0);
+       EXPECT_FALSE(a.armed());
+       EXPECT_TRUE(b.armed());
+
+       wheel.advance(5000);
+       EXPECT_EQ(b.fired, 1);
+       EXPECT_EQ(b.firedAt, 1300u);
+   }
+
+   // Random arm/cancel/advance against a reference multimap
+   TEST_F(TimingWheelTest, MatchesReference)
+   {
+       constexpr int kTimers = 2000;
+       std::vector<Probe> probes(kTimers);
+       std::map<int, std::uint64_t> expected;   // id -> tick it must fire at, armed only
+
+       for (int i = 0; i < kTimers; ++i)
+       {
+           probes[i].id = i;
+       }
+
+       std::mt19937_64 rng(11);
+       std::uint64_t now = 1000;
+
+       for (int round = 0; round < 3000; ++round)
+       {
+           for (int k = 0; k < 5; ++k)
+           {
+               Probe& p = probes[rng() % kTimers];
+               const int spread = static_cast<int>(rng() % 4);
+               const std::uint64_t delay = rng() % (std::uint64_t(1) << (6 + 6 * spread));
+
+               if (rng() % 4 == 0)
+               {
+                   wheel.cancel(p);
+                   expected.erase(p.id);
+               }
+               else
+               {
+                   wheel.arm(p, now + delay);
+                   expected[p.id] = now + std::max<std::uint64_t>(delay, 1);   // due now: next tick
+               }
+           }
+
+           now += rng() % 3000;
+           std::vector<int> before(kTimers);
+
+           for (int i = 0; i < kTimers; ++i)
+           {
+               before[i] = probes[i].fired;
+           }
+
+           wheel.advance(now);
+
+           for (int i = 0; i < kTimers; ++i)
+           {
+               auto it = expected.find(i);
+               const bool due = it != expected.end() && it->second <= now;
+
+               ASSERT_EQ(probes[i].fired - before[i], due ? 1 : 0) << "timer " << i << " round " << round;
+
+               if (due)
+               {
+                   ASSERT_EQ(probes[i].firedAt, it->second);
+                   expected.erase(it);
+               }
+           }
+
+           ASSERT_EQ(wheel.size(), expected.size());
+       }
+   }
+
+   // ----- LoaderDeadlines on virtual time
+
+   class LoaderDeadlinesTest : public ::testing::Test
+   {
+   protected:
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+       using Ev    = ISafetyRules::Event;
+
+       static std::uint64_t readClock(void* now)
+       {
+           return *static_cast<std::uint64_t*>(now);
+       }
+
+       std::uint64_t now = 0;
+       LoaderDeadlines deadlines { LoaderDeadlines::Limits { 100, 500, 50 },
+                                   LoaderDeadlines::Clock::bind<&LoaderDeadlinesTest::readClock>(&now) };
+
+       void advanceTo(std::uint64_t t)
+       {
+           now = t;
+           deadlines.poll();
+       }
+   };
+
+   TEST_F(LoaderDeadlinesTest, StuckDoorFaults)
+   {
+       SafetyRules uut;
+       int faults = 0;
+       uut.setOnEnterFaulted([&faults]() { ++faults; });
+       deadlines.attach(uut);
+
+       uut.dispatch(Ev::evPowerOn);
+       uut.startLoader();
+       EXPECT_EQ(deadlines.pending(), 1u);
+
+       advanceTo(99);
+       EXPECT_EQ(uut.getLoaderSubstate(), Sub::OpenDoor);
+
+       advanceTo(100);
+       EXPECT_EQ(uut.getState(), State::Faulted);
+       EXPECT_EQ(faults, 1);
+       EXPECT_EQ(deadlines.expired(), 1u);
+       EXPECT_EQ(deadlines.pending(), 0u);
+   }
+
+   // Each substate gets its own deadline; leaving the loader cancels it
+   TEST_F(LoaderDeadlinesTest, ProgressRestartsAndCompletionCancels)
+   {
+       SafetyRules uut;
+       deadlines.attach(uut);
+
+       uut.dispatch(Ev::evPowerOn);
+       uut.startLoader();
+       advanceTo(90);
+       uut.dispatch(Ev::evDoorOpened);        // DoorOpened: 500 from now
+       uut.dispatch(Ev::evDoorClosed);        // ignored: does not restart the deadline
+       advanceTo(580);
+       EXPECT_EQ(uut.getLoaderSubstate(), Sub::DoorOpened);
+
+       uut.dispatch(Ev::evBuildPlateLoaded);  // BuildPlateLoaded: 50 from now
+       advanceTo(620);
+       uut.dispatch(Ev::evDoorClosed);        // back to Active: cancelled
+       EXPECT_EQ(deadlines.pending(), 0u);
+
+       advanceTo(10000);
+       EXPECT_EQ(uut.getState(), State::Active);
+       EXPECT_EQ(deadlines.expired(), 0u);
+   }
+
+   TEST_F(LoaderDeadlinesTest, ZeroLimitMeansNoDeadline)
+   {
+       LoaderDeadlines relaxed { LoaderDeadlines::Limits { 0, 0, 0 },
+                                 LoaderDeadlines::Clock::bind<&LoaderDeadlinesTest::readClock>(&now) };
+       SafetyRules uut;
+       relaxed.attach(uut);
+
+       uut.dispatch(Ev::evPowerOn);
+       uut.startLoader();
+       EXPECT_EQ(relaxed.pending(), 0u);
+
+       now = 1000000;
+       EXPECT_EQ(relaxed.poll(), 0u);
+       EXPECT_EQ(uut.getLoaderSubstate(), Sub::OpenDoor);
+   }
+
+   TEST_F(LoaderDeadlinesTest, DetachCancels)
+   {
+       SafetyRules uut;
+       deadlines.attach(uut);
+       uut.dispatch(Ev::evPowerOn);
+       uut.startLoader();
+
+       deadlines.detach(uut);
+       EXPECT_EQ(deadlines.pending(), 0u);
+
+       advanceTo(1000);
+       EXPECT_EQ(uut.getState(), State::BuildPlateLoader);
+
+       // The freed slot is reused
+       SafetyRules other;
+       deadlines.attach(other);
+       other.dispatch(Ev::evPowerOn);
+       other.startLoader();
+       advanceTo(1100);
+       EXPECT_EQ(other.getState(), State::Faulted);
+   }
+
+   // 100k machines entering the loader at staggered times: every even one misses its
+   // OpenDoor deadline, no odd one reaches its DoorOpened deadline
+   TEST_F(LoaderDeadlinesTest, HundredThousandMachines)
+   {
+       constexpr std::size_t kMachines = 100000;
+       LoaderDeadlines deadlines { LoaderDeadlines::Limits { 100, 5000, 50 },
+                                   LoaderDeadlines::Clock::bind<&LoaderDeadlinesTest::readClock>(&now) };
+       std::vector<std::unique_ptr<SafetyRules>> machines;
+       machines.reserve(kMachines);
+
+       for (std::size_t m = 0; m < kMachines; ++m)
+       {
+           machines.push_back(std::make_unique<SafetyRules>());
+           deadlines.attach(*machines.back());
+           machines.back()->dispatch(Ev::evPowerOn);
+       }
+
+       // Machine m enters OpenDoor at time m / 100; odd machines open the door in time
+       for (std::size_t m = 0; m < kMachines; ++m)
+       {
+           now = m / 100;
+           machines[m]->startLoader();
+       }
+
+       // Odd machines open the door 50 ticks in, and then have 5000 more in DoorOpened
+       for (std::size_t m = 1; m < kMachines; m += 2)
+       {
+           now = m / 100 + 50;
+           deadlines.poll();
+           machines[m]->dispatch(Ev::evDoorOpened);
+       }
+
+       now = (kMachines - 1) / 100 + 100;
+       deadlines.poll();
+
+       EXPECT_EQ(deadlines.expired(), kMachines / 2);
+       EXPECT_EQ(deadlines.pending(), kMachines / 2);
+
+       for (std::size_t m = 0; m < kMachines; ++m)
+       {
+           ASSERT_EQ(machines[m]->getState(), m % 2 ? State::BuildPlateLoader : State::Faulted) << m;
+       }
+   }
+
+}
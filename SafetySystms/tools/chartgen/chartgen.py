@@ -0,0 +1,507 @@
+#!/usr/bin/env python3
+"""Generate a constexpr-table ISafetyRules implementation from a PlantUML state chart.
+
+    chartgen.py --chart doc/StartChart.plantuml --out ChartSafetyRules.h
+                [--class ChartSafetyRules]
+                [--alias chartEvent=apiEvent ...] [--action sentEvent=Hook ...]
+
+Understood PlantUML subset:
+    state X            declares a state in the current scope
+    state X {  ...  }  composite state (one level of nesting is supported)
+    X : entry/send(e)  entry action of X
+    A -> B : ev        transition on ev (any arrow: ->, -->, -up->, ...)
+    [*] -> X           initial state of the enclosing scope
+    X -> [*] : ev      completion of the enclosing composite
+    C -> B             unlabeled arc from a composite: taken on its completion
+Descriptions, comments and layout directives are ignored. A single composite
+wrapping the whole chart is taken as the machine itself.
+
+The chart's vocabulary is mapped onto ISafetyRules:
+    --alias evActive=evPowerOn        chart event delivered by dispatch(Event::evPowerOn)
+    --alias evLoadBuildPlate=startLoader
+    --action evRequestDoorOpen=RequestDoorOpen   entry action -> Hook
+Top-level states must be ISafetyRules::State names and substates LoaderSub names.
+Every chart event, mapped or not, is available through dispatch(ChartEvent).
+"""
+
+import argparse
+import re
+import sys
+
+# ----- The ISafetyRules surface the generated class implements (order matters)
+API_STATES = ["Idle", "Active", "Faulted", "BuildPlateLoader"]
+API_SUBS = ["None", "OpenDoor", "DoorOpened", "BuildPlateLoaded"]
+API_EVENTS = ["evPowerOn", "evPowerOff", "evFault", "evDoorOpened", "evBuildPlateLoaded", "evDoorClosed"]
+API_START_LOADER = "startLoader"
+CONFIG_COUNT = 16
+
+TRANSITION_RE = re.compile(
+    r"^(\[\*\]|\w+)\s*-+(?:up|down|left|right|u|d|l|r)?-*>\s*(\[\*\]|\w+)\s*(?::\s*(\w+)\s*)?(?:'.*)?$")
+COMPOSITE_RE = re.compile(r"^state\s+(\w+)\s*\{\s*$")
+STATE_RE = re.compile(r"^state\s+(\w+)\s*(?:'.*)?$")
+ENTRY_RE = re.compile(r"^(\w+)\s*:\s*entry\s*/\s*send\(\s*(\w+)\s*\)\s*$")
+DESCRIPTION_RE = re.compile(r"^(\w+)\s*:")
+IGNORED_PREFIXES = ("'", "@startuml", "@enduml", "skinparam", "left to right", "top to bottom", "hide", "title")
+
+
+class ChartError(Exception):
+    pass
+
+
+class State:
+    def __init__(self, name, parent):
+        self.name = name
+        self.parent = parent
+        self.children = []
+        self.initial = None
+        self.entry = None
+        self.completions = {}     # substate -> event that completes the composite
+        self.transitions = {}     # event (None = completion) -> target name
+
+
+class Chart:
+    def __init__(self):
+        self.root = State("<chart>", None)
+        self.states = {}
+        self.events = []
+
+    def declare(self, name, scope):
+        if name not in self.states:
+            state = State(name, scope)
+            scope.children.append(state)
+            self.states[name] = state
+        return self.states[name]
+
+    def event(self, name):
+        if name and name not in self.events:
+            self.events.append(name)
+
+
+def parse(path):
+    chart = Chart()
+    scopes = [chart.root]
+
+    with open(path, encoding="utf-8") as f:
+        for number, raw in enumerate(f, 1):
+            line = raw.strip()
+
+            if not line or line.startswith(IGNORED_PREFIXES):
+                continue
+
+            scope = scopes[-1]
+            where = "%s:%d" % (path, number)
+
+            if line == "}":
+                if len(scopes) == 1:
+                    raise ChartError("%s: unbalanced '}'" % where)
+                scopes.pop()
+                continue
+
+            m = COMPOSITE_RE.match(line)
+            if m:
+                scopes.append(chart.declare(m.group(1), scope))
+                continue
+
+            m = STATE_RE.match(line)
+            if m:
+                chart.declare(m.group(1), scope)
+                continue
+
+            m = TRANSITION_RE.match(line)
+            if m:
+                source, target, event = m.groups()
+                chart.event(event)
+
+                if source == "[*]":
+                    if target == "[*]":
+                        raise ChartError("%s: [*] -> [*]" % where)
+                    scope.initial = chart.declare(target, scope).name
+                elif target == "[*]":
+                    chart.declare(source, scope)
+                    scope.completions[source] = event
+                else:
+                    state = chart.declare(source, scope)
+                    chart.declare(target, scope)
+                    if event in state.transitions:
+                        raise ChartError("%s: %s has two transitions on %s" % (where, source, event))
+                    state.transitions[event] = target
+                continue
+
+            m = ENTRY_RE.match(line)
+            if m:
+                chart.declare(m.group(1), scope).entry = m.group(2)
+                continue
+
+            if DESCRIPTION_RE.match(line):
+                continue
+
+            raise ChartError("%s: cannot parse: %s" % (where, line))
+
+    if len(scopes) != 1:
+        raise ChartError("%s: unterminated state block" % path)
+
+    # A lone composite wrapping everything is the machine
+    root = chart.root
+    if len(root.children) == 1 and root.children[0].children and root.initial is None:
+        root = root.children[0]
+
+    return chart, root
+
+
+# ----- Semantics: one (next, exit, enter, action) per (configuration, event)
+
+def config_of(state, sub):
+    return API_STATES.index(state) << 2 | API_SUBS.index(sub)
+
+
+def build_table(chart, root, actions):
+    tops = root.children
+
+    for top in tops:
+        if top.name not in API_STATES:
+            raise ChartError("top-level state %s is not an ISafetyRules::State" % top.name)
+        for sub in top.children:
+            if sub.name not in API_SUBS[1:]:
+                raise ChartError("substate %s is not an ISafetyRules::LoaderSub" % sub.name)
+            if sub.children:
+                raise ChartError("%s: only one level of nesting is supported" % sub.name)
+        if top.entry:
+            raise ChartError("%s: entry actions are only supported on substates" % top.name)
+        if top.children and top.initial is None:
+            raise ChartError("composite %s has no initial substate" % top.name)
+
+    if root.initial is None:
+        raise ChartError("the chart has no initial state")
+
+    by_name = {top.name: top for top in tops}
+
+    def action_of(sub):
+        if sub is None or sub.entry is None:
+            return "None"
+        if sub.entry not in actions:
+            raise ChartError("no --action mapping for %s (entry of %s)" % (sub.entry, sub.name))
+        return actions[sub.entry]
+
+    def enter(source_top, target_name):
+        if target_name not in by_name:
+            raise ChartError("transition from %s to %s leaves the top level" % (source_top.name, target_name))
+        target = by_name[target_name]
+        sub = chart.states[target.initial] if target.children else None
+        return (config_of(target.name, sub.name if sub else "None"),
+                "Exit" + source_top.name, "Enter" + target.name, action_of(sub))
+
+    configs = {}
+    for top in tops:
+        for sub in (top.children or [None]):
+            configs[config_of(top.name, sub.name if sub else "None")] = (top, sub)
+
+    table = {}
+    for config, (top, sub) in configs.items():
+        for event in chart.events:
+            cell = None
+
+            # Inner transitions take priority over the composite's own
+            if sub is not None:
+                if sub.transitions.get(event):
+                    target = chart.states[sub.transitions[event]]
+                    if target.parent is top:
+                        cell = (config_of(top.name, target.name), "None", "None", action_of(target))
+                    else:
+                        cell = enter(top, target.name)
+                elif sub.name in top.completions and top.completions[sub.name] == event:
+                    if None not in top.transitions:
+                        raise ChartError("%s completes but has no unlabeled outgoing arc" % top.name)
+                    cell = enter(top, top.transitions[None])
+
+            if cell is None and event in top.transitions:
+                cell = enter(top, top.transitions[event])
+
+            table[(config, event)] = cell
+
+    initial = config_of(root.initial, "None")
+    if by_name[root.initial].children:
+        raise ChartError("initial state %s must not be composite" % root.initial)
+
+    return configs, table, initial
+
+
+# ----- Emission
+
+HEADER = """\
+// Generated by tools/chartgen/chartgen.py from {chart}. Do not edit: change the chart
+// (or the generator) and rebuild.
+#pragma once
+#include "SafetyRules/ISafetyRules.h"
+#include "SafetyRules/SafetyTable.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace safety
+{{
+
+   // ----- Every event named in the chart, in order of first appearance
+   enum class ChartEvent : std::uint8_t
+   {{
+{chart_events}
+   }};
+
+   constexpr std::size_t kChartEventCount = {event_count};
+
+   namespace chart
+   {{
+       constexpr std::size_t kRowWidth = {row_width};   // chart events padded to a power of two
+
+       using Row   = std::array<Transition, kRowWidth>;
+       using Table = std::array<Row, kConfigCount>;
+
+       constexpr Row stayRow(Config config)
+       {{
+           Row row {{}};
+
+           for (auto& cell : row)
+           {{
+               cell = detail::stay(config);
+           }}
+
+           return row;
+       }}
+
+       // (configuration, chart event) -> next configuration and hooks
+       constexpr Table kTable = {{{{
+{rows}
+       }}}};
+
+       // ISafetyRules::Event -> chart event (column){event_comment}
+       constexpr std::array<std::uint8_t, {api_event_count}> kEventColumn = {{{{ {event_columns} }}}};
+
+       constexpr std::uint8_t kStartLoaderColumn = {start_loader_column};{start_loader_comment}
+
+       constexpr Config kInitial = {initial};
+
+{asserts}
+   }}
+
+   // Chart-generated ISafetyRules: a table lookup per trigger, no switch and no
+   // virtual call when used through the (final) class.
+   class {cls} final : public ISafetyRules
+   {{
+      public:
+          // ----- Construction
+          {cls}()
+          {{
+              reset();
+          }}
+
+          // ----- ISafetyRules (control)
+          void reset() override
+          {{
+              config = chart::kInitial;
+
+              fire(Hook::Enter{initial_state});
+          }}
+
+          void dispatch(Event ev) override
+          {{
+              step(chart::kEventColumn[static_cast<std::size_t>(ev)]);
+          }}
+
+          void startLoader() override
+          {{
+              step(chart::kStartLoaderColumn);
+          }}
+
+          // ----- Chart vocabulary, including events ISafetyRules does not have
+          void dispatch(ChartEvent ev)
+          {{
+              step(static_cast<std::uint8_t>(ev));
+          }}
+
+          // ----- ISafetyRules (observability)
+          State getState() const override
+          {{
+              return stateOf(config);
+          }}
+
+          LoaderSub getLoaderSubstate() const override
+          {{
+              return subOf(config);
+          }}
+
+          // ----- ISafetyRules (callback setters)
+          void setOnEnterIdle(VoidFn cb) override                 {{ hook(Hook::EnterIdle) = cb; }}
+          void setOnExitIdle(VoidFn cb) override                  {{ hook(Hook::ExitIdle) = cb; }}
+
+          void setOnEnterActive(VoidFn cb) override               {{ hook(Hook::EnterActive) = cb; }}
+          void setOnExitActive(VoidFn cb) override                {{ hook(Hook::ExitActive) = cb; }}
+
+          void setOnEnterFaulted(VoidFn cb) override              {{ hook(Hook::EnterFaulted) = cb; }}
+          void setOnExitFaulted(VoidFn cb) override               {{ hook(Hook::ExitFaulted) = cb; }}
+
+          void setOnEnterBuildPlateLoader(VoidFn cb) override     {{ hook(Hook::EnterBuildPlateLoader) = cb; }}
+          void setOnExitBuildPlateLoader(VoidFn cb) override      {{ hook(Hook::ExitBuildPlateLoader) = cb; }}
+
+          void setOnRequestDoorOpen(VoidFn cb) override           {{ hook(Hook::RequestDoorOpen) = cb; }}
+          void setOnRequestLoadBuildPlate(VoidFn cb) override     {{ hook(Hook::RequestLoadBuildPlate) = cb; }}
+          void setOnRequestDoorClose(VoidFn cb) override          {{ hook(Hook::RequestDoorClose) = cb; }}
+
+      private:
+          // ----- Same step as SafetyRules: hooks observe the submachine left / not yet entered
+          void step(std::uint8_t column)
+          {{
+              const Transition t = chart::kTable[config][column];
+
+              if (t.exit != Hook::None)
+              {{
+                  config = topOf(config);
+                  fire(t.exit);
+
+                  config = topOf(t.next);
+                  fire(t.enter);
+              }}
+
+              config = t.next;
+
+              if (t.action != Hook::None)
+              {{
+                  fire(t.action);
+              }}
+          }}
+
+          VoidFn& hook(Hook h)
+          {{
+              return hooks[static_cast<std::size_t>(h)];
+          }}
+
+          void fire(Hook h)
+          {{
+              const VoidFn& fn = hooks[static_cast<std::size_t>(h)];
+
+              if (fn) fn();
+          }}
+
+      private:
+          Config config {{ chart::kInitial }};
+
+          std::array<VoidFn, kHookCount> hooks;
+   }};
+
+}} // namespace safety
+"""
+
+
+def config_name(config):
+    return "%s.%s" % (API_STATES[config >> 2], API_SUBS[config & 3])
+
+
+def emit(chart_path, cls, chart, configs, table, initial, aliases):
+    events = chart.events
+    api_columns = {}
+    for event in events:
+        api_columns[aliases.get(event, event)] = events.index(event)
+
+    unmapped = [e for e in API_EVENTS + [API_START_LOADER] if e not in api_columns]
+    row_width = 1
+    while row_width < len(events) + (1 if unmapped else 0):
+        row_width *= 2
+    ignore_column = len(events)  # padding: stays everywhere
+
+    def column_of(api_event):
+        return api_columns.get(api_event, ignore_column)
+
+    def cell_text(config, event):
+        cell = table.get((config, event))
+        if cell is None:
+            return "detail::stay(%d)" % config
+        return "{ %2d, Hook::%s, Hook::%s, Hook::%s }" % cell
+
+    rows = []
+    for config in range(CONFIG_COUNT):
+        if config not in configs:
+            rows.append("           stayRow(%d),%s// unreachable" % (config, " " * (12 - len(str(config)))))
+            continue
+        cells = ["%-55s // %s" % (cell_text(config, e) + ",", e) for e in events]
+        cells += ["%-55s // (padding)" % ("detail::stay(%d)," % config)] * (row_width - len(events))
+        rows.append("           // %s\n           Row {{\n               %s\n           }}," % (
+            config_name(config), "\n               ".join(cells)))
+
+    chart_events = "\n".join(
+        ("       %-24s%s" % (e + ("," if i + 1 < len(events) else ""),
+                             "" if aliases.get(e, e) == e else "// " + aliases[e])).rstrip()
+        for i, e in enumerate(events))
+
+    event_comment = ""
+    missing = [e for e in API_EVENTS if e not in api_columns]
+    if missing:
+        event_comment = "; not in the chart (ignored): " + ", ".join(missing)
+
+    start_loader_comment = ""
+    if API_START_LOADER not in api_columns:
+        start_loader_comment = "   // not in the chart: ignored"
+
+    asserts = []
+    for i, e in enumerate(API_EVENTS):
+        asserts.append("       static_assert(static_cast<int>(ISafetyRules::Event::%s) == %d, "
+                       "\"Regenerate: ISafetyRules::Event changed\");" % (e, i))
+    for i, s in enumerate(API_STATES):
+        asserts.append("       static_assert(toConfig(ISafetyRules::State::%s, ISafetyRules::LoaderSub::None) == %d, "
+                       "\"Regenerate: configuration encoding changed\");" % (s, i << 2))
+
+    return HEADER.format(
+        chart=chart_path.replace("\\", "/").split("/")[-1],
+        chart_events=chart_events,
+        event_count=len(events),
+        row_width=row_width,
+        rows="\n".join(rows),
+        api_event_count=len(API_EVENTS),
+        event_columns=", ".join(str(column_of(e)) for e in API_EVENTS),
+        event_comment=event_comment,
+        start_loader_column=column_of(API_START_LOADER),
+        start_loader_comment=start_loader_comment,
+        initial=initial,
+        initial_state=API_STATES[initial >> 2],
+        asserts="\n".join(asserts),
+        cls=cls)
+
+
+def pairs(values, what):
+    result = {}
+    for value in values or []:
+        if "=" not in value:
+            raise ChartError("--%s expects name=value, got %s" % (what, value))
+        key, mapped = value.split("=", 1)
+        result[key.strip()] = mapped.strip()
+    return result
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--chart", required=True)
+    parser.add_argument("--out", required=True)
+    parser.add_argument("--class", dest="cls", default="ChartSafetyRules")
+    parser.add_argument("--alias", action="append", help="chartEvent=apiEvent")
+    parser.add_argument("--action", action="append", help="sentEvent=Hook")
+    args = parser.parse_args(argv)
+
+    try:
+        aliases = pairs(args.alias, "alias")
+        actions = pairs(args.action, "action")
+        chart, root = parse(args.chart)
+
+        for event in aliases:
+            if event not in chart.events:
+                raise ChartError("--alias names %s, which the chart does not use" % event)
+
+        configs, table, initial = build_table(chart, root, actions)
+        text = emit(args.chart, args.cls, chart, configs, table, initial, aliases)
+    except (ChartError, OSError) as e:
+        print("chartgen: error: %s" % e, file=sys.stderr)
+        return 1
+
+    with open(args.out, "w", encoding="utf-8") as f:
+        f.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
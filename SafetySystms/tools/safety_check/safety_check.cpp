@@ -0,0 +1,109 @@
+#include "SafetyCheck/SafetyCheck.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Bounded model check of SafetyRules against the standard safety properties.
+//
+//    safety_check [--depth N] [--threads T] [--strict] [--list]
+//
+// Explores every trigger sequence up to length N (default 32) breadth first and
+// prints a shortest counterexample per violated property. --strict adds properties
+// that SafetyRules is known to violate; --list prints the properties.
+//
+// Exit status: 0 when every property holds, 1 on a violation, 2 on usage errors.
+
+namespace
+{
+
+   using namespace safety;
+
+   void printConfig(Config config)
+   {
+       std::printf("%s.%s", name(stateOf(config)), name(subOf(config)));
+   }
+
+   void printCounterexample(const Counterexample& c)
+   {
+       std::printf("VIOLATED %s: %s\n", c.property->name, c.property->description);
+       std::printf("  trace (%zu):", c.trace.size());
+
+       for (Trigger t : c.trace)
+       {
+           std::printf(" %s", name(t));
+       }
+
+       std::printf("\n  last step: ");
+       printConfig(c.step.from);
+       std::printf(" --%s--> ", name(c.step.trigger));
+       printConfig(c.step.to);
+       std::printf("  monitor=%u\n  hooks:", c.step.monitor);
+
+       for (std::size_t h = 0; h < c.step.hookCount; ++h)
+       {
+           std::printf(" %s@%s", name(c.step.hooks[h].hook), name(c.step.hooks[h].state));
+       }
+
+       std::printf("\n");
+   }
+
+   int usage(const char* self)
+   {
+       std::fprintf(stderr, "usage: %s [--depth N] [--threads T] [--strict] [--list]\n", self);
+       return 2;
+   }
+
+}
+
+int main(int argc, char** argv)
+{
+   CheckOptions options;
+   bool strict = false;
+   bool list = false;
+
+   for (int i = 1; i < argc; ++i)
+   {
+       if (!std::strcmp(argv[i], "--strict"))                      strict = true;
+       else if (!std::strcmp(argv[i], "--list"))                   list = true;
+       else if (!std::strcmp(argv[i], "--depth") && i + 1 < argc)  options.depth = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+       else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc) options.threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+       else return usage(argv[0]);
+   }
+
+   const std::vector<Property>& properties = strict ? allProperties() : standardProperties();
+
+   if (list)
+   {
+       for (const Property& p : properties)
+       {
+           std::printf("%-26s %s\n", p.name, p.description);
+       }
+
+       return 0;
+   }
+
+   const auto start = std::chrono::steady_clock::now();
+   const CheckResult result = check(properties, options);
+   const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+   std::printf("depth %u%s, %zu states, %zu steps, %.2f ms\n", result.depth,
+               result.fixpoint ? " (fixpoint: holds for every length)" : "", result.states, result.steps, ms);
+   std::printf("new states per depth:");
+
+   for (std::size_t n : result.perLevel)
+   {
+       std::printf(" %zu", n);
+   }
+
+   std::printf("\n");
+
+   for (const Counterexample& c : result.violations)
+   {
+       printCounterexample(c);
+   }
+
+   std::printf("%zu of %zu properties hold\n", properties.size() - result.violations.size(), properties.size());
+   return result.violations.empty() ? 0 : 1;
+}
@@ -0,0 +1,583 @@
+#include "ChartSafetyRules/ChartSafetyRules.h"
+#include "CrudeSafetyRules/CrudeSafetyRules.h"
+#include "SafetyRules/SafetyRules.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Randomized differential fuzzer: SafetyRules against the chart-generated model
+// (ChartSafetyRules) and the legacy SafetyBox.
+//
+//    safety_fuzz [--sequences N] [--length L] [--threads T] [--seed S]
+//                [--no-chart] [--no-box] [--avoid State[.Sub]:trigger,...]
+//
+// Sequence i is drawn from its own RNG seeded by (seed, i), so a run is reproducible
+// regardless of thread count and any reported index can be replayed. Every step
+// compares configurations (and, between the two ISafetyRules engines, the hooks
+// fired). On divergence the lowest failing sequence is shrunk by deleting triggers
+// until no single deletion keeps it failing, then printed step by step.
+//
+// --avoid keeps the generator from delivering a trigger in a configuration (judged on
+// SafetyRules), e.g. to park a known spec delta:
+//    --avoid Faulted:evPowerOn,Faulted:evPowerOff
+//
+// Exit status: 0 no divergence, 1 divergence found, 2 usage error.
+
+namespace
+{
+
+   using namespace safety;
+
+   using Ev = ISafetyRules::Event;
+
+   std::string configName(Config config)
+   {
+       std::string label = name(stateOf(config));
+
+       if (subOf(config) != ISafetyRules::LoaderSub::None)
+       {
+           label = label + "." + name(subOf(config));
+       }
+
+       return label;
+   }
+
+   // ----- Options
+   struct Options
+   {
+       std::uint64_t sequences { 1000000 };
+       unsigned      length { 32 };
+       unsigned      threads { 0 };
+       std::uint64_t seed { 1 };
+       bool          chart { true };
+       bool          box { true };
+       std::array<std::uint8_t, kConfigCount> avoid {};   // bit per trigger
+   };
+
+   bool parseAvoid(const char* list, Options& options)
+   {
+       std::string all(list);
+       std::size_t start = 0;
+
+       while (start < all.size())
+       {
+           const std::size_t end = std::min(all.find(',', start), all.size());
+           const std::string item = all.substr(start, end - start);
+           const std::size_t colon = item.find(':');
+
+           if (colon == std::string::npos)
+           {
+               return false;
+           }
+
+           const std::string where = item.substr(0, colon);
+           const std::string what = item.substr(colon + 1);
+           bool matched = false;
+
+           for (Config c = 0; c < kConfigCount; ++c)
+           {
+               if (configName(c) != where)
+               {
+                   continue;
+               }
+
+               for (std::size_t t = 0; t < kTriggerCount; ++t)
+               {
+                   if (what == name(static_cast<Trigger>(t)))
+                   {
+                       options.avoid[c] |= static_cast<std::uint8_t>(1u << t);
+                       matched = true;
+                   }
+               }
+           }
+
+           if (!matched)
+           {
+               return false;
+           }
+
+           start = end + 1;
+       }
+
+       return true;
+   }
+
+   // ----- Per-sequence generator (splitmix64)
+   class Rng
+   {
+      public:
+          Rng(std::uint64_t seed, std::uint64_t sequence)
+              : state(seed * 0x9E3779B97F4A7C15ull ^ (sequence + 0x632BE59BD9B4E019ull))
+          {
+          }
+
+          std::uint64_t next()
+          {
+              std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+              z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+              z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+              return z ^ (z >> 31);
+          }
+
+          unsigned below(unsigned n)
+          {
+              return static_cast<unsigned>(((next() >> 32) * n) >> 32);
+          }
+
+      private:
+          std::uint64_t state;
+   };
+
+   // ----- Hooks fired during one step
+   struct HookLog
+   {
+       std::array<Hook, 4> hooks;
+       std::uint8_t        count;
+
+       bool operator==(const HookLog& other) const
+       {
+           return count == other.count && std::equal(hooks.begin(), hooks.begin() + count, other.hooks.begin());
+       }
+   };
+
+   template <Hook H>
+   void logHook(void* log)
+   {
+       HookLog& l = *static_cast<HookLog*>(log);
+
+       if (l.count < l.hooks.size())
+       {
+           l.hooks[l.count++] = H;
+       }
+   }
+
+   void installLog(ISafetyRules& uut, HookLog& log)
+   {
+       using Fn = ISafetyRules::VoidFn;
+
+       uut.setOnEnterIdle(Fn::bind<&logHook<Hook::EnterIdle>>(&log));
+       uut.setOnExitIdle(Fn::bind<&logHook<Hook::ExitIdle>>(&log));
+       uut.setOnEnterActive(Fn::bind<&logHook<Hook::EnterActive>>(&log));
+       uut.setOnExitActive(Fn::bind<&logHook<Hook::ExitActive>>(&log));
+       uut.setOnEnterFaulted(Fn::bind<&logHook<Hook::EnterFaulted>>(&log));
+       uut.setOnExitFaulted(Fn::bind<&logHook<Hook::ExitFaulted>>(&log));
+       uut.setOnEnterBuildPlateLoader(Fn::bind<&logHook<Hook::EnterBuildPlateLoader>>(&log));
+       uut.setOnExitBuildPlateLoader(Fn::bind<&logHook<Hook::ExitBuildPlateLoader>>(&log));
+       uut.setOnRequestDoorOpen(Fn::bind<&logHook<Hook::RequestDoorOpen>>(&log));
+       uut.setOnRequestLoadBuildPlate(Fn::bind<&logHook<Hook::RequestLoadBuildPlate>>(&log));
+       uut.setOnRequestDoorClose(Fn::bind<&logHook<Hook::RequestDoorClose>>(&log));
+   }
+
+   // SafetyBox commands: 0=powerOn, 1=powerOff, 2=fault, 3=start, 4=doorOpened, 5=plateArrived, 6=doorClosed
+   constexpr int kBoxCommand[] = { 0, 1, 2, 4, 5, 6, 3 };
+
+   // mode 0=off, 1=on, 2=fault; step 0=idle, 1..3 = loader substates
+   Config boxConfig(const SafetyBox& box)
+   {
+       using State = ISafetyRules::State;
+       using Sub   = ISafetyRules::LoaderSub;
+
+       switch (box.getMode())
+       {
+           case 0:  return toConfig(State::Idle, Sub::None);
+           case 2:  return toConfig(State::Faulted, Sub::None);
+           default: break;
+       }
+
+       return box.getStep() == 0 ? toConfig(State::Active, Sub::None)
+                                 : toConfig(State::BuildPlateLoader, static_cast<Sub>(box.getStep()));
+   }
+
+   // ----- One set of engines (one per thread)
+   enum class Engine { None, Chart, Box };
+
+   struct Divergence
+   {
+       Engine      engine { Engine::None };
+       std::size_t step { 0 };
+   };
+
+   class Harness
+   {
+      public:
+          explicit Harness(const Options& options)
+              : options(options)
+          {
+              installLog(rules, rulesLog);
+              installLog(chart, chartLog);
+          }
+
+          // Starts every engine from Idle
+          void restart()
+          {
+              rules.reset();
+              chart.reset();
+              box.run(1);
+          }
+
+          Config config() const
+          {
+              return toConfig(rules.getState(), rules.getLoaderSubstate());
+          }
+
+          bool avoided(Trigger trigger) const
+          {
+              return (options.avoid[config()] >> static_cast<unsigned>(trigger)) & 1u;
+          }
+
+          // Delivers one trigger everywhere; Engine::None when all agree
+          Engine step(Trigger trigger)
+          {
+              rulesLog.count = 0;
+              chartLog.count = 0;
+
+              if (trigger == Trigger::StartLoader)
+              {
+                  rules.startLoader();
+                  if (options.chart) chart.startLoader();
+              }
+              else
+              {
+                  rules.dispatch(static_cast<Ev>(trigger));
+                  if (options.chart) chart.dispatch(static_cast<Ev>(trigger));
+              }
+
+              if (options.box)
+              {
+                  box.run(kBoxCommand[static_cast<std::size_t>(trigger)]);
+              }
+
+              const Config expected = config();
+
+              if (options.chart && (toConfig(chart.getState(), chart.getLoaderSubstate()) != expected || !(chartLog == rulesLog)))
+              {
+                  return Engine::Chart;
+              }
+
+              if (options.box && boxConfig(box) != expected)
+              {
+                  return Engine::Box;
+              }
+
+              return Engine::None;
+          }
+
+          // Generates sequence `index` into trace and runs it; stops at the first divergence
+          Divergence generate(std::uint64_t index, std::vector<Trigger>& trace)
+          {
+              Rng rng(options.seed, index);
+              const unsigned length = 1 + rng.below(options.length);
+
+              trace.clear();
+              restart();
+
+              for (unsigned i = 0; i < length; ++i)
+              {
+                  Trigger t = static_cast<Trigger>(rng.below(kTriggerCount));
+
+                  for (int tries = 0; avoided(t) && tries < 16; ++tries)
+                  {
+                      t = static_cast<Trigger>(rng.below(kTriggerCount));
+                  }
+
+                  if (avoided(t))
+                  {
+                      continue;
+                  }
+
+                  trace.push_back(t);
+
+                  const Engine e = step(t);
+
+                  if (e != Engine::None)
+                  {
+                      return Divergence { e, trace.size() - 1 };
+                  }
+              }
+
+              return Divergence {};
+          }
+
+          // Replays a fixed trace; a trace that hits an avoided cell does not count
+          Divergence replay(const std::vector<Trigger>& trace)
+          {
+              restart();
+
+              for (std::size_t i = 0; i < trace.size(); ++i)
+              {
+                  if (avoided(trace[i]))
+                  {
+                      return Divergence {};
+                  }
+
+                  const Engine e = step(trace[i]);
+
+                  if (e != Engine::None)
+                  {
+                      return Divergence { e, i };
+                  }
+              }
+
+              return Divergence {};
+          }
+
+          // Step-by-step listing of a trace
+          void print(const std::vector<Trigger>& trace)
+          {
+              restart();
+
+              for (std::size_t i = 0; i < trace.size(); ++i)
+              {
+                  const Engine e = step(trace[i]);
+
+                  std::printf("  %2zu  %-18s  SafetyRules=%-30s", i, name(trace[i]),
+                              configName(config()).c_str());
+
+                  if (options.chart)
+                  {
+                      std::printf("  Chart=%-30s", configName(toConfig(chart.getState(), chart.getLoaderSubstate())).c_str());
+                  }
+
+                  if (options.box)
+                  {
+                      std::printf("  SafetyBox=%-30s", configName(boxConfig(box)).c_str());
+                  }
+
+                  std::printf("\n");
+
+                  if (e == Engine::Chart && !(chartLog == rulesLog))
+                  {
+                      printHooks("SafetyRules hooks", rulesLog);
+                      printHooks("Chart hooks      ", chartLog);
+                  }
+              }
+          }
+
+      private:
+          static void printHooks(const char* label, const HookLog& log)
+          {
+              std::printf("        %s:", label);
+
+              for (std::size_t h = 0; h < log.count; ++h)
+              {
+                  std::printf(" %s", name(log.hooks[h]));
+              }
+
+              std::printf("\n");
+          }
+
+      private:
+          const Options&   options;
+          SafetyRules      rules;
+          ChartSafetyRules chart;
+          SafetyBox        box;
+          HookLog          rulesLog {};
+          HookLog          chartLog {};
+   };
+
+   // ----- Shrinking: delete chunks, then single triggers, while the divergence remains
+   std::vector<Trigger> shrink(Harness& harness, std::vector<Trigger> trace, Engine engine)
+   {
+       auto fails = [&harness, engine](const std::vector<Trigger>& t) {
+           return harness.replay(t).engine == engine;
+       };
+
+       trace.resize(harness.replay(trace).step + 1);
+
+       for (std::size_t chunk = trace.size() / 2; chunk >= 1; chunk /= 2)
+       {
+           bool removed = true;
+
+           while (removed)
+           {
+               removed = false;
+
+               for (std::size_t at = 0; at + chunk <= trace.size(); )
+               {
+                   std::vector<Trigger> candidate(trace.begin(), trace.begin() + at);
+                   candidate.insert(candidate.end(), trace.begin() + at + chunk, trace.end());
+
+                   if (fails(candidate))
+                   {
+                       trace = std::move(candidate);
+                       trace.resize(harness.replay(trace).step + 1);
+                       removed = true;
+                   }
+                   else
+                   {
+                       at += chunk;
+                   }
+               }
+           }
+
+           if (chunk == 1)
+           {
+               break;
+           }
+       }
+
+       return trace;
+   }
+
+   // ----- SafetyBox prints every command; discard it
+   class NullBuffer : public std::streambuf
+   {
+      protected:
+          int overflow(int ch) override
+          {
+              return ch;
+          }
+
+          std::streamsize xsputn(const char*, std::streamsize n) override
+          {
+              return n;
+          }
+   };
+
+   int usage(const char* self)
+   {
+       std::fprintf(stderr,
+                    "usage: %s [--sequences N] [--length L] [--threads T] [--seed S]\n"
+                    "          [--no-chart] [--no-box] [--avoid State[.Sub]:trigger,...]\n",
+                    self);
+       return 2;
+   }
+
+}
+
+int main(int argc, char** argv)
+{
+   Options options;
+
+   for (int i = 1; i < argc; ++i)
+   {
+       const char* arg = argv[i];
+       const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+       if (!std::strcmp(arg, "--no-chart"))            options.chart = false;
+       else if (!std::strcmp(arg, "--no-box"))         options.box = false;
+       else if (!value)                                return usage(argv[0]);
+       else if (!std::strcmp(arg, "--sequences"))      options.sequences = std::strtoull(argv[++i], nullptr, 0);
+       else if (!std::strcmp(arg, "--length"))         options.length = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+       else if (!std::strcmp(arg, "--threads"))        options.threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+       else if (!std::strcmp(arg, "--seed"))           options.seed = std::strtoull(argv[++i], nullptr, 0);
+       else if (!std::strcmp(arg, "--avoid"))
+       {
+           if (!parseAvoid(argv[++i], options)) return usage(argv[0]);
+       }
+       else return usage(argv[0]);
+   }
+
+   if (options.length == 0 || (!options.chart && !options.box))
+   {
+       return usage(argv[0]);
+   }
+
+   if (options.threads == 0)
+   {
+       options.threads = std::max(1u, std::thread::hardware_concurrency());
+   }
+
+   NullBuffer sink;
+   std::streambuf* saved = std::cout.rdbuf(&sink);
+
+   // ----- Workers claim batches of sequence indices; the lowest failing index wins
+   constexpr std::uint64_t kBatch = 4096;
+   const std::uint64_t kNone = ~std::uint64_t(0);
+
+   std::atomic<std::uint64_t> nextBatch { 0 };
+   std::atomic<std::uint64_t> firstFailure { kNone };
+   std::atomic<std::uint64_t> steps { 0 };
+
+   const auto start = std::chrono::steady_clock::now();
+
+   auto worker = [&]() {
+       Harness harness(options);
+       std::vector<Trigger> trace;
+       std::uint64_t localSteps = 0;
+
+       for (;;)
+       {
+           const std::uint64_t begin = nextBatch.fetch_add(kBatch, std::memory_order_relaxed);
+
+           if (begin >= options.sequences || begin >= firstFailure.load(std::memory_order_relaxed))
+           {
+               break;
+           }
+
+           const std::uint64_t end = std::min(begin + kBatch, options.sequences);
+
+           for (std::uint64_t s = begin; s < end; ++s)
+           {
+               const Divergence d = harness.generate(s, trace);
+               localSteps += trace.size();
+
+               if (d.engine != Engine::None)
+               {
+                   std::uint64_t seen = firstFailure.load();
+
+                   while (s < seen && !firstFailure.compare_exchange_weak(seen, s))
+                   {
+                   }
+
+                   break;
+               }
+           }
+       }
+
+       steps.fetch_add(localSteps, std::memory_order_relaxed);
+   };
+
+   std::vector<std::thread> workers;
+
+   for (unsigned t = 0; t < options.threads; ++t)
+   {
+       workers.emplace_back(worker);
+   }
+
+   for (auto& w : workers)
+   {
+       w.join();
+   }
+
+   const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   const std::uint64_t failed = firstFailure.load();
+   const std::uint64_t ran = std::min(options.sequences, failed == kNone ? options.sequences : failed + 1);
+
+   std::printf("%llu sequences, %llu steps, %u threads, %.2f s (%.1f M steps/s)\n",
+               static_cast<unsigned long long>(ran), static_cast<unsigned long long>(steps.load()),
+               options.threads, seconds, static_cast<double>(steps.load()) / seconds / 1e6);
+
+   if (failed == kNone)
+   {
+       std::cout.rdbuf(saved);
+       std::printf("no divergence (seed %llu)\n", static_cast<unsigned long long>(options.seed));
+       return 0;
+   }
+
+   // ----- Reproduce, shrink and report the lowest failing sequence
+   Harness harness(options);
+   std::vector<Trigger> trace;
+   const Divergence d = harness.generate(failed, trace);
+   const std::vector<Trigger> minimal = shrink(harness, trace, d.engine);
+
+   std::printf("divergence: SafetyRules vs %s in sequence %llu (seed %llu), step %zu of %zu; shrunk to %zu:\n",
+               d.engine == Engine::Chart ? "ChartSafetyRules" : "SafetyBox",
+               static_cast<unsigned long long>(failed), static_cast<unsigned long long>(options.seed),
+               d.step, trace.size(), minimal.size());
+
+   harness.print(minimal);
+   std::cout.rdbuf(saved);
+   return 1;
+}
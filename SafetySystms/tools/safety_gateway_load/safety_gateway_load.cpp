@@ -0,0 +1,309 @@
+#include "SafetyGateway/GatewayProtocol.h"
+#include "SafetyRules/SafetyTable.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Load generator for safety_gatewayd.
+//
+//    safety_gateway_load --socket PATH [--clients C] [--printers P] [--cycles N] [--chunk F]
+//
+// C clients (default 4) connect at once and split printers 0 .. P-1 (default
+// 65536) between them. Each drives its printers through N loader cycles (default
+// 50: evPowerOn, startLoader, evDoorOpened, evBuildPlateLoaded, evDoorClosed,
+// evPowerOff), one step for all of its printers at a time, writing F frames
+// (default 8192) per send while it reads its notifications back. It then shuts
+// down its write side and reads until the gateway closes the connection.
+//
+// Checks: every cycle ends in Idle, so the last StateFrame a client gets for a
+// printer must say Idle. Run against a gateway whose printers are in Idle (fresh,
+// or after a previous run of this tool).
+//
+// Exit status: 0 when every notification checks out, 1 otherwise, 2 on usage or
+// socket errors.
+
+namespace
+{
+
+   using namespace safety;
+   using State = ISafetyRules::State;
+   using Sub   = ISafetyRules::LoaderSub;
+
+   constexpr Trigger kCycle[] = { Trigger::evPowerOn, Trigger::StartLoader, Trigger::evDoorOpened,
+                                  Trigger::evBuildPlateLoaded, Trigger::evDoorClosed, Trigger::evPowerOff };
+
+   constexpr std::size_t kSteps = sizeof(kCycle) / sizeof(kCycle[0]);
+
+   struct Options
+   {
+       const char*   socketPath { nullptr };
+       unsigned      clients { 4 };
+       std::uint32_t printers { 65536 };
+       unsigned      cycles { 50 };
+       std::size_t   chunk { 8192 };
+   };
+
+   struct ClientResult
+   {
+       std::uint64_t sent { 0 };            // event frames
+       std::uint64_t notifications { 0 };
+       std::uint64_t notified { 0 };        // distinct printers
+       std::uint64_t wrong { 0 };           // foreign printers, or a last state other than Idle
+       const char*   error { nullptr };
+   };
+
+   // The frames of one client, produced a chunk at a time
+   class Generator
+   {
+      public:
+          Generator(std::uint32_t first, std::uint32_t count, unsigned cycles)
+              : first(first), count(count), total(static_cast<std::uint64_t>(count) * kSteps * cycles)
+          {
+          }
+
+          std::size_t fill(EventFrame* out, std::size_t max)
+          {
+              std::size_t n = 0;
+
+              for (; n < max && position < total; ++n, ++position)
+              {
+                  const std::uint64_t step = position / count;
+                  out[n] = EventFrame { first + static_cast<std::uint32_t>(position % count), kCycle[step % kSteps], {} };
+              }
+
+              return n;
+          }
+
+      private:
+          std::uint32_t first;
+          std::uint32_t count;
+          std::uint64_t total;
+          std::uint64_t position { 0 };
+   };
+
+   int connectTo(const char* path)
+   {
+       sockaddr_un address {};
+       address.sun_family = AF_UNIX;
+       std::strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+       const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+       if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+           || ::fcntl(fd, F_SETFL, O_NONBLOCK) != 0)
+       {
+           if (fd >= 0)
+           {
+               ::close(fd);
+           }
+
+           return -1;
+       }
+
+       return fd;
+   }
+
+   void runClient(const Options& options, unsigned c, ClientResult& result)
+   {
+       const auto first = static_cast<std::uint32_t>(std::uint64_t(options.printers) * c / options.clients);
+       const auto last  = static_cast<std::uint32_t>(std::uint64_t(options.printers) * (c + 1) / options.clients);
+
+       const int fd = connectTo(options.socketPath);
+
+       if (fd < 0)
+       {
+           result.error = std::strerror(errno);
+           return;
+       }
+
+       Generator generator(first, last - first, options.cycles);
+       std::vector<EventFrame> out(options.chunk);
+       std::size_t outBytes = 0;
+       std::size_t outSent = 0;
+       std::uint64_t sentBytes = 0;
+       bool writing = true;
+
+       std::vector<Config> latest(last - first, 0xFF);
+       std::vector<char> in(64 * 1024 + sizeof(StateFrame));
+       std::size_t carry = 0;
+
+       for (;;)
+       {
+           if (writing && outSent == outBytes)
+           {
+               outBytes = generator.fill(out.data(), out.size()) * sizeof(EventFrame);
+               outSent = 0;
+
+               if (outBytes == 0)
+               {
+                   ::shutdown(fd, SHUT_WR);
+                   writing = false;
+               }
+           }
+
+           pollfd p { fd, static_cast<short>(POLLIN | (writing ? POLLOUT : 0)), 0 };
+
+           if (::poll(&p, 1, -1) < 0)
+           {
+               if (errno == EINTR)
+               {
+                   continue;
+               }
+
+               result.error = std::strerror(errno);
+               break;
+           }
+
+           if (writing && (p.revents & POLLOUT))
+           {
+               const ssize_t sent = ::send(fd, reinterpret_cast<const char*>(out.data()) + outSent, outBytes - outSent,
+                                           MSG_NOSIGNAL);
+
+               if (sent < 0 && errno != EAGAIN && errno != EINTR)
+               {
+                   result.error = std::strerror(errno);
+                   break;
+               }
+
+               if (sent > 0)
+               {
+                   outSent += static_cast<std::size_t>(sent);
+                   sentBytes += static_cast<std::uint64_t>(sent);
+               }
+           }
+
+           if (p.revents & (POLLIN | POLLHUP | POLLERR))
+           {
+               const ssize_t got = ::recv(fd, in.data() + carry, in.size() - carry, 0);
+
+               if (got == 0)
+               {
+                   break;   // the gateway has sent everything and closed
+               }
+
+               if (got < 0)
+               {
+                   if (errno == EAGAIN || errno == EINTR)
+                   {
+                       continue;
+                   }
+
+                   result.error = std::strerror(errno);
+                   break;
+               }
+
+               const std::size_t total = carry + static_cast<std::size_t>(got);
+               const std::size_t whole = total - total % sizeof(StateFrame);
+
+               for (std::size_t offset = 0; offset < whole; offset += sizeof(StateFrame))
+               {
+                   StateFrame state;
+                   std::memcpy(&state, in.data() + offset, sizeof(state));
+                   ++result.notifications;
+
+                   if (state.printer < first || state.printer >= last)
+                   {
+                       ++result.wrong;
+                       continue;
+                   }
+
+                   latest[state.printer - first] = state.config;
+               }
+
+               carry = total - whole;
+               std::memmove(in.data(), in.data() + whole, carry);
+           }
+       }
+
+       ::close(fd);
+       result.sent = sentBytes / sizeof(EventFrame);
+
+       for (Config config : latest)
+       {
+           if (config != 0xFF)
+           {
+               ++result.notified;
+               result.wrong += config != toConfig(State::Idle, Sub::None);
+           }
+       }
+   }
+
+   int usage(const char* self)
+   {
+       std::fprintf(stderr, "usage: %s --socket PATH [--clients C] [--printers P] [--cycles N] [--chunk F]\n", self);
+       return 2;
+   }
+
+}
+
+int main(int argc, char** argv)
+{
+   Options options;
+
+   for (int i = 1; i < argc; ++i)
+   {
+       if (!std::strcmp(argv[i], "--socket") && i + 1 < argc)        options.socketPath = argv[++i];
+       else if (!std::strcmp(argv[i], "--clients") && i + 1 < argc)  options.clients = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+       else if (!std::strcmp(argv[i], "--printers") && i + 1 < argc) options.printers = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+       else if (!std::strcmp(argv[i], "--cycles") && i + 1 < argc)   options.cycles = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+       else if (!std::strcmp(argv[i], "--chunk") && i + 1 < argc)    options.chunk = std::strtoull(argv[++i], nullptr, 0);
+       else return usage(argv[0]);
+   }
+
+   if (!options.socketPath || options.clients == 0 || options.printers < options.clients || options.chunk == 0)
+   {
+       return usage(argv[0]);
+   }
+
+   std::vector<ClientResult> results(options.clients);
+   std::vector<std::thread> clients;
+
+   const auto start = std::chrono::steady_clock::now();
+
+   for (unsigned c = 0; c < options.clients; ++c)
+   {
+       clients.emplace_back([&options, &results, c]() { runClient(options, c, results[c]); });
+   }
+
+   for (auto& t : clients)
+   {
+       t.join();
+   }
+
+   const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   ClientResult total;
+
+   for (const ClientResult& r : results)
+   {
+       if (r.error)
+       {
+           std::fprintf(stderr, "safety_gateway_load: %s: %s\n", options.socketPath, r.error);
+           return 2;
+       }
+
+       total.sent += r.sent;
+       total.notifications += r.notifications;
+       total.notified += r.notified;
+       total.wrong += r.wrong;
+   }
+
+   std::printf("%u clients, %llu events in %.3f s: %.2f M events/s\n", options.clients,
+               static_cast<unsigned long long>(total.sent), seconds, static_cast<double>(total.sent) / seconds / 1e6);
+   std::printf("%llu notifications, %llu printers notified, %llu wrong\n",
+               static_cast<unsigned long long>(total.notifications), static_cast<unsigned long long>(total.notified),
+               static_cast<unsigned long long>(total.wrong));
+
+   return total.wrong == 0 ? 0 : 1;
+}
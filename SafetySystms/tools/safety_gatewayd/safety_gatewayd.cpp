@@ -0,0 +1,114 @@
+#include "SafetyGateway/SafetyGateway.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+
+// Event gateway daemon: a fleet of printers fed by local clients over a Unix
+// domain socket (frames in SafetyGateway/GatewayProtocol.h).
+//
+//    safety_gatewayd --socket PATH [--printers N] [--stats SECONDS]
+//
+// Runs until SIGINT or SIGTERM. Every --stats seconds (default 5, 0 = never) it
+// prints events/s over the interval, the mean batch size and the client count.
+//
+// Exit status: 0 after a signal, 2 on usage or socket errors.
+
+namespace
+{
+
+   using namespace safety;
+
+   SafetyGateway* gGateway = nullptr;
+
+   extern "C" void onSignal(int)
+   {
+       if (gGateway)
+       {
+           gGateway->stop();
+       }
+   }
+
+   int usage(const char* self)
+   {
+       std::fprintf(stderr, "usage: %s --socket PATH [--printers N] [--stats SECONDS]\n", self);
+       return 2;
+   }
+
+   void report(const SafetyGateway::Stats& s, const SafetyGateway::Stats& last, double seconds)
+   {
+       const std::uint64_t frames  = s.frames - last.frames;
+       const std::uint64_t batches = s.batches - last.batches;
+
+       std::printf("%.2f M events/s, %.0f events/batch (largest %zu), %zu clients, "
+                   "%llu rejected, %llu notifications (%llu dropped)\n",
+                   static_cast<double>(frames) / seconds / 1e6,
+                   batches ? static_cast<double>(frames) / static_cast<double>(batches) : 0.0, s.largestBatch,
+                   s.connections, static_cast<unsigned long long>(s.rejected),
+                   static_cast<unsigned long long>(s.notifications), static_cast<unsigned long long>(s.dropped));
+       std::fflush(stdout);
+   }
+
+}
+
+int main(int argc, char** argv)
+{
+   const char* socketPath = nullptr;
+   std::size_t printers = 1 << 20;
+   double interval = 5;
+
+   for (int i = 1; i < argc; ++i)
+   {
+       if (!std::strcmp(argv[i], "--socket") && i + 1 < argc)        socketPath = argv[++i];
+       else if (!std::strcmp(argv[i], "--printers") && i + 1 < argc) printers = std::strtoull(argv[++i], nullptr, 0);
+       else if (!std::strcmp(argv[i], "--stats") && i + 1 < argc)    interval = std::strtod(argv[++i], nullptr);
+       else return usage(argv[0]);
+   }
+
+   if (!socketPath || printers == 0)
+   {
+       return usage(argv[0]);
+   }
+
+   try
+   {
+       SafetyGateway gateway(socketPath, printers);
+       gGateway = &gateway;
+
+       struct sigaction action {};
+       action.sa_handler = onSignal;
+       sigaction(SIGINT, &action, nullptr);
+       sigaction(SIGTERM, &action, nullptr);
+
+       std::printf("listening on %s, %zu printers\n", socketPath, printers);
+       std::fflush(stdout);
+
+       using Clock = std::chrono::steady_clock;
+       SafetyGateway::Stats last = gateway.stats();
+       Clock::time_point since = Clock::now();
+
+       while (gateway.pollOnce(interval > 0 ? 100 : -1))
+       {
+           const double seconds = std::chrono::duration<double>(Clock::now() - since).count();
+
+           if (interval > 0 && seconds >= interval)
+           {
+               report(gateway.stats(), last, seconds);
+               last = gateway.stats();
+               since = Clock::now();
+           }
+       }
+
+       report(gateway.stats(), last, std::chrono::duration<double>(Clock::now() - since).count());
+       gGateway = nullptr;
+       return 0;
+   }
+   catch (const std::exception& e)
+   {
+       std::fprintf(stderr, "safety_gatewayd: %s\n", e.what());
+       return 2;
+   }
+}
@@ -0,0 +1,86 @@
+#include "SafetyJournal/SafetyJournal.h"
+#include "SafetyRules/SafetyRules.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+// Replays a journal written by SafetyJournal into a fresh SafetyRules and checks
+// that every step lands in the recorded configuration.
+//
+//    safety_replay <journal> [--dump]
+//
+// Prints the replay throughput in records/s.
+// Exit status: 0 when the replay matches, 1 on divergence, 2 on usage or I/O errors.
+// The replay starts from the configuration the machine had when the journal was attached.
+
+namespace
+{
+
+   using namespace safety;
+
+   void printConfig(Config config)
+   {
+       std::printf("%s.%s", name(stateOf(config)), name(subOf(config)));
+   }
+
+   void dump(const JournalReader& journal)
+   {
+       for (const JournalRecord& r : journal)
+       {
+           std::printf("%8u  %12.6f ms  %-18s -> ", r.sequence,
+                       static_cast<double>(r.timestampNs - journal.startNs()) / 1e6, name(r.trigger));
+           printConfig(r.result);
+           std::printf("\n");
+       }
+   }
+
+}
+
+int main(int argc, char** argv)
+{
+   if (argc < 2 || argc > 3 || (argc == 3 && std::strcmp(argv[2], "--dump") != 0))
+   {
+       std::fprintf(stderr, "usage: %s <journal> [--dump]\n", argv[0]);
+       return 2;
+   }
+
+   try
+   {
+       JournalReader journal(argv[1]);
+
+       if (argc == 3)
+       {
+           dump(journal);
+       }
+
+       SafetyRules rules;
+
+       const auto start = std::chrono::steady_clock::now();
+       const ReplayResult result = replay(journal, rules);
+       const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+       const double rate = elapsed.count() > 0 ? static_cast<double>(result.replayed) / elapsed.count() : 0.0;
+
+       std::printf("replayed %zu records in %.6f s (%.0f records/s)", result.replayed, elapsed.count(), rate);
+
+       if (result.mismatches == 0)
+       {
+           std::printf(", no divergence\n");
+           return 0;
+       }
+
+       std::printf(", %zu diverged; first at #%zu: expected ", result.mismatches, result.firstMismatch);
+       printConfig(result.expected);
+       std::printf(", got ");
+       printConfig(result.actual);
+       std::printf("\n");
+       return 1;
+   }
+   catch (const std::exception& e)
+   {
+       std::fprintf(stderr, "%s: %s\n", argv[0], e.what());
+       return 2;
+   }
+}